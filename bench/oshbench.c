@@ -0,0 +1,765 @@
+/* -*- C -*-
+ *
+ * Copyright (c) 2022 Intel Corporation. All rights reserved.
+ * This software is available to you under the BSD license.
+ *
+ * This file is part of the Sandia OpenSHMEM software package. For license
+ * information, see the LICENSE file in the top level directory of the
+ * distribution.
+ *
+ */
+
+/* oshbench: RMA, atomic, and collective microbenchmarks.
+ *
+ * Point-to-point benchmarks run between PE 0 and the last PE, so that with a
+ * block mapping of PEs to nodes they cross the network.  Message rate runs
+ * between the two halves of the job.  Collectives run on each requested team
+ * shape.  Results are printed by PE 0 as CSV or JSON, one record per
+ * benchmark, team and message size.
+ *
+ * The collective algorithms are selected by the library at initialization,
+ * from SHMEM_BARRIER_ALGORITHM, SHMEM_BCAST_ALGORITHM, etc.  The value in
+ * effect is reported with each result; oshbench-sweep reruns the suite for
+ * every algorithm. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include <pthread.h>
+#include <time.h>
+#include <sys/time.h>
+
+#include <shmem.h>
+
+#define WINDOW 64
+
+enum { FORMAT_CSV, FORMAT_JSON };
+
+static int me, npes;
+static size_t min_size = 1;
+static size_t max_size = 1 << 20;
+static long iterations = 1000;
+static long warmup = 100;
+static int nthreads = 1;
+static int format = FORMAT_CSV;
+static const char *team_list = "world";
+static int nrecords = 0;
+
+static char *src_buf, *dst_buf;
+static double *time_buf;
+static uint64_t *signal_var;
+static uint64_t signal_seq = 0;
+
+/* Per-team state of the current collective benchmark */
+struct bench_team {
+    const char *name;
+    shmem_team_t team;
+    int size;
+};
+
+static double
+wtime(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1.0e9;
+}
+
+
+/* Slowest PE's elapsed time.  Symmetric objects are allocated on the heap,
+ * since the data segment is only symmetric in non-PIE executables. */
+static double
+max_time(double t)
+{
+    time_buf[0] = t;
+    shmem_double_max_reduce(SHMEM_TEAM_WORLD, &time_buf[1], &time_buf[0], 1);
+    return time_buf[1];
+}
+
+
+/* Large transfers run fewer iterations, so that every size moves a similar
+ * amount of data */
+static long
+iters_for(size_t size)
+{
+    long n = iterations;
+
+    if (size > 8192) n = (long) (iterations * 8192 / size);
+    return n < 10 ? 10 : n;
+}
+
+
+static const char *
+algorithm_of(const char *envvar)
+{
+    const char *val;
+
+    if (NULL == envvar) return "-";
+
+    val = getenv(envvar);
+    return (NULL == val || '\0' == val[0]) ? "auto" : val;
+}
+
+
+static void
+emit(const char *bench, const char *team, int team_npes, const char *alg_env,
+     size_t size, long iters, double lat_us, double bw_MBps, double rate_Mops)
+{
+    const char *alg = algorithm_of(alg_env);
+
+    if (me != 0) return;
+
+    if (FORMAT_CSV == format) {
+        if (0 == nrecords)
+            printf("bench,team,npes,threads,algorithm,size,iterations,"
+                   "latency_us,bandwidth_MBps,rate_Mops\n");
+        printf("%s,%s,%d,%d,%s,%zu,%ld,%.3f,%.3f,%.3f\n", bench, team,
+               team_npes, nthreads, alg, size, iters, lat_us, bw_MBps,
+               rate_Mops);
+    } else {
+        printf("%s{\"bench\":\"%s\",\"team\":\"%s\",\"npes\":%d,\"threads\":%d,"
+               "\"algorithm\":\"%s\",\"size\":%zu,\"iterations\":%ld,"
+               "\"latency_us\":%.3f,\"bandwidth_MBps\":%.3f,\"rate_Mops\":%.3f}",
+               nrecords ? ",\n" : "[\n", bench, team, team_npes, nthreads, alg,
+               size, iters, lat_us, bw_MBps, rate_Mops);
+    }
+
+    nrecords++;
+    fflush(stdout);
+}
+
+
+/* ------------------------------------------------------------------------ */
+/* Point-to-point RMA                                                         */
+/* ------------------------------------------------------------------------ */
+
+static int
+need_peer(const char *bench)
+{
+    if (npes >= 2) return 1;
+    if (me == 0)
+        fprintf(stderr, "oshbench: %s requires at least 2 PEs, skipping\n", bench);
+    return 0;
+}
+
+
+static void
+bench_put_lat(void)
+{
+    size_t size;
+    int peer = npes - 1;
+
+    if (!need_peer("put_lat")) return;
+
+    for (size = min_size; size <= max_size; size *= 2) {
+        long i, n = iters_for(size);
+        double t = 0;
+
+        shmem_barrier_all();
+        if (me == 0) {
+            for (i = 0; i < warmup; i++) {
+                shmem_putmem(dst_buf, src_buf, size, peer);
+                shmem_quiet();
+            }
+            t = wtime();
+            for (i = 0; i < n; i++) {
+                shmem_putmem(dst_buf, src_buf, size, peer);
+                shmem_quiet();
+            }
+            t = wtime() - t;
+        }
+        emit("put_lat", "pair", 2, NULL, size, n, t / n * 1e6, size * n / t / 1e6,
+             n / t / 1e6);
+    }
+}
+
+
+static void
+bench_get_lat(void)
+{
+    size_t size;
+    int peer = npes - 1;
+
+    if (!need_peer("get_lat")) return;
+
+    for (size = min_size; size <= max_size; size *= 2) {
+        long i, n = iters_for(size);
+        double t = 0;
+
+        shmem_barrier_all();
+        if (me == 0) {
+            for (i = 0; i < warmup; i++)
+                shmem_getmem(dst_buf, src_buf, size, peer);
+            t = wtime();
+            for (i = 0; i < n; i++)
+                shmem_getmem(dst_buf, src_buf, size, peer);
+            t = wtime() - t;
+        }
+        emit("get_lat", "pair", 2, NULL, size, n, t / n * 1e6, size * n / t / 1e6,
+             n / t / 1e6);
+    }
+}
+
+
+static void
+bench_put_bw(void)
+{
+    size_t size;
+    int peer = npes - 1;
+
+    if (!need_peer("put_bw")) return;
+
+    for (size = min_size; size <= max_size; size *= 2) {
+        long i, n = iters_for(size) * WINDOW;
+        double t = 0;
+
+        shmem_barrier_all();
+        if (me == 0) {
+            for (i = 0; i < warmup; i++)
+                shmem_putmem_nbi(dst_buf, src_buf, size, peer);
+            shmem_quiet();
+            t = wtime();
+            for (i = 0; i < n; i++) {
+                shmem_putmem_nbi(dst_buf, src_buf, size, peer);
+                if (i % WINDOW == WINDOW - 1) shmem_quiet();
+            }
+            shmem_quiet();
+            t = wtime() - t;
+        }
+        emit("put_bw", "pair", 2, NULL, size, n, t / n * 1e6, size * n / t / 1e6,
+             n / t / 1e6);
+    }
+}
+
+
+static void
+bench_get_bw(void)
+{
+    size_t size;
+    int peer = npes - 1;
+
+    if (!need_peer("get_bw")) return;
+
+    for (size = min_size; size <= max_size; size *= 2) {
+        long i, n = iters_for(size) * WINDOW;
+        double t = 0;
+
+        shmem_barrier_all();
+        if (me == 0) {
+            for (i = 0; i < warmup; i++)
+                shmem_getmem_nbi(dst_buf, src_buf, size, peer);
+            shmem_quiet();
+            t = wtime();
+            for (i = 0; i < n; i++) {
+                shmem_getmem_nbi(dst_buf, src_buf, size, peer);
+                if (i % WINDOW == WINDOW - 1) shmem_quiet();
+            }
+            shmem_quiet();
+            t = wtime() - t;
+        }
+        emit("get_bw", "pair", 2, NULL, size, n, t / n * 1e6, size * n / t / 1e6,
+             n / t / 1e6);
+    }
+}
+
+
+/* Ping-pong with put-with-signal; reports half the round trip time */
+static void
+bench_put_signal(void)
+{
+    size_t size;
+    int peer = npes - 1;
+
+    if (!need_peer("put_signal")) return;
+
+    for (size = min_size; size <= max_size; size *= 2) {
+        long i, n = iters_for(size);
+        double t = 0;
+
+        shmem_barrier_all();
+        if (me == 0 || me == peer) {
+            int other = (me == 0) ? peer : 0;
+
+            for (i = 0; i < warmup + n; i++) {
+                if (i == warmup) t = wtime();
+                signal_seq++;
+                if (me == 0) {
+                    shmem_putmem_signal(dst_buf, src_buf, size, signal_var,
+                                        signal_seq, SHMEM_SIGNAL_SET, other);
+                    shmem_signal_wait_until(signal_var, SHMEM_CMP_GE, signal_seq);
+                } else {
+                    shmem_signal_wait_until(signal_var, SHMEM_CMP_GE, signal_seq);
+                    shmem_putmem_signal(dst_buf, src_buf, size, signal_var,
+                                        signal_seq, SHMEM_SIGNAL_SET, other);
+                }
+            }
+            t = wtime() - t;
+        }
+        emit("put_signal", "pair", 2, NULL, size, n, t / n / 2 * 1e6,
+             size * n * 2 / t / 1e6, n * 2 / t / 1e6);
+    }
+}
+
+
+/* ------------------------------------------------------------------------ */
+/* Message rate                                                               */
+/* ------------------------------------------------------------------------ */
+
+struct rate_arg {
+    size_t size;
+    long n;
+    int peer;
+    char *dst;
+};
+
+static void *
+rate_thread(void *arg)
+{
+    struct rate_arg *ra = (struct rate_arg *) arg;
+    shmem_ctx_t ctx;
+    long i;
+
+    if (0 != shmem_ctx_create(SHMEM_CTX_PRIVATE, &ctx))
+        ctx = SHMEM_CTX_DEFAULT;
+
+    for (i = 0; i < ra->n; i++) {
+        shmem_ctx_putmem_nbi(ctx, ra->dst, src_buf, ra->size, ra->peer);
+        if (i % WINDOW == WINDOW - 1) shmem_ctx_quiet(ctx);
+    }
+    shmem_ctx_quiet(ctx);
+
+    if (ctx != SHMEM_CTX_DEFAULT) shmem_ctx_destroy(ctx);
+
+    return NULL;
+}
+
+
+/* The lower half of the PEs each run nthreads threads, with a context per
+ * thread, that put to the corresponding PE in the upper half.  A single thread
+ * runs on the main thread, since the library was initialized without thread
+ * support. */
+static void
+bench_msg_rate(void)
+{
+    size_t size;
+    size_t rate_max = max_size < 8192 ? max_size : 8192;
+    int half = npes / 2;
+    pthread_t *threads;
+    struct rate_arg *args;
+    double elapsed, max_elapsed;
+
+    if (!need_peer("msg_rate")) return;
+
+    threads = malloc(nthreads * sizeof(pthread_t));
+    args = malloc(nthreads * sizeof(struct rate_arg));
+
+    for (size = min_size; size <= rate_max; size *= 2) {
+        long n = iters_for(size) * WINDOW;
+        int i;
+
+        elapsed = 0;
+        shmem_barrier_all();
+
+        if (me < half) {
+            double t = wtime();
+
+            for (i = 0; i < nthreads; i++) {
+                args[i].size = size;
+                args[i].n    = n;
+                args[i].peer = me + half;
+                args[i].dst  = dst_buf + i * size;
+            }
+
+            if (nthreads == 1) {
+                rate_thread(&args[0]);
+            } else {
+                for (i = 0; i < nthreads; i++)
+                    pthread_create(&threads[i], NULL, rate_thread, &args[i]);
+                for (i = 0; i < nthreads; i++)
+                    pthread_join(threads[i], NULL);
+            }
+
+            elapsed = wtime() - t;
+        }
+
+        max_elapsed = max_time(elapsed);
+
+        emit("msg_rate", "world", npes, NULL, size, n,
+             max_elapsed / n * 1e6,
+             (double) size * n * nthreads * half / max_elapsed / 1e6,
+             (double) n * nthreads * half / max_elapsed / 1e6);
+    }
+
+    free(threads);
+    free(args);
+}
+
+
+/* ------------------------------------------------------------------------ */
+/* Atomics                                                                    */
+/* ------------------------------------------------------------------------ */
+
+enum { AMO_FETCH_ADD, AMO_ADD, AMO_CSWAP, AMO_FETCH };
+
+/* Keeps the fetched values live */
+static volatile long amo_sink;
+
+static void
+amo_run(int op, long n, int peer, long *target)
+{
+    long i, v = 0;
+
+    for (i = 0; i < n; i++) {
+        switch (op) {
+        case AMO_FETCH_ADD:
+            v += shmem_long_atomic_fetch_add(target, 1, peer);
+            break;
+        case AMO_ADD:
+            shmem_long_atomic_add(target, 1, peer);
+            break;
+        case AMO_CSWAP:
+            v += shmem_long_atomic_compare_swap(target, i, i + 1, peer);
+            break;
+        case AMO_FETCH:
+            v += shmem_long_atomic_fetch(target, peer);
+            break;
+        }
+    }
+    if (AMO_ADD == op) shmem_quiet();
+
+    amo_sink = v;
+}
+
+
+static void
+bench_amo(void)
+{
+    static const char *names[] = { "amo_fetch_add", "amo_add", "amo_cswap", "amo_fetch" };
+    long *target = (long *) dst_buf;
+    int op, peer = npes - 1;
+
+    if (!need_peer("amo")) return;
+
+    for (op = AMO_FETCH_ADD; op <= AMO_FETCH; op++) {
+        long n = iterations * 10;
+        double t = 0;
+
+        *target = 0;
+        shmem_barrier_all();
+        if (me == 0) {
+            amo_run(op, warmup, peer, target);
+            shmem_long_atomic_set(target, 0, peer);
+            shmem_quiet();
+            t = wtime();
+            amo_run(op, n, peer, target);
+            t = wtime() - t;
+        }
+        emit(names[op], "pair", 2, NULL, sizeof(long), n, t / n * 1e6,
+             sizeof(long) * n / t / 1e6, n / t / 1e6);
+    }
+}
+
+
+/* ------------------------------------------------------------------------ */
+/* Collectives                                                                */
+/* ------------------------------------------------------------------------ */
+
+enum { COLL_BARRIER, COLL_BCAST, COLL_REDUCE, COLL_COLLECT, COLL_FCOLLECT,
+       COLL_ALLTOALL, COLL_NUM };
+
+static const char *coll_names[COLL_NUM] = {
+    "barrier", "bcast", "reduce", "collect", "fcollect", "alltoall"
+};
+
+static const char *coll_env[COLL_NUM] = {
+    "SHMEM_BARRIER_ALGORITHM", "SHMEM_BCAST_ALGORITHM", "SHMEM_REDUCE_ALGORITHM",
+    "SHMEM_COLLECT_ALGORITHM", "SHMEM_FCOLLECT_ALGORITHM", NULL
+};
+
+
+static void
+coll_run(int op, struct bench_team *bt, size_t size)
+{
+    switch (op) {
+    case COLL_BARRIER:
+        if (bt->team == SHMEM_TEAM_WORLD)
+            shmem_barrier_all();
+        else
+            shmem_team_sync(bt->team);
+        break;
+    case COLL_BCAST:
+        shmem_broadcastmem(bt->team, dst_buf, src_buf, size, 0);
+        break;
+    case COLL_REDUCE:
+        shmem_long_sum_reduce(bt->team, (long *) dst_buf, (long *) src_buf,
+                              size / sizeof(long));
+        break;
+    case COLL_COLLECT:
+        shmem_collectmem(bt->team, dst_buf, src_buf, size);
+        break;
+    case COLL_FCOLLECT:
+        shmem_fcollectmem(bt->team, dst_buf, src_buf, size);
+        break;
+    case COLL_ALLTOALL:
+        shmem_alltoallmem(bt->team, dst_buf, src_buf, size);
+        break;
+    }
+}
+
+
+static void
+bench_coll_team(int op, struct bench_team *bt)
+{
+    double elapsed, max_elapsed;
+    size_t size, lo = min_size, hi = max_size;
+
+    if (COLL_BARRIER == op) {
+        lo = hi = 0;
+    } else if (COLL_REDUCE == op) {
+        if (lo < sizeof(long)) lo = sizeof(long);
+    } else if (COLL_COLLECT == op || COLL_FCOLLECT == op || COLL_ALLTOALL == op) {
+        /* Per-PE contribution; the buffers hold max_size bytes in total */
+        hi = max_size / bt->size;
+    }
+
+    for (size = lo; size <= hi; size = size ? size * 2 : 1) {
+        long i, n = iters_for(size);
+
+        elapsed = 0;
+        if (bt->team != SHMEM_TEAM_INVALID) {
+            for (i = 0; i < warmup; i++)
+                coll_run(op, bt, size);
+            shmem_team_sync(bt->team);
+
+            elapsed = wtime();
+            for (i = 0; i < n; i++)
+                coll_run(op, bt, size);
+            elapsed = wtime() - elapsed;
+        }
+
+        max_elapsed = max_time(elapsed);
+
+        emit(coll_names[op], bt->name, bt->size, coll_env[op], size, n,
+             max_elapsed / n * 1e6, size * n / max_elapsed / 1e6,
+             n / max_elapsed / 1e6);
+
+        if (size == 0) break;
+    }
+}
+
+
+/* Team shapes: world, the first half of the PEs, and the even PEs.  PE 0 is
+ * in every team, and reports the results. */
+static int
+team_create(const char *name, struct bench_team *bt)
+{
+    int start = 0, stride = 1, size = npes;
+
+    bt->name = name;
+
+    if (0 == strcmp(name, "world")) {
+        bt->team = SHMEM_TEAM_WORLD;
+        bt->size = npes;
+        return 0;
+    } else if (0 == strcmp(name, "half")) {
+        size = npes / 2;
+    } else if (0 == strcmp(name, "even")) {
+        stride = 2;
+        size = (npes + 1) / 2;
+    } else {
+        if (me == 0) fprintf(stderr, "oshbench: unknown team '%s'\n", name);
+        return 1;
+    }
+
+    if (size < 1) size = 1;
+
+    bt->size = size;
+    shmem_team_split_strided(SHMEM_TEAM_WORLD, start, stride, size, NULL, 0,
+                             &bt->team);
+    return 0;
+}
+
+
+static void
+bench_coll(int op)
+{
+    char *list = strdup(team_list), *saveptr = NULL, *name;
+
+    for (name = strtok_r(list, ",", &saveptr); name != NULL;
+         name = strtok_r(NULL, ",", &saveptr)) {
+        struct bench_team bt;
+
+        if (0 != team_create(name, &bt)) continue;
+
+        bench_coll_team(op, &bt);
+
+        if (bt.team != SHMEM_TEAM_WORLD && bt.team != SHMEM_TEAM_INVALID)
+            shmem_team_destroy(bt.team);
+    }
+
+    free(list);
+}
+
+static void bench_barrier(void)  { bench_coll(COLL_BARRIER); }
+static void bench_bcast(void)    { bench_coll(COLL_BCAST); }
+static void bench_reduce(void)   { bench_coll(COLL_REDUCE); }
+static void bench_collect(void)  { bench_coll(COLL_COLLECT); }
+static void bench_fcollect(void) { bench_coll(COLL_FCOLLECT); }
+static void bench_alltoall(void) { bench_coll(COLL_ALLTOALL); }
+
+
+/* ------------------------------------------------------------------------ */
+
+struct bench {
+    const char *name;
+    void (*fn)(void);
+    const char *desc;
+};
+
+static const struct bench benches[] = {
+    { "put_lat",    bench_put_lat,    "blocking put + quiet latency" },
+    { "get_lat",    bench_get_lat,    "blocking get latency" },
+    { "put_bw",     bench_put_bw,     "non-blocking put bandwidth" },
+    { "get_bw",     bench_get_bw,     "non-blocking get bandwidth" },
+    { "put_signal", bench_put_signal, "put-with-signal ping-pong latency" },
+    { "msg_rate",   bench_msg_rate,   "put message rate, a context per thread (-t)" },
+    { "amo",        bench_amo,        "fetch-add, add, compare-swap, fetch rates" },
+    { "barrier",    bench_barrier,    "barrier latency" },
+    { "bcast",      bench_bcast,      "broadcast" },
+    { "reduce",     bench_reduce,     "long sum reduction" },
+    { "collect",    bench_collect,    "collect" },
+    { "fcollect",   bench_fcollect,   "fcollect" },
+    { "alltoall",   bench_alltoall,   "alltoall" },
+    { NULL, NULL, NULL }
+};
+
+
+static void
+usage(const char *prog)
+{
+    int i;
+
+    if (me != 0) return;
+
+    printf("Usage: oshrun -np N %s [options] [benchmark...]\n\n"
+           "Options:\n"
+           "  -m SIZE    minimum message size in bytes (default %zu)\n"
+           "  -M SIZE    maximum message size in bytes (default %zu)\n"
+           "  -i N       iterations per small message size (default %ld)\n"
+           "  -w N       warmup iterations (default %ld)\n"
+           "  -t N       threads per PE for msg_rate (default %d)\n"
+           "  -T TEAMS   comma separated team shapes for collectives:\n"
+           "             world, half, even (default %s)\n"
+           "  -f FORMAT  csv or json (default csv)\n"
+           "  -h         print this message\n\n"
+           "Benchmarks (default: all):\n",
+           prog, min_size, max_size, iterations, warmup, nthreads, team_list);
+
+    for (i = 0; benches[i].name != NULL; i++)
+        printf("  %-11s %s\n", benches[i].name, benches[i].desc);
+}
+
+
+int
+main(int argc, char *argv[])
+{
+    int c, i, j, provided, ret = 0;
+    int run_all = 1;
+
+    /* Options are parsed before initialization to know the threading level */
+    while ((c = getopt(argc, argv, "m:M:i:w:t:T:f:h")) != -1) {
+        switch (c) {
+        case 'm': min_size = strtoul(optarg, NULL, 0); break;
+        case 'M': max_size = strtoul(optarg, NULL, 0); break;
+        case 'i': iterations = atol(optarg); break;
+        case 'w': warmup = atol(optarg); break;
+        case 't': nthreads = atoi(optarg); break;
+        case 'T': team_list = optarg; break;
+        case 'f':
+            if (0 == strcmp(optarg, "json")) format = FORMAT_JSON;
+            else if (0 == strcmp(optarg, "csv")) format = FORMAT_CSV;
+            else ret = 1;
+            break;
+        case 'h':
+            ret = 2;
+            break;
+        default:
+            ret = 1;
+        }
+    }
+
+    if (min_size == 0) min_size = 1;
+    if (nthreads < 1) nthreads = 1;
+    if (iterations < 1) iterations = 1;
+    if (warmup < 0) warmup = 0;
+
+    if (nthreads > 1) {
+        shmem_init_thread(SHMEM_THREAD_MULTIPLE, &provided);
+        if (provided != SHMEM_THREAD_MULTIPLE) {
+            fprintf(stderr, "oshbench: SHMEM_THREAD_MULTIPLE is not supported\n");
+            shmem_global_exit(1);
+        }
+    } else {
+        shmem_init();
+    }
+
+    me = shmem_my_pe();
+    npes = shmem_n_pes();
+
+    if (ret != 0 || min_size > max_size) {
+        usage(argv[0]);
+        shmem_finalize();
+        return ret == 2 ? 0 : 1;
+    }
+
+    for (i = optind; i < argc; i++) {
+        for (j = 0; benches[j].name != NULL; j++)
+            if (0 == strcmp(argv[i], benches[j].name)) break;
+        if (benches[j].name == NULL) {
+            if (me == 0) fprintf(stderr, "oshbench: unknown benchmark '%s'\n", argv[i]);
+            shmem_finalize();
+            return 1;
+        }
+        run_all = 0;
+    }
+
+    /* msg_rate gives each thread its own destination region */
+    src_buf    = shmem_malloc(max_size * (nthreads > 1 ? nthreads : 1));
+    dst_buf    = shmem_malloc(max_size * (nthreads > 1 ? nthreads : 1));
+    time_buf   = shmem_calloc(2, sizeof(double));
+    signal_var = shmem_calloc(1, sizeof(uint64_t));
+
+    if (NULL == src_buf || NULL == dst_buf || NULL == time_buf ||
+        NULL == signal_var) {
+        if (me == 0)
+            fprintf(stderr, "oshbench: unable to allocate %zu bytes, "
+                    "increase SHMEM_SYMMETRIC_SIZE or reduce -M\n", max_size);
+        shmem_global_exit(1);
+    }
+
+    memset(src_buf, me, max_size);
+
+    for (j = 0; benches[j].name != NULL; j++) {
+        int selected = run_all;
+
+        for (i = optind; i < argc && !selected; i++)
+            selected = (0 == strcmp(argv[i], benches[j].name));
+
+        if (selected) benches[j].fn();
+    }
+
+    if (me == 0 && FORMAT_JSON == format)
+        printf("%s]\n", nrecords ? "\n" : "[\n");
+
+    shmem_barrier_all();
+
+    shmem_free(src_buf);
+    shmem_free(dst_buf);
+    shmem_free(time_buf);
+    shmem_free(signal_var);
+
+    shmem_finalize();
+
+    return 0;
+}
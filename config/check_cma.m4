@@ -4,7 +4,7 @@
 AC_DEFUN([CHECK_CMA], [
     AC_ARG_WITH([cma],
        [AS_HELP_STRING([--with-cma],
-         [Use Cross Memory Attach syscalls for on-node comms, invalid with XPMEM (default: no)])])
+         [Use Cross Memory Attach syscalls for on-node comms (default: no)])])
 
     if test "$with_cma" = "yes" ; then
         AC_CHECK_FUNC([process_vm_writev],
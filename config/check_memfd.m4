@@ -0,0 +1,14 @@
+#CHECK_MEMFD([action-if-found], [action-if-not-found])
+# --------------------------------------------------------
+# check if memfd shared symmetric heap support is wanted.
+AC_DEFUN([CHECK_MEMFD], [
+    AC_ARG_WITH([memfd],
+       [AS_HELP_STRING([--with-memfd],
+         [Back the symmetric heap with a memfd mapped by on-node PEs for load/store access, invalid with XPMEM (default: no)])])
+
+    memfd_happy="no"
+    if test "$with_memfd" = "yes" ; then
+        AC_CHECK_FUNCS([memfd_create], [memfd_happy="yes"])
+    fi
+    AS_IF([test "$memfd_happy" = "yes"], [$1], [$2])
+])
@@ -0,0 +1,51 @@
+#CHECK_NT_COPY([action-if-found], [action-if-not-found])
+# --------------------------------------------------------
+# check if non-temporal copy kernels can be built.  AVX2 support is required;
+# the AVX-512 kernel is built when the compiler supports it.
+AC_DEFUN([CHECK_NT_COPY], [
+    AC_ARG_ENABLE([nt-copy],
+       [AS_HELP_STRING([--disable-nt-copy],
+         [Disable non-temporal copy kernels for large on-node transfers (default: enabled on x86-64)])])
+
+    nt_copy_happy="no"
+    if test "$enable_nt_copy" != "no" ; then
+        AC_MSG_CHECKING([for non-temporal copy intrinsics])
+        AC_LANG_PUSH([C])
+        AC_LINK_IFELSE([
+            AC_LANG_SOURCE([[
+#if !defined(__x86_64__)
+#error "Non-temporal copy kernels require x86-64"
+#endif
+#include <immintrin.h>
+__attribute__((target("avx2")))
+void copy(void *d, const void *s) {
+    _mm256_stream_si256((__m256i *) d, _mm256_loadu_si256((const __m256i *) s));
+    _mm_sfence();
+}
+int main(void) {
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+}
+]])],
+            [nt_copy_happy="yes"],
+            [nt_copy_happy="no"])
+        AC_MSG_RESULT([$nt_copy_happy])
+
+        if test "$nt_copy_happy" = "yes" ; then
+            AC_MSG_CHECKING([for AVX-512 non-temporal copy intrinsics])
+            AC_COMPILE_IFELSE([
+                AC_LANG_SOURCE([[
+#include <immintrin.h>
+__attribute__((target("avx512f")))
+void copy(void *d, const void *s) {
+    _mm512_stream_si512((__m512i *) d, _mm512_loadu_si512(s));
+}
+]])],
+                [AC_DEFINE([HAVE_NT_COPY_AVX512], [1], [Define if the AVX-512 copy kernel can be built])
+                 AC_MSG_RESULT([yes])],
+                [AC_MSG_RESULT([no])])
+        fi
+        AC_LANG_POP([C])
+    fi
+    AS_IF([test "$nt_copy_happy" = "yes"], [$1], [$2])
+])
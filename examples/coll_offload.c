@@ -0,0 +1,177 @@
+/*
+ * Back-to-back barrier, broadcast, and reduction check.  Intended for the
+ * Portals 4 collective offload, which keeps counters and accumulators across
+ * operations, e.g.:
+ *
+ *   SHMEM_BARRIER_ALGORITHM=offload SHMEM_BCAST_ALGORITHM=offload \
+ *   SHMEM_REDUCE_ALGORITHM=offload oshrun -n 8 ./coll_offload 1000
+ *
+ * Every iteration runs a barrier, a max reduction, a broadcast, and sum, or,
+ * and xor reductions of a varying length without synchronization in between.
+ * Some broadcasts use a root other than PE 0 and some reductions exceed the
+ * default offload size, so offloaded and fallback operations interleave.
+ * Every few iterations a non-blocking broadcast is left pending on PE 0
+ * across a barrier, which the other PEs only enter after completing it.
+ */
+
+#include <shmem.h>
+#include <shmemx.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define MAX_COUNT 160
+
+enum { BCAST, BCAST_NB, SUM, OR, XOR, ISUM, DSUM, MAX, NUM_OPS };
+
+long *flags;
+long src[MAX_COUNT];
+long dst[2][NUM_OPS][MAX_COUNT];
+int isrc[MAX_COUNT], idst[2][MAX_COUNT];
+double dsrc[MAX_COUNT], ddst[2][MAX_COUNT];
+long errors, total;
+
+static int me, npes;
+
+static void
+check(const char *what, long iter, int j, long got, long expected)
+{
+    if (got != expected) {
+        if (errors < 10)
+            printf("%d: iteration %ld: %s[%d] = %ld, expected %ld\n",
+                   me, iter, what, j, got, expected);
+        errors++;
+    }
+}
+
+int
+main(int argc, char* argv[])
+{
+    long iters = (argc > 1) ? atol(argv[1]) : 1000;
+    long i, e;
+    int j, pe, n, root;
+
+    shmem_init();
+    me = shmem_my_pe();
+    npes = shmem_n_pes();
+
+    flags = shmem_malloc(2 * npes * sizeof(long));
+    for (pe = 0; pe < 2 * npes; pe++)
+        flags[pe] = -1;
+    shmem_barrier_all();
+
+    for (i = 0; i < iters; i++) {
+        int p = i % 2;
+        long *d;
+
+        /* Barrier: the puts from all PEs must be visible after it */
+        for (pe = 0; pe < npes; pe++)
+            shmem_long_p(&flags[p * npes + me], i, pe);
+        if (i % 5 == 4) {
+            shmem_quiet();
+            shmem_sync_all();
+        } else
+            shmem_barrier_all();
+        for (pe = 0; pe < npes; pe++)
+            check("barrier", i, pe, flags[p * npes + pe], i);
+
+        /* Max is not offloaded; its tree algorithm ends with a broadcast
+         * that does not wait for completion, followed directly by the next
+         * broadcast */
+        n = 1 + (i * 11) % MAX_COUNT;
+        d = dst[p][MAX];
+        for (j = 0; j < n; j++)
+            d[j] = (me + j + i) % npes;
+        shmem_long_max_reduce(SHMEM_TEAM_WORLD, d, d, n);
+        for (j = 0; j < n; j++)
+            check("max", i, j, d[j], npes - 1);
+
+        /* Broadcast, mostly from PE 0 */
+        n = 1 + (i * 7) % MAX_COUNT;
+        root = (i % 4 == 3) ? (int) (i % npes) : 0;
+        for (j = 0; j < n; j++)
+            src[j] = i * 1000 + j + root;
+        shmem_long_broadcast(SHMEM_TEAM_WORLD, dst[p][BCAST], src, n, root);
+        for (j = 0; j < n; j++)
+            check("bcast", i, j, dst[p][BCAST][j], i * 1000 + j + root);
+
+        /* Reductions of varying length, so consecutive ones reuse the
+         * accumulators with different sizes */
+        n = 1 + (i * 13) % MAX_COUNT;
+        for (j = 0; j < n; j++)
+            src[j] = me + j + i;
+        shmem_long_sum_reduce(SHMEM_TEAM_WORLD, dst[p][SUM], src, n);
+        for (j = 0; j < n; j++)
+            check("sum", i, j, dst[p][SUM][j],
+                  (long) npes * (j + i) + (long) npes * (npes - 1) / 2);
+
+        n = 1 + (i * 29) % MAX_COUNT;
+        for (j = 0; j < n; j++)
+            src[j] = 1L << ((me + j + i) % 63);
+        shmem_long_or_reduce(SHMEM_TEAM_WORLD, dst[p][OR], src, n);
+        for (j = 0; j < n; j++) {
+            for (e = 0, pe = 0; pe < npes; pe++)
+                e |= 1L << ((pe + j + i) % 63);
+            check("or", i, j, dst[p][OR][j], e);
+        }
+
+        n = 1 + (i * 31) % MAX_COUNT;
+        for (j = 0; j < n; j++)
+            src[j] = (me + 1L) * (j + i + 1);
+        shmem_long_xor_reduce(SHMEM_TEAM_WORLD, dst[p][XOR], src, n);
+        for (j = 0; j < n; j++) {
+            for (e = 0, pe = 0; pe < npes; pe++)
+                e ^= (pe + 1L) * (j + i + 1);
+            check("xor", i, j, dst[p][XOR][j], e);
+        }
+
+        n = 1 + (i * 17) % MAX_COUNT;
+        for (j = 0; j < n; j++)
+            isrc[j] = me - j;
+        shmem_int_sum_reduce(SHMEM_TEAM_WORLD, idst[p], isrc, n);
+        for (j = 0; j < n; j++)
+            check("int sum", i, j, idst[p][j],
+                  (long) npes * (npes - 1) / 2 - (long) npes * j);
+
+        n = 1 + (i * 3) % MAX_COUNT;
+        for (j = 0; j < n; j++)
+            dsrc[j] = me + j * 0.5;
+        shmem_double_sum_reduce(SHMEM_TEAM_WORLD, ddst[p], dsrc, n);
+        for (j = 0; j < n; j++)
+            check("double sum", i, j, (long) (2 * ddst[p][j]),
+                  (long) npes * (npes - 1) + (long) npes * j);
+
+        /* Non-blocking broadcast that PE 0 completes only after a barrier,
+         * so the barrier must progress it while waiting */
+        if (i % 8 == 7) {
+            shmemx_req_t req;
+
+            n = 1 + (i * 5) % MAX_COUNT;
+            for (j = 0; j < n; j++)
+                src[j] = i * 100 + j;
+            shmemx_broadcastmem_nb(SHMEM_TEAM_WORLD, dst[p][BCAST_NB], src,
+                                   n * sizeof(long), npes - 1, &req);
+            if (me == 0) {
+                shmem_barrier_all();
+                shmemx_req_wait(&req);
+            } else {
+                shmemx_req_wait(&req);
+                shmem_barrier_all();
+            }
+            for (j = 0; j < n; j++)
+                check("bcast nb", i, j, dst[p][BCAST_NB][j], i * 100 + j);
+        }
+    }
+
+    shmem_barrier_all();
+    shmem_long_sum_reduce(SHMEM_TEAM_WORLD, &total, &errors, 1);
+
+    if (errors)
+        printf("%d: %ld errors\n", me, errors);
+    else if (me == 0 && total == 0)
+        printf("coll_offload: %ld iterations on %d PEs passed\n", iters, npes);
+
+    shmem_free(flags);
+    shmem_finalize();
+
+    return errors != 0;
+}
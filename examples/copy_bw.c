@@ -0,0 +1,104 @@
+/*
+ * On-node copy bandwidth microbenchmark.  PE 0 puts to and gets from PE 1
+ * over a sweep of transfer sizes and reports the bandwidth of each.  Compare
+ * runs with SHMEM_COPY_KERNEL set to memcpy, movsb, and nt to choose
+ * SHMEM_COPY_THRESHOLD for a system.
+ *
+ * Usage: oshrun -n 2 ./copy_bw [max_size_in_MB]
+ */
+
+#include <shmem.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+#define MIN_SIZE (4 * 1024)
+#define DEFAULT_MAX_SIZE (256L * 1024 * 1024)
+#define MIN_BYTES (1024L * 1024 * 1024)
+
+static double
+wtime(void)
+{
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec + tv.tv_usec / 1.0e6;
+}
+
+int
+main(int argc, char* argv[], char *envp[])
+{
+    int me, npes;
+    size_t size, max_size = DEFAULT_MAX_SIZE;
+    char *target, *source;
+
+    shmem_init();
+    me = shmem_my_pe();
+    npes = shmem_n_pes();
+
+    if (argc > 1)
+        max_size = (size_t) atol(argv[1]) * 1024 * 1024;
+
+    if (npes < 2) {
+        if (me == 0)
+            printf("copy_bw requires at least 2 PEs\n");
+        shmem_finalize();
+        return 1;
+    }
+
+    target = shmem_malloc(max_size);
+    source = shmem_malloc(max_size);
+    if (NULL == target || NULL == source) {
+        if (me == 0)
+            printf("Unable to allocate %zu bytes, increase SHMEM_SYMMETRIC_SIZE\n",
+                   2 * max_size);
+        shmem_global_exit(1);
+    }
+
+    if (NULL == shmem_ptr(target, 1) && me == 0)
+        printf("Warning: PE 1 is not reachable by load/store\n");
+
+    memset(target, 0, max_size);
+    memset(source, me, max_size);
+    shmem_barrier_all();
+
+    if (me == 0)
+        printf("%12s %10s %14s %14s\n", "Size (B)", "Iters", "Put (MB/s)", "Get (MB/s)");
+
+    for (size = MIN_SIZE; size <= max_size; size *= 2) {
+        long i, iters = MIN_BYTES / size;
+        double start, put_time, get_time;
+
+        if (iters < 4) iters = 4;
+
+        if (me == 0) {
+            /* Warm up */
+            shmem_putmem(target, source, size, 1);
+            shmem_getmem(target, source, size, 1);
+            shmem_quiet();
+
+            start = wtime();
+            for (i = 0; i < iters; i++)
+                shmem_putmem(target, source, size, 1);
+            shmem_quiet();
+            put_time = wtime() - start;
+
+            start = wtime();
+            for (i = 0; i < iters; i++)
+                shmem_getmem(target, source, size, 1);
+            get_time = wtime() - start;
+
+            printf("%12zu %10ld %14.1f %14.1f\n", size, iters,
+                   size * iters / put_time / 1.0e6,
+                   size * iters / get_time / 1.0e6);
+        }
+
+        shmem_barrier_all();
+    }
+
+    shmem_free(target);
+    shmem_free(source);
+    shmem_finalize();
+
+    return 0;
+}
@@ -0,0 +1,199 @@
+/*
+ * On-node routing check.  Every PE transfers data to itself and to the next
+ * PE, in both the symmetric heap and the data segment, at sizes on both sides
+ * of the on-node crossovers, and checks the results:
+ *
+ *   oshrun -n 4 ./shr_route
+ *   SHMEM_SHR_ROUTE_CALIBRATE=1 oshrun -n 4 ./shr_route
+ *   SHMEM_CMA_PUT_MAX=1024 SHMEM_CMA_GET_MAX=1024 oshrun -n 4 ./shr_route
+ *
+ * Each size is put and read back with get, ibput and ibget, and put with
+ * signal.  Fence ordering is checked for a put and for an atomic, each
+ * followed by a flag put that may take a different route.  Run with
+ * SHMEM_DEBUG set to print the routes in use.
+ */
+
+#include <shmem.h>
+#include <shmemx.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MAX_SIZE (4L * 1024 * 1024 + 64)
+
+enum { SELF, HEAP, DATA, NUM_DEST };
+
+static const char *dest_str[NUM_DEST] = { "self", "heap", "data" };
+static const size_t sizes[] = { 1, 8, 64, 1000, 4096, 8192, 8200, 65536,
+                                262144 + 8, 1048576, 4194304, MAX_SIZE };
+
+char data_buf[2 * MAX_SIZE];
+long data_flag;
+
+/* Atomics and signals always target the heap, since builds without a network
+ * transport may only support atomics there */
+static char *heap_buf;
+static long *heap_flag, *heap_cntr;
+static uint64_t *heap_sig;
+
+static char *src, *dst;
+static int me, npes;
+static long errors;
+
+static char
+pattern(int pe, long iter, size_t n, int dest, size_t i)
+{
+    return (char) (pe * 31 + i * 7 + n + dest * 5 + iter);
+}
+
+static void
+fill(char *buf, int pe, long iter, size_t n, int dest)
+{
+    size_t i;
+
+    for (i = 0; i < n; i++)
+        buf[i] = pattern(pe, iter, n, dest, i);
+}
+
+/* Check nblocks blocks of bsize bytes, stride bytes apart in buf, against
+ * the pattern of n bytes filled by pe */
+static void
+check_blocks(const char *what, const char *buf, size_t stride, size_t bsize,
+             int nblocks, int pe, long iter, size_t n, int dest)
+{
+    size_t i;
+    int j;
+
+    for (j = 0; j < nblocks; j++) {
+        for (i = 0; i < bsize; i++) {
+            if (buf[j * stride + i] != pattern(pe, iter, n, dest, j * bsize + i)) {
+                if (errors < 10)
+                    printf("%d: iteration %ld: %s %s of %zu bytes from PE %d: "
+                           "mismatch at byte %zu\n", me, iter, dest_str[dest],
+                           what, n, pe, j * bsize + i);
+                errors++;
+                return;
+            }
+        }
+    }
+}
+
+static void
+check(const char *what, const char *buf, int pe, long iter, size_t n, int dest)
+{
+    check_blocks(what, buf, n, n, 1, pe, iter, n, dest);
+}
+
+int
+main(int argc, char* argv[])
+{
+    long iters = (argc > 1) ? atol(argv[1]) : 2;
+    long i, adds = 0;
+    int dest;
+    size_t k;
+
+    shmem_init();
+    me = shmem_my_pe();
+    npes = shmem_n_pes();
+
+    heap_buf = shmem_malloc(2 * MAX_SIZE);
+    heap_flag = shmem_calloc(1, sizeof(long));
+    heap_cntr = shmem_calloc(1, sizeof(long));
+    heap_sig = shmem_calloc(1, sizeof(uint64_t));
+    src = malloc(2 * MAX_SIZE);
+    dst = malloc(2 * MAX_SIZE);
+    if (NULL == heap_buf || NULL == heap_flag || NULL == heap_cntr ||
+        NULL == heap_sig || NULL == src || NULL == dst) {
+        printf("%d: out of memory\n", me);
+        shmem_global_exit(1);
+    }
+    shmem_barrier_all();
+
+    for (i = 0; i < iters; i++) {
+        for (dest = 0; dest < NUM_DEST; dest++) {
+            /* Self-targeted transfers use the heap */
+            char *buf = (dest == DATA) ? data_buf : heap_buf;
+            long *flag = (dest == DATA) ? &data_flag : heap_flag;
+            int target = (dest == SELF) ? me : (me + 1) % npes;
+            int source = (dest == SELF) ? me : (me + npes - 1) % npes;
+
+            for (k = 0; k < sizeof(sizes) / sizeof(sizes[0]); k++) {
+                size_t n = sizes[k], b = (n + 23) / 24, bn = 3 * b * sizeof(long);
+                long seq = (i * NUM_DEST + dest) * 64 + k + 1;
+
+                /* Put, then get back what was put */
+                fill(src, me, i, n, dest);
+                shmem_putmem(buf, src, n, target);
+                shmem_barrier_all();
+                check("put", buf, source, i, n, dest);
+                memset(dst, 0, n);
+                shmem_getmem(dst, buf, n, target);
+                check("get", dst, me, i, n, dest);
+                shmem_barrier_all();
+
+                /* Three blocks of b longs, spaced 2b apart at the target */
+                fill(src, me, i + 1, bn, dest);
+                memset(buf, 0, 5 * b * sizeof(long));
+                shmem_barrier_all();
+                shmemx_ibput64(buf, src, 2 * b, b, b, 3, target);
+                shmem_barrier_all();
+                check_blocks("ibput", buf, 2 * b * sizeof(long), b * sizeof(long), 3,
+                             source, i + 1, bn, dest);
+                memset(dst, 0, bn);
+                shmemx_ibget64(dst, buf, b, 2 * b, b, 3, target);
+                check("ibget", dst, me, i + 1, bn, dest);
+                shmem_barrier_all();
+
+                /* Fence orders the put with a flag put that may take a
+                 * different route.  A nonblocking put may still be in flight
+                 * at the fence. */
+                fill(src, me, i + 2, n, dest);
+                shmem_putmem_nbi(buf, src, n, target);
+                shmem_fence();
+                shmem_long_p(flag, seq, target);
+                shmem_long_wait_until(flag, SHMEM_CMP_EQ, seq);
+                check("fenced put", buf, source, i + 2, n, dest);
+                shmem_barrier_all();
+
+                /* Likewise for an atomic, which may take the network
+                 * transport while the flag put does not */
+                shmem_long_atomic_add(heap_cntr, 1, target);
+                adds++;
+                shmem_fence();
+                shmem_long_p(flag, -seq, target);
+                shmem_long_wait_until(flag, SHMEM_CMP_EQ, -seq);
+                if (*heap_cntr != adds) {
+                    if (errors < 10)
+                        printf("%d: iteration %ld: %s fenced atomic: %ld, "
+                               "expected %ld\n", me, i, dest_str[dest], *heap_cntr,
+                               adds);
+                    errors++;
+                }
+                shmem_barrier_all();
+
+                /* Put with signal */
+                fill(src, me, i + 3, n, dest);
+                shmem_putmem_signal(buf, src, n, heap_sig, 1, SHMEM_SIGNAL_ADD, target);
+                shmem_signal_wait_until(heap_sig, SHMEM_CMP_EQ, 1);
+                check("put with signal", buf, source, i + 3, n, dest);
+                *heap_sig = 0;
+                shmem_barrier_all();
+            }
+        }
+    }
+
+    if (errors)
+        printf("%d: %ld errors\n", me, errors);
+    else if (me == 0)
+        printf("shr_route: %ld iterations on %d PEs passed\n", iters, npes);
+
+    shmem_free(heap_sig);
+    shmem_free(heap_cntr);
+    shmem_free(heap_flag);
+    shmem_free(heap_buf);
+    free(src);
+    free(dst);
+    shmem_finalize();
+
+    return errors != 0;
+}
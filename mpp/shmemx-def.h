@@ -13,6 +13,9 @@ extern "C" {
 /* Counting puts */
 typedef char * shmemx_ct_t;
 
+/* Non-blocking collective request */
+typedef char * shmemx_req_t;
+
 /* Counter */
 typedef struct {
     uint64_t pending_put;
@@ -22,6 +25,29 @@ typedef struct {
     uint64_t target;
 } shmemx_pcntr_t;
 
+/* Instrumentation operation classes (SHMEM_PCNTR_PROFILE) */
+enum {
+    SHMEMX_PCNTR_PUT = 0,
+    SHMEMX_PCNTR_GET,
+    SHMEMX_PCNTR_AMO,
+    SHMEMX_PCNTR_COLL,
+    SHMEMX_PCNTR_QUIET,
+    SHMEMX_PCNTR_WAIT,
+    SHMEMX_PCNTR_NUM_CLASSES
+};
+
+/* Histogram bin i > 0 counts values in [2^(i-1), 2^i); bin 0 counts zero.
+ * Sizes are in bytes and latencies in nanoseconds. */
+#define SHMEMX_PCNTR_NUM_BINS 32
+
+typedef struct {
+    uint64_t count;
+    uint64_t bytes;
+    uint64_t time_ns;
+    uint64_t size_hist[SHMEMX_PCNTR_NUM_BINS];
+    uint64_t latency_hist[SHMEMX_PCNTR_NUM_BINS];
+} shmemx_pcntr_hist_t;
+
 #define SHMEMX_EXTERNAL_HEAP_ZE 0
 #define SHMEMX_EXTERNAL_HEAP_CUDA 1
 
@@ -55,6 +55,7 @@
 
 #include "pmi.h"
 #include "simple_pmiutil.h"
+#include "simple_pmi_tree.h"
 #define MPI_MAX_PORT_NAME      256
 
 /*
@@ -226,6 +227,18 @@ int PMI_Init(int *spawned)
     if (!PMI_initialized)
         PMI_initialized = NORMAL_INIT_WITH_PM;
 
+    /* SOS: optionally exchange the KVS over a tree of the processes */
+    if ((p = getenv("PMI_TREE_FANOUT")) && atoi(p) > 1 &&
+        PMI_initialized == NORMAL_INIT_WITH_PM && PMI_size > 1) {
+        char kvsname[PMIU_MAXLINE];
+
+        rc = PMI_KVS_Get_my_name(kvsname, sizeof(kvsname));
+        if (rc == PMI_SUCCESS)
+            rc = PMII_Tree_init(kvsname, PMI_rank, PMI_size, atoi(p));
+        if (rc != PMI_SUCCESS)
+            return rc;
+    }
+
     return PMI_SUCCESS;
 }
 
@@ -309,7 +322,9 @@ int PMI_Barrier(void)
 {
     int err = PMI_SUCCESS;
 
-    if (PMI_initialized > SINGLETON_INIT_BUT_NO_PM) {
+    if (PMII_Tree_enabled()) {
+        err = PMII_Tree_barrier();
+    } else if (PMI_initialized > SINGLETON_INIT_BUT_NO_PM) {
         err = GetResponse("cmd=barrier_in\n", "barrier_out", 0);
     }
 
@@ -321,6 +336,8 @@ int PMI_Finalize(void)
 {
     int err = PMI_SUCCESS;
 
+    PMII_Tree_finalize();
+
     if (PMI_initialized > SINGLETON_INIT_BUT_NO_PM) {
         err = GetResponse("cmd=finalize\n", "finalize_ack", 0);
         shutdown(PMI_fd, SHUT_RDWR);
@@ -412,6 +429,9 @@ int PMI_KVS_Put(const char kvsname[], const char key[], const char value[])
         return PMI_SUCCESS;
     }
 
+    if (PMII_Tree_enabled())
+        return PMII_Tree_put(key, value);
+
     rc = MPL_snprintf(buf, PMIU_MAXLINE,
                       "cmd=put kvsname=%s key=%s value=%s\n", kvsname, key, value);
     if (rc < 0)
@@ -441,6 +461,11 @@ int PMI_KVS_Get(const char kvsname[], const char key[], char value[], int length
     if (PMIi_InitIfSingleton() != 0)
         return PMI_FAIL;
 
+    /* Keys that are not in the local copy of the KVS, e.g. keys provided by
+     * the process manager, are looked up in the process manager's KVS */
+    if (PMII_Tree_enabled() && PMII_Tree_get(key, value, length) == PMI_SUCCESS)
+        return PMI_SUCCESS;
+
     rc = MPL_snprintf(buf, PMIU_MAXLINE, "cmd=get kvsname=%s key=%s\n", kvsname, key);
     if (rc < 0)
         return PMI_FAIL;
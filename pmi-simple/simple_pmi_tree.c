@@ -0,0 +1,433 @@
+/* -*- C -*-
+ *
+ * Copyright (c) 2022 Intel Corporation. All rights reserved.
+ * This software is available to you under the BSD license.
+ *
+ * This file is part of the Sandia OpenSHMEM software package. For license
+ * information, see the LICENSE file in the top level directory of the
+ * distribution.
+ *
+ */
+
+/* Tree mode for the simple PMI client, see simple_pmi_tree.h.
+ *
+ * Processes exchange KVS entries with their tree parent and children over
+ * TCP connections.  Each entry is sent as a pair of 32-bit lengths followed
+ * by the key and value bytes; an entry with an empty key ends a batch. */
+
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+
+#include "mpl.h"
+#include "mpl_sockaddr.h"
+#include "pmi.h"
+#include "simple_pmiutil.h"
+#include "simple_pmi_tree.h"
+#include "uthash.h"
+
+#define PMII_TREE_ADDR_KEY "PMI_tree_addr_%d"
+#define PMII_TREE_HOST_LEN 256
+
+typedef struct {
+    char *key;
+    char *value;
+    UT_hash_handle hh;
+} PMII_Tree_entry_t;
+
+/* List of entries to be sent in the next batch */
+typedef struct {
+    PMII_Tree_entry_t **entries;
+    size_t len, size;
+} PMII_Tree_list_t;
+
+static int tree_enabled = 0;
+static int tree_rank = 0;
+static int tree_parent_fd = -1;
+static int *tree_child_fds = NULL;
+static int tree_nchildren = 0;
+
+static PMII_Tree_entry_t *tree_kvs = NULL;
+
+/* Entries put by this process or its subtree since the last barrier */
+static PMII_Tree_list_t tree_pending = { NULL, 0, 0 };
+
+
+static int tree_write_all(int fd, const void *buf, size_t len)
+{
+    const char *p = (const char *) buf;
+
+    while (len > 0) {
+        ssize_t n = write(fd, p, len);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            return PMI_FAIL;
+        }
+        p += n;
+        len -= (size_t) n;
+    }
+
+    return PMI_SUCCESS;
+}
+
+
+static int tree_read_all(int fd, void *buf, size_t len)
+{
+    char *p = (char *) buf;
+
+    while (len > 0) {
+        ssize_t n = read(fd, p, len);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            return PMI_FAIL;
+        } else if (n == 0) {
+            return PMI_FAIL;
+        }
+        p += n;
+        len -= (size_t) n;
+    }
+
+    return PMI_SUCCESS;
+}
+
+
+static int tree_list_append(PMII_Tree_list_t * list, PMII_Tree_entry_t * e)
+{
+    if (list->len == list->size) {
+        size_t size = list->size ? list->size * 2 : 64;
+        PMII_Tree_entry_t **entries = realloc(list->entries, size * sizeof(*entries));
+        if (entries == NULL)
+            return PMI_FAIL;
+        list->entries = entries;
+        list->size = size;
+    }
+
+    list->entries[list->len++] = e;
+    return PMI_SUCCESS;
+}
+
+
+/* Insert or update an entry in the local KVS */
+static PMII_Tree_entry_t *tree_store(const char *key, size_t keylen,
+                                     const char *value, size_t vallen)
+{
+    PMII_Tree_entry_t *e;
+    char *v;
+
+    HASH_FIND(hh, tree_kvs, key, keylen, e);
+
+    v = malloc(vallen + 1);
+    if (v == NULL)
+        return NULL;
+    memcpy(v, value, vallen);
+    v[vallen] = '\0';
+
+    if (e == NULL) {
+        e = malloc(sizeof(PMII_Tree_entry_t));
+        if (e == NULL) {
+            free(v);
+            return NULL;
+        }
+        e->key = malloc(keylen + 1);
+        if (e->key == NULL) {
+            free(v);
+            free(e);
+            return NULL;
+        }
+        memcpy(e->key, key, keylen);
+        e->key[keylen] = '\0';
+        e->value = v;
+        HASH_ADD_KEYPTR(hh, tree_kvs, e->key, keylen, e);
+    } else {
+        free(e->value);
+        e->value = v;
+    }
+
+    return e;
+}
+
+
+static int tree_send_list(int fd, PMII_Tree_list_t * list)
+{
+    uint32_t hdr[2];
+    size_t i;
+
+    for (i = 0; i < list->len; i++) {
+        PMII_Tree_entry_t *e = list->entries[i];
+
+        hdr[0] = (uint32_t) strlen(e->key);
+        hdr[1] = (uint32_t) strlen(e->value);
+
+        if (tree_write_all(fd, hdr, sizeof(hdr)) ||
+            tree_write_all(fd, e->key, hdr[0]) || tree_write_all(fd, e->value, hdr[1]))
+            return PMI_FAIL;
+    }
+
+    /* End of batch */
+    hdr[0] = hdr[1] = 0;
+    return tree_write_all(fd, hdr, sizeof(hdr));
+}
+
+
+/* Receive a batch of entries, store them, and append them to list */
+static int tree_recv_list(int fd, PMII_Tree_list_t * list)
+{
+    char key[PMIU_MAXLINE], value[PMIU_MAXLINE];
+    uint32_t hdr[2];
+
+    for (;;) {
+        PMII_Tree_entry_t *e;
+
+        if (tree_read_all(fd, hdr, sizeof(hdr)))
+            return PMI_FAIL;
+
+        if (hdr[0] == 0)
+            break;
+
+        if (hdr[0] >= sizeof(key) || hdr[1] >= sizeof(value))
+            return PMI_FAIL;
+
+        if (tree_read_all(fd, key, hdr[0]) || tree_read_all(fd, value, hdr[1]))
+            return PMI_FAIL;
+
+        e = tree_store(key, hdr[0], value, hdr[1]);
+        if (e == NULL || tree_list_append(list, e))
+            return PMI_FAIL;
+    }
+
+    return PMI_SUCCESS;
+}
+
+
+static void tree_set_nodelay(int fd)
+{
+    int optval = 1;
+
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, (char *) &optval, sizeof(optval));
+}
+
+
+int PMII_Tree_init(const char kvsname[], int rank, int size, int fanout)
+{
+    char key[PMIU_MAXLINE], value[PMIU_MAXLINE], host[PMII_TREE_HOST_LEN];
+    unsigned short port;
+    int listen_fd, first_child, i, rc;
+
+    tree_rank = rank;
+
+    first_child = rank * fanout + 1;
+    if (first_child < size)
+        tree_nchildren = (size - first_child < fanout) ? size - first_child : fanout;
+    else
+        tree_nchildren = 0;
+
+    listen_fd = MPL_socket();
+    if (listen_fd < 0) {
+        PMIU_printf(1, "Unable to create tree socket\n");
+        return PMI_FAIL;
+    }
+
+    MPL_LISTEN_PUSH(0, fanout);
+    rc = MPL_listen_anyport(listen_fd, &port);
+    MPL_LISTEN_POP;
+    if (rc) {
+        PMIU_printf(1, "Unable to listen on tree socket (errno %d)\n", errno);
+        close(listen_fd);
+        return PMI_FAIL;
+    }
+
+    if (gethostname(host, sizeof(host)) != 0) {
+        close(listen_fd);
+        return PMI_FAIL;
+    }
+    host[sizeof(host) - 1] = '\0';
+
+    /* Publish the address through the process manager, which is not in tree
+     * mode yet */
+    MPL_snprintf(key, sizeof(key), PMII_TREE_ADDR_KEY, rank);
+    MPL_snprintf(value, sizeof(value), "%s:%u", host, (unsigned) port);
+
+    rc = PMI_KVS_Put(kvsname, key, value);
+    if (rc == PMI_SUCCESS)
+        rc = PMI_Barrier();
+    if (rc != PMI_SUCCESS) {
+        close(listen_fd);
+        return rc;
+    }
+
+    if (rank > 0) {
+        MPL_sockaddr_t addr;
+        int32_t my_rank = rank;
+        char *colon;
+
+        MPL_snprintf(key, sizeof(key), PMII_TREE_ADDR_KEY, (rank - 1) / fanout);
+        rc = PMI_KVS_Get(kvsname, key, value, sizeof(value));
+        if (rc != PMI_SUCCESS) {
+            close(listen_fd);
+            return rc;
+        }
+
+        colon = strrchr(value, ':');
+        if (colon == NULL) {
+            close(listen_fd);
+            return PMI_FAIL;
+        }
+        *colon = '\0';
+
+        tree_parent_fd = MPL_socket();
+        if (tree_parent_fd < 0 || MPL_get_sockaddr(value, &addr) ||
+            MPL_connect(tree_parent_fd, &addr, (unsigned short) atoi(colon + 1))) {
+            PMIU_printf(1, "Unable to connect to tree parent at %s:%s\n", value, colon + 1);
+            close(listen_fd);
+            return PMI_FAIL;
+        }
+
+        tree_set_nodelay(tree_parent_fd);
+
+        if (tree_write_all(tree_parent_fd, &my_rank, sizeof(my_rank))) {
+            close(listen_fd);
+            return PMI_FAIL;
+        }
+    }
+
+    if (tree_nchildren > 0) {
+        tree_child_fds = malloc(tree_nchildren * sizeof(int));
+        if (tree_child_fds == NULL) {
+            close(listen_fd);
+            return PMI_FAIL;
+        }
+        for (i = 0; i < tree_nchildren; i++)
+            tree_child_fds[i] = -1;
+    }
+
+    /* Children connect in any order and identify themselves by rank */
+    for (i = 0; i < tree_nchildren; i++) {
+        int32_t child_rank;
+        int fd;
+
+        do {
+            fd = accept(listen_fd, NULL, NULL);
+        } while (fd < 0 && errno == EINTR);
+
+        if (fd < 0 || tree_read_all(fd, &child_rank, sizeof(child_rank)) ||
+            child_rank < first_child || child_rank >= first_child + tree_nchildren ||
+            tree_child_fds[child_rank - first_child] != -1) {
+            PMIU_printf(1, "Tree connection from a child failed\n");
+            if (fd >= 0)
+                close(fd);
+            close(listen_fd);
+            return PMI_FAIL;
+        }
+
+        tree_set_nodelay(fd);
+        tree_child_fds[child_rank - first_child] = fd;
+    }
+
+    close(listen_fd);
+    tree_enabled = 1;
+
+    return PMI_SUCCESS;
+}
+
+
+int PMII_Tree_enabled(void)
+{
+    return tree_enabled;
+}
+
+
+int PMII_Tree_put(const char key[], const char value[])
+{
+    PMII_Tree_entry_t *e = tree_store(key, strlen(key), value, strlen(value));
+
+    if (e == NULL)
+        return PMI_FAIL;
+
+    return tree_list_append(&tree_pending, e);
+}
+
+
+int PMII_Tree_get(const char key[], char value[], int length)
+{
+    PMII_Tree_entry_t *e;
+
+    HASH_FIND_STR(tree_kvs, key, e);
+    if (e == NULL)
+        return PMI_FAIL;
+
+    MPL_strncpy(value, e->value, length);
+    return PMI_SUCCESS;
+}
+
+
+/* Gather the pending entries of the subtree to the root, then broadcast all
+ * of them back down.  Returning from the broadcast completes the barrier. */
+int PMII_Tree_barrier(void)
+{
+    PMII_Tree_list_t down = { NULL, 0, 0 };
+    PMII_Tree_list_t *bcast;
+    int i, rc = PMI_SUCCESS;
+
+    for (i = 0; i < tree_nchildren && rc == PMI_SUCCESS; i++)
+        rc = tree_recv_list(tree_child_fds[i], &tree_pending);
+
+    if (rc == PMI_SUCCESS && tree_rank > 0) {
+        rc = tree_send_list(tree_parent_fd, &tree_pending);
+        if (rc == PMI_SUCCESS)
+            rc = tree_recv_list(tree_parent_fd, &down);
+        bcast = &down;
+    } else {
+        bcast = &tree_pending;
+    }
+
+    for (i = 0; i < tree_nchildren && rc == PMI_SUCCESS; i++)
+        rc = tree_send_list(tree_child_fds[i], bcast);
+
+    free(down.entries);
+    tree_pending.len = 0;
+
+    return rc;
+}
+
+
+void PMII_Tree_finalize(void)
+{
+    PMII_Tree_entry_t *e, *tmp;
+    int i;
+
+    if (!tree_enabled)
+        return;
+
+    tree_enabled = 0;
+
+    if (tree_parent_fd >= 0)
+        close(tree_parent_fd);
+    tree_parent_fd = -1;
+
+    for (i = 0; i < tree_nchildren; i++)
+        close(tree_child_fds[i]);
+    free(tree_child_fds);
+    tree_child_fds = NULL;
+    tree_nchildren = 0;
+
+    HASH_ITER(hh, tree_kvs, e, tmp) {
+        HASH_DEL(tree_kvs, e);
+        free(e->key);
+        free(e->value);
+        free(e);
+    }
+
+    free(tree_pending.entries);
+    tree_pending.entries = NULL;
+    tree_pending.len = tree_pending.size = 0;
+}
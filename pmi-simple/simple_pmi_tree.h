@@ -0,0 +1,34 @@
+/* -*- C -*-
+ *
+ * Copyright (c) 2022 Intel Corporation. All rights reserved.
+ * This software is available to you under the BSD license.
+ *
+ * This file is part of the Sandia OpenSHMEM software package. For license
+ * information, see the LICENSE file in the top level directory of the
+ * distribution.
+ *
+ */
+
+#ifndef SIMPLE_PMI_TREE_H
+#define SIMPLE_PMI_TREE_H
+
+/* Tree mode for the simple PMI client (SOS local extension).
+ *
+ * When PMI_TREE_FANOUT is set to a value greater than one, the processes of
+ * the job connect to each other in a tree with the given fanout during
+ * PMI_Init.  Afterwards, PMI_KVS_Put stores values locally, and PMI_Barrier
+ * gathers the values put since the previous barrier up the tree and
+ * broadcasts them back down, so that every process holds a copy of the KVS
+ * and PMI_KVS_Get is served locally.  The process manager only sees one put,
+ * one barrier, and one get per process during the tree setup.  Keys that
+ * are not found locally, e.g. keys provided by the process manager, are
+ * looked up in the process manager's KVS. */
+
+int PMII_Tree_init(const char kvsname[], int rank, int size, int fanout);
+int PMII_Tree_enabled(void);
+int PMII_Tree_put(const char key[], const char value[]);
+int PMII_Tree_get(const char key[], char value[], int length);
+int PMII_Tree_barrier(void);
+void PMII_Tree_finalize(void);
+
+#endif /* SIMPLE_PMI_TREE_H */
@@ -0,0 +1,683 @@
+/* -*- C -*-
+ *
+ * Copyright (c) 2022 Intel Corporation. All rights reserved.
+ * This software is available to you under the BSD license.
+ *
+ * This file is part of the Sandia OpenSHMEM software package. For license
+ * information, see the LICENSE file in the top level directory of the
+ * distribution.
+ *
+ */
+
+/* Collective algorithm decision table.
+ *
+ * The table is a text file with one rule per line:
+ *
+ *   <collective> <max_pes> <max_bytes> <datatype> <algorithm>
+ *
+ * where collective is sync, bcast, reduce, or fcollect; max_pes and max_bytes
+ * are inclusive upper bounds on the active set size and message size (or
+ * "inf"); datatype is a reduction datatype name or "any"; and algorithm is
+ * one of the names accepted by the SHMEM_*_ALGORITHM variables.  Lines
+ * starting with '#' are comments.  The rule with the smallest max_pes, then
+ * smallest max_bytes, that covers an operation selects its algorithm; rules
+ * for a specific datatype take precedence over rules for "any".  Operations
+ * not covered by any rule use the SHMEM_COLL_*CROSSOVER defaults.
+ *
+ * PE 0 reads the file and sends the rules to the other PEs, so the file only
+ * needs to be visible to PE 0.  When SHMEM_COLL_TUNE is set and the file does
+ * not exist, the table is generated by timing each algorithm over a grid of
+ * active set sizes (powers of two up to the job size) and message sizes
+ * (powers of eight up to SHMEM_COLL_TUNE_MAX_SIZE) and written by PE 0. */
+
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <stdint.h>
+#include <inttypes.h>
+
+#define SHMEM_INTERNAL_INCLUDE
+#include "shmem.h"
+#include "shmem_internal.h"
+#include "shmem_collectives.h"
+#include "shmem_pcntr.h"
+#include "runtime.h"
+
+#define COLL_TUNE_WARMUP   2
+#define COLL_TUNE_MIN_SIZE 8
+
+struct shmem_internal_coll_tune_rule_t {
+    int         coll;
+    int         max_pes;
+    int         datatype;
+    coll_type_t alg;
+    size_t      max_bytes;
+};
+typedef struct shmem_internal_coll_tune_rule_t shmem_internal_coll_tune_rule_t;
+
+struct coll_tune_rules_t {
+    shmem_internal_coll_tune_rule_t *rules;
+    size_t nrules, size;
+    int oom;
+};
+
+int shmem_internal_coll_tune_nrows[SHMEM_INTERNAL_COLL_TUNE_NUM];
+
+static shmem_internal_coll_tune_rule_t *coll_tune_table = NULL;
+static shmem_internal_coll_tune_rule_t *coll_tune_rows[SHMEM_INTERNAL_COLL_TUNE_NUM];
+
+static const char *coll_tune_coll_str[] = { "sync", "bcast", "reduce", "fcollect" };
+
+static const char *coll_tune_alg_str[] = { "auto", "linear", "tree", "dissem",
+                                           "ring", "recdbl", "hier", "offload" };
+
+/* Indexed by shm_internal_datatype_t */
+static const char *coll_tune_type_str[] = {
+    "signed_byte", "char", "schar", "short", "int", "long", "longlong",
+    "fortran_integer", "int8", "int16", "int32", "int64", "ptrdiff", "uchar",
+    "ushort", "uint", "ulong", "ulonglong", "uint8", "uint16", "uint32",
+    "uint64", "size", "float", "double", "longdouble", "complexf", "complexd"
+};
+
+/* Reduction datatypes measured when generating the table */
+static const shm_internal_datatype_t coll_tune_reduce_types[] = {
+    SHM_INTERNAL_LONG, SHM_INTERNAL_DOUBLE
+};
+
+#define NELEMS(a) (sizeof(a) / sizeof((a)[0]))
+
+
+static int
+coll_tune_lookup_str(const char *str, const char **names, int nnames)
+{
+    int i;
+
+    for (i = 0; i < nnames; i++)
+        if (0 == strcmp(str, names[i])) return i;
+
+    return -1;
+}
+
+
+/* Whether the collective implements the algorithm; AUTO, HIER, and OFFLOAD
+ * are never valid table entries */
+static int
+coll_tune_alg_valid(int coll, coll_type_t alg)
+{
+    switch (coll) {
+    case SHMEM_INTERNAL_COLL_TUNE_SYNC:
+        return alg == LINEAR || alg == TREE || alg == DISSEM;
+    case SHMEM_INTERNAL_COLL_TUNE_BCAST:
+        return alg == LINEAR || alg == TREE;
+    case SHMEM_INTERNAL_COLL_TUNE_REDUCE:
+        return alg == LINEAR || alg == TREE || alg == RING || alg == RECDBL;
+    case SHMEM_INTERNAL_COLL_TUNE_FCOLLECT:
+        return alg == LINEAR || alg == RING || alg == RECDBL;
+    default:
+        return 0;
+    }
+}
+
+
+static int
+coll_tune_append(struct coll_tune_rules_t *r, int coll, int max_pes,
+                 size_t max_bytes, int datatype, coll_type_t alg)
+{
+    if (r->nrules == r->size) {
+        size_t size = r->size ? 2 * r->size : 64;
+        shmem_internal_coll_tune_rule_t *rules;
+
+        rules = realloc(r->rules, size * sizeof(shmem_internal_coll_tune_rule_t));
+        if (NULL == rules) {
+            r->oom = 1;
+            return 1;
+        }
+
+        r->rules = rules;
+        r->size  = size;
+    }
+
+    r->rules[r->nrules].coll      = coll;
+    r->rules[r->nrules].max_pes   = max_pes;
+    r->rules[r->nrules].max_bytes = max_bytes;
+    r->rules[r->nrules].datatype  = datatype;
+    r->rules[r->nrules].alg       = alg;
+    r->nrules++;
+
+    return 0;
+}
+
+
+/* Returns 0 on success, ENOENT if the file does not exist, or another errno
+ * value if it cannot be read.  Malformed rules are skipped with a warning. */
+static int
+coll_tune_read(const char *path, struct coll_tune_rules_t *r)
+{
+    char line[256], coll_s[32], pes_s[32], bytes_s[32], type_s[32], alg_s[32];
+    int lineno = 0;
+    FILE *f;
+
+    f = fopen(path, "r");
+    if (NULL == f) return errno;
+
+    while (NULL != fgets(line, sizeof(line), f)) {
+        int coll, datatype, alg, n;
+        long max_pes;
+        unsigned long long max_bytes;
+        char *p = line, *end;
+
+        lineno++;
+        while (*p == ' ' || *p == '\t') p++;
+        if (*p == '#' || *p == '\n' || *p == '\0') continue;
+
+        n = sscanf(p, "%31s %31s %31s %31s %31s", coll_s, pes_s, bytes_s,
+                   type_s, alg_s);
+        if (n != 5) goto bad_rule;
+
+        coll = coll_tune_lookup_str(coll_s, coll_tune_coll_str, NELEMS(coll_tune_coll_str));
+        alg  = coll_tune_lookup_str(alg_s, coll_tune_alg_str, NELEMS(coll_tune_alg_str));
+        if (coll < 0 || alg < 0 || !coll_tune_alg_valid(coll, (coll_type_t) alg))
+            goto bad_rule;
+
+        if (0 == strcmp(type_s, "any")) {
+            datatype = SHMEM_INTERNAL_COLL_TUNE_ANY_TYPE;
+        } else {
+            datatype = coll_tune_lookup_str(type_s, coll_tune_type_str,
+                                            NELEMS(coll_tune_type_str));
+            if (datatype < 0) goto bad_rule;
+        }
+
+        if (0 == strcmp(pes_s, "inf")) {
+            max_pes = INT_MAX;
+        } else {
+            errno = 0;
+            max_pes = strtol(pes_s, &end, 10);
+            if (errno || *end != '\0' || max_pes < 1 || max_pes > INT_MAX) goto bad_rule;
+        }
+
+        if (0 == strcmp(bytes_s, "inf")) {
+            max_bytes = SIZE_MAX;
+        } else {
+            errno = 0;
+            max_bytes = strtoull(bytes_s, &end, 10);
+            if (errno || *end != '\0' || max_bytes > SIZE_MAX) goto bad_rule;
+        }
+
+        if (coll_tune_append(r, coll, (int) max_pes, (size_t) max_bytes,
+                             datatype, (coll_type_t) alg)) {
+            fclose(f);
+            return ENOMEM;
+        }
+        continue;
+
+    bad_rule:
+        RAISE_WARN_MSG("Ignoring bad rule at %s:%d\n", path, lineno);
+    }
+
+    fclose(f);
+    return 0;
+}
+
+
+static void
+coll_tune_write(const char *path, const struct coll_tune_rules_t *r)
+{
+    size_t i;
+    FILE *f;
+
+    f = fopen(path, "w");
+    if (NULL == f) {
+        RAISE_WARN_MSG("Unable to write collective tuning table %s (%s)\n",
+                       path, strerror(errno));
+        return;
+    }
+
+    fprintf(f, "# Sandia OpenSHMEM collective tuning table\n"
+               "# Generated with %d PEs (%d per node), tree radix %ld\n"
+               "# collective max_pes max_bytes datatype algorithm\n",
+            shmem_internal_num_pes, shmem_runtime_get_node_size(),
+            shmem_internal_params.COLL_RADIX);
+
+    for (i = 0; i < r->nrules; i++) {
+        const shmem_internal_coll_tune_rule_t *rule = &r->rules[i];
+
+        fprintf(f, "%-8s ", coll_tune_coll_str[rule->coll]);
+        if (rule->max_pes == INT_MAX) fprintf(f, "%5s ", "inf");
+        else                          fprintf(f, "%5d ", rule->max_pes);
+        if (rule->max_bytes == SIZE_MAX) fprintf(f, "%9s ", "inf");
+        else                             fprintf(f, "%9zu ", rule->max_bytes);
+        fprintf(f, "%-6s %s\n",
+                rule->datatype == SHMEM_INTERNAL_COLL_TUNE_ANY_TYPE ? "any" :
+                coll_tune_type_str[rule->datatype],
+                coll_tune_alg_str[rule->alg]);
+    }
+
+    if (0 != fclose(f))
+        RAISE_WARN_MSG("Unable to write collective tuning table %s\n", path);
+}
+
+
+/* Buffers used while measuring */
+struct coll_tune_bufs_t {
+    void     *src, *dst;
+    long     *psync[2];
+    uint64_t *times;
+};
+
+
+static void
+coll_tune_run(int coll, coll_type_t alg, int PE_size, size_t len, int datatype,
+              struct coll_tune_bufs_t *b, long *pSync)
+{
+    switch (coll) {
+    case SHMEM_INTERNAL_COLL_TUNE_SYNC:
+        if (alg == LINEAR)
+            shmem_internal_sync_linear(0, 1, PE_size, pSync);
+        else if (alg == TREE)
+            shmem_internal_sync_tree(0, 1, PE_size, pSync);
+        else
+            shmem_internal_sync_dissem(0, 1, PE_size, pSync);
+        break;
+    case SHMEM_INTERNAL_COLL_TUNE_BCAST:
+        if (alg == LINEAR)
+            shmem_internal_bcast_linear(b->dst, b->src, len, 0, 0, 1, PE_size, pSync, 1);
+        else
+            shmem_internal_bcast_tree(b->dst, b->src, len, 0, 0, 1, PE_size, pSync, 1);
+        break;
+    case SHMEM_INTERNAL_COLL_TUNE_REDUCE:
+    {
+        /* Both measured datatypes are 8 bytes */
+        size_t type_size = datatype == SHM_INTERNAL_DOUBLE ? sizeof(double) : sizeof(long);
+        size_t count = len / type_size;
+
+        if (alg == LINEAR)
+            shmem_internal_op_to_all_linear(b->dst, b->src, count, type_size, 0, 1, PE_size,
+                                            NULL, pSync, SHM_INTERNAL_SUM, datatype);
+        else if (alg == TREE)
+            shmem_internal_op_to_all_tree(b->dst, b->src, count, type_size, 0, 1, PE_size,
+                                          NULL, pSync, SHM_INTERNAL_SUM, datatype);
+        else if (alg == RING)
+            shmem_internal_op_to_all_ring(b->dst, b->src, count, type_size, 0, 1, PE_size,
+                                          NULL, pSync, SHM_INTERNAL_SUM, datatype);
+        else
+            shmem_internal_op_to_all_recdbl_sw(b->dst, b->src, count, type_size, 0, 1, PE_size,
+                                               NULL, pSync, SHM_INTERNAL_SUM, datatype);
+        break;
+    }
+    case SHMEM_INTERNAL_COLL_TUNE_FCOLLECT:
+        if (alg == LINEAR)
+            shmem_internal_fcollect_linear(b->dst, b->src, len, 0, 1, PE_size, pSync);
+        else if (alg == RING)
+            shmem_internal_fcollect_ring(b->dst, b->src, len, 0, 1, PE_size, pSync);
+        else
+            shmem_internal_fcollect_recdbl(b->dst, b->src, len, 0, 1, PE_size, pSync);
+        break;
+    }
+}
+
+
+/* Collective over all PEs.  Returns, on PE 0, the time per operation of the
+ * slowest PE in the active set [0, PE_size). */
+static uint64_t
+coll_tune_measure(int coll, coll_type_t alg, int PE_size, size_t len,
+                  int datatype, struct coll_tune_bufs_t *b)
+{
+    long i, iters = shmem_internal_params.COLL_TUNE_ITERS;
+    uint64_t start = 0, t, max = 0;
+
+    shmem_internal_barrier_all();
+
+    if (shmem_internal_my_pe < PE_size) {
+        /* Back-to-back collectives alternate between two pSync arrays */
+        for (i = 0; i < COLL_TUNE_WARMUP + iters; i++) {
+            if (i == COLL_TUNE_WARMUP) start = shmem_internal_pcntr_now();
+            coll_tune_run(coll, alg, PE_size, len, datatype, b, b->psync[i & 1]);
+        }
+        t = (shmem_internal_pcntr_now() - start) / iters;
+
+        shmem_internal_put_scalar(SHMEM_CTX_DEFAULT, &b->times[shmem_internal_my_pe],
+                                  &t, sizeof(t), 0);
+    }
+
+    shmem_internal_barrier_all();
+
+    if (shmem_internal_my_pe == 0)
+        for (i = 0; i < PE_size; i++)
+            if (b->times[i] > max) max = b->times[i];
+
+    return max;
+}
+
+
+/* Collective over all PEs.  Times each candidate algorithm for one table
+ * cell and, on PE 0, appends a rule for the fastest. */
+static void
+coll_tune_cell(int coll, int PE_size, int max_pes, size_t len, size_t max_bytes,
+               int datatype, struct coll_tune_bufs_t *b, struct coll_tune_rules_t *r)
+{
+    coll_type_t alg, best = AUTO;
+    uint64_t t, best_t = UINT64_MAX;
+
+    for (alg = LINEAR; alg < HIER; alg++) {
+        if (!coll_tune_alg_valid(coll, alg)) continue;
+
+        if (coll == SHMEM_INTERNAL_COLL_TUNE_REDUCE && (alg == LINEAR || alg == TREE) &&
+            !shmem_transport_atomic_supported(SHM_INTERNAL_SUM, datatype))
+            continue;
+
+        if (coll == SHMEM_INTERNAL_COLL_TUNE_FCOLLECT && alg == RECDBL &&
+            0 != (PE_size & (PE_size - 1)))
+            continue;
+
+        t = coll_tune_measure(coll, alg, PE_size, len, datatype, b);
+        if (t < best_t) {
+            best_t = t;
+            best   = alg;
+        }
+    }
+
+    if (shmem_internal_my_pe != 0) return;
+
+    DEBUG_MSG("%s %d PEs %zu bytes %s: %s (%"PRIu64" ns)\n",
+              coll_tune_coll_str[coll], PE_size, len,
+              datatype == SHMEM_INTERNAL_COLL_TUNE_ANY_TYPE ? "any" :
+              coll_tune_type_str[datatype], coll_tune_alg_str[best], best_t);
+
+    coll_tune_append(r, coll, max_pes, max_bytes, datatype, best);
+}
+
+
+/* Active set sizes measured: 2, 4, ..., and the job size */
+static int
+coll_tune_next_size(int PE_size)
+{
+    if (PE_size == shmem_internal_num_pes) return PE_size + 1;
+    if (2 * PE_size > shmem_internal_num_pes) return shmem_internal_num_pes;
+    return 2 * PE_size;
+}
+
+
+/* Collective over all PEs.  The rules are accumulated on PE 0. */
+static int
+coll_tune_generate(struct coll_tune_rules_t *r)
+{
+    const size_t max_size = shmem_internal_params.COLL_TUNE_MAX_SIZE;
+    const int npes = shmem_internal_num_pes;
+    struct coll_tune_bufs_t b;
+    size_t len, max_bytes, i;
+    int PE_size, max_pes, ret = 0;
+
+    if (shmem_internal_params.COLL_TUNE_ITERS <= 0) {
+        RETURN_ERROR_STR("SHMEM_COLL_TUNE_ITERS must be greater than zero");
+        return 1;
+    }
+
+    if (max_size < COLL_TUNE_MIN_SIZE) {
+        RETURN_ERROR_MSG("SHMEM_COLL_TUNE_MAX_SIZE must be at least %d\n", COLL_TUNE_MIN_SIZE);
+        return 1;
+    }
+
+    b.src      = shmem_internal_shmalloc(max_size);
+    b.dst      = shmem_internal_shmalloc(max_size);
+    b.psync[0] = shmem_internal_shmalloc(2 * sizeof(long) * SHMEM_SYNC_SIZE);
+    b.times    = shmem_internal_shmalloc(sizeof(uint64_t) * npes);
+
+    if (NULL == b.src || NULL == b.dst || NULL == b.psync[0] || NULL == b.times) {
+        RETURN_ERROR_MSG("Unable to allocate %zu bytes of symmetric memory for "
+                         "collective tuning, decrease SHMEM_COLL_TUNE_MAX_SIZE\n",
+                         2 * max_size);
+        ret = 1;
+        goto out;
+    }
+
+    b.psync[1] = b.psync[0] + SHMEM_SYNC_SIZE;
+    for (i = 0; i < 2 * SHMEM_SYNC_SIZE; i++)
+        b.psync[0][i] = SHMEM_SYNC_VALUE;
+    memset(b.src, 0, max_size);
+
+    if (shmem_internal_my_pe == 0)
+        RAISE_WARN_MSG("Measuring collective algorithms for %s, this may take a while\n",
+                       shmem_internal_params.COLL_TUNE_FILE);
+
+    /* The largest active set measured also covers bigger teams, and the
+     * largest message size of each collective also covers bigger messages */
+    for (PE_size = 2; PE_size <= npes; PE_size = coll_tune_next_size(PE_size)) {
+        max_pes = PE_size == npes ? INT_MAX : PE_size;
+
+        coll_tune_cell(SHMEM_INTERNAL_COLL_TUNE_SYNC, PE_size, max_pes, 0, SIZE_MAX,
+                       SHMEM_INTERNAL_COLL_TUNE_ANY_TYPE, &b, r);
+
+        for (len = COLL_TUNE_MIN_SIZE; len <= max_size; len *= 8) {
+            max_bytes = len * 8 > max_size ? SIZE_MAX : len;
+            coll_tune_cell(SHMEM_INTERNAL_COLL_TUNE_BCAST, PE_size, max_pes, len,
+                           max_bytes, SHMEM_INTERNAL_COLL_TUNE_ANY_TYPE, &b, r);
+        }
+
+        for (i = 0; i < NELEMS(coll_tune_reduce_types); i++) {
+            for (len = COLL_TUNE_MIN_SIZE; len <= max_size; len *= 8) {
+                max_bytes = len * 8 > max_size ? SIZE_MAX : len;
+                coll_tune_cell(SHMEM_INTERNAL_COLL_TUNE_REDUCE, PE_size, max_pes, len,
+                               max_bytes, coll_tune_reduce_types[i], &b, r);
+            }
+        }
+
+        /* The fcollect result must also fit in the destination buffer */
+        for (len = COLL_TUNE_MIN_SIZE; len * PE_size <= max_size; len *= 8) {
+            max_bytes = len * 8 * PE_size > max_size ? SIZE_MAX : len;
+            coll_tune_cell(SHMEM_INTERNAL_COLL_TUNE_FCOLLECT, PE_size, max_pes, len,
+                           max_bytes, SHMEM_INTERNAL_COLL_TUNE_ANY_TYPE, &b, r);
+        }
+    }
+
+    /* Only PE 0 records rules */
+    if (r->oom) {
+        RETURN_ERROR_STR("Out of memory recording collective tuning rules");
+        ret = 1;
+    }
+
+ out:
+    shmem_internal_barrier_all();
+    shmem_internal_free(b.times);
+    shmem_internal_free(b.psync[0]);
+    shmem_internal_free(b.dst);
+    shmem_internal_free(b.src);
+
+    return ret;
+}
+
+
+/* Collective over all PEs.  Returns val from PE 0. */
+static long
+coll_tune_bcast_long(long *sym, long val)
+{
+    if (shmem_internal_my_pe == 0)
+        *sym = val;
+
+    shmem_internal_barrier_all();
+
+    if (shmem_internal_my_pe != 0) {
+        shmem_internal_get(SHMEM_CTX_DEFAULT, &val, sym, sizeof(long), 0);
+        shmem_internal_get_wait(SHMEM_CTX_DEFAULT);
+    }
+
+    shmem_internal_barrier_all();
+
+    return val;
+}
+
+
+/* Collective over all PEs.  Returns whether failed is set on any PE, so that
+ * all PEs leave the tuning setup together. */
+static int
+coll_tune_any(long *sym, int failed)
+{
+    long one = 1;
+
+    *sym = 0;
+    shmem_internal_barrier_all();
+
+    if (failed)
+        shmem_internal_atomic(SHMEM_CTX_DEFAULT, sym, &one, sizeof(long), 0,
+                              SHM_INTERNAL_SUM, SHM_INTERNAL_LONG);
+
+    shmem_internal_barrier_all();
+
+    return 0 != coll_tune_bcast_long(sym, *sym);
+}
+
+
+static int
+coll_tune_rule_cmp(const void *a, const void *b)
+{
+    const shmem_internal_coll_tune_rule_t *x = a, *y = b;
+
+    if (x->coll != y->coll)           return x->coll < y->coll ? -1 : 1;
+    if (x->max_pes != y->max_pes)     return x->max_pes < y->max_pes ? -1 : 1;
+    if (x->max_bytes != y->max_bytes) return x->max_bytes < y->max_bytes ? -1 : 1;
+    return 0;
+}
+
+
+int
+shmem_internal_coll_tune_init(void)
+{
+    struct coll_tune_rules_t r = { NULL, 0, 0, 0 };
+    const char *path = shmem_internal_params.COLL_TUNE_FILE;
+    long *sym, nrules;
+    size_t i;
+    int ret = 0;
+
+    if (!shmem_internal_params.COLL_TUNE_FILE_provided) {
+        if (shmem_internal_params.COLL_TUNE && shmem_internal_my_pe == 0)
+            RAISE_WARN_STR("SHMEM_COLL_TUNE requires SHMEM_COLL_TUNE_FILE, not tuning");
+        return 0;
+    }
+
+    sym = shmem_internal_shmalloc(sizeof(long));
+    if (NULL == sym) {
+        RETURN_ERROR_STR("Out of symmetric memory for collective tuning");
+        return 1;
+    }
+
+    /* Peers may not have initialized their collectives pSyncs yet */
+    shmem_runtime_barrier();
+
+    /* nrules is -1 when PE 0 has no table to load */
+    nrules = -1;
+    if (shmem_internal_my_pe == 0) {
+        ret = coll_tune_read(path, &r);
+        if (0 == ret) {
+            nrules = (long) r.nrules;
+        } else if (ENOENT != ret || !shmem_internal_params.COLL_TUNE) {
+            RAISE_WARN_MSG("Unable to read collective tuning table %s (%s)\n",
+                           path, strerror(ret));
+            nrules = 0;
+        }
+    }
+    nrules = coll_tune_bcast_long(sym, nrules);
+
+    if (nrules < 0) {
+        ret = coll_tune_generate(&r);
+        if (ret == 0 && shmem_internal_my_pe == 0)
+            coll_tune_write(path, &r);
+        /* Agree on the outcome, since only PE 0 fails when it runs out of
+         * memory for the rules */
+        nrules = coll_tune_bcast_long(sym, ret ? -1 : (long) r.nrules);
+        if (nrules < 0) {
+            ret = 1;
+            goto out;
+        }
+    }
+    ret = 0;
+
+    if (nrules > 0) {
+        shmem_internal_coll_tune_rule_t *sym_rules;
+        size_t len = nrules * sizeof(shmem_internal_coll_tune_rule_t);
+        int failed;
+
+        coll_tune_table = malloc(len);
+        sym_rules = shmem_internal_shmalloc(len);
+        failed = NULL == coll_tune_table || NULL == sym_rules;
+        if (failed)
+            RETURN_ERROR_STR("Out of memory loading the collective tuning table");
+
+        /* Agree on the outcome before any PE leaves the collective section */
+        if (coll_tune_any(sym, failed)) {
+            free(coll_tune_table);
+            coll_tune_table = NULL;
+            if (NULL != sym_rules) shmem_internal_free(sym_rules);
+            ret = 1;
+            goto out;
+        }
+
+        if (shmem_internal_my_pe == 0)
+            memcpy(sym_rules, r.rules, len);
+
+        shmem_internal_barrier_all();
+
+        if (shmem_internal_my_pe == 0) {
+            memcpy(coll_tune_table, sym_rules, len);
+        } else {
+            shmem_internal_get(SHMEM_CTX_DEFAULT, coll_tune_table, sym_rules, len, 0);
+            shmem_internal_get_wait(SHMEM_CTX_DEFAULT);
+        }
+
+        shmem_internal_barrier_all();
+        shmem_internal_free(sym_rules);
+
+        qsort(coll_tune_table, nrules, sizeof(shmem_internal_coll_tune_rule_t),
+              coll_tune_rule_cmp);
+
+        for (i = nrules; i > 0; i--) {
+            int coll = coll_tune_table[i-1].coll;
+            coll_tune_rows[coll] = &coll_tune_table[i-1];
+            shmem_internal_coll_tune_nrows[coll]++;
+        }
+
+        DEBUG_MSG("Loaded %ld collective tuning rules from %s\n", nrules, path);
+    }
+
+ out:
+    free(r.rules);
+    shmem_internal_free(sym);
+    return ret;
+}
+
+
+void
+shmem_internal_coll_tune_fini(void)
+{
+    int i;
+
+    for (i = 0; i < SHMEM_INTERNAL_COLL_TUNE_NUM; i++) {
+        shmem_internal_coll_tune_nrows[i] = 0;
+        coll_tune_rows[i] = NULL;
+    }
+
+    free(coll_tune_table);
+    coll_tune_table = NULL;
+}
+
+
+coll_type_t
+shmem_internal_coll_tune_lookup(int coll, int PE_size, size_t len, int datatype)
+{
+    const shmem_internal_coll_tune_rule_t *rows = coll_tune_rows[coll];
+    coll_type_t any = AUTO;
+    int i;
+
+    for (i = 0; i < shmem_internal_coll_tune_nrows[coll]; i++) {
+        if (PE_size > rows[i].max_pes || len > rows[i].max_bytes) continue;
+
+        if (rows[i].datatype == datatype)
+            return rows[i].alg;
+        if (rows[i].datatype == SHMEM_INTERNAL_COLL_TUNE_ANY_TYPE && any == AUTO)
+            any = rows[i].alg;
+    }
+
+    return any;
+}
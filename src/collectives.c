@@ -21,6 +21,7 @@
 #include "shmem_internal.h"
 #include "shmem_collectives.h"
 #include "shmem_internal_op.h"
+#include "shmem_team.h"
 
 coll_type_t shmem_internal_barrier_type = AUTO;
 coll_type_t shmem_internal_bcast_type = AUTO;
@@ -29,19 +30,35 @@ coll_type_t shmem_internal_collect_type = AUTO;
 coll_type_t shmem_internal_fcollect_type = AUTO;
 long *shmem_internal_barrier_all_psync;
 long *shmem_internal_sync_all_psync;
+shmem_internal_sync_req_t shmem_internal_barrier_all_req;
 
 char *coll_type_str[] = { "AUTO",
                           "LINEAR",
                           "TREE",
                           "DISSEM",
                           "RING",
-                          "RECDBL" };
+                          "RECDBL",
+                          "HIER",
+                          "OFFLOAD" };
 
 static int *full_tree_children;
 static int full_tree_num_children;
 static int full_tree_parent;
 static long tree_radix = -1;
 
+/* Node layout used by the hierarchical barrier over all PEs */
+static int hier_leader;
+static int *hier_local_pes;
+static int hier_num_local;
+static int *hier_leaders;
+static int hier_num_leaders;
+static int hier_leader_idx;
+
+/* The hierarchical barrier keeps its on-node counters in the last two int
+ * slots of pSync, above those used by the leader dissemination rounds */
+#define HIER_GATHER_IDX  ((int) (SHMEM_BARRIER_SYNC_SIZE * sizeof(long) / sizeof(int)) - 2)
+#define HIER_RELEASE_IDX ((int) (SHMEM_BARRIER_SYNC_SIZE * sizeof(long) / sizeof(int)) - 1)
+
 
 static int
 shmem_internal_build_kary_tree(int radix, int PE_start, int stride,
@@ -92,6 +109,78 @@ shmem_internal_build_kary_tree(int radix, int PE_start, int stride,
 }
 
 
+/* Find the node leader (the lowest PE reachable through shared memory) for
+ * every PE and record the on-node PEs and the list of leaders.  Every PE must
+ * call this during initialization, since it performs an fcollect over all
+ * PEs. */
+static int
+shmem_internal_hier_init(void)
+{
+    int i, j;
+    int *node_leaders;
+    long *psync;
+
+    hier_leader = shmem_internal_my_pe;
+    hier_num_local = 0;
+
+    for (i = 0; i < shmem_internal_num_pes; i++) {
+        if (-1 == shmem_internal_get_shr_rank(i)) continue;
+        if (hier_leader == shmem_internal_my_pe && i < hier_leader) hier_leader = i;
+        if (i != shmem_internal_my_pe) hier_num_local++;
+    }
+
+    if (hier_leader == shmem_internal_my_pe && hier_num_local > 0) {
+        hier_local_pes = malloc(sizeof(int) * hier_num_local);
+        if (NULL == hier_local_pes) return -1;
+
+        for (i = 0, j = 0; i < shmem_internal_num_pes; i++) {
+            if (i != shmem_internal_my_pe && -1 != shmem_internal_get_shr_rank(i))
+                hier_local_pes[j++] = i;
+        }
+    } else {
+        hier_num_local = 0;
+    }
+
+    node_leaders = shmem_internal_shmalloc(sizeof(int) * shmem_internal_num_pes);
+    if (NULL == node_leaders) return -1;
+
+    psync = shmem_internal_shmalloc(sizeof(long) * SHMEM_COLLECT_SYNC_SIZE);
+    if (NULL == psync) return -1;
+
+    for (i = 0; i < SHMEM_COLLECT_SYNC_SIZE; i++)
+        psync[i] = SHMEM_SYNC_VALUE;
+
+    /* Peers must not update psync before it is initialized */
+    shmem_runtime_barrier();
+
+    shmem_internal_fcollect_ring(node_leaders, &hier_leader, sizeof(int), 0, 1,
+                                 shmem_internal_num_pes, psync);
+
+    hier_num_leaders = 0;
+    for (i = 0; i < shmem_internal_num_pes; i++) {
+        if (node_leaders[i] == i) hier_num_leaders++;
+    }
+
+    hier_leaders = malloc(sizeof(int) * hier_num_leaders);
+    if (NULL == hier_leaders) return -1;
+
+    for (i = 0, j = 0; i < shmem_internal_num_pes; i++) {
+        if (node_leaders[i] == i) {
+            if (i == shmem_internal_my_pe) hier_leader_idx = j;
+            hier_leaders[j++] = i;
+        }
+    }
+
+    shmem_internal_free(psync);
+    shmem_internal_free(node_leaders);
+
+    DEBUG_MSG("Hierarchical barrier: leader=%d, num_local=%d, num_leaders=%d\n",
+              hier_leader, hier_num_local, hier_num_leaders);
+
+    return 0;
+}
+
+
 /* Circulator iterator for PE active sets */
 static inline int
 shmem_internal_circular_iter_next(int curr, int PE_start, int PE_stride, int PE_size)
@@ -175,6 +264,10 @@ shmem_internal_collectives_init(void)
             shmem_internal_barrier_type = TREE;
         } else if (0 == strcmp(type, "dissem")) {
             shmem_internal_barrier_type = DISSEM;
+        } else if (0 == strcmp(type, "hier")) {
+            shmem_internal_barrier_type = HIER;
+        } else if (0 == strcmp(type, "offload")) {
+            shmem_internal_barrier_type = OFFLOAD;
         } else {
             RAISE_WARN_MSG("Ignoring bad barrier algorithm '%s'\n", type);
         }
@@ -187,6 +280,8 @@ shmem_internal_collectives_init(void)
             shmem_internal_bcast_type = LINEAR;
         } else if (0 == strcmp(type, "tree")) {
             shmem_internal_bcast_type = TREE;
+        } else if (0 == strcmp(type, "offload")) {
+            shmem_internal_bcast_type = OFFLOAD;
         } else {
             RAISE_WARN_MSG("Ignoring bad broadcast algorithm '%s'\n", type);
         }
@@ -203,6 +298,8 @@ shmem_internal_collectives_init(void)
             shmem_internal_reduce_type = TREE;
         } else if (0 == strcmp(type, "recdbl")) {
             shmem_internal_reduce_type = RECDBL;
+        } else if (0 == strcmp(type, "offload")) {
+            shmem_internal_reduce_type = OFFLOAD;
         } else {
             RAISE_WARN_MSG("Ignoring bad reduction algorithm '%s'\n", type);
         }
@@ -234,6 +331,21 @@ shmem_internal_collectives_init(void)
         }
     }
 
+    if (shmem_internal_barrier_type == HIER) {
+        if (0 != shmem_internal_hier_init()) return -1;
+    }
+
+    if (shmem_internal_barrier_type == OFFLOAD || shmem_internal_bcast_type == OFFLOAD ||
+        shmem_internal_reduce_type == OFFLOAD) {
+#ifdef USE_PORTALS4
+        if (0 != shmem_transport_portals4_coll_init())
+            return -1;
+#else
+        /* The offload path falls back to the tree algorithms */
+        RAISE_WARN_STR("Collective offload requires the Portals 4 transport");
+#endif
+    }
+
     return 0;
 }
 
@@ -407,6 +519,436 @@ shmem_internal_sync_dissem(int PE_start, int PE_stride, int PE_size, long *pSync
 }
 
 
+/* Hierarchical barrier.  PEs check in with their node leader, the leaders
+ * synchronize using the dissemination algorithm, and then each leader releases
+ * the PEs on its node.  Only the leaders communicate across nodes; check-in and
+ * release are between co-located PEs.  The release is a put, which uses the
+ * shared memory transport.  The check-in counts arrivals with an atomic add in
+ * pSync, which has no room for a flag per PE, so it only stays in shared memory
+ * when USE_SHR_ATOMICS is defined and otherwise goes through the network
+ * transport.  The node layout is computed at initialization for the active set
+ * of all PEs; other active sets use the dissemination algorithm. */
+void
+shmem_internal_sync_hier(int PE_start, int PE_stride, int PE_size, long *pSync)
+{
+    int zero = 0, one = 1, neg_one = -1;
+    int distance, to, i;
+    int *pSync_ints = (int*) pSync;
+    int *gather = &pSync_ints[HIER_GATHER_IDX];
+    int *release = &pSync_ints[HIER_RELEASE_IDX];
+
+    if (NULL == hier_leaders || PE_start != 0 || PE_stride != 1 ||
+        PE_size != shmem_internal_num_pes) {
+        shmem_internal_sync_dissem(PE_start, PE_stride, PE_size, pSync);
+        return;
+    }
+
+    if (hier_leader != shmem_internal_my_pe) {
+        /* check in with the leader */
+        shmem_internal_atomic(SHMEM_CTX_DEFAULT, gather, &one, sizeof(int),
+                              hier_leader, SHM_INTERNAL_SUM, SHM_INTERNAL_INT);
+
+        /* wait for release */
+        SHMEM_WAIT_UNTIL(release, SHMEM_CMP_NE, 0);
+
+        /* Clear pSync */
+        shmem_internal_put_scalar(SHMEM_CTX_DEFAULT, release, &zero, sizeof(zero),
+                                 shmem_internal_my_pe);
+        SHMEM_WAIT_UNTIL(release, SHMEM_CMP_EQ, 0);
+        return;
+    }
+
+    /* wait for the on-node PEs to check in */
+    if (hier_num_local > 0) {
+        SHMEM_WAIT_UNTIL(gather, SHMEM_CMP_EQ, hier_num_local);
+
+        /* Clear pSync */
+        shmem_internal_put_scalar(SHMEM_CTX_DEFAULT, gather, &zero, sizeof(zero),
+                                 shmem_internal_my_pe);
+        SHMEM_WAIT_UNTIL(gather, SHMEM_CMP_EQ, 0);
+    }
+
+    /* dissemination among the node leaders */
+    for (i = 0, distance = 1 ; distance < hier_num_leaders ; ++i, distance <<= 1) {
+        shmem_internal_assert(i < HIER_GATHER_IDX);
+
+        to = hier_leaders[(hier_leader_idx + distance) % hier_num_leaders];
+
+        shmem_internal_atomic(SHMEM_CTX_DEFAULT, &pSync_ints[i], &one, sizeof(int),
+                              to, SHM_INTERNAL_SUM, SHM_INTERNAL_INT);
+
+        SHMEM_WAIT_UNTIL(&pSync_ints[i], SHMEM_CMP_NE, 0);
+        shmem_internal_assert(pSync_ints[i] < 3);
+
+        shmem_internal_atomic(SHMEM_CTX_DEFAULT, &pSync_ints[i], &neg_one, sizeof(int),
+                              shmem_internal_my_pe, SHM_INTERNAL_SUM, SHM_INTERNAL_INT);
+    }
+
+    /* Ensure local pSync decrements are done before a subsequent barrier */
+    if (hier_num_leaders > 1)
+        shmem_internal_quiet(SHMEM_CTX_DEFAULT);
+
+    /* release the on-node PEs */
+    for (i = 0 ; i < hier_num_local ; ++i) {
+        shmem_internal_put_scalar(SHMEM_CTX_DEFAULT, release, &one, sizeof(one),
+                                  hier_local_pes[i]);
+    }
+}
+
+
+/* Barrier offloaded to the network with triggered operations.  Only the
+ * active set of all PEs is offloaded; other active sets use the tree
+ * algorithm. */
+void
+shmem_internal_sync_offload(int PE_start, int PE_stride, int PE_size, long *pSync)
+{
+#ifdef USE_PORTALS4
+    if (shmem_transport_portals4_coll_enabled && PE_start == 0 && PE_stride == 1 &&
+        PE_size == shmem_internal_num_pes) {
+        shmem_transport_portals4_coll_barrier();
+        return;
+    }
+#endif
+
+    shmem_internal_sync_tree(PE_start, PE_stride, PE_size, pSync);
+}
+
+
+/*****************************************
+ *
+ * Split-phase BARRIER/SYNC
+ *
+ * The split-phase operations follow the same message pattern as the blocking
+ * algorithms above, so the two can be used interchangeably on a pSync.  Each
+ * state corresponds to a wait on pSync in the blocking algorithm; instead of
+ * waiting, progress returns to the caller and resumes from the recorded state
+ * on the next call.
+ *
+ *****************************************/
+enum sync_req_state_t {
+    SYNC_REQ_DONE = 0,
+    SYNC_REQ_WAIT_CHILDREN,     /* tree/linear: wait for callins from children */
+    SYNC_REQ_WAIT_PARENT,       /* tree: wait for ack from parent */
+    SYNC_REQ_WAIT_RELEASE,      /* tree/linear leaf: wait for ack from parent */
+    SYNC_REQ_CLEAR_AND_RELEASE, /* tree/linear: wait for clear, then ack children */
+    SYNC_REQ_CLEAR,             /* tree/linear leaf: wait for clear */
+    SYNC_REQ_DISSEM_ROUND,      /* dissem/hier: wait for round notification */
+    SYNC_REQ_HIER_GATHER,       /* hier leader: wait for on-node check in */
+    SYNC_REQ_HIER_CLEAR_GATHER, /* hier leader: wait for clear */
+    SYNC_REQ_HIER_WAIT_RELEASE, /* hier: wait for release from the leader */
+    SYNC_REQ_HIER_CLEAR_RELEASE /* hier: wait for clear */
+};
+
+/* Nonblocking equivalent of SHMEM_WAIT_UNTIL */
+#define SYNC_REQ_TEST(var, cond, value, ret)                    \
+    do {                                                        \
+        SHMEM_TEST(cond, var, value, ret);                      \
+        if (ret) {                                              \
+            shmem_internal_membar_acq_rel();                    \
+            shmem_transport_syncmem();                          \
+        } else {                                                \
+            shmem_transport_probe();                            \
+        }                                                       \
+    } while (0)
+
+
+/* Notify the next dissemination peer, or finish once all rounds are done */
+static void
+sync_req_dissem_next(shmem_internal_sync_req_t *req)
+{
+    int one = 1, i;
+    int *pSync_ints = (int*) req->pSync;
+    int num_procs, to;
+
+    num_procs = (req->type == HIER) ? hier_num_leaders : req->PE_size;
+
+    if (req->distance < num_procs) {
+        if (req->type == HIER) {
+            shmem_internal_assert(req->round < HIER_GATHER_IDX);
+            to = hier_leaders[(hier_leader_idx + req->distance) % num_procs];
+        } else {
+            int coll_rank = (shmem_internal_my_pe - req->PE_start) / req->PE_stride;
+            to = req->PE_start + ((coll_rank + req->distance) % num_procs) * req->PE_stride;
+        }
+
+        shmem_internal_atomic(SHMEM_CTX_DEFAULT, &pSync_ints[req->round], &one,
+                              sizeof(int), to, SHM_INTERNAL_SUM, SHM_INTERNAL_INT);
+        req->state = SYNC_REQ_DISSEM_ROUND;
+        return;
+    }
+
+    /* Ensure local pSync decrements are done before a subsequent barrier */
+    if (req->distance > 1)
+        shmem_internal_quiet(SHMEM_CTX_DEFAULT);
+
+    if (req->type == HIER) {
+        for (i = 0 ; i < hier_num_local ; ++i) {
+            shmem_internal_put_scalar(SHMEM_CTX_DEFAULT, &pSync_ints[HIER_RELEASE_IDX],
+                                      &one, sizeof(one), hier_local_pes[i]);
+        }
+    }
+
+    req->state = SYNC_REQ_DONE;
+}
+
+
+/* Advance the state machine as far as possible without waiting.  Returns
+ * nonzero once the operation has completed. */
+static int
+sync_req_progress(shmem_internal_sync_req_t *req)
+{
+    long zero = 0, one = 1;
+    int izero = 0, ineg_one = -1;
+    int *pSync_ints = (int*) req->pSync;
+    int *gather = &pSync_ints[HIER_GATHER_IDX];
+    int *release = &pSync_ints[HIER_RELEASE_IDX];
+    int ret, pe, i;
+
+    for (;;) {
+        switch (req->state) {
+        case SYNC_REQ_DONE:
+            return 1;
+
+        case SYNC_REQ_WAIT_CHILDREN:
+            SYNC_REQ_TEST(req->pSync, SHMEM_CMP_EQ, req->num_children, ret);
+            if (!ret) return 0;
+
+            if (req->parent == shmem_internal_my_pe) {
+                /* The root; clear pSync */
+                shmem_internal_put_scalar(SHMEM_CTX_DEFAULT, req->pSync, &zero,
+                                          sizeof(zero), shmem_internal_my_pe);
+                req->state = SYNC_REQ_CLEAR_AND_RELEASE;
+            } else {
+                /* Middle of the tree; send ack to parent */
+                shmem_internal_atomic(SHMEM_CTX_DEFAULT, req->pSync, &one, sizeof(one),
+                                      req->parent, SHM_INTERNAL_SUM, SHM_INTERNAL_LONG);
+                req->state = SYNC_REQ_WAIT_PARENT;
+            }
+            break;
+
+        case SYNC_REQ_WAIT_PARENT:
+            SYNC_REQ_TEST(req->pSync, SHMEM_CMP_EQ, req->num_children + 1, ret);
+            if (!ret) return 0;
+
+            shmem_internal_put_scalar(SHMEM_CTX_DEFAULT, req->pSync, &zero,
+                                      sizeof(zero), shmem_internal_my_pe);
+            req->state = SYNC_REQ_CLEAR_AND_RELEASE;
+            break;
+
+        case SYNC_REQ_WAIT_RELEASE:
+            SYNC_REQ_TEST(req->pSync, SHMEM_CMP_NE, 0, ret);
+            if (!ret) return 0;
+
+            shmem_internal_put_scalar(SHMEM_CTX_DEFAULT, req->pSync, &zero,
+                                      sizeof(zero), shmem_internal_my_pe);
+            req->state = SYNC_REQ_CLEAR;
+            break;
+
+        case SYNC_REQ_CLEAR_AND_RELEASE:
+            SYNC_REQ_TEST(req->pSync, SHMEM_CMP_EQ, 0, ret);
+            if (!ret) return 0;
+
+            if (req->type == LINEAR) {
+                for (pe = req->PE_start + req->PE_stride, i = 1 ;
+                     i < req->PE_size ;
+                     i++, pe += req->PE_stride) {
+                    shmem_internal_put_scalar(SHMEM_CTX_DEFAULT, req->pSync, &one,
+                                              sizeof(one), pe);
+                }
+            } else {
+                for (i = 0 ; i < req->num_children ; ++i) {
+                    shmem_internal_atomic(SHMEM_CTX_DEFAULT, req->pSync, &one,
+                                          sizeof(one), req->children[i],
+                                          SHM_INTERNAL_SUM, SHM_INTERNAL_LONG);
+                }
+            }
+            req->state = SYNC_REQ_DONE;
+            break;
+
+        case SYNC_REQ_CLEAR:
+            SYNC_REQ_TEST(req->pSync, SHMEM_CMP_EQ, 0, ret);
+            if (!ret) return 0;
+
+            req->state = SYNC_REQ_DONE;
+            break;
+
+        case SYNC_REQ_DISSEM_ROUND:
+            SYNC_REQ_TEST(&pSync_ints[req->round], SHMEM_CMP_NE, 0, ret);
+            if (!ret) return 0;
+
+            shmem_internal_assert(pSync_ints[req->round] < 3);
+
+            /* this slot is no longer used, so subtract off results now */
+            shmem_internal_atomic(SHMEM_CTX_DEFAULT, &pSync_ints[req->round],
+                                  &ineg_one, sizeof(int), shmem_internal_my_pe,
+                                  SHM_INTERNAL_SUM, SHM_INTERNAL_INT);
+            req->round++;
+            req->distance <<= 1;
+            sync_req_dissem_next(req);
+            break;
+
+        case SYNC_REQ_HIER_GATHER:
+            SYNC_REQ_TEST(gather, SHMEM_CMP_EQ, hier_num_local, ret);
+            if (!ret) return 0;
+
+            shmem_internal_put_scalar(SHMEM_CTX_DEFAULT, gather, &izero,
+                                      sizeof(izero), shmem_internal_my_pe);
+            req->state = SYNC_REQ_HIER_CLEAR_GATHER;
+            break;
+
+        case SYNC_REQ_HIER_CLEAR_GATHER:
+            SYNC_REQ_TEST(gather, SHMEM_CMP_EQ, 0, ret);
+            if (!ret) return 0;
+
+            sync_req_dissem_next(req);
+            break;
+
+        case SYNC_REQ_HIER_WAIT_RELEASE:
+            SYNC_REQ_TEST(release, SHMEM_CMP_NE, 0, ret);
+            if (!ret) return 0;
+
+            shmem_internal_put_scalar(SHMEM_CTX_DEFAULT, release, &izero,
+                                      sizeof(izero), shmem_internal_my_pe);
+            req->state = SYNC_REQ_HIER_CLEAR_RELEASE;
+            break;
+
+        case SYNC_REQ_HIER_CLEAR_RELEASE:
+            SYNC_REQ_TEST(release, SHMEM_CMP_EQ, 0, ret);
+            if (!ret) return 0;
+
+            req->state = SYNC_REQ_DONE;
+            break;
+
+        default:
+            RAISE_ERROR_MSG("Illegal split-phase sync state (%d)\n", req->state);
+        }
+    }
+}
+
+
+void
+shmem_internal_sync_start(shmem_internal_sync_req_t *req, int PE_start,
+                          int PE_stride, int PE_size, long *pSync)
+{
+    long one = 1;
+    int ione = 1;
+    coll_type_t type;
+
+    if (req->active)
+        RAISE_ERROR_STR("Split-phase sync started while another is in progress");
+
+    if (shmem_internal_params.BARRIERS_FLUSH) {
+        fflush(stdout);
+        fflush(stderr);
+    }
+
+    req->active       = 1;
+    req->PE_start     = PE_start;
+    req->PE_stride    = PE_stride;
+    req->PE_size      = PE_size;
+    req->pSync        = pSync;
+    req->children     = NULL;
+    req->num_children = 0;
+    req->round        = 0;
+    req->distance     = 1;
+    req->state        = SYNC_REQ_DONE;
+
+    if (PE_size == 1) return;
+
+    /* Select the same algorithm as shmem_internal_sync */
+    type = shmem_internal_sync_type(PE_size);
+    if (type == HIER && (NULL == hier_leaders || PE_start != 0 ||
+                         PE_stride != 1 || PE_size != shmem_internal_num_pes)) {
+        type = DISSEM;
+    }
+    if (type == OFFLOAD)
+        type = TREE;
+    req->type = type;
+
+    switch (type) {
+    case LINEAR:
+        req->parent = PE_start;
+        if (PE_start == shmem_internal_my_pe) {
+            req->num_children = PE_size - 1;
+            req->state = SYNC_REQ_WAIT_CHILDREN;
+        } else {
+            shmem_internal_atomic(SHMEM_CTX_DEFAULT, pSync, &one, sizeof(one), PE_start,
+                                  SHM_INTERNAL_SUM, SHM_INTERNAL_LONG);
+            req->state = SYNC_REQ_WAIT_RELEASE;
+        }
+        break;
+    case TREE:
+        if (PE_size == shmem_internal_num_pes) {
+            req->parent = full_tree_parent;
+            req->num_children = full_tree_num_children;
+            req->children = full_tree_children;
+        } else {
+            req->children = malloc(sizeof(int) * tree_radix);
+            if (NULL == req->children)
+                RAISE_ERROR_STR("Out of memory allocating split-phase sync tree");
+            shmem_internal_build_kary_tree(tree_radix, PE_start, PE_stride, PE_size,
+                                           0, &req->parent, &req->num_children,
+                                           req->children);
+        }
+
+        if (req->num_children != 0) {
+            req->state = SYNC_REQ_WAIT_CHILDREN;
+        } else {
+            shmem_internal_atomic(SHMEM_CTX_DEFAULT, pSync, &one, sizeof(one),
+                                  req->parent, SHM_INTERNAL_SUM, SHM_INTERNAL_LONG);
+            req->state = SYNC_REQ_WAIT_RELEASE;
+        }
+        break;
+    case DISSEM:
+        shmem_internal_assert(SHMEM_BARRIER_SYNC_SIZE >= (sizeof(int) * 8) / (sizeof(long) / sizeof(int)));
+        sync_req_dissem_next(req);
+        break;
+    case HIER:
+        if (hier_leader != shmem_internal_my_pe) {
+            shmem_internal_atomic(SHMEM_CTX_DEFAULT, &((int*) pSync)[HIER_GATHER_IDX],
+                                  &ione, sizeof(int), hier_leader,
+                                  SHM_INTERNAL_SUM, SHM_INTERNAL_INT);
+            req->state = SYNC_REQ_HIER_WAIT_RELEASE;
+        } else if (hier_num_local > 0) {
+            req->state = SYNC_REQ_HIER_GATHER;
+        } else {
+            sync_req_dissem_next(req);
+        }
+        break;
+    default:
+        RAISE_ERROR_MSG("Illegal barrier/sync type (%d)\n", type);
+    }
+}
+
+
+int
+shmem_internal_sync_test(shmem_internal_sync_req_t *req)
+{
+    if (!req->active) return 1;
+
+    if (!sync_req_progress(req)) return 0;
+
+    if (req->children != NULL && req->children != full_tree_children)
+        free(req->children);
+    req->children = NULL;
+    req->active = 0;
+
+    /* Ensure remote updates are visible in memory */
+    shmem_internal_membar_acq_rel();
+    shmem_transport_syncmem();
+
+    return 1;
+}
+
+
+void
+shmem_internal_sync_wait(shmem_internal_sync_req_t *req)
+{
+    while (!shmem_internal_sync_test(req))
+        SPINLOCK_BODY();
+}
+
+
 /*****************************************
  *
  * BROADCAST
@@ -560,6 +1102,31 @@ shmem_internal_bcast_tree(void *target, const void *source, size_t len,
 }
 
 
+/* Broadcast offloaded to the network with triggered operations, for the
+ * active set of all PEs, a root of PE 0, and messages of up to
+ * SHMEM_PORTALS4_COLL_OFFLOAD_SIZE bytes.  Other broadcasts use the tree
+ * algorithm. */
+void
+shmem_internal_bcast_offload(void *target, const void *source, size_t len,
+                             int PE_root, int PE_start, int PE_stride, int PE_size,
+                             long *pSync, int complete)
+{
+    if (PE_size == 1 || len == 0) return;
+
+#ifdef USE_PORTALS4
+    if (shmem_transport_portals4_coll_enabled && PE_root == 0 && PE_start == 0 &&
+        PE_stride == 1 && PE_size == shmem_internal_num_pes &&
+        len <= shmem_transport_portals4_coll_max_size) {
+        shmem_transport_portals4_coll_bcast(target, source, len, complete);
+        return;
+    }
+#endif
+
+    shmem_internal_bcast_tree(target, source, len, PE_root, PE_start, PE_stride,
+                              PE_size, pSync, complete);
+}
+
+
 /*****************************************
  *
  * REDUCTION
@@ -971,6 +1538,39 @@ shmem_internal_op_to_all_recdbl_sw(void *target, const void *source, size_t coun
 }
 
 
+/* Reduction offloaded to the network with triggered operations, for the
+ * active set of all PEs, the sum, or, and xor operations, and messages of up
+ * to SHMEM_PORTALS4_COLL_OFFLOAD_SIZE bytes.  Other reductions use the tree
+ * algorithm when the transport supports the atomic, and the recursive
+ * doubling or ring algorithm otherwise. */
+void
+shmem_internal_op_to_all_offload(void *target, const void *source, size_t count, size_t type_size,
+                                 int PE_start, int PE_stride, int PE_size,
+                                 void *pWrk, long *pSync,
+                                 shm_internal_op_t op, shm_internal_datatype_t datatype)
+{
+    if (count == 0) return;
+
+#ifdef USE_PORTALS4
+    if (PE_start == 0 && PE_stride == 1 && PE_size == shmem_internal_num_pes &&
+        shmem_transport_portals4_coll_reduce_supported(op, count * type_size)) {
+        shmem_transport_portals4_coll_reduce(target, source, count * type_size, op, datatype);
+        return;
+    }
+#endif
+
+    if (shmem_transport_atomic_supported(op, datatype))
+        shmem_internal_op_to_all_tree(target, source, count, type_size, PE_start,
+                                      PE_stride, PE_size, pWrk, pSync, op, datatype);
+    else if (count * type_size < shmem_internal_params.COLL_SIZE_CROSSOVER)
+        shmem_internal_op_to_all_recdbl_sw(target, source, count, type_size, PE_start,
+                                           PE_stride, PE_size, pWrk, pSync, op, datatype);
+    else
+        shmem_internal_op_to_all_ring(target, source, count, type_size, PE_start,
+                                      PE_stride, PE_size, pWrk, pSync, op, datatype);
+}
+
+
 /*****************************************
  *
  * COLLECT (variable size)
@@ -1223,6 +1823,8 @@ shmem_internal_alltoall(void *dest, const void *source, size_t len,
     if (0 == len)
         return;
 
+    uint64_t pcntr = shmem_internal_pcntr_enter();
+
     /* Send data round-robin, ending with my PE */
     start_pe = shmem_internal_circular_iter_next(shmem_internal_my_pe,
                                                  PE_start, PE_stride,
@@ -1241,6 +1843,8 @@ shmem_internal_alltoall(void *dest, const void *source, size_t len,
 
     for (i = 0; i < SHMEM_BARRIER_SYNC_SIZE; i++)
         pSync[i] = SHMEM_SYNC_VALUE;
+
+    shmem_internal_pcntr_leave_coll(SHMEM_TRACE_COLL_ALLTOALL, LINEAR, len * PE_size, pcntr);
 }
 
 
@@ -1258,6 +1862,8 @@ shmem_internal_alltoalls(void *dest, const void *source, ptrdiff_t dst,
     if (0 == nelems)
         return;
 
+    uint64_t pcntr = shmem_internal_pcntr_enter();
+
     /* Implementation note: Neither OFI nor Portals presently has support for
      * noncontiguous data at the target of a one-sided operation.  I'm not sure
      * of the best communication schedule for the resulting doubly-nested
@@ -1292,4 +1898,479 @@ shmem_internal_alltoalls(void *dest, const void *source, ptrdiff_t dst,
 
     for (i = 0; i < SHMEM_BARRIER_SYNC_SIZE; i++)
         pSync[i] = SHMEM_SYNC_VALUE;
+
+    shmem_internal_pcntr_leave_coll(SHMEM_TRACE_COLL_ALLTOALLS, LINEAR, elem_size * nelems * PE_size, pcntr);
+}
+
+
+/*****************************************
+ *
+ * Non-blocking collectives
+ *
+ * A non-blocking collective is compiled into a schedule of steps when it is
+ * started.  Progress executes the steps in order, returning to the caller when
+ * a step has to wait for a pSync counter to reach its target value or for
+ * gets to complete.  Requests are progressed from shmem_internal_quiet, from
+ * the wait loops of point-to-point synchronization and blocking collectives,
+ * and from request test/wait.
+ *
+ * Each request on a team uses one of the team's N_NBC_PSYNCS_PER_TEAM pSyncs,
+ * round-robin.  Every schedule ends with a dissemination barrier, so once any
+ * PE completes a request, all PEs have finished its data phase.  This allows a
+ * pSync to be reused as soon as the local request using it has completed.
+ * Counters are consumed with atomic decrements rather than cleared, so updates
+ * for the next request on the pSync that arrive early are not lost.
+ *
+ *****************************************/
+
+/* pSync int slots: data counter, release counter, then one slot per
+ * dissemination round */
+#define NBC_CNTR_DATA    0
+#define NBC_CNTR_DOWN    1
+#define NBC_CNTR_DISSEM  2
+
+enum nbc_op_t {
+    NBC_COPY,       /* local copy of len bytes */
+    NBC_PUT,        /* nonblocking put of len bytes to pe */
+    NBC_GET,        /* nonblocking get of len bytes from pe */
+    NBC_GET_WAIT,   /* wait until the posted gets have completed */
+    NBC_FENCE,      /* order puts before subsequent counter updates */
+    NBC_QUIET,      /* complete all outstanding operations */
+    NBC_ADD,        /* add value to cntr on pe */
+    NBC_WAIT,       /* wait until the local cntr reaches value, then consume it */
+    NBC_REDUCE      /* target = target op source, for len elements */
+};
+
+struct nbc_step_t {
+    enum nbc_op_t   op;
+    int             pe;
+    void           *target;
+    const void     *source;
+    size_t          len;
+    int            *cntr;
+    int             value;
+};
+typedef struct nbc_step_t nbc_step_t;
+
+struct shmem_internal_nbc_req_t {
+    struct shmem_internal_nbc_req_t *next;
+    shmem_internal_team_t  *team;
+    int                     slot;
+    int                     done;
+    int                    *psync;
+    nbc_step_t             *steps;
+    int                     num_steps, max_steps, cur_step;
+    void                   *tmp;
+    shm_internal_op_t       op;
+    shm_internal_datatype_t datatype;
+};
+
+int shmem_internal_nbc_num_active = 0;
+static shmem_internal_nbc_req_t *nbc_active_head = NULL;
+static shmem_internal_nbc_req_t *nbc_active_tail = NULL;
+
+/* Held while the active list is progressed or modified.  Progress is skipped
+ * rather than waiting when the lock is held, which also prevents recursion
+ * through the quiet performed by a schedule. */
+static int nbc_busy = 0;
+
+
+static void
+nbc_push(shmem_internal_nbc_req_t *req, enum nbc_op_t op, int pe, void *target,
+         const void *source, size_t len, int *cntr, int value)
+{
+    nbc_step_t *step;
+
+    if (req->num_steps == req->max_steps) {
+        req->max_steps = (req->max_steps == 0) ? 16 : req->max_steps * 2;
+        req->steps = realloc(req->steps, sizeof(nbc_step_t) * req->max_steps);
+        if (NULL == req->steps)
+            RAISE_ERROR_STR("Out of memory allocating non-blocking collective schedule");
+    }
+
+    step = &req->steps[req->num_steps++];
+    step->op     = op;
+    step->pe     = pe;
+    step->target = target;
+    step->source = source;
+    step->len    = len;
+    step->cntr   = cntr;
+    step->value  = value;
+}
+
+
+static shmem_internal_nbc_req_t *
+nbc_req_create(shmem_internal_team_t *team)
+{
+    shmem_internal_nbc_req_t *req;
+    int slot = team->nbc_seq++ % N_NBC_PSYNCS_PER_TEAM;
+
+    /* Wait for the previous request that used this pSync */
+    while (__atomic_load_n(&team->nbc_pending[slot], __ATOMIC_ACQUIRE)) {
+        shmem_internal_nbc_progress();
+        SPINLOCK_BODY();
+    }
+
+    req = calloc(1, sizeof(shmem_internal_nbc_req_t));
+    if (NULL == req)
+        RAISE_ERROR_STR("Out of memory allocating non-blocking collective request");
+
+    req->team  = team;
+    req->slot  = slot;
+    req->psync = (int *) &shmem_internal_nbc_psync_pool[(team->psync_idx *
+                                                         N_NBC_PSYNCS_PER_TEAM + slot) *
+                                                        NBC_PSYNC_SIZE];
+    __atomic_store_n(&team->nbc_pending[slot], 1, __ATOMIC_RELEASE);
+
+    return req;
+}
+
+
+/* Append the dissemination barrier that ends every schedule */
+static void
+nbc_push_barrier(shmem_internal_nbc_req_t *req)
+{
+    shmem_internal_team_t *team = req->team;
+    int distance, to, i;
+
+    for (i = NBC_CNTR_DISSEM, distance = 1 ; distance < team->size ; ++i, distance <<= 1) {
+        shmem_internal_assert(i < (int) (NBC_PSYNC_SIZE * sizeof(long) / sizeof(int)));
+
+        to = team->start + ((team->my_pe + distance) % team->size) * team->stride;
+        nbc_push(req, NBC_ADD, to, NULL, NULL, 0, &req->psync[i], 1);
+        nbc_push(req, NBC_WAIT, -1, NULL, NULL, 0, &req->psync[i], 1);
+    }
+
+    /* Complete local pSync decrements and data transfers */
+    nbc_push(req, NBC_QUIET, -1, NULL, NULL, 0, NULL, 0);
+}
+
+
+static void
+nbc_req_start(shmem_internal_nbc_req_t *req)
+{
+    __atomic_add_fetch(&shmem_internal_nbc_num_active, 1, __ATOMIC_RELAXED);
+
+    while (__atomic_exchange_n(&nbc_busy, 1, __ATOMIC_ACQUIRE))
+        SPINLOCK_BODY();
+
+    if (NULL == nbc_active_tail)
+        nbc_active_head = req;
+    else
+        nbc_active_tail->next = req;
+    nbc_active_tail = req;
+
+    __atomic_store_n(&nbc_busy, 0, __ATOMIC_RELEASE);
+
+    /* Issue the leading steps, which often require no waiting */
+    shmem_internal_nbc_progress();
+}
+
+
+/* Execute steps until one has to wait.  Returns nonzero once the schedule has
+ * completed. */
+static int
+nbc_req_progress(shmem_internal_nbc_req_t *req)
+{
+    int ret, neg;
+
+    while (req->cur_step < req->num_steps) {
+        nbc_step_t *step = &req->steps[req->cur_step];
+
+        switch (step->op) {
+        case NBC_COPY:
+            shmem_internal_copy_self(step->target, step->source, step->len);
+            break;
+        case NBC_PUT:
+            shmem_internal_put_nbi(SHMEM_CTX_DEFAULT, step->target, step->source,
+                                   step->len, step->pe);
+            break;
+        case NBC_GET:
+            shmem_internal_get(SHMEM_CTX_DEFAULT, step->target, step->source,
+                               step->len, step->pe);
+            break;
+        case NBC_GET_WAIT:
+            if (!shmem_internal_get_test(SHMEM_CTX_DEFAULT)) {
+                shmem_transport_probe();
+                return 0;
+            }
+            shmem_internal_membar_acquire();
+            break;
+        case NBC_FENCE:
+            shmem_internal_fence(SHMEM_CTX_DEFAULT);
+            break;
+        case NBC_QUIET:
+            shmem_internal_quiet(SHMEM_CTX_DEFAULT);
+            break;
+        case NBC_ADD:
+            shmem_internal_atomic(SHMEM_CTX_DEFAULT, step->cntr, &step->value,
+                                  sizeof(int), step->pe, SHM_INTERNAL_SUM,
+                                  SHM_INTERNAL_INT);
+            break;
+        case NBC_WAIT:
+            SHMEM_TEST(SHMEM_CMP_GE, step->cntr, step->value, ret);
+            if (!ret) {
+                shmem_transport_probe();
+                return 0;
+            }
+            shmem_internal_membar_acq_rel();
+            shmem_transport_syncmem();
+
+            neg = -step->value;
+            shmem_internal_atomic(SHMEM_CTX_DEFAULT, step->cntr, &neg, sizeof(int),
+                                  shmem_internal_my_pe, SHM_INTERNAL_SUM,
+                                  SHM_INTERNAL_INT);
+            break;
+        case NBC_REDUCE:
+            shmem_internal_reduce_local(req->op, req->datatype, (int) step->len,
+                                        (void *) step->source, step->target);
+            break;
+        default:
+            RAISE_ERROR_MSG("Illegal non-blocking collective step (%d)\n", step->op);
+        }
+
+        req->cur_step++;
+    }
+
+    return 1;
+}
+
+
+void
+shmem_internal_nbc_progress(void)
+{
+    shmem_internal_nbc_req_t *req, *prev = NULL, *next;
+
+    if (__atomic_exchange_n(&nbc_busy, 1, __ATOMIC_ACQUIRE))
+        return;
+
+    for (req = nbc_active_head ; req != NULL ; req = next) {
+        next = req->next;
+
+        if (!nbc_req_progress(req)) {
+            prev = req;
+            continue;
+        }
+
+        if (NULL == prev)
+            nbc_active_head = next;
+        else
+            prev->next = next;
+        if (nbc_active_tail == req)
+            nbc_active_tail = prev;
+
+        free(req->steps);
+        free(req->tmp);
+        req->steps = NULL;
+        req->tmp = NULL;
+
+        __atomic_store_n(&req->team->nbc_pending[req->slot], 0, __ATOMIC_RELEASE);
+        __atomic_sub_fetch(&shmem_internal_nbc_num_active, 1, __ATOMIC_RELAXED);
+        __atomic_store_n(&req->done, 1, __ATOMIC_RELEASE);
+    }
+
+    __atomic_store_n(&nbc_busy, 0, __ATOMIC_RELEASE);
+}
+
+
+int
+shmem_internal_nbc_test(shmem_internal_nbc_req_t **req)
+{
+    if (NULL == *req) return 1;
+
+    if (!__atomic_load_n(&(*req)->done, __ATOMIC_ACQUIRE)) {
+        shmem_internal_nbc_progress();
+        if (!__atomic_load_n(&(*req)->done, __ATOMIC_ACQUIRE))
+            return 0;
+    }
+
+    free(*req);
+    *req = NULL;
+
+    return 1;
+}
+
+
+void
+shmem_internal_nbc_wait(shmem_internal_nbc_req_t **req)
+{
+    while (!shmem_internal_nbc_test(req))
+        SPINLOCK_BODY();
+}
+
+
+void
+shmem_internal_nbc_team_drain(shmem_internal_team_t *team)
+{
+    int i;
+
+    for (i = 0 ; i < N_NBC_PSYNCS_PER_TEAM ; i++) {
+        while (__atomic_load_n(&team->nbc_pending[i], __ATOMIC_ACQUIRE)) {
+            shmem_internal_nbc_progress();
+            SPINLOCK_BODY();
+        }
+    }
+}
+
+
+/* Binomial-tree broadcast: wait for the data from the parent, then forward it
+ * to the children */
+shmem_internal_nbc_req_t *
+shmem_internal_bcast_nb(shmem_internal_team_t *team, void *dest,
+                        const void *source, size_t len, int PE_root)
+{
+    shmem_internal_nbc_req_t *req = nbc_req_create(team);
+    int parent, num_children, i;
+    int *children = alloca(sizeof(int) * tree_radix);
+    int root = team->start + PE_root * team->stride;
+    const void *from = source;
+
+    shmem_internal_build_kary_tree(tree_radix, team->start, team->stride,
+                                   team->size, PE_root, &parent,
+                                   &num_children, children);
+
+    if (shmem_internal_my_pe != root) {
+        nbc_push(req, NBC_WAIT, -1, NULL, NULL, 0, &req->psync[NBC_CNTR_DATA], 1);
+        from = dest;
+    }
+
+    for (i = 0 ; i < num_children ; i++)
+        nbc_push(req, NBC_PUT, children[i], dest, from, len, NULL, 0);
+
+    if (num_children > 0) {
+        nbc_push(req, NBC_FENCE, -1, NULL, NULL, 0, NULL, 0);
+        for (i = 0 ; i < num_children ; i++)
+            nbc_push(req, NBC_ADD, children[i], NULL, NULL, 0,
+                     &req->psync[NBC_CNTR_DATA], 1);
+    }
+
+    if (shmem_internal_my_pe == root && dest != source)
+        nbc_push(req, NBC_COPY, -1, dest, source, len, NULL, 0);
+
+    nbc_push_barrier(req);
+    nbc_req_start(req);
+
+    return req;
+}
+
+
+/* Every PE writes its block directly into each peer's dest */
+static shmem_internal_nbc_req_t *
+nbc_all_to_all(shmem_internal_team_t *team, void *dest, const void *source,
+               size_t len, int is_alltoall)
+{
+    shmem_internal_nbc_req_t *req = nbc_req_create(team);
+    int i, peer_rank, peer;
+    int my_rank = team->my_pe;
+
+    nbc_push(req, NBC_COPY, -1, (uint8_t *) dest + my_rank * len,
+             (uint8_t *) source + (is_alltoall ? my_rank * len : 0), len, NULL, 0);
+
+    if (team->size > 1) {
+        /* Send round-robin, starting with the next PE, to avoid incast */
+        for (i = 1 ; i < team->size ; i++) {
+            peer_rank = (my_rank + i) % team->size;
+            peer = team->start + peer_rank * team->stride;
+            nbc_push(req, NBC_PUT, peer, (uint8_t *) dest + my_rank * len,
+                     (uint8_t *) source + (is_alltoall ? peer_rank * len : 0),
+                     len, NULL, 0);
+        }
+
+        nbc_push(req, NBC_FENCE, -1, NULL, NULL, 0, NULL, 0);
+
+        for (i = 1 ; i < team->size ; i++) {
+            peer = team->start + ((my_rank + i) % team->size) * team->stride;
+            nbc_push(req, NBC_ADD, peer, NULL, NULL, 0, &req->psync[NBC_CNTR_DATA], 1);
+        }
+
+        nbc_push(req, NBC_WAIT, -1, NULL, NULL, 0, &req->psync[NBC_CNTR_DATA],
+                 team->size - 1);
+    }
+
+    nbc_push_barrier(req);
+    nbc_req_start(req);
+
+    return req;
+}
+
+
+shmem_internal_nbc_req_t *
+shmem_internal_fcollect_nb(shmem_internal_team_t *team, void *dest,
+                           const void *source, size_t len)
+{
+    return nbc_all_to_all(team, dest, source, len, 0);
+}
+
+
+shmem_internal_nbc_req_t *
+shmem_internal_alltoall_nb(shmem_internal_team_t *team, void *dest,
+                           const void *source, size_t len)
+{
+    return nbc_all_to_all(team, dest, source, len, 1);
+}
+
+
+/* Tree allreduce.  Partial results are accumulated in dest.  A parent reads
+ * the children's partial results with gets once they have signaled, so no
+ * symmetric scratch space is needed, and then the final result is pushed back
+ * down the tree. */
+shmem_internal_nbc_req_t *
+shmem_internal_op_to_all_nb(shmem_internal_team_t *team, void *dest,
+                            const void *source, size_t count, size_t type_size,
+                            shm_internal_op_t op, shm_internal_datatype_t datatype)
+{
+    shmem_internal_nbc_req_t *req = nbc_req_create(team);
+    int parent, num_children, i;
+    int *children = alloca(sizeof(int) * tree_radix);
+    size_t len = count * type_size;
+
+    req->op = op;
+    req->datatype = datatype;
+
+    shmem_internal_build_kary_tree(tree_radix, team->start, team->stride,
+                                   team->size, 0, &parent, &num_children,
+                                   children);
+
+    if (dest != source)
+        nbc_push(req, NBC_COPY, -1, dest, source, len, NULL, 0);
+
+    if (num_children > 0) {
+        char *tmp = malloc(len * num_children);
+        if (NULL == tmp)
+            RAISE_ERROR_STR("Out of memory allocating non-blocking reduction buffer");
+        req->tmp = tmp;
+
+        nbc_push(req, NBC_WAIT, -1, NULL, NULL, 0, &req->psync[NBC_CNTR_DATA],
+                 num_children);
+
+        for (i = 0 ; i < num_children ; i++)
+            nbc_push(req, NBC_GET, children[i], tmp + i * len, dest, len, NULL, 0);
+
+        nbc_push(req, NBC_GET_WAIT, -1, NULL, NULL, 0, NULL, 0);
+
+        for (i = 0 ; i < num_children ; i++)
+            nbc_push(req, NBC_REDUCE, -1, dest, tmp + i * len, count, NULL, 0);
+    }
+
+    if (parent != shmem_internal_my_pe) {
+        nbc_push(req, NBC_FENCE, -1, NULL, NULL, 0, NULL, 0);
+        nbc_push(req, NBC_ADD, parent, NULL, NULL, 0, &req->psync[NBC_CNTR_DATA], 1);
+        nbc_push(req, NBC_WAIT, -1, NULL, NULL, 0, &req->psync[NBC_CNTR_DOWN], 1);
+    }
+
+    if (num_children > 0) {
+        for (i = 0 ; i < num_children ; i++)
+            nbc_push(req, NBC_PUT, children[i], dest, dest, len, NULL, 0);
+
+        nbc_push(req, NBC_FENCE, -1, NULL, NULL, 0, NULL, 0);
+
+        for (i = 0 ; i < num_children ; i++)
+            nbc_push(req, NBC_ADD, children[i], NULL, NULL, 0,
+                     &req->psync[NBC_CNTR_DOWN], 1);
+    }
+
+    nbc_push_barrier(req);
+    nbc_req_start(req);
+
+    return req;
 }
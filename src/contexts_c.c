@@ -42,6 +42,9 @@ shmem_ctx_create(long options, shmem_ctx_t *ctx)
 {
     SHMEM_ERR_CHECK_INITIALIZED();
 
+    *ctx = (shmem_ctx_t) shmem_internal_ctx_pool_get(&shmem_internal_team_world, options);
+    if (*ctx != NULL) return 0;
+
     int ret = shmem_transport_ctx_create(&shmem_internal_team_world, options, (shmem_transport_ctx_t **) ctx);
 
     if (0 != ret) *ctx = SHMEM_CTX_INVALID;
@@ -65,6 +68,14 @@ shmem_ctx_destroy(shmem_ctx_t ctx)
     }
 
     shmem_internal_quiet(ctx);
+#ifdef USE_SHR_COPY
+    shmem_shr_copy_ctx_release(ctx);
+#endif
+
+    /* Keep the quiesced context for reuse by a later create on its team */
+    if (shmem_internal_ctx_pool_put((shmem_transport_ctx_t *) ctx))
+        return;
+
     shmem_transport_ctx_destroy((shmem_transport_ctx_t *) ctx);
 
     return;
@@ -37,6 +37,8 @@
 #include "runtime.h"
 #include "build_info.h"
 #include "shmem_team.h"
+#include "shmem_copy.h"
+#include "shmem_pcntr.h"
 
 #if defined(ENABLE_REMOTE_VIRTUAL_ADDRESSING) && defined(__linux__)
 #include <sys/personality.h>
@@ -79,6 +81,9 @@ void *shmem_internal_heap_base = NULL;
 long shmem_internal_heap_length = 0;
 void *shmem_internal_data_base = NULL;
 long shmem_internal_data_length = 0;
+#ifdef USE_MEMFD
+int shmem_internal_heap_fd = -1;
+#endif
 
 void *shmem_external_heap_base = NULL;
 long shmem_external_heap_length = 0;
@@ -106,6 +111,13 @@ hwloc_topology_t shmem_internal_topology;
 #ifdef ENABLE_THREADS
 shmem_internal_mutex_t shmem_internal_mutex_alloc;
 shmem_internal_mutex_t shmem_internal_mutex_rand_r;
+#ifndef USE_PORTALS4
+shmem_internal_mutex_t shmem_internal_mutex_ct;
+#endif
+#endif
+
+#ifndef USE_PORTALS4
+shmem_internal_ct_t *shmem_internal_ct_pending = NULL;
 #endif
 
 static char *shmem_internal_thread_level_str[4] = { "SINGLE", "FUNNELED",
@@ -145,8 +157,12 @@ shmem_internal_shutdown(void)
 
     shmem_internal_barrier_all();
 
+    shmem_internal_pcntr_fini();
+
     shmem_internal_finalized = 1;
 
+    shmem_internal_coll_tune_fini();
+
     shmem_internal_team_fini();
 
     shmem_transport_fini();
@@ -154,6 +170,9 @@ shmem_internal_shutdown(void)
     shmem_shr_transport_fini();
 
     SHMEM_MUTEX_DESTROY(shmem_internal_mutex_alloc);
+#ifndef USE_PORTALS4
+    SHMEM_MUTEX_DESTROY(shmem_internal_mutex_ct);
+#endif
 
     shmem_internal_randr_fini();
 
@@ -204,6 +223,9 @@ shmem_internal_heap_preinit(int tl_requested, int *tl_provided)
 #ifdef ENABLE_THREADS
     shmem_internal_thread_level = tl_requested;
     *tl_provided = tl_requested;
+#ifndef USE_PORTALS4
+    SHMEM_MUTEX_INIT(shmem_internal_mutex_ct);
+#endif
 #else
     shmem_internal_thread_level = SHMEM_THREAD_SINGLE;
     *tl_provided = SHMEM_THREAD_SINGLE;
@@ -460,6 +482,14 @@ shmem_internal_heap_postinit(void)
     }
 #endif // HAVE_SCHED_GETAFFINITY
 
+#ifdef USE_NT_COPY
+    ret = shmem_internal_copy_init();
+    if (0 != ret) {
+        RETURN_ERROR_MSG("Copy kernel init failed (%d)\n", ret);
+        goto cleanup_postinit;
+    }
+#endif
+
     /* Initialize transport devices */
     ret = shmem_transport_init();
     if (0 != ret) {
@@ -501,6 +531,12 @@ shmem_internal_heap_postinit(void)
     }
     shr_initialized = 1;
 
+    ret = shmem_shr_route_init();
+    if (0 != ret) {
+        RETURN_ERROR_MSG("On-node route initialization failed (%d)\n", ret);
+        goto cleanup_postinit;
+    }
+
     ret = shmem_internal_collectives_init();
     if (ret != 0) {
         RETURN_ERROR_MSG("Initialization of collectives failed (%d)\n", ret);
@@ -514,9 +550,21 @@ shmem_internal_heap_postinit(void)
     }
     teams_initialized = 1;
 
+    ret = shmem_internal_coll_tune_init();
+    if (ret != 0) {
+        RETURN_ERROR_MSG("Initialization of collective tuning failed (%d)\n", ret);
+        goto cleanup_postinit;
+    }
+
     shmem_internal_randr_init();
     randr_initialized = 1;
 
+    ret = shmem_internal_pcntr_init();
+    if (ret != 0) {
+        RETURN_ERROR_MSG("Initialization of instrumentation failed (%d)\n", ret);
+        goto cleanup_postinit;
+    }
+
     atexit(shmem_internal_shutdown_atexit);
     shmem_internal_initialized = 1;
 
@@ -0,0 +1,149 @@
+/* -*- C -*-
+ *
+ * Copyright (c) 2022 Intel Corporation. All rights reserved.
+ * This software is available to you under the BSD license.
+ *
+ * This file is part of the Sandia OpenSHMEM software package. For license
+ * information, see the LICENSE file in the top level directory of the
+ * distribution.
+ *
+ */
+
+/* oshtrace: convert the per-PE trace files written with SHMEM_TRACE=1 into the
+ * Chrome trace event JSON format, which can be loaded by Perfetto
+ * (ui.perfetto.dev) and chrome://tracing.
+ *
+ *   oshtrace shmem_trace.*.trace > trace.json
+ *
+ * Each PE is shown as a process and each of its threads as a thread.  The
+ * timestamps of a PE are relative to the end of its shmem_init. */
+
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+
+#include "shmem_trace_format.h"
+
+static const char *class_str[] = { "put", "get", "amo", "coll", "quiet", "wait" };
+
+static const char *coll_str[] = { "coll", "sync", "barrier", "broadcast",
+                                   "reduce", "collect", "fcollect", "alltoall",
+                                   "alltoalls" };
+
+static const char *alg_str[] = { "auto", "linear", "tree", "dissem", "ring",
+                                 "recdbl", "hier", "offload" };
+
+#define NELEMS(a) (sizeof(a) / sizeof((a)[0]))
+
+static int first_event = 1;
+
+
+static void
+print_event(const shmem_trace_file_header_t *hdr,
+            const shmem_trace_buf_header_t *bhdr,
+            const shmem_trace_event_t *ev)
+{
+    const char *name = "unknown";
+    int op = SHMEM_TRACE_DETAIL_OP(ev->detail);
+    int alg = SHMEM_TRACE_DETAIL_ALG(ev->detail);
+
+    if (ev->op_class < NELEMS(class_str))
+        name = class_str[ev->op_class];
+    if (op != SHMEM_TRACE_COLL_NONE && (size_t) op < NELEMS(coll_str))
+        name = coll_str[op];
+
+    printf("%s{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\",\"pid\":%d,\"tid\":%u,"
+           "\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"bytes\":%"PRIu64",\"ctx\":%u",
+           first_event ? "" : ",\n", name,
+           ev->op_class < NELEMS(class_str) ? class_str[ev->op_class] : "unknown",
+           hdr->pe, bhdr->tid,
+           (double) (int64_t) (ev->start_ns - hdr->t0_ns) / 1000.0,
+           (double) ev->duration_ns / 1000.0, ev->len, ev->ctx);
+
+    if (ev->pe >= 0)
+        printf(",\"pe\":%d", ev->pe);
+    if (op != SHMEM_TRACE_COLL_NONE && (size_t) alg < NELEMS(alg_str))
+        printf(",\"algorithm\":\"%s\"", alg_str[alg]);
+
+    printf("}}");
+    first_event = 0;
+}
+
+
+static int
+convert_file(const char *path)
+{
+    shmem_trace_file_header_t hdr;
+    shmem_trace_buf_header_t bhdr;
+    shmem_trace_event_t ev;
+    uint64_t i;
+    FILE *f;
+
+    f = fopen(path, "rb");
+    if (NULL == f) {
+        fprintf(stderr, "oshtrace: unable to open %s\n", path);
+        return 1;
+    }
+
+    if (1 != fread(&hdr, sizeof(hdr), 1, f) ||
+        0 != memcmp(hdr.magic, SHMEM_TRACE_MAGIC, sizeof(hdr.magic))) {
+        fprintf(stderr, "oshtrace: %s is not a trace file\n", path);
+        fclose(f);
+        return 1;
+    }
+
+    if (hdr.version != SHMEM_TRACE_VERSION || hdr.event_size != sizeof(ev)) {
+        fprintf(stderr, "oshtrace: %s has unsupported version %u\n", path,
+                hdr.version);
+        fclose(f);
+        return 1;
+    }
+
+    printf("%s{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%d,"
+           "\"args\":{\"name\":\"PE %d\"}}",
+           first_event ? "" : ",\n", hdr.pe, hdr.pe);
+    first_event = 0;
+
+    while (1 == fread(&bhdr, sizeof(bhdr), 1, f)) {
+        if (bhdr.dropped > 0)
+            fprintf(stderr, "oshtrace: PE %d thread %u overwrote %"PRIu64
+                    " events, increase SHMEM_TRACE_EVENTS\n", hdr.pe, bhdr.tid,
+                    bhdr.dropped);
+
+        for (i = 0; i < bhdr.nevents; i++) {
+            if (1 != fread(&ev, sizeof(ev), 1, f)) {
+                fprintf(stderr, "oshtrace: %s is truncated\n", path);
+                fclose(f);
+                return 1;
+            }
+            print_event(&hdr, &bhdr, &ev);
+        }
+    }
+
+    fclose(f);
+    return 0;
+}
+
+
+int
+main(int argc, char *argv[])
+{
+    int i, ret = 0;
+
+    if (argc < 2 || 0 == strcmp(argv[1], "-h") || 0 == strcmp(argv[1], "--help")) {
+        fprintf(stderr, "Usage: %s TRACE_FILE... > trace.json\n", argv[0]);
+        return argc < 2 ? 1 : 0;
+    }
+
+    printf("{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+
+    for (i = 1; i < argc; i++)
+        ret |= convert_file(argv[i]);
+
+    printf("\n]}\n");
+
+    return ret;
+}
@@ -13,8 +13,11 @@
  *
  */
 
+#include <string.h>
+
 #include "shmem_internal.h"
 #include "transport.h"
+#include "shmem_pcntr.h"
 
 #ifdef ENABLE_PROFILING
 #include "pshmem.h"
@@ -37,6 +40,15 @@
 #pragma weak shmemx_pcntr_get_all = pshmemx_pcntr_get_all
 #define shmemx_pcntr_get_all pshmemx_pcntr_get_all
 
+#pragma weak shmemx_pcntr_get_hist = pshmemx_pcntr_get_hist
+#define shmemx_pcntr_get_hist pshmemx_pcntr_get_hist
+
+#pragma weak shmemx_pcntr_get_pe_bytes = pshmemx_pcntr_get_pe_bytes
+#define shmemx_pcntr_get_pe_bytes pshmemx_pcntr_get_pe_bytes
+
+#pragma weak shmemx_pcntr_reset = pshmemx_pcntr_reset
+#define shmemx_pcntr_reset pshmemx_pcntr_reset
+
 #endif /* ENABLE_PROFILING */
 
 void SHMEM_FUNCTION_ATTRIBUTES 
@@ -87,3 +99,47 @@ shmemx_pcntr_get_all(shmem_ctx_t ctx, shmemx_pcntr_t *pcntr)
     return;
 }
 
+/* The following report the instrumentation enabled by SHMEM_PCNTR_PROFILE and
+ * return -1 when it is disabled */
+int SHMEM_FUNCTION_ATTRIBUTES
+shmemx_pcntr_get_hist(shmem_ctx_t ctx, int op_class, shmemx_pcntr_hist_t *hist)
+{
+    struct shmem_internal_pcntr_ctx_t *stats;
+
+    SHMEM_ERR_CHECK_INITIALIZED();
+    SHMEM_ERR_CHECK_NULL(hist, 1);
+
+    if (!shmem_internal_pcntr_profile || ctx == SHMEM_CTX_INVALID ||
+        op_class < 0 || op_class >= SHMEMX_PCNTR_NUM_CLASSES)
+        return -1;
+
+    stats = shmem_internal_pcntr_ctx_stats(ctx);
+    memcpy(hist, &stats->hist[op_class], sizeof(shmemx_pcntr_hist_t));
+
+    return 0;
+}
+
+int SHMEM_FUNCTION_ATTRIBUTES
+shmemx_pcntr_get_pe_bytes(int pe, uint64_t *put_bytes, uint64_t *get_bytes)
+{
+    SHMEM_ERR_CHECK_INITIALIZED();
+    SHMEM_ERR_CHECK_NULL(put_bytes, 1);
+    SHMEM_ERR_CHECK_NULL(get_bytes, 1);
+
+    return shmem_internal_pcntr_get_pe_bytes(pe, put_bytes, get_bytes);
+}
+
+void SHMEM_FUNCTION_ATTRIBUTES
+shmemx_pcntr_reset(shmem_ctx_t ctx)
+{
+    struct shmem_internal_pcntr_ctx_t *stats;
+
+    SHMEM_ERR_CHECK_INITIALIZED();
+
+    if (!shmem_internal_pcntr_profile || ctx == SHMEM_CTX_INVALID)
+        return;
+
+    stats = shmem_internal_pcntr_ctx_stats(ctx);
+    memset(stats->hist, 0, sizeof(stats->hist));
+    return;
+}
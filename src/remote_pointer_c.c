@@ -22,6 +22,7 @@
 #include "shmem.h"
 #include "shmem_internal.h"
 #include "shmem_remote_pointer.h"
+#include "shmem_team.h"
 
 
 #ifdef ENABLE_PROFILING
@@ -57,7 +58,23 @@ shmem_team_ptr(shmem_team_t team, const void *target, int pe)
         return NULL;
     }
 
-    int global_pe = shmem_team_translate_pe(team, pe, SHMEM_TEAM_WORLD);
+    shmem_internal_team_t *myteam = (shmem_internal_team_t *) team;
 
-    return shmem_internal_ptr(target, global_pe);
+    if (pe < 0 || pe >= myteam->size) {
+        return NULL;
+    }
+
+    /* Heap addresses are offset from the member's heap base, without
+     * translating the PE number */
+    if ((char *) target >= (char *) shmem_internal_heap_base &&
+        (char *) target < (char *) shmem_internal_heap_base + shmem_internal_heap_length) {
+        char **bases = shmem_internal_team_heap_bases(myteam);
+
+        if (NULL != bases) {
+            if (NULL == bases[pe]) return NULL;
+            return bases[pe] + ((char *) target - (char *) shmem_internal_heap_base);
+        }
+    }
+
+    return shmem_internal_ptr(target, shmem_internal_team_pe(myteam, pe));
 }
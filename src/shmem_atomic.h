@@ -36,7 +36,7 @@
 
 /* Internal flag to identify whether a memory barrier is needed */
 
-#if defined(USE_XPMEM)
+#if defined(USE_XPMEM) || defined(USE_MEMFD)
 # define SHMEM_INTERNAL_NEED_MEMBAR 1
 #elif defined(ENABLE_THREADS)
 # define SHMEM_INTERNAL_NEED_MEMBAR (shmem_internal_thread_level != SHMEM_THREAD_SINGLE)
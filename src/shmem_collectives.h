@@ -25,7 +25,9 @@ enum coll_type_t {
     TREE,
     DISSEM,
     RING,
-    RECDBL
+    RECDBL,
+    HIER,
+    OFFLOAD
 };
 typedef enum coll_type_t coll_type_t;
 
@@ -40,9 +42,57 @@ extern coll_type_t shmem_internal_reduce_type;
 extern coll_type_t shmem_internal_collect_type;
 extern coll_type_t shmem_internal_fcollect_type;
 
+/* Collective algorithm decision table, loaded from SHMEM_COLL_TUNE_FILE */
+enum shmem_internal_coll_tune_op_t {
+    SHMEM_INTERNAL_COLL_TUNE_SYNC = 0,
+    SHMEM_INTERNAL_COLL_TUNE_BCAST,
+    SHMEM_INTERNAL_COLL_TUNE_REDUCE,
+    SHMEM_INTERNAL_COLL_TUNE_FCOLLECT,
+    SHMEM_INTERNAL_COLL_TUNE_NUM
+};
+
+#define SHMEM_INTERNAL_COLL_TUNE_ANY_TYPE -1
+
+extern int shmem_internal_coll_tune_nrows[SHMEM_INTERNAL_COLL_TUNE_NUM];
+
+int shmem_internal_coll_tune_init(void);
+void shmem_internal_coll_tune_fini(void);
+coll_type_t shmem_internal_coll_tune_lookup(int coll, int PE_size, size_t len, int datatype);
+
+/* Algorithm chosen by the decision table, or AUTO when there is no rule */
+static inline
+coll_type_t
+shmem_internal_coll_tune_select(int coll, int PE_size, size_t len, int datatype)
+{
+    if (0 == shmem_internal_coll_tune_nrows[coll]) return AUTO;
+
+    return shmem_internal_coll_tune_lookup(coll, PE_size, len, datatype);
+}
+
 void shmem_internal_sync_linear(int PE_start, int PE_stride, int PE_size, long *pSync);
 void shmem_internal_sync_tree(int PE_start, int PE_stride, int PE_size, long *pSync);
 void shmem_internal_sync_dissem(int PE_start, int PE_stride, int PE_size, long *pSync);
+void shmem_internal_sync_hier(int PE_start, int PE_stride, int PE_size, long *pSync);
+void shmem_internal_sync_offload(int PE_start, int PE_stride, int PE_size, long *pSync);
+
+/* Algorithm selected by shmem_internal_sync for an active set of PE_size */
+static inline
+coll_type_t
+shmem_internal_sync_type(int PE_size)
+{
+    coll_type_t alg;
+
+    if (shmem_internal_barrier_type != AUTO)
+        return shmem_internal_barrier_type;
+
+    alg = shmem_internal_coll_tune_select(SHMEM_INTERNAL_COLL_TUNE_SYNC, PE_size, 0,
+                                          SHMEM_INTERNAL_COLL_TUNE_ANY_TYPE);
+    if (alg != AUTO)
+        return alg;
+
+    return PE_size < shmem_internal_params.COLL_CROSSOVER ? LINEAR : TREE;
+}
+
 
 static inline
 void
@@ -55,14 +105,10 @@ shmem_internal_sync(int PE_start, int PE_stride, int PE_size, long *pSync)
 
     if (PE_size == 1) return;
 
-    switch (shmem_internal_barrier_type) {
-    case AUTO:
-        if (PE_size < shmem_internal_params.COLL_CROSSOVER) {
-            shmem_internal_sync_linear(PE_start, PE_stride, PE_size, pSync);
-        } else {
-            shmem_internal_sync_tree(PE_start, PE_stride, PE_size, pSync);
-        }
-        break;
+    coll_type_t alg = shmem_internal_sync_type(PE_size);
+    uint64_t pcntr = shmem_internal_pcntr_enter();
+
+    switch (alg) {
     case LINEAR:
         shmem_internal_sync_linear(PE_start, PE_stride, PE_size, pSync);
         break;
@@ -72,14 +118,21 @@ shmem_internal_sync(int PE_start, int PE_stride, int PE_size, long *pSync)
     case DISSEM:
         shmem_internal_sync_dissem(PE_start, PE_stride, PE_size, pSync);
         break;
+    case HIER:
+        shmem_internal_sync_hier(PE_start, PE_stride, PE_size, pSync);
+        break;
+    case OFFLOAD:
+        shmem_internal_sync_offload(PE_start, PE_stride, PE_size, pSync);
+        break;
     default:
-        RAISE_ERROR_MSG("Illegal barrier/sync type (%d)\n",
-                        shmem_internal_barrier_type);
+        RAISE_ERROR_MSG("Illegal barrier/sync type (%d)\n", alg);
     }
 
     /* Ensure remote updates are visible in memory */
     shmem_internal_membar_acq_rel();
     shmem_transport_syncmem();
+
+    shmem_internal_pcntr_leave_coll(SHMEM_TRACE_COLL_SYNC, alg, 0, pcntr);
 }
 
 
@@ -95,8 +148,13 @@ static inline
 void
 shmem_internal_barrier(int PE_start, int PE_stride, int PE_size, long *pSync)
 {
+    uint64_t pcntr = shmem_internal_pcntr_enter();
+
     shmem_internal_quiet(SHMEM_CTX_DEFAULT);
     shmem_internal_sync(PE_start, PE_stride, PE_size, pSync);
+
+    shmem_internal_pcntr_leave_coll(SHMEM_TRACE_COLL_BARRIER,
+                                    shmem_internal_sync_type(PE_size), 0, pcntr);
 }
 
 
@@ -104,17 +162,49 @@ static inline
 void
 shmem_internal_barrier_all(void)
 {
+    uint64_t pcntr = shmem_internal_pcntr_enter();
+
     shmem_internal_quiet(SHMEM_CTX_DEFAULT);
     shmem_internal_sync(0, 1, shmem_internal_num_pes, shmem_internal_barrier_all_psync);
+
+    shmem_internal_pcntr_leave_coll(SHMEM_TRACE_COLL_BARRIER,
+                                    shmem_internal_sync_type(shmem_internal_num_pes),
+                                    0, pcntr);
 }
 
 
+/* Split-phase barrier/sync state.  Only one split-phase operation may be in
+ * progress on a given pSync, and the pSync must not be passed to another
+ * collective until the operation completes. */
+struct shmem_internal_sync_req_t {
+    int          active;
+    coll_type_t  type;
+    int          state;
+    int          PE_start, PE_stride, PE_size;
+    long        *pSync;
+    int          parent, num_children;
+    int         *children;
+    int          round, distance;
+};
+typedef struct shmem_internal_sync_req_t shmem_internal_sync_req_t;
+
+extern shmem_internal_sync_req_t shmem_internal_barrier_all_req;
+
+void shmem_internal_sync_start(shmem_internal_sync_req_t *req, int PE_start,
+                               int PE_stride, int PE_size, long *pSync);
+int shmem_internal_sync_test(shmem_internal_sync_req_t *req);
+void shmem_internal_sync_wait(shmem_internal_sync_req_t *req);
+
+
 void shmem_internal_bcast_linear(void *target, const void *source, size_t len,
                                  int PE_root, int PE_start, int PE_stride, int PE_size,
                                  long *pSync, int complete);
 void shmem_internal_bcast_tree(void *target, const void *source, size_t len,
                                int PE_root, int PE_start, int PE_stride, int PE_size,
                                long *pSync, int complete);
+void shmem_internal_bcast_offload(void *target, const void *source, size_t len,
+                                  int PE_root, int PE_start, int PE_stride, int PE_size,
+                                  long *pSync, int complete);
 
 static inline
 void
@@ -122,16 +212,17 @@ shmem_internal_bcast(void *target, const void *source, size_t len,
                      int PE_root, int PE_start, int PE_stride, int PE_size,
                      long *pSync, int complete)
 {
-    switch (shmem_internal_bcast_type) {
-    case AUTO:
-        if (PE_size < shmem_internal_params.COLL_CROSSOVER) {
-            shmem_internal_bcast_linear(target, source, len, PE_root, PE_start,
-                                        PE_stride, PE_size, pSync, complete);
-        } else {
-            shmem_internal_bcast_tree(target, source, len, PE_root, PE_start,
-                                      PE_stride, PE_size, pSync, complete);
-        }
-        break;
+    coll_type_t alg = shmem_internal_bcast_type;
+    uint64_t pcntr = shmem_internal_pcntr_enter();
+
+    if (alg == AUTO) {
+        alg = shmem_internal_coll_tune_select(SHMEM_INTERNAL_COLL_TUNE_BCAST, PE_size, len,
+                                              SHMEM_INTERNAL_COLL_TUNE_ANY_TYPE);
+        if (alg == AUTO)
+            alg = PE_size < shmem_internal_params.COLL_CROSSOVER ? LINEAR : TREE;
+    }
+
+    switch (alg) {
     case LINEAR:
         shmem_internal_bcast_linear(target, source, len, PE_root, PE_start,
                                     PE_stride, PE_size, pSync, complete);
@@ -140,10 +231,15 @@ shmem_internal_bcast(void *target, const void *source, size_t len,
         shmem_internal_bcast_tree(target, source, len, PE_root, PE_start,
                                   PE_stride, PE_size, pSync, complete);
         break;
+    case OFFLOAD:
+        shmem_internal_bcast_offload(target, source, len, PE_root, PE_start,
+                                     PE_stride, PE_size, pSync, complete);
+        break;
     default:
-        RAISE_ERROR_MSG("Illegal broadcast type (%d)\n",
-                        shmem_internal_bcast_type);
+        RAISE_ERROR_MSG("Illegal broadcast type (%d)\n", alg);
     }
+
+    shmem_internal_pcntr_leave_coll(SHMEM_TRACE_COLL_BCAST, alg, len, pcntr);
 }
 
 
@@ -164,6 +260,10 @@ void shmem_internal_op_to_all_recdbl_sw(void *target, const void *source, size_t
                                    int PE_start, int PE_stride, int PE_size,
                                    void *pWrk, long *pSync,
                                    shm_internal_op_t op, shm_internal_datatype_t datatype);
+void shmem_internal_op_to_all_offload(void *target, const void *source, size_t count, size_t type_size,
+                                      int PE_start, int PE_stride, int PE_size,
+                                      void *pWrk, long *pSync,
+                                      shm_internal_op_t op, shm_internal_datatype_t datatype);
 
 static inline
 void
@@ -175,40 +275,32 @@ shmem_internal_op_to_all(void *target, const void *source, size_t count,
 {
     shmem_internal_assert(type_size > 0);
 
-    switch (shmem_internal_reduce_type) {
-        case AUTO:
-            if (shmem_transport_atomic_supported(op, datatype)) {
-                if (PE_size < shmem_internal_params.COLL_CROSSOVER) {
-                    shmem_internal_op_to_all_linear(target, source, count, type_size,
-                                                    PE_start, PE_stride, PE_size,
-                                                    pWrk, pSync, op, datatype);
-                } else {
-                    shmem_internal_op_to_all_tree(target, source, count, type_size,
-                                                  PE_start, PE_stride, PE_size,
-                                                  pWrk, pSync, op, datatype);
-                }
-            } else {
-                if (count * type_size < shmem_internal_params.COLL_SIZE_CROSSOVER)
-                    shmem_internal_op_to_all_recdbl_sw(target, source, count, type_size,
-                                                       PE_start, PE_stride, PE_size,
-                                                       pWrk, pSync, op, datatype);
-                else
-                    shmem_internal_op_to_all_ring(target, source, count, type_size,
-                                                  PE_start, PE_stride, PE_size,
-                                                  pWrk, pSync, op, datatype);
-            }
+    coll_type_t alg = shmem_internal_reduce_type;
+    int atomic = shmem_transport_atomic_supported(op, datatype);
+    uint64_t pcntr = shmem_internal_pcntr_enter();
+
+    if (alg == AUTO) {
+        alg = shmem_internal_coll_tune_select(SHMEM_INTERNAL_COLL_TUNE_REDUCE, PE_size,
+                                              count * type_size, datatype);
+        if ((alg == LINEAR || alg == TREE) && !atomic)
+            alg = AUTO;
+
+        if (alg == AUTO) {
+            if (atomic)
+                alg = PE_size < shmem_internal_params.COLL_CROSSOVER ? LINEAR : TREE;
+            else
+                alg = count * type_size < shmem_internal_params.COLL_SIZE_CROSSOVER ?
+                      RECDBL : RING;
+        }
+    } else if ((alg == LINEAR || alg == TREE) && !atomic) {
+        alg = RECDBL;
+    }
 
-            break;
+    switch (alg) {
         case LINEAR:
-            if (shmem_transport_atomic_supported(op, datatype)) {
-                shmem_internal_op_to_all_linear(target, source, count, type_size,
-                                                PE_start, PE_stride, PE_size,
-                                                pWrk, pSync, op, datatype);
-            } else {
-                shmem_internal_op_to_all_recdbl_sw(target, source, count, type_size,
-                                                   PE_start, PE_stride, PE_size,
-                                                   pWrk, pSync, op, datatype);
-            }
+            shmem_internal_op_to_all_linear(target, source, count, type_size,
+                                            PE_start, PE_stride, PE_size,
+                                            pWrk, pSync, op, datatype);
             break;
         case RING:
             shmem_internal_op_to_all_ring(target, source, count, type_size,
@@ -216,25 +308,25 @@ shmem_internal_op_to_all(void *target, const void *source, size_t count,
                                           pWrk, pSync, op, datatype);
             break;
         case TREE:
-            if (shmem_transport_atomic_supported(op, datatype)) {
-                shmem_internal_op_to_all_tree(target, source, count, type_size,
-                                              PE_start, PE_stride, PE_size,
-                                              pWrk, pSync, op, datatype);
-            } else {
-                shmem_internal_op_to_all_recdbl_sw(target, source, count, type_size,
-                                                   PE_start, PE_stride, PE_size,
-                                                   pWrk, pSync, op, datatype);
-            }
+            shmem_internal_op_to_all_tree(target, source, count, type_size,
+                                          PE_start, PE_stride, PE_size,
+                                          pWrk, pSync, op, datatype);
             break;
         case RECDBL:
             shmem_internal_op_to_all_recdbl_sw(target, source, count, type_size,
                                                PE_start, PE_stride, PE_size,
                                                pWrk, pSync, op, datatype);
             break;
+        case OFFLOAD:
+            shmem_internal_op_to_all_offload(target, source, count, type_size,
+                                             PE_start, PE_stride, PE_size,
+                                             pWrk, pSync, op, datatype);
+            break;
         default:
-            RAISE_ERROR_MSG("Illegal reduction type (%d)\n",
-                            shmem_internal_reduce_type);
+            RAISE_ERROR_MSG("Illegal reduction type (%d)\n", alg);
     }
+
+    shmem_internal_pcntr_leave_coll(SHMEM_TRACE_COLL_REDUCE, alg, count * type_size, pcntr);
 }
 
 
@@ -246,12 +338,17 @@ void
 shmem_internal_collect(void *target, const void *source, size_t len,
                   int PE_start, int PE_stride, int PE_size, long *pSync)
 {
+    coll_type_t alg = AUTO;
+    uint64_t pcntr = shmem_internal_pcntr_enter();
+
     switch (shmem_internal_collect_type) {
     case AUTO:
+        alg = LINEAR;
         shmem_internal_collect_linear(target, source, len, PE_start, PE_stride,
                                       PE_size, pSync);
         break;
     case LINEAR:
+        alg = LINEAR;
         shmem_internal_collect_linear(target, source, len, PE_start, PE_stride,
                                       PE_size, pSync);
         break;
@@ -259,6 +356,8 @@ shmem_internal_collect(void *target, const void *source, size_t len,
         RAISE_ERROR_MSG("Illegal collect type (%d)\n",
                         shmem_internal_collect_type);
     }
+
+    shmem_internal_pcntr_leave_coll(SHMEM_TRACE_COLL_COLLECT, alg, len, pcntr);
 }
 
 
@@ -274,11 +373,21 @@ void
 shmem_internal_fcollect(void *target, const void *source, size_t len,
                    int PE_start, int PE_stride, int PE_size, long *pSync)
 {
-    switch (shmem_internal_fcollect_type) {
-    case AUTO:
-        shmem_internal_fcollect_ring(target, source, len, PE_start, PE_stride,
-                                     PE_size, pSync);
-        break;
+    coll_type_t alg = shmem_internal_fcollect_type;
+    uint64_t pcntr = shmem_internal_pcntr_enter();
+
+    if (alg == AUTO) {
+        alg = shmem_internal_coll_tune_select(SHMEM_INTERNAL_COLL_TUNE_FCOLLECT, PE_size, len,
+                                              SHMEM_INTERNAL_COLL_TUNE_ANY_TYPE);
+        if (alg == AUTO)
+            alg = RING;
+    }
+
+    /* Recursive doubling requires a power of two active set */
+    if (alg == RECDBL && 0 != (PE_size & (PE_size - 1)))
+        alg = RING;
+
+    switch (alg) {
     case LINEAR:
         shmem_internal_fcollect_linear(target, source, len, PE_start, PE_stride,
                                        PE_size, pSync);
@@ -288,18 +397,14 @@ shmem_internal_fcollect(void *target, const void *source, size_t len,
                                      PE_size, pSync);
         break;
     case RECDBL:
-        if (0 == (PE_size & (PE_size - 1))) {
-            shmem_internal_fcollect_recdbl(target, source, len, PE_start, PE_stride,
-                                           PE_size, pSync);
-        } else {
-            shmem_internal_fcollect_ring(target, source, len, PE_start, PE_stride,
-                                         PE_size, pSync);
-        }
+        shmem_internal_fcollect_recdbl(target, source, len, PE_start, PE_stride,
+                                       PE_size, pSync);
         break;
     default:
-        RAISE_ERROR_MSG("Illegal fcollect type (%d)\n",
-                        shmem_internal_fcollect_type);
+        RAISE_ERROR_MSG("Illegal fcollect type (%d)\n", alg);
     }
+
+    shmem_internal_pcntr_leave_coll(SHMEM_TRACE_COLL_FCOLLECT, alg, len, pcntr);
 }
 
 
@@ -309,4 +414,30 @@ void shmem_internal_alltoall(void *dest, const void *source, size_t len,
 void shmem_internal_alltoalls(void *dest, const void *source, ptrdiff_t dst,
                               ptrdiff_t sst, size_t elem_size, size_t nelems,
                               int PE_start, int PE_stride, int PE_size, long *pSync);
+
+
+/* Non-blocking collectives.  Each operation is compiled into a schedule of
+ * communication steps that is advanced by shmem_internal_nbc_progress. */
+struct shmem_internal_team_t;
+struct shmem_internal_nbc_req_t;
+typedef struct shmem_internal_nbc_req_t shmem_internal_nbc_req_t;
+
+shmem_internal_nbc_req_t *
+shmem_internal_bcast_nb(struct shmem_internal_team_t *team, void *dest,
+                        const void *source, size_t len, int PE_root);
+shmem_internal_nbc_req_t *
+shmem_internal_fcollect_nb(struct shmem_internal_team_t *team, void *dest,
+                           const void *source, size_t len);
+shmem_internal_nbc_req_t *
+shmem_internal_alltoall_nb(struct shmem_internal_team_t *team, void *dest,
+                           const void *source, size_t len);
+shmem_internal_nbc_req_t *
+shmem_internal_op_to_all_nb(struct shmem_internal_team_t *team, void *dest,
+                            const void *source, size_t count, size_t type_size,
+                            shm_internal_op_t op, shm_internal_datatype_t datatype);
+
+int shmem_internal_nbc_test(shmem_internal_nbc_req_t **req);
+void shmem_internal_nbc_wait(shmem_internal_nbc_req_t **req);
+void shmem_internal_nbc_team_drain(struct shmem_internal_team_t *team);
+
 #endif
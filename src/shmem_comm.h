@@ -29,6 +29,12 @@
 
 #include "transport.h"
 #include "shr_transport.h"
+#include "shmem_copy.h"
+#include "shmem_pcntr.h"
+
+#ifdef USE_SHR_COPY
+#include "shr_copy.h"
+#endif
 
 static inline
 void
@@ -37,12 +43,15 @@ shmem_internal_put_nb(shmem_ctx_t ctx, void *target, const void *source, size_t
 {
     if (len == 0)
         return;
+    uint64_t pcntr = shmem_internal_pcntr_enter();
 
     if (shmem_shr_transport_use_write(ctx, target, source, len, pe)) {
         shmem_shr_transport_put(ctx, target, source, len, pe);
     } else {
         shmem_transport_put_nb((shmem_transport_ctx_t *)ctx, target, source, len, pe, completion);
     }
+
+    shmem_internal_pcntr_leave(ctx, SHMEMX_PCNTR_PUT, len, pe, pcntr);
 }
 
 
@@ -60,6 +69,7 @@ void
 shmem_internal_put_scalar(shmem_ctx_t ctx, void *target, const void *source, size_t len, int pe)
 {
     shmem_internal_assert(len > 0);
+    uint64_t pcntr = shmem_internal_pcntr_enter();
 
     if (shmem_shr_transport_use_write(ctx, target, source, len, pe)) {
         shmem_shr_transport_put_scalar(ctx, target, source, len, pe);
@@ -72,6 +82,8 @@ shmem_internal_put_scalar(shmem_ctx_t ctx, void *target, const void *source, siz
 	shmem_internal_put_wait(ctx, &completion);
 #endif
     }
+
+    shmem_internal_pcntr_leave(ctx, SHMEMX_PCNTR_PUT, len, pe, pcntr);
 }
 
 static inline
@@ -79,21 +91,23 @@ void
 shmem_internal_put_signal_nbi(shmem_ctx_t ctx, void *target, const void *source, size_t len,
                               uint64_t *sig_addr, uint64_t signal, int sig_op, int pe)
 {
+    uint64_t pcntr = shmem_internal_pcntr_enter();
+
     if (len == 0) {
+        shmem_shr_transport_mark_nic(ctx, pe);
         if (sig_op == SHMEM_SIGNAL_ADD)
             shmem_transport_atomic((shmem_transport_ctx_t *) ctx, sig_addr, &signal, sizeof(uint64_t),
                                    pe, SHM_INTERNAL_SUM, SHM_INTERNAL_UINT64);
         else
             shmem_transport_atomic_set((shmem_transport_ctx_t *) ctx, sig_addr, &signal,
                                       sizeof(uint64_t), pe, SHM_INTERNAL_UINT64);
-        return;
-    }
-
-    if (shmem_shr_transport_use_write(ctx, target, source, len, pe)) {
+    } else if (shmem_shr_transport_use_write(ctx, target, source, len, pe)) {
         shmem_shr_transport_put_signal(ctx, target, source, len, sig_addr, signal, sig_op, pe);
     } else {
         shmem_transport_put_signal_nbi((shmem_transport_ctx_t *) ctx, target, source, len, sig_addr, signal, sig_op, pe);
     }
+
+    shmem_internal_pcntr_leave(ctx, SHMEMX_PCNTR_PUT, len + sizeof(uint64_t), pe, pcntr);
 }
 
 static inline
@@ -101,23 +115,20 @@ void
 shmem_internal_put_nbi(shmem_ctx_t ctx, void *target, const void *source, size_t len, int pe)
 {
     if (len == 0) return;
+    uint64_t pcntr = shmem_internal_pcntr_enter();
 
+#ifdef USE_SHR_COPY
+    if (shmem_shr_copy_use(target, len, pe)) {
+        shmem_shr_copy_put(ctx, target, source, len, pe);
+    } else
+#endif
     if (shmem_shr_transport_use_write(ctx, target, source, len, pe)) {
         shmem_shr_transport_put(ctx, target, source, len, pe);
     } else {
         shmem_transport_put_nbi((shmem_transport_ctx_t *)ctx, target, source, len, pe);
     }
-}
 
-
-static inline
-void
-shmem_internal_put_ct_nb(shmemx_ct_t ct, void *target, const void *source, size_t len, int pe,
-                      long *completion)
-{
-    /* TODO: add shortcut for on-node-comms */
-    shmem_transport_put_ct_nb((shmem_transport_ct_t *)
-                              ct, target, source, len, pe, completion);
+    shmem_internal_pcntr_leave(ctx, SHMEMX_PCNTR_PUT, len, pe, pcntr);
 }
 
 
@@ -126,22 +137,35 @@ void
 shmem_internal_get(shmem_ctx_t ctx, void *target, const void *source, size_t len, int pe)
 {
     if (len == 0) return;
+    uint64_t pcntr = shmem_internal_pcntr_enter();
 
     if (shmem_shr_transport_use_read(ctx, target, source, len, pe)) {
         shmem_shr_transport_get(ctx, target, source, len, pe);
     } else {
         shmem_transport_get((shmem_transport_ctx_t *)ctx, target, source, len, pe);
     }
+
+    shmem_internal_pcntr_leave(ctx, SHMEMX_PCNTR_GET, len, pe, pcntr);
 }
 
 
+/* Unlike shmem_internal_get, large on-node transfers may complete
+ * asynchronously, at the next quiet on ctx */
 static inline
 void
-shmem_internal_get_ct(shmemx_ct_t ct, void *target, const void *source, size_t len, int pe)
+shmem_internal_get_nbi(shmem_ctx_t ctx, void *target, const void *source, size_t len, int pe)
 {
-    /* TODO: add shortcut for on-node-comms */
-    shmem_transport_get_ct((shmem_transport_ct_t *) ct,
-                           target, source, len, pe);
+    if (len == 0) return;
+    uint64_t pcntr = shmem_internal_pcntr_enter();
+
+#ifdef USE_SHR_COPY
+    if (shmem_shr_copy_use(source, len, pe)) {
+        shmem_shr_copy_get(ctx, target, source, len, pe);
+    } else
+#endif
+    shmem_internal_get(ctx, target, source, len, pe);
+
+    shmem_internal_pcntr_leave(ctx, SHMEMX_PCNTR_GET, len, pe, pcntr);
 }
 
 
@@ -153,18 +177,77 @@ shmem_internal_get_wait(shmem_ctx_t ctx)
     /* on-node is always blocking, so this is a no-op for them */
 }
 
+
+/* Returns nonzero once the gets issued on ctx have completed */
+static inline
+int
+shmem_internal_get_test(shmem_ctx_t ctx)
+{
+    return shmem_transport_get_test((shmem_transport_ctx_t *)ctx);
+}
+
+/* Strided transfer of nblocks blocks of bsize bytes; strides are in bytes.
+ * A strided put must be completed with shmem_internal_put_wait and a strided
+ * get with shmem_internal_get_wait. */
+static inline
+void
+shmem_internal_iput(shmem_ctx_t ctx, void *target, const void *source,
+                    ptrdiff_t tst, ptrdiff_t sst, size_t bsize, size_t nblocks,
+                    int pe, long *completion)
+{
+    if (bsize == 0 || nblocks == 0) return;
+    uint64_t pcntr = shmem_internal_pcntr_enter();
+
+    if (nblocks == 1 || ((size_t) tst == bsize && (size_t) sst == bsize)) {
+        shmem_internal_put_nb(ctx, target, source, bsize * nblocks, pe, completion);
+    } else if (shmem_shr_transport_use_write(ctx, target, source, bsize, pe)) {
+        shmem_shr_transport_iput(ctx, target, source, tst, sst, bsize, nblocks, pe);
+    } else {
+        shmem_transport_iput((shmem_transport_ctx_t *)ctx, target, source, tst,
+                             sst, bsize, nblocks, pe, completion);
+    }
+
+    shmem_internal_pcntr_leave(ctx, SHMEMX_PCNTR_PUT, bsize * nblocks, pe, pcntr);
+}
+
+
+static inline
+void
+shmem_internal_iget(shmem_ctx_t ctx, void *target, const void *source,
+                    ptrdiff_t tst, ptrdiff_t sst, size_t bsize, size_t nblocks,
+                    int pe)
+{
+    if (bsize == 0 || nblocks == 0) return;
+    uint64_t pcntr = shmem_internal_pcntr_enter();
+
+    if (nblocks == 1 || ((size_t) tst == bsize && (size_t) sst == bsize)) {
+        shmem_internal_get(ctx, target, source, bsize * nblocks, pe);
+    } else if (shmem_shr_transport_use_read(ctx, target, source, bsize, pe)) {
+        shmem_shr_transport_iget(ctx, target, source, tst, sst, bsize, nblocks, pe);
+    } else {
+        shmem_transport_iget((shmem_transport_ctx_t *)ctx, target, source, tst,
+                             sst, bsize, nblocks, pe);
+    }
+
+    shmem_internal_pcntr_leave(ctx, SHMEMX_PCNTR_GET, bsize * nblocks, pe, pcntr);
+}
+
+
 static inline
 void
 shmem_internal_swap(shmem_ctx_t ctx, void *target, void *source, void *dest, size_t len,
                     int pe, shm_internal_datatype_t datatype)
 {
     shmem_internal_assert(len > 0);
+    uint64_t pcntr = shmem_internal_pcntr_enter();
 
     if (shmem_shr_transport_use_atomic(ctx, target, len, pe, datatype)) {
         shmem_shr_transport_swap(ctx, target, source, dest, len, pe, datatype);
     } else {
         shmem_transport_swap((shmem_transport_ctx_t *)ctx, target, source, dest, len, pe, datatype);
     }
+
+    shmem_internal_pcntr_leave(ctx, SHMEMX_PCNTR_AMO, len, pe, pcntr);
 }
 
 
@@ -175,6 +258,7 @@ shmem_internal_swap_nbi(shmem_ctx_t ctx, void *target, void *source,
                         shm_internal_datatype_t datatype)
 {
     shmem_internal_assert(len > 0);
+    uint64_t pcntr = shmem_internal_pcntr_enter();
 
     if (shmem_shr_transport_use_atomic(ctx, target, len, pe, datatype)) {
         shmem_shr_transport_swap(ctx, target, source, dest, len, pe, datatype);
@@ -182,6 +266,8 @@ shmem_internal_swap_nbi(shmem_ctx_t ctx, void *target, void *source,
         shmem_transport_swap_nbi((shmem_transport_ctx_t *)ctx, target, source,
                                  dest, len, pe, datatype);
     }
+
+    shmem_internal_pcntr_leave(ctx, SHMEMX_PCNTR_AMO, len, pe, pcntr);
 }
 
 
@@ -191,6 +277,7 @@ shmem_internal_cswap(shmem_ctx_t ctx, void *target, void *source, void *dest, vo
                     int pe, shm_internal_datatype_t datatype)
 {
     shmem_internal_assert(len > 0);
+    uint64_t pcntr = shmem_internal_pcntr_enter();
 
     if (shmem_shr_transport_use_atomic(ctx, target, len, pe, datatype)) {
         shmem_shr_transport_cswap(ctx, target, source, dest, operand, len, pe, datatype);
@@ -198,6 +285,8 @@ shmem_internal_cswap(shmem_ctx_t ctx, void *target, void *source, void *dest, vo
         shmem_transport_cswap((shmem_transport_ctx_t *)ctx, target, source,
                               dest, operand, len, pe, datatype);
     }
+
+    shmem_internal_pcntr_leave(ctx, SHMEMX_PCNTR_AMO, len, pe, pcntr);
 }
 
 
@@ -208,6 +297,7 @@ shmem_internal_cswap_nbi(shmem_ctx_t ctx, void *target, void *source,
                          shm_internal_datatype_t datatype)
 {
     shmem_internal_assert(len > 0);
+    uint64_t pcntr = shmem_internal_pcntr_enter();
 
     if (shmem_shr_transport_use_atomic(ctx, target, len, pe, datatype)) {
         shmem_shr_transport_cswap(ctx, target, source, dest, operand, len, pe, datatype);
@@ -215,6 +305,8 @@ shmem_internal_cswap_nbi(shmem_ctx_t ctx, void *target, void *source,
         shmem_transport_cswap_nbi((shmem_transport_ctx_t *)ctx, target, source,
                                   dest, operand, len, pe, datatype);
     }
+
+    shmem_internal_pcntr_leave(ctx, SHMEMX_PCNTR_AMO, len, pe, pcntr);
 }
 
 
@@ -224,6 +316,7 @@ shmem_internal_mswap(shmem_ctx_t ctx, void *target, void *source, void *dest, vo
                     int pe, shm_internal_datatype_t datatype)
 {
     shmem_internal_assert(len > 0);
+    uint64_t pcntr = shmem_internal_pcntr_enter();
 
     if (shmem_shr_transport_use_atomic(ctx, target, len, pe, datatype)) {
         shmem_shr_transport_mswap(ctx, target, source, dest, mask, len, pe, datatype);
@@ -231,6 +324,8 @@ shmem_internal_mswap(shmem_ctx_t ctx, void *target, void *source, void *dest, vo
         shmem_transport_mswap((shmem_transport_ctx_t *)ctx, target, source,
                               dest, mask, len, pe, datatype);
     }
+
+    shmem_internal_pcntr_leave(ctx, SHMEMX_PCNTR_AMO, len, pe, pcntr);
 }
 
 
@@ -240,6 +335,7 @@ shmem_internal_atomic(shmem_ctx_t ctx, void *target, const void *source, size_t
                       int pe, shm_internal_op_t op, shm_internal_datatype_t datatype)
 {
     shmem_internal_assert(len > 0);
+    uint64_t pcntr = shmem_internal_pcntr_enter();
 
     if (shmem_shr_transport_use_atomic(ctx, target, len, pe, datatype)) {
         shmem_shr_transport_atomic(ctx, target, source, len, pe, op, datatype);
@@ -256,6 +352,8 @@ shmem_internal_atomic(shmem_ctx_t ctx, void *target, const void *source, size_t
                                len, pe, op, datatype);
 #endif
     }
+
+    shmem_internal_pcntr_leave(ctx, SHMEMX_PCNTR_AMO, len, pe, pcntr);
 }
 
 
@@ -265,13 +363,16 @@ shmem_internal_atomic_fetch(shmem_ctx_t ctx, void *target, const void *source, s
                             int pe, shm_internal_datatype_t datatype)
 {
     shmem_internal_assert(len > 0);
+    uint64_t pcntr = shmem_internal_pcntr_enter();
 
-    if (shmem_shr_transport_use_atomic(ctx, target, len, pe, datatype)) {
+    if (shmem_shr_transport_use_atomic(ctx, (void *) source, len, pe, datatype)) {
         shmem_shr_transport_atomic_fetch(ctx, target, source, len, pe, datatype);
     } else {
         shmem_transport_atomic_fetch((shmem_transport_ctx_t *)ctx, target,
                                      source, len, pe, datatype);
     }
+
+    shmem_internal_pcntr_leave(ctx, SHMEMX_PCNTR_AMO, len, pe, pcntr);
 }
 
 
@@ -281,6 +382,7 @@ shmem_internal_atomic_set(shmem_ctx_t ctx, void *target, const void *source, siz
                           int pe, shm_internal_datatype_t datatype)
 {
     shmem_internal_assert(len > 0);
+    uint64_t pcntr = shmem_internal_pcntr_enter();
 
     if (shmem_shr_transport_use_atomic(ctx, target, len, pe, datatype)) {
         shmem_shr_transport_atomic_set(ctx, target, source, len, pe, datatype);
@@ -297,6 +399,8 @@ shmem_internal_atomic_set(shmem_ctx_t ctx, void *target, const void *source, siz
                                    source, len, pe, datatype);
 #endif
     }
+
+    shmem_internal_pcntr_leave(ctx, SHMEMX_PCNTR_AMO, len, pe, pcntr);
 }
 
 
@@ -307,6 +411,7 @@ shmem_internal_fetch_atomic(shmem_ctx_t ctx, void *target, void *source, void *d
                             shm_internal_datatype_t datatype)
 {
     shmem_internal_assert(len > 0);
+    uint64_t pcntr = shmem_internal_pcntr_enter();
 
     if (shmem_shr_transport_use_atomic(ctx, target, len, pe, datatype)) {
         shmem_shr_transport_fetch_atomic(ctx, target, source, dest, len, pe,
@@ -315,6 +420,8 @@ shmem_internal_fetch_atomic(shmem_ctx_t ctx, void *target, void *source, void *d
         shmem_transport_fetch_atomic((shmem_transport_ctx_t *)ctx, target,
                                      source, dest, len, pe, op, datatype);
     }
+
+    shmem_internal_pcntr_leave(ctx, SHMEMX_PCNTR_AMO, len, pe, pcntr);
 }
 
 
@@ -325,6 +432,7 @@ shmem_internal_atomicv(shmem_ctx_t ctx, void *target, const void *source,
                        shm_internal_datatype_t datatype, long *completion)
 {
     shmem_internal_assert(len > 0);
+    uint64_t pcntr = shmem_internal_pcntr_enter();
 
 #ifdef DISABLE_NONFETCH_AMO
     /* FIXME: This is a temporary workaround to resolve a known issue with non-fetching AMOs when using
@@ -347,6 +455,8 @@ shmem_internal_atomicv(shmem_ctx_t ctx, void *target, const void *source,
                                 pe, op, datatype, completion);
     }
 #endif
+
+    shmem_internal_pcntr_leave(ctx, SHMEMX_PCNTR_AMO, len, pe, pcntr);
 }
 
 
@@ -357,6 +467,7 @@ shmem_internal_fetch_atomic_nbi(shmem_ctx_t ctx, void *target, void *source,
                                 shm_internal_op_t op, shm_internal_datatype_t datatype)
 {
     shmem_internal_assert(len > 0);
+    uint64_t pcntr = shmem_internal_pcntr_enter();
 
     if (shmem_shr_transport_use_atomic(ctx, target, len, pe, datatype)) {
         shmem_shr_transport_fetch_atomic(ctx, target, source, dest, len, pe,
@@ -365,9 +476,217 @@ shmem_internal_fetch_atomic_nbi(shmem_ctx_t ctx, void *target, void *source,
         shmem_transport_fetch_atomic_nbi((shmem_transport_ctx_t *)ctx, target,
                                          source, dest, len, pe, op, datatype);
     }
+
+    shmem_internal_pcntr_leave(ctx, SHMEMX_PCNTR_AMO, len, pe, pcntr);
 }
 
 
+#define SHMEM_INTERNAL_AMO_BATCH_LEN 64
+
+/* Batched NBI fetching atomics.  Element i updates target[i] on PE
+ * (pe_start + pe_stride * pe[i]) with element i of source and returns the
+ * prior value in element i of dest.  When operand is non-NULL, the operation
+ * is a compare-and-swap against element i of operand and op is ignored.
+ * On-node elements are performed directly; runs of the remaining elements are
+ * handed to the transport as a batch, which it may post as a single
+ * pipelined sequence.  Completion is by quiet. */
+static inline
+void
+shmem_internal_fetch_atomic_batch(shmem_ctx_t ctx, void *const *target,
+                                  const void *source, void *dest,
+                                  const void *operand, size_t len,
+                                  const int *pe, size_t count, int pe_start,
+                                  int pe_stride, shm_internal_op_t op,
+                                  shm_internal_datatype_t datatype)
+{
+    int pes[SHMEM_INTERNAL_AMO_BATCH_LEN];
+    size_t i, run = 0, nrun = 0;
+    uint64_t pcntr = shmem_internal_pcntr_enter();
+
+    shmem_internal_assert(len > 0);
+
+    for (i = 0; i <= count; i++) {
+        int flush = (i == count) || nrun == SHMEM_INTERNAL_AMO_BATCH_LEN;
+        int shr = 0, p = 0;
+
+        if (i < count) {
+            p = pe_start + pe_stride * pe[i];
+            shr = shmem_shr_transport_use_atomic(ctx, target[i], len, p, datatype);
+        }
+
+        if ((flush || shr) && nrun > 0) {
+            if (NULL == operand)
+                shmem_transport_fetch_atomic_batch((shmem_transport_ctx_t *) ctx,
+                                                   target + run,
+                                                   (const uint8_t *) source + run * len,
+                                                   (uint8_t *) dest + run * len,
+                                                   len, pes, nrun, op, datatype);
+            else
+                shmem_transport_cswap_batch((shmem_transport_ctx_t *) ctx,
+                                            target + run,
+                                            (const uint8_t *) source + run * len,
+                                            (uint8_t *) dest + run * len,
+                                            (const uint8_t *) operand + run * len,
+                                            len, pes, nrun, datatype);
+            nrun = 0;
+        }
+
+        if (i == count) break;
+
+        if (shr) {
+            if (NULL == operand)
+                shmem_shr_transport_fetch_atomic(ctx, target[i],
+                                                 (uint8_t *) source + i * len,
+                                                 (uint8_t *) dest + i * len,
+                                                 len, p, op, datatype);
+            else
+                shmem_shr_transport_cswap(ctx, target[i],
+                                          (uint8_t *) source + i * len,
+                                          (uint8_t *) dest + i * len,
+                                          (uint8_t *) operand + i * len,
+                                          len, p, datatype);
+        } else {
+            if (0 == nrun) run = i;
+            pes[nrun++] = p;
+        }
+    }
+
+    shmem_internal_pcntr_leave(ctx, SHMEMX_PCNTR_AMO, len * count, -1, pcntr);
+}
+
+
+#ifndef USE_PORTALS4
+/* Transports without native counting events emulate them with a symmetric
+ * counter on each PE.  A counted operation atomically increments the counter
+ * at the target PE once the data has been delivered.  Since the counter is
+ * ordinary symmetric memory, on-node peers update it through the shared memory
+ * transport.  As with Portals counting events, CT objects must be created and
+ * freed in the same order on all PEs.
+ *
+ * Counted puts are not individually completed.  The initiator keeps a count
+ * of the puts issued to each PE and, at the next quiet, ct_get, ct_wait, or
+ * ct_free, or while it polls in a blocking wait (SHMEM_WAIT_PROBE), completes
+ * them together and adds each count to the target's counter with a single
+ * atomic.  A target's counter therefore never runs ahead of the data it
+ * counts, but an initiator that issues counted puts and then computes without
+ * entering the library delays the count until its next such call. */
+struct shmem_internal_ct_t {
+    uint64_t *cntr;
+    uint64_t *pending;          /* Counted puts per target PE, not yet added */
+    int *dirty;                 /* Target PEs with a nonzero pending count */
+    int ndirty;
+    struct shmem_internal_ct_t *next;   /* Next CT with pending counts */
+};
+typedef struct shmem_internal_ct_t shmem_internal_ct_t;
+
+/* CTs with pending counts, protected by shmem_internal_mutex_ct */
+extern shmem_internal_ct_t *shmem_internal_ct_pending;
+#ifdef ENABLE_THREADS
+extern shmem_internal_mutex_t shmem_internal_mutex_ct;
+#endif
+
+
+static inline
+void
+shmem_internal_ct_inc(shmemx_ct_t ct, int pe)
+{
+    uint64_t one = 1;
+
+    shmem_internal_atomic(SHMEM_CTX_DEFAULT, ((shmem_internal_ct_t *) ct)->cntr,
+                          &one, sizeof(uint64_t), pe, SHM_INTERNAL_SUM,
+                          SHM_INTERNAL_UINT64);
+}
+
+
+/* Complete the outstanding counted puts and publish their counts */
+static inline
+void
+shmem_internal_ct_flush(void)
+{
+    shmem_internal_ct_t *ict;
+    int i, ret;
+
+    if (NULL == __atomic_load_n(&shmem_internal_ct_pending, __ATOMIC_ACQUIRE))
+        return;
+
+    SHMEM_MUTEX_LOCK(shmem_internal_mutex_ct);
+
+    if (NULL == shmem_internal_ct_pending) {
+        SHMEM_MUTEX_UNLOCK(shmem_internal_mutex_ct);
+        return;
+    }
+
+    /* Deliver the data of every pending put before any counter update */
+#ifdef USE_SHR_COPY
+    shmem_shr_copy_quiet(SHMEM_CTX_DEFAULT);
+#endif
+    ret = shmem_transport_quiet((shmem_transport_ctx_t *) SHMEM_CTX_DEFAULT);
+    if (0 != ret) { RAISE_ERROR(ret); }
+    shmem_internal_membar_release();
+
+    for (ict = shmem_internal_ct_pending; NULL != ict; ict = ict->next) {
+        for (i = 0; i < ict->ndirty; i++) {
+            int pe = ict->dirty[i];
+
+            shmem_internal_atomic(SHMEM_CTX_DEFAULT, ict->cntr, &ict->pending[pe],
+                                  sizeof(uint64_t), pe, SHM_INTERNAL_SUM,
+                                  SHM_INTERNAL_UINT64);
+            ict->pending[pe] = 0;
+        }
+        ict->ndirty = 0;
+    }
+    __atomic_store_n(&shmem_internal_ct_pending, NULL, __ATOMIC_RELEASE);
+
+    SHMEM_MUTEX_UNLOCK(shmem_internal_mutex_ct);
+}
+#endif
+
+
+static inline
+void
+shmem_internal_put_ct_nb(shmemx_ct_t ct, void *target, const void *source, size_t len, int pe,
+                      long *completion)
+{
+#ifdef USE_PORTALS4
+    shmem_transport_put_ct_nb((shmem_transport_ct_t *)
+                              ct, target, source, len, pe, completion);
+#else
+    shmem_internal_ct_t *ict = (shmem_internal_ct_t *) ct;
+
+    shmem_internal_put_nb(SHMEM_CTX_DEFAULT, target, source, len, pe, completion);
+
+    SHMEM_MUTEX_LOCK(shmem_internal_mutex_ct);
+
+    if (0 == ict->pending[pe]++) {
+        if (0 == ict->ndirty) {
+            ict->next = shmem_internal_ct_pending;
+            __atomic_store_n(&shmem_internal_ct_pending, ict, __ATOMIC_RELEASE);
+        }
+        ict->dirty[ict->ndirty++] = pe;
+    }
+
+    SHMEM_MUTEX_UNLOCK(shmem_internal_mutex_ct);
+#endif
+}
+
+
+static inline
+void
+shmem_internal_get_ct(shmemx_ct_t ct, void *target, const void *source, size_t len, int pe)
+{
+#ifdef USE_PORTALS4
+    shmem_transport_get_ct((shmem_transport_ct_t *) ct,
+                           target, source, len, pe);
+#else
+    shmem_internal_get(SHMEM_CTX_DEFAULT, target, source, len, pe);
+    shmem_internal_get_wait(SHMEM_CTX_DEFAULT);
+
+    shmem_internal_ct_inc(ct, pe);
+#endif
+}
+
+
+#ifdef USE_PORTALS4
 static inline
 void shmem_internal_ct_create(shmemx_ct_t *ct)
 {
@@ -402,6 +721,86 @@ void shmem_internal_ct_wait(shmemx_ct_t ct, long wait_for)
     shmem_transport_ct_wait((shmem_transport_ct_t *) ct, wait_for);
 }
 
+#else
+static inline
+void shmem_internal_ct_create(shmemx_ct_t *ct)
+{
+    shmem_internal_ct_t *ict;
+
+    ict = malloc(sizeof(shmem_internal_ct_t));
+    if (NULL == ict) {
+        RAISE_ERROR_STR("Out of memory allocating CT object");
+    }
+
+    ict->cntr = shmem_internal_shmalloc(sizeof(uint64_t));
+    if (NULL == ict->cntr) {
+        RAISE_ERROR_STR("Out of symmetric memory allocating CT counter");
+    }
+    __atomic_store_n(ict->cntr, 0, __ATOMIC_RELEASE);
+
+    ict->pending = calloc(shmem_internal_num_pes, sizeof(uint64_t));
+    ict->dirty = malloc(shmem_internal_num_pes * sizeof(int));
+    if (NULL == ict->pending || NULL == ict->dirty) {
+        RAISE_ERROR_STR("Out of memory allocating CT object");
+    }
+    ict->ndirty = 0;
+    ict->next = NULL;
+
+    *ct = (shmemx_ct_t) ict;
+}
+
+
+static inline
+void shmem_internal_ct_free(shmemx_ct_t *ct)
+{
+    shmem_internal_ct_t *ict = (shmem_internal_ct_t *) *ct;
+
+    shmem_internal_ct_flush();
+
+    shmem_internal_free(ict->cntr);
+    free(ict->pending);
+    free(ict->dirty);
+    free(ict);
+    *ct = NULL;
+}
+
+
+static inline
+long shmem_internal_ct_get(shmemx_ct_t ct)
+{
+    shmem_internal_ct_flush();
+    shmem_transport_probe();
+
+    return (long) __atomic_load_n(((shmem_internal_ct_t *) ct)->cntr,
+                                  __ATOMIC_ACQUIRE);
+}
+
+
+static inline
+void shmem_internal_ct_set(shmemx_ct_t ct, long value)
+{
+    __atomic_store_n(((shmem_internal_ct_t *) ct)->cntr, (uint64_t) value,
+                     __ATOMIC_RELEASE);
+}
+
+
+static inline
+void shmem_internal_ct_wait(shmemx_ct_t ct, long wait_for)
+{
+    uint64_t *cntr = ((shmem_internal_ct_t *) ct)->cntr;
+
+    shmem_internal_ct_flush();
+
+    while ((long) __atomic_load_n(cntr, __ATOMIC_ACQUIRE) < wait_for) {
+        shmem_transport_probe();
+        SPINLOCK_BODY();
+    }
+
+    shmem_internal_membar_acq_rel();
+    shmem_transport_syncmem();
+}
+#endif
+
 
 /* Uses internal put for external heap config; otherwise memcpy */
 static inline
@@ -416,7 +815,7 @@ void shmem_internal_copy_self(void *dest, const void *source, size_t nelems)
                           shmem_internal_my_pe, &completion);
     shmem_internal_put_wait(SHMEM_CTX_DEFAULT, &completion);
 #else
-    memcpy(dest, source, nelems);
+    shmem_internal_memcpy(dest, source, nelems);
 #endif
 }
 
@@ -0,0 +1,198 @@
+/* -*- C -*-
+ *
+ * Copyright (c) 2022 Intel Corporation. All rights reserved.
+ * This software is available to you under the BSD license.
+ *
+ * This file is part of the Sandia OpenSHMEM software package. For license
+ * information, see the LICENSE file in the top level directory of the
+ * distribution.
+ *
+ */
+
+#include "config.h"
+
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <immintrin.h>
+
+#define SHMEM_INTERNAL_INCLUDE
+#include "shmem.h"
+#include "shmem_internal.h"
+#include "shmem_copy.h"
+
+/* Used when the LLC size cannot be determined */
+#define SHMEM_INTERNAL_COPY_DEFAULT_THRESHOLD (4 * 1024 * 1024)
+
+static void shmem_internal_copy_memcpy(void *dest, const void *source, size_t len);
+
+/* Copies are performed with memcpy until shmem_internal_copy_init runs */
+size_t shmem_internal_copy_threshold = SIZE_MAX;
+shmem_internal_copy_fn_t shmem_internal_copy_large = shmem_internal_copy_memcpy;
+
+
+static void
+shmem_internal_copy_memcpy(void *dest, const void *source, size_t len)
+{
+    memcpy(dest, source, len);
+}
+
+
+static void
+shmem_internal_copy_movsb(void *dest, const void *source, size_t len)
+{
+    __asm__ __volatile__ ("rep movsb"
+                          : "+D" (dest), "+S" (source), "+c" (len)
+                          :
+                          : "memory");
+}
+
+
+/* The non-temporal kernels copy up to the first aligned destination address
+ * with memcpy, stream the body with unaligned loads and aligned non-temporal
+ * stores, and copy the remainder with memcpy.  The trailing sfence orders the
+ * weakly-ordered streaming stores before any later flag update. */
+static void
+shmem_internal_copy_nt_sse2(void *dest, const void *source, size_t len)
+{
+    uint8_t *d = (uint8_t *) dest;
+    const uint8_t *s = (const uint8_t *) source;
+    size_t head = (16 - ((uintptr_t) d & 15)) & 15;
+
+    if (head > len) head = len;
+    memcpy(d, s, head);
+    d += head; s += head; len -= head;
+
+    for ( ; len >= 64 ; len -= 64, d += 64, s += 64) {
+        __m128i v0 = _mm_loadu_si128((const __m128i *) s);
+        __m128i v1 = _mm_loadu_si128((const __m128i *) (s + 16));
+        __m128i v2 = _mm_loadu_si128((const __m128i *) (s + 32));
+        __m128i v3 = _mm_loadu_si128((const __m128i *) (s + 48));
+        _mm_stream_si128((__m128i *) d, v0);
+        _mm_stream_si128((__m128i *) (d + 16), v1);
+        _mm_stream_si128((__m128i *) (d + 32), v2);
+        _mm_stream_si128((__m128i *) (d + 48), v3);
+    }
+    _mm_sfence();
+
+    memcpy(d, s, len);
+}
+
+
+__attribute__((target("avx2")))
+static void
+shmem_internal_copy_nt_avx2(void *dest, const void *source, size_t len)
+{
+    uint8_t *d = (uint8_t *) dest;
+    const uint8_t *s = (const uint8_t *) source;
+    size_t head = (32 - ((uintptr_t) d & 31)) & 31;
+
+    if (head > len) head = len;
+    memcpy(d, s, head);
+    d += head; s += head; len -= head;
+
+    for ( ; len >= 128 ; len -= 128, d += 128, s += 128) {
+        __m256i v0 = _mm256_loadu_si256((const __m256i *) s);
+        __m256i v1 = _mm256_loadu_si256((const __m256i *) (s + 32));
+        __m256i v2 = _mm256_loadu_si256((const __m256i *) (s + 64));
+        __m256i v3 = _mm256_loadu_si256((const __m256i *) (s + 96));
+        _mm256_stream_si256((__m256i *) d, v0);
+        _mm256_stream_si256((__m256i *) (d + 32), v1);
+        _mm256_stream_si256((__m256i *) (d + 64), v2);
+        _mm256_stream_si256((__m256i *) (d + 96), v3);
+    }
+    _mm_sfence();
+
+    memcpy(d, s, len);
+}
+
+
+#ifdef HAVE_NT_COPY_AVX512
+__attribute__((target("avx512f")))
+static void
+shmem_internal_copy_nt_avx512(void *dest, const void *source, size_t len)
+{
+    uint8_t *d = (uint8_t *) dest;
+    const uint8_t *s = (const uint8_t *) source;
+    size_t head = (64 - ((uintptr_t) d & 63)) & 63;
+
+    if (head > len) head = len;
+    memcpy(d, s, head);
+    d += head; s += head; len -= head;
+
+    for ( ; len >= 256 ; len -= 256, d += 256, s += 256) {
+        __m512i v0 = _mm512_loadu_si512(s);
+        __m512i v1 = _mm512_loadu_si512(s + 64);
+        __m512i v2 = _mm512_loadu_si512(s + 128);
+        __m512i v3 = _mm512_loadu_si512(s + 192);
+        _mm512_stream_si512((__m512i *) d, v0);
+        _mm512_stream_si512((__m512i *) (d + 64), v1);
+        _mm512_stream_si512((__m512i *) (d + 128), v2);
+        _mm512_stream_si512((__m512i *) (d + 192), v3);
+    }
+    _mm_sfence();
+
+    memcpy(d, s, len);
+}
+#endif
+
+
+int
+shmem_internal_copy_init(void)
+{
+    const char *type = shmem_internal_params.COPY_KERNEL;
+    const char *name;
+    shmem_internal_copy_fn_t nt_kernel;
+    const char *nt_name;
+    size_t threshold;
+    long llc = 0;
+
+    __builtin_cpu_init();
+
+#ifdef HAVE_NT_COPY_AVX512
+    if (__builtin_cpu_supports("avx512f")) {
+        nt_kernel = shmem_internal_copy_nt_avx512;
+        nt_name = "nt-avx512";
+    } else
+#endif
+    if (__builtin_cpu_supports("avx2")) {
+        nt_kernel = shmem_internal_copy_nt_avx2;
+        nt_name = "nt-avx2";
+    } else {
+        nt_kernel = shmem_internal_copy_nt_sse2;
+        nt_name = "nt-sse2";
+    }
+
+    if (0 == strcmp(type, "auto") || 0 == strcmp(type, "nt")) {
+        shmem_internal_copy_large = nt_kernel;
+        name = nt_name;
+    } else if (0 == strcmp(type, "movsb")) {
+        shmem_internal_copy_large = shmem_internal_copy_movsb;
+        name = "movsb";
+    } else if (0 == strcmp(type, "memcpy")) {
+        shmem_internal_copy_large = shmem_internal_copy_memcpy;
+        name = "memcpy";
+    } else {
+        RAISE_WARN_MSG("Ignoring bad copy kernel '%s'\n", type);
+        shmem_internal_copy_large = nt_kernel;
+        name = nt_name;
+    }
+
+    /* Copies larger than half the LLC would evict most of its contents */
+    if (shmem_internal_params.COPY_THRESHOLD_provided &&
+        shmem_internal_params.COPY_THRESHOLD > 0) {
+        threshold = shmem_internal_params.COPY_THRESHOLD;
+    } else {
+#ifdef _SC_LEVEL3_CACHE_SIZE
+        llc = sysconf(_SC_LEVEL3_CACHE_SIZE);
+#endif
+        threshold = (llc > 0) ? (size_t) llc / 2 :
+                                SHMEM_INTERNAL_COPY_DEFAULT_THRESHOLD;
+    }
+
+    shmem_internal_copy_threshold = threshold;
+
+    DEBUG_MSG("Copy kernel %s for copies >= %zu bytes\n", name, threshold);
+
+    return 0;
+}
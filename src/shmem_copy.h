@@ -0,0 +1,46 @@
+/* -*- C -*-
+ *
+ * Copyright (c) 2022 Intel Corporation. All rights reserved.
+ * This software is available to you under the BSD license.
+ *
+ * This file is part of the Sandia OpenSHMEM software package. For license
+ * information, see the LICENSE file in the top level directory of the
+ * distribution.
+ *
+ */
+
+#ifndef SHMEM_COPY_H
+#define SHMEM_COPY_H
+
+#include <string.h>
+#include <stddef.h>
+
+#ifdef USE_NT_COPY
+typedef void (*shmem_internal_copy_fn_t)(void *dest, const void *source,
+                                         size_t len);
+
+extern size_t shmem_internal_copy_threshold;
+extern shmem_internal_copy_fn_t shmem_internal_copy_large;
+
+int shmem_internal_copy_init(void);
+#endif
+
+
+/* Copy used for bulk on-node transfers.  Copies at or above the copy
+ * threshold use the kernel selected at startup, which by default streams the
+ * data with non-temporal stores to avoid evicting the cache contents of the
+ * PE and of the peers sharing its last level cache. */
+static inline
+void
+shmem_internal_memcpy(void *dest, const void *source, size_t len)
+{
+#ifdef USE_NT_COPY
+    if (len >= shmem_internal_copy_threshold) {
+        shmem_internal_copy_large(dest, source, len);
+        return;
+    }
+#endif
+    memcpy(dest, source, len);
+}
+
+#endif
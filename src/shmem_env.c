@@ -218,7 +218,13 @@ printf("\nNetwork transport: %s\n",
 #undef SHMEM_INTERNAL_ENV_DEF
 
 printf("\nOn-node transport: %s\n",
-#if defined(USE_CMA)
+#if defined(USE_MEMFD) && defined(USE_CMA)
+       "memfd heap, Linux CMA"
+#elif defined(USE_MEMFD)
+       "memfd heap"
+#elif defined(USE_XPMEM) && defined(USE_CMA)
+       "XPMEM, Linux CMA"
+#elif defined(USE_CMA)
        "Linux CMA"
 #elif defined(USE_XPMEM)
        "XPMEM"
@@ -50,6 +50,16 @@ SHMEM_INTERNAL_ENV_DEF(MAX_BOUNCE_BUFFERS, long, 128, SHMEM_INTERNAL_ENV_CAT_OTH
                        "Maximum number of bounce buffers per context")
 SHMEM_INTERNAL_ENV_DEF(TRAP_ON_ABORT, bool, false, SHMEM_INTERNAL_ENV_CAT_OTHER,
                        "Generate trap if the program aborts or calls shmem_global_exit")
+SHMEM_INTERNAL_ENV_DEF(PCNTR_PROFILE, bool, false, SHMEM_INTERNAL_ENV_CAT_OTHER,
+                       "Record per-context message size and latency histograms, print at finalize")
+SHMEM_INTERNAL_ENV_DEF(TRACE, bool, false, SHMEM_INTERNAL_ENV_CAT_OTHER,
+                       "Record a trace of communication events, written to a file per PE")
+SHMEM_INTERNAL_ENV_DEF(TRACE_FILE, string, "shmem_trace", SHMEM_INTERNAL_ENV_CAT_OTHER,
+                       "Trace file name prefix, PE number and .trace are appended")
+SHMEM_INTERNAL_ENV_DEF(TRACE_EVENTS, long, 65536, SHMEM_INTERNAL_ENV_CAT_OTHER,
+                       "Trace ring buffer capacity per thread (events)")
+SHMEM_INTERNAL_ENV_DEF(TRACE_SIGNAL, long, 0, SHMEM_INTERNAL_ENV_CAT_OTHER,
+                       "Signal number that writes the trace file when received (0 disables)")
 
 SHMEM_INTERNAL_ENV_DEF(COLL_CROSSOVER, long, 4, SHMEM_INTERNAL_ENV_CAT_COLLECTIVES,
                        "Crossover between linear and tree collectives (num. PEs)")
@@ -58,20 +68,30 @@ SHMEM_INTERNAL_ENV_DEF(COLL_SIZE_CROSSOVER, size, 16384, SHMEM_INTERNAL_ENV_CAT_
 SHMEM_INTERNAL_ENV_DEF(COLL_RADIX, long, 4, SHMEM_INTERNAL_ENV_CAT_COLLECTIVES,
                        "Radix for tree-based collectives")
 SHMEM_INTERNAL_ENV_DEF(BARRIER_ALGORITHM, string, "auto", SHMEM_INTERNAL_ENV_CAT_COLLECTIVES,
-                       "Algorithm for barrier.  Options are auto, linear, tree, dissem")
+                       "Algorithm for barrier.  Options are auto, linear, tree, dissem, hier, offload")
 SHMEM_INTERNAL_ENV_DEF(BCAST_ALGORITHM, string, "auto", SHMEM_INTERNAL_ENV_CAT_COLLECTIVES,
-                       "Algorithm for broadcast.  Options are auto, linear, tree")
+                       "Algorithm for broadcast.  Options are auto, linear, tree, offload")
 SHMEM_INTERNAL_ENV_DEF(REDUCE_ALGORITHM, string, "auto", SHMEM_INTERNAL_ENV_CAT_COLLECTIVES,
-                       "Algorithm for reductions.  Options are auto, linear, tree, recdbl")
+                       "Algorithm for reductions.  Options are auto, linear, tree, recdbl, offload")
 SHMEM_INTERNAL_ENV_DEF(COLLECT_ALGORITHM, string, "auto", SHMEM_INTERNAL_ENV_CAT_COLLECTIVES,
                        "Algorithm for collect.  Options are auto, linear")
 SHMEM_INTERNAL_ENV_DEF(FCOLLECT_ALGORITHM, string, "auto", SHMEM_INTERNAL_ENV_CAT_COLLECTIVES,
                        "Algorithm for fcollect.  Options are auto, linear, ring, recdbl")
 SHMEM_INTERNAL_ENV_DEF(BARRIERS_FLUSH, bool, false, SHMEM_INTERNAL_ENV_CAT_COLLECTIVES,
                         "Flush stdout and stderr on barrier")
+SHMEM_INTERNAL_ENV_DEF(COLL_TUNE_FILE, string, "", SHMEM_INTERNAL_ENV_CAT_COLLECTIVES,
+                       "Collective algorithm decision table to load at startup")
+SHMEM_INTERNAL_ENV_DEF(COLL_TUNE, bool, false, SHMEM_INTERNAL_ENV_CAT_COLLECTIVES,
+                       "Measure the collective algorithms and write COLL_TUNE_FILE if it does not exist")
+SHMEM_INTERNAL_ENV_DEF(COLL_TUNE_MAX_SIZE, size, 256*1024, SHMEM_INTERNAL_ENV_CAT_COLLECTIVES,
+                       "Largest message size measured by COLL_TUNE (bytes)")
+SHMEM_INTERNAL_ENV_DEF(COLL_TUNE_ITERS, long, 20, SHMEM_INTERNAL_ENV_CAT_COLLECTIVES,
+                       "Iterations per measurement by COLL_TUNE")
 
 SHMEM_INTERNAL_ENV_DEF(TEAMS_MAX, long, DEFAULT_TEAMS_MAX, SHMEM_INTERNAL_ENV_CAT_OTHER,
                        "Maximum number of teams per PE")
+SHMEM_INTERNAL_ENV_DEF(CTX_POOL_SIZE, long, 8, SHMEM_INTERNAL_ENV_CAT_OTHER,
+                       "Number of destroyed contexts kept per team for reuse (max 32), 0 to disable")
 SHMEM_INTERNAL_ENV_DEF(TEAM_SHARED_ONLY_SELF, bool, false, SHMEM_INTERNAL_ENV_CAT_OTHER,
                        "Include only the self PE in SHMEM_TEAM_SHARED")
 
@@ -82,6 +102,43 @@ SHMEM_INTERNAL_ENV_DEF(CMA_GET_MAX, size, 16*1024, SHMEM_INTERNAL_ENV_CAT_INTRAN
                        "Size below which to use CMA for gets")
 #endif /* USE_CMA */
 
+#if defined(USE_ON_NODE_COMMS) || defined(USE_MEMCPY)
+SHMEM_INTERNAL_ENV_DEF(SHR_ROUTE_CALIBRATE, bool, false, SHMEM_INTERNAL_ENV_CAT_INTRANODE,
+                       "Time the on-node mechanisms at startup and route puts and gets to the fastest by size")
+SHMEM_INTERNAL_ENV_DEF(SHR_ROUTE_SELF_MAX, size, 0, SHMEM_INTERNAL_ENV_CAT_INTRANODE,
+                       "Size above which self-targeted puts and gets use the network transport, 0 for no limit")
+#endif
+
+#ifdef USE_SHR_DOORBELL
+SHMEM_INTERNAL_ENV_DEF(WAIT_SLEEP, bool, false, SHMEM_INTERNAL_ENV_CAT_INTRANODE,
+                       "Sleep in wait operations until woken by an on-node update")
+SHMEM_INTERNAL_ENV_DEF(WAIT_SPIN_COUNT, long, 4096, SHMEM_INTERNAL_ENV_CAT_INTRANODE,
+                       "Number of polls performed by wait operations before sleeping")
+SHMEM_INTERNAL_ENV_DEF(WAIT_SLEEP_TIMEOUT, long, 100, SHMEM_INTERNAL_ENV_CAT_INTRANODE,
+                       "Maximum sleep (us) before a wait polls for network updates, 0 for no limit")
+#endif /* USE_SHR_DOORBELL */
+
+#ifdef USE_NT_COPY
+SHMEM_INTERNAL_ENV_DEF(COPY_KERNEL, string, "auto", SHMEM_INTERNAL_ENV_CAT_INTRANODE,
+                       "Kernel for large on-node copies (auto, nt, movsb, memcpy)")
+SHMEM_INTERNAL_ENV_DEF(COPY_THRESHOLD, size, 0, SHMEM_INTERNAL_ENV_CAT_INTRANODE,
+                       "Size at or above which on-node copies use COPY_KERNEL, 0 for half the LLC size")
+#endif /* USE_NT_COPY */
+
+#ifdef USE_SHR_COPY
+SHMEM_INTERNAL_ENV_DEF(SHR_COPY_THREADS, long, 0, SHMEM_INTERNAL_ENV_CAT_INTRANODE,
+                       "Number of helper threads performing large on-node nbi transfers, 0 to disable")
+SHMEM_INTERNAL_ENV_DEF(SHR_COPY_MIN_SIZE, size, 256*1024, SHMEM_INTERNAL_ENV_CAT_INTRANODE,
+                       "Size at or above which on-node nbi transfers are offloaded to helper threads")
+SHMEM_INTERNAL_ENV_DEF(SHR_COPY_CHUNK_SIZE, size, 1024*1024, SHMEM_INTERNAL_ENV_CAT_INTRANODE,
+                       "Size of the pieces an offloaded transfer is split into across helper threads")
+#endif /* USE_SHR_COPY */
+
+#ifdef USE_PORTALS4
+SHMEM_INTERNAL_ENV_DEF(PORTALS4_COLL_OFFLOAD_SIZE, size, 1024, SHMEM_INTERNAL_ENV_CAT_TRANSPORT,
+                       "Largest broadcast or reduction offloaded with triggered operations (bytes)")
+#endif
+
 #ifdef USE_OFI
 SHMEM_INTERNAL_ENV_DEF(OFI_ATOMIC_CHECKS_WARN, bool, false, SHMEM_INTERNAL_ENV_CAT_TRANSPORT,
                        "Display warnings about unsupported atomic operations")
@@ -104,7 +161,7 @@ SHMEM_INTERNAL_ENV_DEF(OFI_STX_AUTO, bool, false, SHMEM_INTERNAL_ENV_CAT_TRANSPO
 SHMEM_INTERNAL_ENV_DEF(OFI_STX_THRESHOLD, long, 1, SHMEM_INTERNAL_ENV_CAT_TRANSPORT,
                        "Maximum number of shared contexts per STX before allocating a new STX resource")
 SHMEM_INTERNAL_ENV_DEF(OFI_STX_ALLOCATOR, string, "round-robin", SHMEM_INTERNAL_ENV_CAT_TRANSPORT,
-                       "Algorithm for allocating STX resources to contexts")
+                       "Algorithm for allocating STX resources to contexts.  Options are round-robin, random, load")
 SHMEM_INTERNAL_ENV_DEF(OFI_STX_DISABLE_PRIVATE, bool, false, SHMEM_INTERNAL_ENV_CAT_TRANSPORT,
                        "Disallow private contexts from having exclusive STX access")
 SHMEM_INTERNAL_ENV_DEF(OFI_DISABLE_MULTIRAIL, bool, false, SHMEM_INTERNAL_ENV_CAT_TRANSPORT,
@@ -114,6 +171,12 @@ SHMEM_INTERNAL_ENV_DEF(OFI_DISABLE_MULTIRAIL, bool, false, SHMEM_INTERNAL_ENV_CA
 #ifdef USE_UCX
 SHMEM_INTERNAL_ENV_DEF(PROGRESS_INTERVAL, long, 1000, SHMEM_INTERNAL_ENV_CAT_TRANSPORT,
                        "Polling interval for progress thread in microseconds (0 to disable)")
+SHMEM_INTERNAL_ENV_DEF(UCX_CTX_WORKER, string, "ctx", SHMEM_INTERNAL_ENV_CAT_TRANSPORT,
+                       "UCX worker used by contexts.  Options are ctx, thread, default")
+SHMEM_INTERNAL_ENV_DEF(UCX_MAX_PENDING, long, 4096, SHMEM_INTERNAL_ENV_CAT_TRANSPORT,
+                       "Maximum number of outstanding gets and fetching atomics per context")
+SHMEM_INTERNAL_ENV_DEF(UCX_EAGER_CONNECT, bool, false, SHMEM_INTERNAL_ENV_CAT_TRANSPORT,
+                       "Connect to all PEs during initialization, instead of on first use")
 #endif
 
 #ifdef ENABLE_PMI_MPI
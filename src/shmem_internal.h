@@ -41,6 +41,9 @@ extern void *shmem_internal_heap_base;
 extern long shmem_internal_heap_length;
 extern void *shmem_internal_data_base;
 extern long shmem_internal_data_length;
+#ifdef USE_MEMFD
+extern int shmem_internal_heap_fd;
+#endif
 
 extern void *shmem_external_heap_base;
 extern long shmem_external_heap_length;
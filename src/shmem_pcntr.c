@@ -0,0 +1,256 @@
+/* -*- C -*-
+ *
+ * Copyright (c) 2022 Intel Corporation. All rights reserved.
+ * This software is available to you under the BSD license.
+ *
+ * This file is part of the Sandia OpenSHMEM software package. For license
+ * information, see the LICENSE file in the top level directory of the
+ * distribution.
+ *
+ */
+
+#include "config.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+
+#define SHMEM_INTERNAL_INCLUDE
+#include "shmem.h"
+#include "shmem_internal.h"
+#include "shmem_pcntr.h"
+
+int shmem_internal_pcntr_enabled = 0;
+int shmem_internal_pcntr_profile = 0;
+__thread int shmem_internal_pcntr_active = 0;
+
+/* Statistics of every context that has issued an instrumented operation.
+ * Entries outlive their contexts and are released at finalize. */
+static struct shmem_internal_pcntr_ctx_t *shmem_internal_pcntr_ctx_list = NULL;
+static int shmem_internal_pcntr_ctx_count = 0;
+
+/* Bytes written to (puts and atomics) and read from (gets) each PE.  These are
+ * kept per process rather than per context to bound the memory footprint. */
+static uint64_t *shmem_internal_pcntr_put_bytes = NULL;
+static uint64_t *shmem_internal_pcntr_get_bytes = NULL;
+
+static const char *shmem_internal_pcntr_class_str[SHMEMX_PCNTR_NUM_CLASSES] = {
+    "put", "get", "amo", "coll", "quiet", "wait"
+};
+
+
+static inline int
+shmem_internal_pcntr_bin(uint64_t value)
+{
+    int bin;
+
+    if (value == 0) return 0;
+
+    bin = 64 - __builtin_clzll(value);
+    return bin < SHMEMX_PCNTR_NUM_BINS ? bin : SHMEMX_PCNTR_NUM_BINS - 1;
+}
+
+
+int
+shmem_internal_pcntr_init(void)
+{
+    int ret;
+
+    ret = shmem_internal_trace_init();
+    if (ret != 0) return ret;
+
+    shmem_internal_pcntr_enabled = shmem_internal_trace_enabled;
+
+    if (!shmem_internal_params.PCNTR_PROFILE) return 0;
+
+    shmem_internal_pcntr_put_bytes = calloc(shmem_internal_num_pes, sizeof(uint64_t));
+    shmem_internal_pcntr_get_bytes = calloc(shmem_internal_num_pes, sizeof(uint64_t));
+
+    if (NULL == shmem_internal_pcntr_put_bytes ||
+        NULL == shmem_internal_pcntr_get_bytes) {
+        RETURN_ERROR_STR("Out of memory allocating instrumentation counters");
+        free(shmem_internal_pcntr_put_bytes);
+        free(shmem_internal_pcntr_get_bytes);
+        return 1;
+    }
+
+    shmem_internal_pcntr_profile = 1;
+    shmem_internal_pcntr_enabled = 1;
+
+    return 0;
+}
+
+
+static void
+shmem_internal_pcntr_print_hist(const char *name, const uint64_t *hist,
+                                const char *unit)
+{
+    int i;
+
+    printf("      %-8s", name);
+    for (i = 0; i < SHMEMX_PCNTR_NUM_BINS; i++) {
+        if (hist[i] == 0) continue;
+        if (i == 0)
+            printf(" 0%s:%"PRIu64, unit, hist[i]);
+        else
+            printf(" <%"PRIu64"%s:%"PRIu64, (uint64_t) 1 << i, unit, hist[i]);
+    }
+    printf("\n");
+}
+
+
+static void
+shmem_internal_pcntr_dump(void)
+{
+    struct shmem_internal_pcntr_ctx_t *stats;
+    uint64_t total_ns = 0;
+    int i, c;
+
+    for (stats = shmem_internal_pcntr_ctx_list; stats != NULL; stats = stats->next)
+        for (c = 0; c < SHMEMX_PCNTR_NUM_CLASSES; c++)
+            total_ns += stats->hist[c].time_ns;
+
+    printf("[%04d] Instrumentation: %.6f s in library\n",
+           shmem_internal_my_pe, (double) total_ns / 1.0e9);
+
+    for (stats = shmem_internal_pcntr_ctx_list; stats != NULL; stats = stats->next) {
+        printf("  ctx %d\n", stats->id);
+
+        for (c = 0; c < SHMEMX_PCNTR_NUM_CLASSES; c++) {
+            shmemx_pcntr_hist_t *h = &stats->hist[c];
+
+            if (h->count == 0) continue;
+
+            printf("    %-6s count %"PRIu64" bytes %"PRIu64" time %.6f s\n",
+                   shmem_internal_pcntr_class_str[c], h->count, h->bytes,
+                   (double) h->time_ns / 1.0e9);
+            shmem_internal_pcntr_print_hist("size", h->size_hist, "B");
+            shmem_internal_pcntr_print_hist("latency", h->latency_hist, "ns");
+        }
+    }
+
+    for (i = 0; i < shmem_internal_num_pes; i++) {
+        if (shmem_internal_pcntr_put_bytes[i] == 0 &&
+            shmem_internal_pcntr_get_bytes[i] == 0)
+            continue;
+
+        printf("  pe %d: written %"PRIu64" read %"PRIu64"\n", i,
+               shmem_internal_pcntr_put_bytes[i],
+               shmem_internal_pcntr_get_bytes[i]);
+    }
+
+    fflush(stdout);
+}
+
+
+void
+shmem_internal_pcntr_fini(void)
+{
+    struct shmem_internal_pcntr_ctx_t *stats, *next;
+
+    if (!shmem_internal_pcntr_enabled) return;
+
+    shmem_internal_pcntr_enabled = 0;
+
+    shmem_internal_trace_fini();
+
+    if (shmem_internal_pcntr_profile)
+        shmem_internal_pcntr_dump();
+
+    for (stats = shmem_internal_pcntr_ctx_list; stats != NULL; stats = next) {
+        next = stats->next;
+        free(stats);
+    }
+    shmem_internal_pcntr_ctx_list = NULL;
+    shmem_internal_pcntr_ctx_count = 0;
+
+    free(shmem_internal_pcntr_put_bytes);
+    free(shmem_internal_pcntr_get_bytes);
+    shmem_internal_pcntr_put_bytes = NULL;
+    shmem_internal_pcntr_get_bytes = NULL;
+    shmem_internal_pcntr_profile = 0;
+}
+
+
+/* Look up the statistics of ctx, allocating them on first use.  Allocation
+ * races between threads sharing a context are resolved by compare-and-swap. */
+struct shmem_internal_pcntr_ctx_t *
+shmem_internal_pcntr_ctx_stats(shmem_ctx_t ctx)
+{
+    shmem_transport_ctx_t *tctx = (shmem_transport_ctx_t *) ctx;
+    struct shmem_internal_pcntr_ctx_t *stats, *expected = NULL;
+
+    stats = __atomic_load_n(&tctx->pcntr_stats, __ATOMIC_ACQUIRE);
+    if (NULL != stats) return stats;
+
+    stats = calloc(1, sizeof(struct shmem_internal_pcntr_ctx_t));
+    if (NULL == stats)
+        RAISE_ERROR_STR("Out of memory allocating instrumentation counters");
+
+    if (!__atomic_compare_exchange_n(&tctx->pcntr_stats, &expected, stats, 0,
+                                     __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+        free(stats);
+        return expected;
+    }
+
+    stats->id = __atomic_fetch_add(&shmem_internal_pcntr_ctx_count, 1,
+                                   __ATOMIC_RELAXED);
+    stats->next = __atomic_load_n(&shmem_internal_pcntr_ctx_list, __ATOMIC_RELAXED);
+    while (!__atomic_compare_exchange_n(&shmem_internal_pcntr_ctx_list,
+                                        &stats->next, stats, 0,
+                                        __ATOMIC_RELEASE, __ATOMIC_RELAXED))
+        ;
+
+    return stats;
+}
+
+
+void
+shmem_internal_pcntr_record(shmem_ctx_t ctx, int op_class, size_t len, int pe,
+                            int detail, uint64_t start)
+{
+    struct shmem_internal_pcntr_ctx_t *stats;
+    shmemx_pcntr_hist_t *h;
+    uint64_t end = shmem_internal_pcntr_now();
+    uint64_t elapsed = end - start;
+
+    if (ctx == SHMEM_CTX_INVALID) return;
+
+    stats = shmem_internal_pcntr_ctx_stats(ctx);
+
+    if (shmem_internal_trace_enabled)
+        shmem_internal_trace_event(stats->id, op_class, len, pe, detail, start, end);
+
+    if (!shmem_internal_pcntr_profile) return;
+
+    h = &stats->hist[op_class];
+
+    __atomic_fetch_add(&h->count, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&h->bytes, len, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&h->time_ns, elapsed, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&h->size_hist[shmem_internal_pcntr_bin(len)], 1,
+                       __ATOMIC_RELAXED);
+    __atomic_fetch_add(&h->latency_hist[shmem_internal_pcntr_bin(elapsed)], 1,
+                       __ATOMIC_RELAXED);
+
+    if (pe < 0 || pe >= shmem_internal_num_pes) return;
+
+    if (op_class == SHMEMX_PCNTR_GET)
+        __atomic_fetch_add(&shmem_internal_pcntr_get_bytes[pe], len, __ATOMIC_RELAXED);
+    else if (op_class == SHMEMX_PCNTR_PUT || op_class == SHMEMX_PCNTR_AMO)
+        __atomic_fetch_add(&shmem_internal_pcntr_put_bytes[pe], len, __ATOMIC_RELAXED);
+}
+
+
+int
+shmem_internal_pcntr_get_pe_bytes(int pe, uint64_t *put_bytes, uint64_t *get_bytes)
+{
+    if (!shmem_internal_pcntr_profile || pe < 0 || pe >= shmem_internal_num_pes)
+        return -1;
+
+    *put_bytes = __atomic_load_n(&shmem_internal_pcntr_put_bytes[pe], __ATOMIC_RELAXED);
+    *get_bytes = __atomic_load_n(&shmem_internal_pcntr_get_bytes[pe], __ATOMIC_RELAXED);
+
+    return 0;
+}
@@ -0,0 +1,107 @@
+/* -*- C -*-
+ *
+ * Copyright (c) 2022 Intel Corporation. All rights reserved.
+ * This software is available to you under the BSD license.
+ *
+ * This file is part of the Sandia OpenSHMEM software package. For license
+ * information, see the LICENSE file in the top level directory of the
+ * distribution.
+ *
+ */
+
+#ifndef SHMEM_PCNTR_H
+#define SHMEM_PCNTR_H
+
+#include <stdint.h>
+
+#include "shmem_internal.h"
+#include "transport.h"
+#include "shmem_trace.h"
+
+/* Opt-in instrumentation (SHMEM_PCNTR_PROFILE and SHMEM_TRACE).  Each
+ * communication entry point brackets its work with enter/leave.  When
+ * instrumentation is disabled, enter is a single predicted branch on a global
+ * flag.  When enabled, the outermost instrumented call on a thread is timed
+ * and recorded against its context; calls it makes internally (e.g. the puts
+ * of a collective) are not recorded separately. */
+
+struct shmem_internal_pcntr_ctx_t {
+    shmemx_pcntr_hist_t hist[SHMEMX_PCNTR_NUM_CLASSES];
+    int id;
+    struct shmem_internal_pcntr_ctx_t *next;
+};
+
+/* Enabled is set when any instrumentation is active, profile when histograms
+ * are collected */
+extern int shmem_internal_pcntr_enabled;
+extern int shmem_internal_pcntr_profile;
+extern __thread int shmem_internal_pcntr_active;
+
+int shmem_internal_pcntr_init(void);
+void shmem_internal_pcntr_fini(void);
+
+void shmem_internal_pcntr_record(shmem_ctx_t ctx, int op_class, size_t len,
+                                 int pe, int detail, uint64_t start);
+struct shmem_internal_pcntr_ctx_t *
+shmem_internal_pcntr_ctx_stats(shmem_ctx_t ctx);
+int shmem_internal_pcntr_get_pe_bytes(int pe, uint64_t *put_bytes,
+                                      uint64_t *get_bytes);
+
+
+static inline uint64_t
+shmem_internal_pcntr_now(void)
+{
+#ifdef HAVE_CLOCK_GETTIME
+    struct timespec tv;
+    clock_gettime(CLOCK_MONOTONIC, &tv);
+    return (uint64_t) tv.tv_sec * 1000000000ULL + (uint64_t) tv.tv_nsec;
+#else
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return (uint64_t) tv.tv_sec * 1000000000ULL + (uint64_t) tv.tv_usec * 1000;
+#endif
+}
+
+
+/* Returns a nonzero start time when the caller is the outermost instrumented
+ * call on this thread, and zero otherwise */
+static inline uint64_t
+shmem_internal_pcntr_enter(void)
+{
+    if (__builtin_expect(!shmem_internal_pcntr_enabled, 1))
+        return 0;
+
+    if (shmem_internal_pcntr_active)
+        return 0;
+
+    shmem_internal_pcntr_active = 1;
+    return shmem_internal_pcntr_now();
+}
+
+
+static inline void
+shmem_internal_pcntr_leave(shmem_ctx_t ctx, int op_class, size_t len, int pe,
+                           uint64_t start)
+{
+    if (__builtin_expect(start == 0, 1))
+        return;
+
+    shmem_internal_pcntr_record(ctx, op_class, len, pe, 0, start);
+    shmem_internal_pcntr_active = 0;
+}
+
+
+/* Collectives are recorded on the default context, along with the operation
+ * and the algorithm that was selected for it */
+static inline void
+shmem_internal_pcntr_leave_coll(int coll_op, int alg, size_t len, uint64_t start)
+{
+    if (__builtin_expect(start == 0, 1))
+        return;
+
+    shmem_internal_pcntr_record(SHMEM_CTX_DEFAULT, SHMEMX_PCNTR_COLL, len, -1,
+                                SHMEM_TRACE_DETAIL(coll_op, alg), start);
+    shmem_internal_pcntr_active = 0;
+}
+
+#endif
@@ -20,6 +20,9 @@
 #include "shmem_comm.h"
 #include "transport.h"
 
+extern int shmem_internal_nbc_num_active;
+void shmem_internal_nbc_progress(void);
+
 static inline void
 shmem_internal_quiet(shmem_ctx_t ctx)
 {
@@ -28,6 +31,27 @@ shmem_internal_quiet(shmem_ctx_t ctx)
     if (ctx == SHMEM_CTX_INVALID)
         return;
 
+    uint64_t pcntr = shmem_internal_pcntr_enter();
+
+    /* Advance outstanding non-blocking collectives */
+    if (shmem_internal_nbc_num_active)
+        shmem_internal_nbc_progress();
+
+#ifndef USE_PORTALS4
+    /* Counted puts are issued on the default context */
+    if (ctx == SHMEM_CTX_DEFAULT)
+        shmem_internal_ct_flush();
+#endif
+
+#ifdef USE_SHR_COPY
+    shmem_shr_copy_quiet(ctx);
+#endif
+
+    /* Cleared first, so that a put issued concurrently keeps it set */
+#ifdef SHMEM_SHR_ROUTE_HAVE_NIC
+    __atomic_store_n(&((shmem_transport_ctx_t *)ctx)->shr_nic_pending, 0, __ATOMIC_RELAXED);
+#endif
+
     ret = shmem_transport_quiet((shmem_transport_ctx_t *)ctx);
     if (0 != ret) { RAISE_ERROR(ret); }
 
@@ -38,6 +62,8 @@ shmem_internal_quiet(shmem_ctx_t ctx)
      * performed via the shmem_ptr API, the result of atomics 
      * that targeted the local process) visible */
     shmem_transport_syncmem();
+
+    shmem_internal_pcntr_leave(ctx, SHMEMX_PCNTR_QUIET, 0, -1, pcntr);
 }
 
 
@@ -49,15 +75,96 @@ shmem_internal_fence(shmem_ctx_t ctx)
     if (ctx == SHMEM_CTX_INVALID)
         return;
 
-    ret = shmem_transport_fence((shmem_transport_ctx_t *)ctx);
+    uint64_t pcntr = shmem_internal_pcntr_enter();
+
+    /* Offloaded on-node puts are not ordered with later operations */
+#ifdef USE_SHR_COPY
+    shmem_shr_copy_quiet(ctx);
+#endif
+
+    /* The network transport cannot order its puts and atomics to on-node PEs
+     * with the shared memory operations that follow, so complete them */
+#ifdef SHMEM_SHR_ROUTE_HAVE_NIC
+    if (__atomic_exchange_n(&((shmem_transport_ctx_t *)ctx)->shr_nic_pending, 0,
+                            __ATOMIC_RELAXED))
+        ret = shmem_transport_quiet((shmem_transport_ctx_t *)ctx);
+    else
+#endif
+        ret = shmem_transport_fence((shmem_transport_ctx_t *)ctx);
     if (0 != ret) { RAISE_ERROR(ret); }
 
     shmem_internal_membar_release();
 
+    shmem_internal_pcntr_leave(ctx, SHMEMX_PCNTR_QUIET, 0, -1, pcntr);
+
     /* Since fence does not guarantee any memory visibility, 
      * transport level memory flush is not required here. */
 }
 
+
+/* Complete the operations issued on ctx to the given PE.  Transports that
+ * cannot track completion per target complete all operations of ctx. */
+static inline void
+shmem_internal_quiet_pe(shmem_ctx_t ctx, int pe)
+{
+    int ret;
+
+    if (ctx == SHMEM_CTX_INVALID)
+        return;
+
+    uint64_t pcntr = shmem_internal_pcntr_enter();
+
+    if (shmem_internal_nbc_num_active)
+        shmem_internal_nbc_progress();
+
+#ifndef USE_PORTALS4
+    if (ctx == SHMEM_CTX_DEFAULT)
+        shmem_internal_ct_flush();
+#endif
+
+#ifdef USE_SHR_COPY
+    shmem_shr_copy_quiet(ctx);
+#endif
+
+    ret = shmem_transport_quiet_pe((shmem_transport_ctx_t *)ctx, pe);
+    if (0 != ret) { RAISE_ERROR(ret); }
+
+    shmem_internal_membar();
+
+    shmem_transport_syncmem();
+
+    shmem_internal_pcntr_leave(ctx, SHMEMX_PCNTR_QUIET, 0, pe, pcntr);
+}
+
+
+static inline void
+shmem_internal_fence_pe(shmem_ctx_t ctx, int pe)
+{
+    int ret;
+
+    if (ctx == SHMEM_CTX_INVALID)
+        return;
+
+    uint64_t pcntr = shmem_internal_pcntr_enter();
+
+#ifdef USE_SHR_COPY
+    shmem_shr_copy_quiet(ctx);
+#endif
+
+#ifdef SHMEM_SHR_ROUTE_HAVE_NIC
+    if (shmem_internal_get_shr_rank(pe) != -1 &&
+        __atomic_load_n(&((shmem_transport_ctx_t *)ctx)->shr_nic_pending, __ATOMIC_RELAXED))
+        ret = shmem_transport_quiet_pe((shmem_transport_ctx_t *)ctx, pe);
+    else
+#endif
+        ret = shmem_transport_fence_pe((shmem_transport_ctx_t *)ctx, pe);
+    if (0 != ret) { RAISE_ERROR(ret); }
+
+    shmem_internal_membar_release();
+
+    shmem_internal_pcntr_leave(ctx, SHMEMX_PCNTR_QUIET, 0, pe, pcntr);
+}
+
 #define COMP(type, a, b, ret)                            \
     do {                                                 \
         ret = 0;                                         \
@@ -99,10 +206,28 @@ shmem_internal_fence(shmem_ctx_t ctx)
 
 #define SHMEM_TEST(type, a, b, ret) COMP(type, SYNC_LOAD(a), b, ret)
 
+/* Progress made by polling waits.  Outstanding non-blocking collectives are
+ * advanced as well, since a peer may be waiting on one of their steps while
+ * this PE waits on the peer.  For the same reason, the counts of emulated
+ * counted puts are published. */
+#ifdef USE_PORTALS4
+#define SHMEM_WAIT_PROBE_CT() do { } while (0)
+#else
+#define SHMEM_WAIT_PROBE_CT() shmem_internal_ct_flush()
+#endif
+
+#define SHMEM_WAIT_PROBE()                               \
+    do {                                                 \
+        shmem_transport_probe();                         \
+        SHMEM_WAIT_PROBE_CT();                                          \
+        if (shmem_internal_nbc_num_active)               \
+            shmem_internal_nbc_progress();               \
+    } while (0)
+
 #define SHMEM_WAIT_POLL(var, value)                      \
     do {                                                 \
         while (SYNC_LOAD(var) == value) {                \
-            shmem_transport_probe();                     \
+            SHMEM_WAIT_PROBE();                          \
             SPINLOCK_BODY(); }                           \
     } while(0)
 
@@ -112,7 +237,7 @@ shmem_internal_fence(shmem_ctx_t ctx)
                                                          \
         COMP(cond, SYNC_LOAD(var), value, cmpret);       \
         while (!cmpret) {                                \
-            shmem_transport_probe();                     \
+            SHMEM_WAIT_PROBE();                          \
             SPINLOCK_BODY();                             \
             COMP(cond, SYNC_LOAD(var), value, cmpret);   \
         }                                                \
@@ -124,7 +249,7 @@ shmem_internal_fence(shmem_ctx_t ctx)
                                                                         \
         COMP_SIGNAL(cond, SYNC_LOAD(var), value, cmpret, sat_value);    \
         while (!cmpret) {                                               \
-            shmem_transport_probe();                                    \
+            SHMEM_WAIT_PROBE();                                         \
             SPINLOCK_BODY();                                            \
             COMP_SIGNAL(cond, SYNC_LOAD(var), value, cmpret, sat_value);\
         }                                                               \
@@ -174,46 +299,131 @@ shmem_internal_fence(shmem_ctx_t ctx)
         }                                                               \
     } while(0)
 
+#ifdef USE_SHR_DOORBELL
+/* Spin for up to WAIT_SPIN_COUNT polls, then sleep on this PE's doorbell until
+ * an on-node peer updates our memory.  Sleeps are bounded by
+ * WAIT_SLEEP_TIMEOUT so that network updates are still observed. */
+#define SHMEM_WAIT_UNTIL_SLEEP(var, cond, value)                        \
+    do {                                                                \
+        long spins = 0;                                                 \
+        uint32_t seq;                                                   \
+        int cmpret;                                                     \
+                                                                        \
+        COMP(cond, SYNC_LOAD(var), value, cmpret);                      \
+        while (!cmpret) {                                               \
+            SHMEM_WAIT_PROBE();                                         \
+            if (spins++ < shmem_internal_params.WAIT_SPIN_COUNT ||      \
+                shmem_internal_nbc_num_active) {                        \
+                SPINLOCK_BODY();                                        \
+            } else {                                                    \
+                seq = shmem_shr_doorbell_arm();                         \
+                COMP(cond, SYNC_LOAD(var), value, cmpret);              \
+                if (!cmpret) shmem_shr_doorbell_sleep(seq);             \
+                shmem_shr_doorbell_disarm();                            \
+            }                                                           \
+            COMP(cond, SYNC_LOAD(var), value, cmpret);                  \
+        }                                                               \
+    } while(0)
+
+#define SHMEM_SIGNAL_WAIT_UNTIL_SLEEP(var, cond, value, sat_value)      \
+    do {                                                                \
+        long spins = 0;                                                 \
+        uint32_t seq;                                                   \
+        int cmpret;                                                     \
+                                                                        \
+        COMP_SIGNAL(cond, SYNC_LOAD(var), value, cmpret, sat_value);    \
+        while (!cmpret) {                                               \
+            SHMEM_WAIT_PROBE();                                         \
+            if (spins++ < shmem_internal_params.WAIT_SPIN_COUNT ||      \
+                shmem_internal_nbc_num_active) {                        \
+                SPINLOCK_BODY();                                        \
+            } else {                                                    \
+                seq = shmem_shr_doorbell_arm();                         \
+                COMP_SIGNAL(cond, SYNC_LOAD(var), value, cmpret, sat_value);\
+                if (!cmpret) shmem_shr_doorbell_sleep(seq);             \
+                shmem_shr_doorbell_disarm();                            \
+            }                                                           \
+            COMP_SIGNAL(cond, SYNC_LOAD(var), value, cmpret, sat_value);\
+        }                                                               \
+    } while(0)
+#endif
+
+#if defined(USE_SHR_DOORBELL)
+#define SHMEM_INTERNAL_WAIT_UNTIL(var, cond, value)                     \
+    do {                                                                \
+        if (shmem_internal_params.WAIT_SLEEP) {                         \
+            SHMEM_WAIT_UNTIL_SLEEP(var, cond, value);                   \
+        } else {                                                        \
+            SHMEM_WAIT_UNTIL_POLL(var, cond, value);                    \
+        }                                                               \
+    } while (0)
+#define SHMEM_INTERNAL_SIGNAL_WAIT_UNTIL(var, cond, value, sat_value)   \
+    do {                                                                \
+        if (shmem_internal_params.WAIT_SLEEP) {                         \
+            SHMEM_SIGNAL_WAIT_UNTIL_SLEEP(var, cond, value, sat_value); \
+        } else {                                                        \
+            SHMEM_SIGNAL_WAIT_UNTIL_POLL(var, cond, value, sat_value);  \
+        }                                                               \
+    } while (0)
 /* Polling based wait is required for providers that need 
  * manual progress, i.e., cxi. This is enabled through 
  * ENABLE_FI_MANUAL_PROGRESS */
-#if defined(ENABLE_HARD_POLLING) || defined(ENABLE_FI_MANUAL_PROGRESS)
+#elif defined(ENABLE_HARD_POLLING) || defined(ENABLE_FI_MANUAL_PROGRESS)
 #define SHMEM_INTERNAL_WAIT_UNTIL(var, cond, value)                     \
     SHMEM_WAIT_UNTIL_POLL(var, cond, value)
 #define SHMEM_INTERNAL_SIGNAL_WAIT_UNTIL(var, cond, value, sat_value)   \
     SHMEM_SIGNAL_WAIT_UNTIL_POLL(var, cond, value, sat_value)
 #else
+/* Blocking waits cannot advance non-blocking collectives, so poll while any
+ * are outstanding.  Counted-put counts are published before blocking. */
 #define SHMEM_INTERNAL_WAIT_UNTIL(var, cond, value)                     \
-    if (shmem_internal_thread_level == SHMEM_THREAD_SINGLE) {           \
-        SHMEM_WAIT_UNTIL_BLOCK(var, cond, value);                       \
-    } else {                                                            \
-        SHMEM_WAIT_UNTIL_POLL(var, cond, value);                        \
-    }
+    do {                                                                \
+        if (shmem_internal_thread_level == SHMEM_THREAD_SINGLE &&       \
+            !shmem_internal_nbc_num_active) {                           \
+            SHMEM_WAIT_PROBE_CT();                                      \
+            SHMEM_WAIT_UNTIL_BLOCK(var, cond, value);                   \
+        } else {                                                        \
+            SHMEM_WAIT_UNTIL_POLL(var, cond, value);                    \
+        }                                                               \
+    } while (0)
 #define SHMEM_INTERNAL_SIGNAL_WAIT_UNTIL(var, cond, value, sat_value)   \
-    if (shmem_internal_thread_level == SHMEM_THREAD_SINGLE) {           \
-        SHMEM_SIGNAL_WAIT_UNTIL_BLOCK(var, cond, value, sat_value);     \
-    } else {                                                            \
-        SHMEM_SIGNAL_WAIT_UNTIL_POLL(var, cond, value, sat_value);      \
-    }
+    do {                                                                \
+        if (shmem_internal_thread_level == SHMEM_THREAD_SINGLE &&       \
+            !shmem_internal_nbc_num_active) {                           \
+            SHMEM_WAIT_PROBE_CT();                                      \
+            SHMEM_SIGNAL_WAIT_UNTIL_BLOCK(var, cond, value, sat_value); \
+        } else {                                                        \
+            SHMEM_SIGNAL_WAIT_UNTIL_POLL(var, cond, value, sat_value);  \
+        }                                                               \
+    } while (0)
 #endif
 
 #define SHMEM_WAIT(var, value) do {                                     \
+        uint64_t pcntr_ = shmem_internal_pcntr_enter();                 \
         SHMEM_INTERNAL_WAIT_UNTIL(var, SHMEM_CMP_NE, value);            \
         shmem_internal_membar_acq_rel();                                \
         shmem_transport_syncmem();                                      \
+        shmem_internal_pcntr_leave(SHMEM_CTX_DEFAULT,                   \
+                                   SHMEMX_PCNTR_WAIT, 0, -1, pcntr_);   \
     } while (0)
 
 #define SHMEM_WAIT_UNTIL(var, cond, value) do {                         \
+        uint64_t pcntr_ = shmem_internal_pcntr_enter();                 \
         SHMEM_INTERNAL_WAIT_UNTIL(var, cond, value);                    \
         shmem_internal_membar_acq_rel();                                \
         shmem_transport_syncmem();                                      \
+        shmem_internal_pcntr_leave(SHMEM_CTX_DEFAULT,                   \
+                                   SHMEMX_PCNTR_WAIT, 0, -1, pcntr_);   \
     } while (0)
 
 #define SHMEM_SIGNAL_WAIT_UNTIL(var, cond, value, sat_value)            \
     do {                                                                \
+        uint64_t pcntr_ = shmem_internal_pcntr_enter();                 \
         SHMEM_INTERNAL_SIGNAL_WAIT_UNTIL(var, cond, value, sat_value);  \
         shmem_internal_membar_acq_rel();                                \
         shmem_transport_syncmem();                                      \
+        shmem_internal_pcntr_leave(SHMEM_CTX_DEFAULT,                   \
+                                   SHMEMX_PCNTR_WAIT, 0, -1, pcntr_);   \
     } while (0)
 
 #endif
@@ -26,6 +26,9 @@
 #define N_PSYNC_BYTES             8
 #define PSYNC_CHUNK_SIZE          (N_PSYNCS_PER_TEAM * SHMEM_SYNC_SIZE)
 
+/* Marks a context pool slot that is being filled, while its owner is stored */
+#define CTX_POOL_CLAIMED          ((shmem_transport_ctx_t *) 1)
+
 
 shmem_internal_team_t shmem_internal_team_world;
 shmem_team_t SHMEM_TEAM_WORLD = (shmem_team_t) &shmem_internal_team_world;
@@ -39,6 +42,7 @@ shmem_team_t SHMEMX_TEAM_NODE = (shmem_team_t) &shmem_internal_team_node;
 shmem_internal_team_t **shmem_internal_team_pool;
 long *shmem_internal_psync_pool;
 long *shmem_internal_psync_barrier_pool;
+long *shmem_internal_nbc_psync_pool;
 static unsigned char *psync_pool_avail;
 static unsigned char *psync_pool_avail_reduced;
 
@@ -107,40 +111,6 @@ int shmem_internal_team_init(void)
         shmem_internal_team_node.psync_avail[i] = 1;
     SHMEMX_TEAM_NODE = (shmem_team_t) &shmem_internal_team_node;
 
-    if (shmem_internal_params.TEAM_SHARED_ONLY_SELF) {
-        shmem_internal_team_shared.start         = shmem_internal_my_pe;
-        shmem_internal_team_shared.stride        = 1;
-        shmem_internal_team_shared.size          = 1;
-    } else { /* Search for shared-memory peer PEs while checking for a consistent stride */
-        int start = -1, stride = -1, size = 0;
-
-        for (int pe = 0; pe < shmem_internal_num_pes; pe++) {
-            void *ret_ptr = shmem_internal_ptr(shmem_internal_heap_base, pe);
-            if (ret_ptr == NULL) continue;
-
-            int ret = check_for_linear_stride(pe, &start, &stride, &size);
-            if (ret < 0) {
-                start = shmem_internal_my_pe;
-                stride = 1;
-                size = 1;
-                break;
-            }
-        }
-        shmem_internal_assertp(size > 0 && size <= shmem_runtime_get_node_size());
-
-        shmem_internal_team_shared.start = start;
-        shmem_internal_team_shared.stride = (stride == -1) ? 1 : stride;
-        shmem_internal_team_shared.size = size;
-        shmem_internal_team_shared.my_pe =
-              shmem_internal_team_translate_pe(&shmem_internal_team_world, shmem_internal_my_pe,
-                                               &shmem_internal_team_shared);
-        shmem_internal_assertp(shmem_internal_team_shared.my_pe >= 0);
-
-        DEBUG_MSG("SHMEM_TEAM_SHARED: start=%d, stride=%d, size=%d\n",
-                  shmem_internal_team_shared.start, shmem_internal_team_shared.stride,
-                  shmem_internal_team_shared.size);
-    }
-
     /* Search for on-node peer PEs while checking for a consistent stride */
     int start = -1, stride = -1, size = 0;
     for (int pe = 0; pe < shmem_internal_num_pes; pe++) {
@@ -168,6 +138,29 @@ int shmem_internal_team_init(void)
               shmem_internal_team_node.start, shmem_internal_team_node.stride,
               shmem_internal_team_node.size);
 
+    /* When the on-node transport maps the heaps of all on-node peers,
+     * shmem_ptr succeeds for exactly the members of SHMEMX_TEAM_NODE.
+     * Otherwise, it only succeeds for the calling PE. */
+#if defined(USE_ON_NODE_COMMS) && (defined(USE_XPMEM) || defined(USE_MEMFD))
+    if (!shmem_internal_params.TEAM_SHARED_ONLY_SELF) {
+        shmem_internal_team_shared.start  = shmem_internal_team_node.start;
+        shmem_internal_team_shared.stride = shmem_internal_team_node.stride;
+        shmem_internal_team_shared.size   = shmem_internal_team_node.size;
+        shmem_internal_team_shared.my_pe  = shmem_internal_team_node.my_pe;
+    } else
+#endif
+    {
+        shmem_internal_team_shared.start  = shmem_internal_my_pe;
+        shmem_internal_team_shared.stride = 1;
+        shmem_internal_team_shared.size   = 1;
+        shmem_internal_team_shared.my_pe  = 0;
+    }
+    shmem_internal_assertp(shmem_internal_team_shared.my_pe >= 0);
+
+    DEBUG_MSG("SHMEM_TEAM_SHARED: start=%d, stride=%d, size=%d\n",
+              shmem_internal_team_shared.start, shmem_internal_team_shared.stride,
+              shmem_internal_team_shared.size);
+
     if (shmem_internal_params.TEAMS_MAX > N_PSYNC_BYTES * CHAR_BIT) {
         RETURN_ERROR_MSG("Requested %ld teams, but only %d are supported\n",
                          shmem_internal_params.TEAMS_MAX, N_PSYNC_BYTES * CHAR_BIT);
@@ -207,6 +200,17 @@ int shmem_internal_team_init(void)
     shmem_internal_psync_barrier_pool = &shmem_internal_psync_pool[PSYNC_CHUNK_SIZE *
                                                          shmem_internal_params.TEAMS_MAX];
 
+    /* Allocate the pSyncs used by non-blocking collectives, one group of
+     * N_NBC_PSYNCS_PER_TEAM per team */
+    long nbc_psync_len = shmem_internal_params.TEAMS_MAX * N_NBC_PSYNCS_PER_TEAM *
+                         NBC_PSYNC_SIZE;
+    shmem_internal_nbc_psync_pool = shmem_internal_shmalloc(sizeof(long) * nbc_psync_len);
+    if (NULL == shmem_internal_nbc_psync_pool) goto cleanup;
+
+    for (long i = 0; i < nbc_psync_len; i++) {
+        shmem_internal_nbc_psync_pool[i] = SHMEM_SYNC_VALUE;
+    }
+
     psync_pool_avail = shmem_internal_shmalloc(2 * N_PSYNC_BYTES);
     if (NULL == psync_pool_avail) goto cleanup;
     psync_pool_avail_reduced = &psync_pool_avail[N_PSYNC_BYTES];
@@ -238,6 +242,10 @@ cleanup:
         shmem_internal_free(shmem_internal_psync_pool);
         shmem_internal_psync_pool = NULL;
     }
+    if (shmem_internal_nbc_psync_pool) {
+        shmem_internal_free(shmem_internal_nbc_psync_pool);
+        shmem_internal_nbc_psync_pool = NULL;
+    }
     if (psync_pool_avail) {
         shmem_internal_free(psync_pool_avail);
         psync_pool_avail = NULL;
@@ -260,6 +268,7 @@ void shmem_internal_team_fini(void)
 
     free(shmem_internal_team_pool);
     shmem_internal_free(shmem_internal_psync_pool);
+    shmem_internal_free(shmem_internal_nbc_psync_pool);
     shmem_internal_free(psync_pool_avail);
     shmem_internal_free(team_ret_val);
 
@@ -510,6 +519,17 @@ int shmem_internal_team_destroy(shmem_internal_team_t *team)
         shmem_internal_bit_set(psync_pool_avail, N_PSYNC_BYTES, team->psync_idx);
     }
 
+    /* Complete any non-blocking collectives still using the team's pSyncs */
+    shmem_internal_nbc_team_drain(team);
+
+    /* Destroy the contexts kept for reuse, which were already quiesced */
+    for (size_t i = 0; i < N_CTX_POOL_SLOTS; i++) {
+        shmem_transport_ctx_t *ctx = __atomic_exchange_n(&team->ctx_pool[i], NULL,
+                                                         __ATOMIC_ACQUIRE);
+        if (ctx != NULL && ctx != CTX_POOL_CLAIMED)
+            shmem_transport_ctx_destroy(ctx);
+    }
+
     /* Destroy all undestroyed shareable contexts on this team */
     for (size_t i = 0; i < team->contexts_len; i++) {
         if (team->contexts[i] != NULL) {
@@ -521,6 +541,10 @@ int shmem_internal_team_destroy(shmem_internal_team_t *team)
     }
     shmem_internal_team_pool[team->psync_idx] = NULL;
     free(team->contexts);
+    free(team->sync_req);
+    team->sync_req = NULL;
+    free(team->heap_bases);
+    team->heap_bases = NULL;
 
     if (team != &shmem_internal_team_world && team != &shmem_internal_team_shared &&
         team != &shmem_internal_team_node) {
@@ -530,6 +554,89 @@ int shmem_internal_team_destroy(shmem_internal_team_t *team)
     return 0;
 }
 
+/* Identifies the calling thread to the context pool.  Private contexts may
+ * only be reused by the thread that created them, since the transport may
+ * have bound them to resources private to that thread. */
+static inline
+uint64_t ctx_pool_thread_id(void)
+{
+    static __thread uint64_t thread_id = 0;
+    static uint64_t next_thread_id = 0;
+
+    if (thread_id == 0)
+        thread_id = __atomic_add_fetch(&next_thread_id, 1, __ATOMIC_RELAXED);
+
+    return thread_id;
+}
+
+/* Returns a previously destroyed context on the team that was created with the
+ * same options, or NULL if there is none.  Slots are claimed with an atomic
+ * compare-and-swap, so pool operations do not take a lock. */
+shmem_transport_ctx_t *shmem_internal_ctx_pool_get(shmem_internal_team_t *team, long options)
+{
+    long pool_size = shmem_internal_params.CTX_POOL_SIZE;
+    uint64_t tid = 0;
+
+    if (pool_size <= 0) return NULL;
+    if (pool_size > N_CTX_POOL_SLOTS) pool_size = N_CTX_POOL_SLOTS;
+
+    if (options & SHMEM_CTX_PRIVATE)
+        tid = ctx_pool_thread_id();
+
+    for (long i = 0; i < pool_size; i++) {
+        shmem_transport_ctx_t *ctx = __atomic_load_n(&team->ctx_pool[i], __ATOMIC_ACQUIRE);
+
+        if (ctx == NULL || ctx == CTX_POOL_CLAIMED || ctx->options != options) continue;
+        if ((options & SHMEM_CTX_PRIVATE) &&
+            __atomic_load_n(&team->ctx_pool_owner[i], __ATOMIC_RELAXED) != tid)
+            continue;
+
+        if (__atomic_compare_exchange_n(&team->ctx_pool[i], &ctx, NULL, 0,
+                                        __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+            /* Let the transport rebalance the idle context's resources */
+            if (shmem_transport_ctx_reuse(ctx)) {
+                shmem_transport_ctx_destroy(ctx);
+                return NULL;
+            }
+            return ctx;
+        }
+    }
+
+    return NULL;
+}
+
+/* Keeps a quiesced context for reuse by its team.  Returns 1 if the context
+ * was pooled, or 0 if the pool is full and the context must be destroyed. */
+int shmem_internal_ctx_pool_put(shmem_transport_ctx_t *ctx)
+{
+    shmem_internal_team_t *team = ctx->team;
+    long pool_size = shmem_internal_params.CTX_POOL_SIZE;
+    uint64_t tid = 0;
+
+    if (pool_size <= 0 || team == NULL) return 0;
+    if (pool_size > N_CTX_POOL_SLOTS) pool_size = N_CTX_POOL_SLOTS;
+
+    if (ctx->options & SHMEM_CTX_PRIVATE)
+        tid = ctx_pool_thread_id();
+
+    for (long i = 0; i < pool_size; i++) {
+        shmem_transport_ctx_t *empty = NULL;
+
+        if (__atomic_load_n(&team->ctx_pool[i], __ATOMIC_RELAXED) != NULL) continue;
+
+        /* Claim the slot before writing its owner, then publish the context
+         * so that a thread that sees it also sees the owner */
+        if (__atomic_compare_exchange_n(&team->ctx_pool[i], &empty, CTX_POOL_CLAIMED,
+                                        0, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+            __atomic_store_n(&team->ctx_pool_owner[i], tid, __ATOMIC_RELAXED);
+            __atomic_store_n(&team->ctx_pool[i], ctx, __ATOMIC_RELEASE);
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
 /* Returns a psync from the given team that can be safely used for the
  * specified collective operation. */
 long * shmem_internal_team_choose_psync(shmem_internal_team_t *team, shmem_internal_team_op_t op)
@@ -578,3 +685,32 @@ void shmem_internal_team_release_psyncs(shmem_internal_team_t *team, shmem_inter
 
     return;
 }
+
+
+/* Returns the address of the symmetric heap of each member of the team, or
+ * NULL for members whose heap cannot be accessed with loads and stores.  The
+ * table is built on first use, so that teams that are never passed to
+ * shmem_team_ptr do not pay for it; a thread that loses the race to publish
+ * its table frees it. */
+char **shmem_internal_team_heap_bases(shmem_internal_team_t *team)
+{
+    char **bases = __atomic_load_n(&team->heap_bases, __ATOMIC_ACQUIRE);
+    char **expected = NULL;
+
+    if (NULL != bases) return bases;
+
+    bases = malloc(team->size * sizeof(char *));
+    if (NULL == bases) return NULL;
+
+    for (int i = 0; i < team->size; i++)
+        bases[i] = shmem_internal_ptr(shmem_internal_heap_base,
+                                      shmem_internal_team_pe(team, i));
+
+    if (!__atomic_compare_exchange_n(&team->heap_bases, &expected, bases, 0,
+                                     __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+        free(bases);
+        bases = expected;
+    }
+
+    return bases;
+}
@@ -17,6 +17,14 @@
 
 #define N_PSYNCS_PER_TEAM   2
 
+/* Number of non-blocking collectives that may be in flight on a team, and the
+ * size (in longs) of the pSync used by each of them */
+#define N_NBC_PSYNCS_PER_TEAM   4
+#define NBC_PSYNC_SIZE          (SHMEM_BARRIER_SYNC_SIZE + 1)
+
+/* Maximum number of destroyed contexts kept for reuse by a team */
+#define N_CTX_POOL_SLOTS        32
+
 struct shmem_internal_team_t {
     int                            my_pe;
     int                            start, stride, size;
@@ -26,6 +34,12 @@ struct shmem_internal_team_t {
     long                           config_mask;
     size_t                         contexts_len;
     struct shmem_transport_ctx_t **contexts;
+    struct shmem_internal_sync_req_t *sync_req;
+    unsigned long                  nbc_seq;
+    int                            nbc_pending[N_NBC_PSYNCS_PER_TEAM];
+    struct shmem_transport_ctx_t  *ctx_pool[N_CTX_POOL_SLOTS];
+    uint64_t                       ctx_pool_owner[N_CTX_POOL_SLOTS];
+    char                         **heap_bases;
 };
 typedef struct shmem_internal_team_t shmem_internal_team_t;
 
@@ -33,6 +47,8 @@ extern shmem_internal_team_t shmem_internal_team_world;
 extern shmem_internal_team_t shmem_internal_team_shared;
 extern shmem_internal_team_t shmem_internal_team_node;
 
+extern long *shmem_internal_nbc_psync_pool;
+
 enum shmem_internal_team_op_t {
     SYNC = 0,
     BCAST,
@@ -70,10 +86,16 @@ int shmem_internal_team_create_ctx(shmem_internal_team_t *team, long options, sh
 
 int shmem_internal_ctx_get_team(shmem_ctx_t ctx, shmem_internal_team_t **team);
 
+struct shmem_transport_ctx_t *shmem_internal_ctx_pool_get(shmem_internal_team_t *team, long options);
+
+int shmem_internal_ctx_pool_put(struct shmem_transport_ctx_t *ctx);
+
 long * shmem_internal_team_choose_psync(shmem_internal_team_t *team, shmem_internal_team_op_t op);
 
 void shmem_internal_team_release_psyncs(shmem_internal_team_t *team, shmem_internal_team_op_t op);
 
+char **shmem_internal_team_heap_bases(shmem_internal_team_t *team);
+
 static inline
 int shmem_internal_team_pe(shmem_internal_team_t *team, int pe)
 {
@@ -0,0 +1,258 @@
+/* -*- C -*-
+ *
+ * Copyright (c) 2022 Intel Corporation. All rights reserved.
+ * This software is available to you under the BSD license.
+ *
+ * This file is part of the Sandia OpenSHMEM software package. For license
+ * information, see the LICENSE file in the top level directory of the
+ * distribution.
+ *
+ */
+
+#include "config.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <inttypes.h>
+#include <signal.h>
+#include <unistd.h>
+
+#define SHMEM_INTERNAL_INCLUDE
+#include "shmem.h"
+#include "shmem_internal.h"
+#include "shmem_pcntr.h"
+#include "shmem_trace.h"
+
+struct shmem_internal_trace_buf_t {
+    uint64_t head;
+    uint32_t tid;
+    struct shmem_internal_trace_buf_t *next;
+    shmem_trace_event_t events[];
+};
+
+typedef struct shmem_internal_trace_buf_t shmem_internal_trace_buf_t;
+
+int shmem_internal_trace_enabled = 0;
+
+static __thread shmem_internal_trace_buf_t *shmem_internal_trace_buf = NULL;
+static shmem_internal_trace_buf_t *shmem_internal_trace_buf_list = NULL;
+static uint32_t shmem_internal_trace_nthreads = 0;
+static uint64_t shmem_internal_trace_nevents = 0;
+static uint64_t shmem_internal_trace_t0 = 0;
+
+/* The file name is formatted at init so that the signal handler only needs
+ * async-signal-safe calls */
+static char shmem_internal_trace_path[PATH_MAX];
+
+/* Longest trace path printed in diagnostics, which are formatted into a
+ * SHMEM_INTERNAL_DIAG_STRLEN buffer */
+#define SHMEM_INTERNAL_TRACE_PATH_DIAG_LEN 512
+
+
+static int
+shmem_internal_trace_write_all(int fd, const void *buf, size_t len)
+{
+    const char *p = (const char *) buf;
+
+    while (len > 0) {
+        ssize_t ret = write(fd, p, len);
+        if (ret < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        p   += ret;
+        len -= (size_t) ret;
+    }
+
+    return 0;
+}
+
+
+/* Events being recorded concurrently with a flush from the signal handler may
+ * be captured partially written. */
+static int
+shmem_internal_trace_flush(void)
+{
+    shmem_trace_file_header_t hdr;
+    shmem_internal_trace_buf_t *buf;
+    int fd, ret = 0;
+
+    fd = open(shmem_internal_trace_path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) return -1;
+
+    memset(&hdr, 0, sizeof(hdr));
+    memcpy(hdr.magic, SHMEM_TRACE_MAGIC, sizeof(hdr.magic));
+    hdr.version    = SHMEM_TRACE_VERSION;
+    hdr.event_size = sizeof(shmem_trace_event_t);
+    hdr.pe         = shmem_internal_my_pe;
+    hdr.npes       = shmem_internal_num_pes;
+    hdr.t0_ns      = shmem_internal_trace_t0;
+
+    ret = shmem_internal_trace_write_all(fd, &hdr, sizeof(hdr));
+
+    for (buf = __atomic_load_n(&shmem_internal_trace_buf_list, __ATOMIC_ACQUIRE);
+         buf != NULL && ret == 0; buf = buf->next) {
+        shmem_trace_buf_header_t bhdr;
+        uint64_t head = __atomic_load_n(&buf->head, __ATOMIC_ACQUIRE);
+        uint64_t first, idx, n;
+
+        memset(&bhdr, 0, sizeof(bhdr));
+        bhdr.tid     = buf->tid;
+        bhdr.nevents = head < shmem_internal_trace_nevents ? head : shmem_internal_trace_nevents;
+        bhdr.dropped = head - bhdr.nevents;
+
+        ret = shmem_internal_trace_write_all(fd, &bhdr, sizeof(bhdr));
+        if (ret != 0) break;
+
+        /* Oldest events first; a wrapped buffer is written in two pieces */
+        first = head - bhdr.nevents;
+        idx   = first & (shmem_internal_trace_nevents - 1);
+        n     = shmem_internal_trace_nevents - idx;
+        if (n > bhdr.nevents) n = bhdr.nevents;
+
+        ret = shmem_internal_trace_write_all(fd, &buf->events[idx],
+                                             n * sizeof(shmem_trace_event_t));
+        if (ret == 0 && n < bhdr.nevents)
+            ret = shmem_internal_trace_write_all(fd, &buf->events[0],
+                                                 (bhdr.nevents - n) * sizeof(shmem_trace_event_t));
+    }
+
+    close(fd);
+    return ret;
+}
+
+
+static void
+shmem_internal_trace_signal_handler(int signum)
+{
+    shmem_internal_trace_flush();
+}
+
+
+int
+shmem_internal_trace_init(void)
+{
+    long nevents = shmem_internal_params.TRACE_EVENTS;
+    int ret;
+
+    if (!shmem_internal_params.TRACE) return 0;
+
+    if (nevents <= 0) {
+        RETURN_ERROR_STR("SHMEM_TRACE_EVENTS must be greater than zero");
+        return 1;
+    }
+
+    /* Round up to a power of two so that the ring index is a mask */
+    shmem_internal_trace_nevents = 1;
+    while (shmem_internal_trace_nevents < (uint64_t) nevents)
+        shmem_internal_trace_nevents <<= 1;
+
+    ret = snprintf(shmem_internal_trace_path, sizeof(shmem_internal_trace_path),
+                   "%s.%d.trace", shmem_internal_params.TRACE_FILE,
+                   shmem_internal_my_pe);
+    if (ret < 0 || (size_t) ret >= sizeof(shmem_internal_trace_path)) {
+        RETURN_ERROR_STR("SHMEM_TRACE_FILE is too long");
+        return 1;
+    }
+
+    if (shmem_internal_params.TRACE_SIGNAL > 0) {
+        struct sigaction act;
+
+        memset(&act, 0, sizeof(act));
+        act.sa_handler = shmem_internal_trace_signal_handler;
+        act.sa_flags   = SA_RESTART;
+        sigemptyset(&act.sa_mask);
+
+        if (0 != sigaction((int) shmem_internal_params.TRACE_SIGNAL, &act, NULL)) {
+            RETURN_ERROR_MSG("Unable to install trace handler for signal %ld\n",
+                             shmem_internal_params.TRACE_SIGNAL);
+            return 1;
+        }
+    }
+
+    shmem_internal_trace_t0 = shmem_internal_pcntr_now();
+    shmem_internal_trace_enabled = 1;
+
+    DEBUG_MSG("Tracing to %.*s, %"PRIu64" events per thread\n",
+              SHMEM_INTERNAL_TRACE_PATH_DIAG_LEN, shmem_internal_trace_path,
+              shmem_internal_trace_nevents);
+
+    return 0;
+}
+
+
+void
+shmem_internal_trace_fini(void)
+{
+    shmem_internal_trace_buf_t *buf, *next;
+
+    if (!shmem_internal_trace_enabled) return;
+
+    shmem_internal_trace_enabled = 0;
+
+    if (shmem_internal_params.TRACE_SIGNAL > 0)
+        signal((int) shmem_internal_params.TRACE_SIGNAL, SIG_DFL);
+
+    if (0 != shmem_internal_trace_flush())
+        RAISE_WARN_MSG("Unable to write trace file %.*s\n",
+                       SHMEM_INTERNAL_TRACE_PATH_DIAG_LEN, shmem_internal_trace_path);
+
+    for (buf = shmem_internal_trace_buf_list; buf != NULL; buf = next) {
+        next = buf->next;
+        free(buf);
+    }
+    shmem_internal_trace_buf_list = NULL;
+    shmem_internal_trace_buf = NULL;
+}
+
+
+static shmem_internal_trace_buf_t *
+shmem_internal_trace_buf_create(void)
+{
+    shmem_internal_trace_buf_t *buf;
+
+    buf = malloc(sizeof(shmem_internal_trace_buf_t) +
+                 shmem_internal_trace_nevents * sizeof(shmem_trace_event_t));
+    if (NULL == buf)
+        RAISE_ERROR_STR("Out of memory allocating trace buffer");
+
+    buf->head = 0;
+    buf->tid  = __atomic_fetch_add(&shmem_internal_trace_nthreads, 1, __ATOMIC_RELAXED);
+    buf->next = __atomic_load_n(&shmem_internal_trace_buf_list, __ATOMIC_RELAXED);
+    while (!__atomic_compare_exchange_n(&shmem_internal_trace_buf_list,
+                                        &buf->next, buf, 0,
+                                        __ATOMIC_RELEASE, __ATOMIC_RELAXED))
+        ;
+
+    return buf;
+}
+
+
+void
+shmem_internal_trace_event(int ctx_id, int op_class, size_t len, int pe,
+                           int detail, uint64_t start, uint64_t end)
+{
+    shmem_internal_trace_buf_t *buf = shmem_internal_trace_buf;
+    shmem_trace_event_t *ev;
+    uint64_t head;
+
+    if (NULL == buf)
+        buf = shmem_internal_trace_buf = shmem_internal_trace_buf_create();
+
+    head = buf->head;
+    ev = &buf->events[head & (shmem_internal_trace_nevents - 1)];
+
+    ev->start_ns    = start;
+    ev->duration_ns = end - start;
+    ev->len         = len;
+    ev->pe          = pe;
+    ev->ctx         = (uint16_t) ctx_id;
+    ev->op_class    = (uint8_t) op_class;
+    ev->detail      = (uint8_t) detail;
+
+    __atomic_store_n(&buf->head, head + 1, __ATOMIC_RELEASE);
+}
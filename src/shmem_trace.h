@@ -0,0 +1,34 @@
+/* -*- C -*-
+ *
+ * Copyright (c) 2022 Intel Corporation. All rights reserved.
+ * This software is available to you under the BSD license.
+ *
+ * This file is part of the Sandia OpenSHMEM software package. For license
+ * information, see the LICENSE file in the top level directory of the
+ * distribution.
+ *
+ */
+
+#ifndef SHMEM_TRACE_H
+#define SHMEM_TRACE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "shmem_trace_format.h"
+
+/* Event tracer (SHMEM_TRACE).  Events are produced by the instrumentation
+ * hooks in shmem_pcntr.h.  Each thread appends to its own ring buffer, so
+ * recording needs no locks; when a buffer wraps, the oldest events are
+ * overwritten.  The buffers are written to a binary file per PE at finalize,
+ * and optionally when the process receives SHMEM_TRACE_SIGNAL. */
+
+extern int shmem_internal_trace_enabled;
+
+int shmem_internal_trace_init(void);
+void shmem_internal_trace_fini(void);
+
+void shmem_internal_trace_event(int ctx_id, int op_class, size_t len, int pe,
+                                int detail, uint64_t start, uint64_t end);
+
+#endif
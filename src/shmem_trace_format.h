@@ -0,0 +1,76 @@
+/* -*- C -*-
+ *
+ * Copyright (c) 2022 Intel Corporation. All rights reserved.
+ * This software is available to you under the BSD license.
+ *
+ * This file is part of the Sandia OpenSHMEM software package. For license
+ * information, see the LICENSE file in the top level directory of the
+ * distribution.
+ *
+ */
+
+#ifndef SHMEM_TRACE_FORMAT_H
+#define SHMEM_TRACE_FORMAT_H
+
+#include <stdint.h>
+
+/* On-disk format of the per-PE trace files written when SHMEM_TRACE is set.
+ * This header is shared by the library and the oshtrace converter, and must
+ * not depend on any other library header.
+ *
+ * A file holds a file header followed by one block per thread that issued
+ * traced operations.  A block is a buffer header followed by its events,
+ * oldest first.  All fields use the byte order of the writing host. */
+
+#define SHMEM_TRACE_MAGIC   "SOSTRACE"
+#define SHMEM_TRACE_VERSION 1
+
+typedef struct {
+    char     magic[8];
+    uint32_t version;
+    uint32_t event_size;
+    int32_t  pe;
+    int32_t  npes;
+    /* Timestamps are CLOCK_MONOTONIC nanoseconds.  t0_ns is sampled just
+     * before the final barrier of shmem_init and serves as the time origin
+     * of the PE. */
+    uint64_t t0_ns;
+} shmem_trace_file_header_t;
+
+typedef struct {
+    uint32_t tid;
+    uint32_t reserved;
+    uint64_t nevents;
+    uint64_t dropped;
+} shmem_trace_buf_header_t;
+
+/* op_class takes the SHMEMX_PCNTR_* values: put, get, amo, coll, quiet, wait.
+ * For collectives, detail holds the operation in the upper four bits and the
+ * algorithm (coll_type_t) in the lower four. */
+typedef struct {
+    uint64_t start_ns;
+    uint64_t duration_ns;
+    uint64_t len;
+    int32_t  pe;
+    uint16_t ctx;
+    uint8_t  op_class;
+    uint8_t  detail;
+} shmem_trace_event_t;
+
+enum {
+    SHMEM_TRACE_COLL_NONE = 0,
+    SHMEM_TRACE_COLL_SYNC,
+    SHMEM_TRACE_COLL_BARRIER,
+    SHMEM_TRACE_COLL_BCAST,
+    SHMEM_TRACE_COLL_REDUCE,
+    SHMEM_TRACE_COLL_COLLECT,
+    SHMEM_TRACE_COLL_FCOLLECT,
+    SHMEM_TRACE_COLL_ALLTOALL,
+    SHMEM_TRACE_COLL_ALLTOALLS
+};
+
+#define SHMEM_TRACE_DETAIL(coll_op, alg) ((uint8_t) (((coll_op) << 4) | ((alg) & 0xf)))
+#define SHMEM_TRACE_DETAIL_OP(detail)    ((detail) >> 4)
+#define SHMEM_TRACE_DETAIL_ALG(detail)   ((detail) & 0xf)
+
+#endif
@@ -0,0 +1,339 @@
+/* -*- C -*-
+ *
+ * Copyright (c) 2022 Intel Corporation. All rights reserved.
+ * This software is available to you under the BSD license.
+ *
+ * This file is part of the Sandia OpenSHMEM software package. For license
+ * information, see the LICENSE file in the top level directory of the
+ * distribution.
+ *
+ */
+
+#include "config.h"
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+#ifdef HAVE_SCHED_GETAFFINITY
+#include <sched.h>
+#endif
+
+#define SHMEM_INTERNAL_INCLUDE
+#include "shmem.h"
+#include "shmem_internal.h"
+#include "shmem_comm.h"
+#include "shr_copy.h"
+#include "uthash.h"
+
+struct shmem_shr_copy_ctx_t {
+    shmem_ctx_t ctx;
+    uint64_t issued;
+    uint64_t completed;
+    UT_hash_handle hh;
+};
+
+typedef struct shmem_shr_copy_ctx_t shmem_shr_copy_ctx_t;
+
+struct shmem_shr_copy_item_t {
+    int is_put;
+    void *target;
+    const void *source;
+    size_t len;
+    int pe;
+    shmem_shr_copy_ctx_t *state;
+    struct shmem_shr_copy_item_t *next;
+};
+
+typedef struct shmem_shr_copy_item_t shmem_shr_copy_item_t;
+
+struct shmem_shr_copy_queue_t {
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    shmem_shr_copy_item_t *head;
+    shmem_shr_copy_item_t *tail;
+    int cpu;
+    int stop;
+};
+
+typedef struct shmem_shr_copy_queue_t shmem_shr_copy_queue_t;
+
+int shmem_shr_copy_nthreads = 0;
+uint64_t shmem_shr_copy_outstanding = 0;
+
+static shmem_shr_copy_queue_t *shmem_shr_copy_queues = NULL;
+static unsigned shmem_shr_copy_next_queue = 0;
+
+/* Per-context state, looked up by context handle */
+static shmem_shr_copy_ctx_t *shmem_shr_copy_ctx_table = NULL;
+static pthread_mutex_t shmem_shr_copy_ctx_lock = PTHREAD_MUTEX_INITIALIZER;
+
+
+static void *
+shmem_shr_copy_worker(void *arg)
+{
+    shmem_shr_copy_queue_t *q = (shmem_shr_copy_queue_t *) arg;
+    shmem_shr_copy_item_t *item;
+
+#ifdef HAVE_SCHED_GETAFFINITY
+    if (q->cpu >= 0) {
+        cpu_set_t set;
+
+        CPU_ZERO(&set);
+        CPU_SET(q->cpu, &set);
+        if (0 != pthread_setaffinity_np(pthread_self(), sizeof(set), &set))
+            RAISE_WARN_MSG("Unable to pin copy thread to CPU %d\n", q->cpu);
+    }
+#endif
+
+    for (;;) {
+        pthread_mutex_lock(&q->lock);
+        while (NULL == q->head && !q->stop)
+            pthread_cond_wait(&q->cond, &q->lock);
+
+        if (NULL == q->head) {
+            pthread_mutex_unlock(&q->lock);
+            break;
+        }
+
+        item = q->head;
+        q->head = item->next;
+        if (NULL == q->head) q->tail = NULL;
+        pthread_mutex_unlock(&q->lock);
+
+        if (item->is_put)
+            shmem_shr_transport_put(item->state->ctx, item->target,
+                                    item->source, item->len, item->pe);
+        else
+            shmem_shr_transport_get(item->state->ctx, item->target,
+                                    item->source, item->len, item->pe);
+
+        __atomic_fetch_add(&item->state->completed, 1, __ATOMIC_RELEASE);
+        __atomic_fetch_sub(&shmem_shr_copy_outstanding, 1, __ATOMIC_RELEASE);
+        free(item);
+    }
+
+    return NULL;
+}
+
+
+/* Helper threads are pinned to the last CPUs in the PE's affinity mask, which
+ * are assumed to be spare.  Threads are left unpinned when the mask does not
+ * leave a CPU for the PE itself. */
+static void
+shmem_shr_copy_assign_cpus(void)
+{
+    int i;
+
+    for (i = 0; i < shmem_shr_copy_nthreads; i++)
+        shmem_shr_copy_queues[i].cpu = -1;
+
+#ifdef HAVE_SCHED_GETAFFINITY
+    cpu_set_t set;
+    int cpu, count, n = 0;
+
+    CPU_ZERO(&set);
+    if (0 != sched_getaffinity(0, sizeof(set), &set)) return;
+
+    count = CPU_COUNT(&set);
+    if (count <= shmem_shr_copy_nthreads) return;
+
+    for (cpu = CPU_SETSIZE - 1; cpu >= 0 && n < shmem_shr_copy_nthreads; cpu--) {
+        if (CPU_ISSET(cpu, &set))
+            shmem_shr_copy_queues[n++].cpu = cpu;
+    }
+#endif
+}
+
+
+int
+shmem_shr_copy_init(void)
+{
+    int i, ret;
+
+    if (shmem_internal_params.SHR_COPY_THREADS <= 0) return 0;
+
+    if (shmem_internal_params.SHR_COPY_CHUNK_SIZE == 0) {
+        RETURN_ERROR_STR("SHMEM_SHR_COPY_CHUNK_SIZE must be nonzero");
+        return 1;
+    }
+
+    shmem_shr_copy_queues = calloc(shmem_internal_params.SHR_COPY_THREADS,
+                                   sizeof(shmem_shr_copy_queue_t));
+    if (NULL == shmem_shr_copy_queues) return 1;
+
+    shmem_shr_copy_nthreads = (int) shmem_internal_params.SHR_COPY_THREADS;
+    shmem_shr_copy_assign_cpus();
+
+    for (i = 0; i < shmem_shr_copy_nthreads; i++) {
+        shmem_shr_copy_queue_t *q = &shmem_shr_copy_queues[i];
+
+        pthread_mutex_init(&q->lock, NULL);
+        pthread_cond_init(&q->cond, NULL);
+
+        ret = pthread_create(&q->thread, NULL, shmem_shr_copy_worker, q);
+        if (0 != ret) {
+            RETURN_ERROR_MSG("Unable to create copy thread (%d)\n", ret);
+            shmem_shr_copy_nthreads = i;
+            shmem_shr_copy_fini();
+            return 1;
+        }
+    }
+
+    DEBUG_MSG("On-node copy engine: %d threads, min size %zu, chunk size %zu\n",
+              shmem_shr_copy_nthreads, shmem_internal_params.SHR_COPY_MIN_SIZE,
+              shmem_internal_params.SHR_COPY_CHUNK_SIZE);
+
+    return 0;
+}
+
+
+void
+shmem_shr_copy_fini(void)
+{
+    int i;
+    shmem_shr_copy_ctx_t *state, *tmp;
+
+    if (NULL == shmem_shr_copy_queues) return;
+
+    for (i = 0; i < shmem_shr_copy_nthreads; i++) {
+        shmem_shr_copy_queue_t *q = &shmem_shr_copy_queues[i];
+
+        pthread_mutex_lock(&q->lock);
+        q->stop = 1;
+        pthread_cond_signal(&q->cond);
+        pthread_mutex_unlock(&q->lock);
+
+        pthread_join(q->thread, NULL);
+        pthread_mutex_destroy(&q->lock);
+        pthread_cond_destroy(&q->cond);
+    }
+
+    free(shmem_shr_copy_queues);
+    shmem_shr_copy_queues = NULL;
+    shmem_shr_copy_nthreads = 0;
+
+    HASH_ITER(hh, shmem_shr_copy_ctx_table, state, tmp) {
+        HASH_DEL(shmem_shr_copy_ctx_table, state);
+        free(state);
+    }
+}
+
+
+static shmem_shr_copy_ctx_t *
+shmem_shr_copy_ctx_lookup(shmem_ctx_t ctx, int create)
+{
+    shmem_shr_copy_ctx_t *state;
+
+    pthread_mutex_lock(&shmem_shr_copy_ctx_lock);
+    HASH_FIND_PTR(shmem_shr_copy_ctx_table, &ctx, state);
+
+    if (NULL == state && create) {
+        state = calloc(1, sizeof(shmem_shr_copy_ctx_t));
+        if (NULL == state)
+            RAISE_ERROR_STR("Out of memory allocating copy engine context state");
+        state->ctx = ctx;
+        HASH_ADD_PTR(shmem_shr_copy_ctx_table, ctx, state);
+    }
+    pthread_mutex_unlock(&shmem_shr_copy_ctx_lock);
+
+    return state;
+}
+
+
+static void
+shmem_shr_copy_submit(shmem_ctx_t ctx, int is_put, void *target,
+                      const void *source, size_t len, int pe)
+{
+    shmem_shr_copy_ctx_t *state = shmem_shr_copy_ctx_lookup(ctx, 1);
+    size_t chunk = shmem_internal_params.SHR_COPY_CHUNK_SIZE;
+    size_t off, frag_len;
+
+    for (off = 0; off < len; off += frag_len) {
+        shmem_shr_copy_item_t *item;
+        shmem_shr_copy_queue_t *q;
+
+        frag_len = (len - off < chunk) ? len - off : chunk;
+
+        item = malloc(sizeof(shmem_shr_copy_item_t));
+        if (NULL == item)
+            RAISE_ERROR_STR("Out of memory allocating copy engine work item");
+
+        item->is_put = is_put;
+        item->target = (uint8_t *) target + off;
+        item->source = (const uint8_t *) source + off;
+        item->len    = frag_len;
+        item->pe     = pe;
+        item->state  = state;
+        item->next   = NULL;
+
+        __atomic_fetch_add(&state->issued, 1, __ATOMIC_RELAXED);
+        __atomic_fetch_add(&shmem_shr_copy_outstanding, 1, __ATOMIC_RELAXED);
+
+        /* Spread the chunks of a transfer across the helper threads */
+        q = &shmem_shr_copy_queues[__atomic_fetch_add(&shmem_shr_copy_next_queue, 1,
+                                                      __ATOMIC_RELAXED) %
+                                   shmem_shr_copy_nthreads];
+
+        pthread_mutex_lock(&q->lock);
+        if (NULL == q->tail)
+            q->head = item;
+        else
+            q->tail->next = item;
+        q->tail = item;
+        pthread_cond_signal(&q->cond);
+        pthread_mutex_unlock(&q->lock);
+    }
+}
+
+
+void
+shmem_shr_copy_put(shmem_ctx_t ctx, void *target, const void *source,
+                   size_t len, int pe)
+{
+    shmem_shr_copy_submit(ctx, 1, target, source, len, pe);
+}
+
+
+void
+shmem_shr_copy_get(shmem_ctx_t ctx, void *target, const void *source,
+                   size_t len, int pe)
+{
+    shmem_shr_copy_submit(ctx, 0, target, source, len, pe);
+}
+
+
+void
+shmem_shr_copy_ctx_wait(shmem_ctx_t ctx)
+{
+    shmem_shr_copy_ctx_t *state = shmem_shr_copy_ctx_lookup(ctx, 0);
+    uint64_t issued;
+
+    if (NULL == state) return;
+
+    issued = __atomic_load_n(&state->issued, __ATOMIC_RELAXED);
+    while (__atomic_load_n(&state->completed, __ATOMIC_ACQUIRE) < issued)
+        SPINLOCK_BODY();
+}
+
+
+void
+shmem_shr_copy_ctx_release(shmem_ctx_t ctx)
+{
+    shmem_shr_copy_ctx_t *state;
+
+    shmem_shr_copy_ctx_wait(ctx);
+
+    pthread_mutex_lock(&shmem_shr_copy_ctx_lock);
+    HASH_FIND_PTR(shmem_shr_copy_ctx_table, &ctx, state);
+    if (NULL != state) {
+        HASH_DEL(shmem_shr_copy_ctx_table, state);
+        free(state);
+    }
+    pthread_mutex_unlock(&shmem_shr_copy_ctx_lock);
+}
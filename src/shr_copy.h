@@ -0,0 +1,68 @@
+/* -*- C -*-
+ *
+ * Copyright (c) 2022 Intel Corporation. All rights reserved.
+ * This software is available to you under the BSD license.
+ *
+ * This file is part of the Sandia OpenSHMEM software package. For license
+ * information, see the LICENSE file in the top level directory of the
+ * distribution.
+ *
+ */
+
+#ifndef SHR_COPY_H
+#define SHR_COPY_H
+
+#include <stddef.h>
+
+#include "shmem_internal.h"
+
+#ifdef USE_MEMFD
+#include "transport_memfd.h"
+#endif
+
+/* Asynchronous on-node copy engine.  Large on-node put_nbi and get_nbi
+ * transfers are split into chunks and queued to helper threads, each with its
+ * own work queue.  Every context tracks the number of chunks issued and
+ * completed on its behalf, so that quiet and fence only wait for the
+ * transfers of the context they are called on. */
+
+extern int shmem_shr_copy_nthreads;
+extern uint64_t shmem_shr_copy_outstanding;
+
+int shmem_shr_copy_init(void);
+void shmem_shr_copy_fini(void);
+
+void shmem_shr_copy_put(shmem_ctx_t ctx, void *target, const void *source,
+                        size_t len, int pe);
+void shmem_shr_copy_get(shmem_ctx_t ctx, void *target, const void *source,
+                        size_t len, int pe);
+void shmem_shr_copy_ctx_wait(shmem_ctx_t ctx);
+void shmem_shr_copy_ctx_release(shmem_ctx_t ctx);
+
+
+/* Whether an on-node nbi transfer of len bytes should be offloaded.  Large
+ * transfers are offloaded even when they exceed the CMA size limits, since the
+ * system call cost is paid by a helper thread. */
+static inline int
+shmem_shr_copy_use(const void *remote, size_t len, int pe)
+{
+    return shmem_shr_copy_nthreads > 0 &&
+           len >= shmem_internal_params.SHR_COPY_MIN_SIZE &&
+#if defined(USE_MEMFD) && !defined(USE_CMA)
+           shmem_transport_memfd_in_heap(remote, len) &&
+#endif
+           -1 != shmem_internal_get_shr_rank(pe);
+}
+
+
+/* Complete the outstanding offloaded transfers of ctx */
+static inline void
+shmem_shr_copy_quiet(shmem_ctx_t ctx)
+{
+    if (__atomic_load_n(&shmem_shr_copy_outstanding, __ATOMIC_ACQUIRE) == 0)
+        return;
+
+    shmem_shr_copy_ctx_wait(ctx);
+}
+
+#endif
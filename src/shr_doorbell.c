@@ -0,0 +1,209 @@
+/* -*- C -*-
+ *
+ * Copyright (c) 2022 Intel Corporation. All rights reserved.
+ * This software is available to you under the BSD license.
+ *
+ * This file is part of the Sandia OpenSHMEM software package. For license
+ * information, see the LICENSE file in the top level directory of the
+ * distribution.
+ *
+ */
+
+#include "config.h"
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <limits.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/types.h>
+#include <linux/futex.h>
+
+#define SHMEM_INTERNAL_INCLUDE
+#include "shmem.h"
+#include "shmem_internal.h"
+#include "shr_doorbell.h"
+#include "runtime.h"
+
+shmem_shr_doorbell_t *shmem_shr_doorbell_self = NULL;
+shmem_shr_doorbell_t **shmem_shr_doorbell_peers = NULL;
+
+static int shmem_shr_doorbell_fd = -1;
+static size_t shmem_shr_doorbell_len = 0;
+
+/* Peers reopen the doorbell memfd through /proc/<pid>/fd/<fd> */
+typedef struct pmi_doorbell_data {
+    pid_t           lpid;
+    int             fd;
+} pmi_doorbell_data_t;
+
+
+int
+shmem_shr_doorbell_init(void)
+{
+    int ret;
+    pmi_doorbell_data_t doorbell_data;
+    char errmsg[256];
+
+    if (!shmem_internal_params.WAIT_SLEEP) return 0;
+
+    shmem_shr_doorbell_len = (size_t) sysconf(_SC_PAGESIZE);
+
+    shmem_shr_doorbell_fd = memfd_create("shmem-doorbell", MFD_CLOEXEC);
+    if (shmem_shr_doorbell_fd < 0) {
+        RETURN_ERROR_MSG("Doorbell memfd_create failed (%s)\n",
+                         shmem_util_strerror(errno, errmsg, 256));
+        return 1;
+    }
+
+    if (0 != ftruncate(shmem_shr_doorbell_fd, shmem_shr_doorbell_len)) {
+        RETURN_ERROR_MSG("Doorbell ftruncate failed (%s)\n",
+                         shmem_util_strerror(errno, errmsg, 256));
+        return 1;
+    }
+
+    shmem_shr_doorbell_self = mmap(NULL, shmem_shr_doorbell_len,
+                                   PROT_READ | PROT_WRITE, MAP_SHARED,
+                                   shmem_shr_doorbell_fd, 0);
+    if (MAP_FAILED == shmem_shr_doorbell_self) {
+        shmem_shr_doorbell_self = NULL;
+        RETURN_ERROR_MSG("Doorbell mmap failed (%s)\n",
+                         shmem_util_strerror(errno, errmsg, 256));
+        return 1;
+    }
+
+    doorbell_data.lpid = getpid();
+    doorbell_data.fd   = shmem_shr_doorbell_fd;
+
+    ret = shmem_runtime_put("shr-doorbell", &doorbell_data,
+                            sizeof(pmi_doorbell_data_t));
+    if (0 != ret) {
+        RETURN_ERROR_MSG("runtime_put failed: %d\n", ret);
+    }
+
+    return ret;
+}
+
+
+int
+shmem_shr_doorbell_startup(void)
+{
+    int i, ret, fd, peer_num, num_on_node;
+    pmi_doorbell_data_t doorbell_data;
+    char path[64];
+    char errmsg[256];
+    void *doorbell;
+
+    if (!shmem_internal_params.WAIT_SLEEP) return 0;
+
+    num_on_node = shmem_runtime_get_node_size();
+
+    shmem_shr_doorbell_peers = calloc(num_on_node, sizeof(shmem_shr_doorbell_t *));
+    if (NULL == shmem_shr_doorbell_peers) return 1;
+
+    for (i = 0 ; i < shmem_internal_num_pes; ++i) {
+        peer_num = shmem_runtime_get_node_rank(i);
+        if (-1 == peer_num) continue;
+
+        if (i == shmem_internal_my_pe) {
+            shmem_shr_doorbell_peers[peer_num] = shmem_shr_doorbell_self;
+            continue;
+        }
+
+        ret = shmem_runtime_get(i, "shr-doorbell", &doorbell_data,
+                                sizeof(pmi_doorbell_data_t));
+        if (0 != ret) {
+            RETURN_ERROR_MSG("runtime_get failed: %d\n", ret);
+            return 1;
+        }
+
+        snprintf(path, sizeof(path), "/proc/%d/fd/%d", (int) doorbell_data.lpid,
+                 doorbell_data.fd);
+
+        fd = open(path, O_RDWR | O_CLOEXEC);
+        if (fd < 0) {
+            RETURN_ERROR_MSG("Unable to open doorbell of PE %d (%s)\n", i,
+                             shmem_util_strerror(errno, errmsg, 256));
+            return 1;
+        }
+
+        doorbell = mmap(NULL, shmem_shr_doorbell_len, PROT_READ | PROT_WRITE,
+                        MAP_SHARED, fd, 0);
+        close(fd);
+
+        if (MAP_FAILED == doorbell) {
+            RETURN_ERROR_MSG("Unable to map doorbell of PE %d (%s)\n", i,
+                             shmem_util_strerror(errno, errmsg, 256));
+            return 1;
+        }
+
+        shmem_shr_doorbell_peers[peer_num] = doorbell;
+    }
+
+    return 0;
+}
+
+
+void
+shmem_shr_doorbell_fini(void)
+{
+    int i;
+
+    if (NULL != shmem_shr_doorbell_peers) {
+        for (i = 0; i < shmem_runtime_get_node_size(); i++) {
+            if (NULL != shmem_shr_doorbell_peers[i] &&
+                shmem_shr_doorbell_peers[i] != shmem_shr_doorbell_self)
+                munmap(shmem_shr_doorbell_peers[i], shmem_shr_doorbell_len);
+        }
+        free(shmem_shr_doorbell_peers);
+        shmem_shr_doorbell_peers = NULL;
+    }
+
+    if (NULL != shmem_shr_doorbell_self) {
+        munmap(shmem_shr_doorbell_self, shmem_shr_doorbell_len);
+        shmem_shr_doorbell_self = NULL;
+    }
+
+    if (shmem_shr_doorbell_fd >= 0) {
+        close(shmem_shr_doorbell_fd);
+        shmem_shr_doorbell_fd = -1;
+    }
+}
+
+
+void
+shmem_shr_doorbell_wake(shmem_shr_doorbell_t *doorbell)
+{
+    __atomic_fetch_add(&doorbell->seq, 1, __ATOMIC_RELEASE);
+    syscall(SYS_futex, &doorbell->seq, FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+}
+
+
+/* Sleep until the doorbell is rung or the timeout expires.  The timeout bounds
+ * the latency of observing updates that arrive over the network, which do not
+ * ring the doorbell.  Spurious returns (EAGAIN, EINTR, ETIMEDOUT) are harmless
+ * since the caller rechecks its wait condition. */
+void
+shmem_shr_doorbell_sleep(uint32_t seq)
+{
+    struct timespec ts, *tsp = NULL;
+    long timeout = shmem_internal_params.WAIT_SLEEP_TIMEOUT;
+
+    if (timeout > 0) {
+        ts.tv_sec  = timeout / 1000000;
+        ts.tv_nsec = (timeout % 1000000) * 1000;
+        tsp = &ts;
+    }
+
+    syscall(SYS_futex, &shmem_shr_doorbell_self->seq, FUTEX_WAIT, seq, tsp,
+            NULL, 0);
+}
@@ -0,0 +1,83 @@
+/* -*- C -*-
+ *
+ * Copyright (c) 2022 Intel Corporation. All rights reserved.
+ * This software is available to you under the BSD license.
+ *
+ * This file is part of the Sandia OpenSHMEM software package. For license
+ * information, see the LICENSE file in the top level directory of the
+ * distribution.
+ *
+ */
+
+#ifndef SHR_DOORBELL_H
+#define SHR_DOORBELL_H
+
+#include <stdint.h>
+
+#include "shmem_internal.h"
+
+/* Each PE owns one doorbell, placed in a memfd page that is mapped by every
+ * on-node peer.  A PE that has exhausted its spin budget in a wait operation
+ * registers as a sleeper and blocks on seq.  On-node writers ring the
+ * doorbell of the target PE after each update, which bumps seq and wakes the
+ * sleepers only when there are any. */
+struct shmem_shr_doorbell_t {
+    uint32_t seq;
+    uint32_t sleepers;
+};
+
+typedef struct shmem_shr_doorbell_t shmem_shr_doorbell_t;
+
+extern shmem_shr_doorbell_t *shmem_shr_doorbell_self;
+extern shmem_shr_doorbell_t **shmem_shr_doorbell_peers;
+
+int shmem_shr_doorbell_init(void);
+int shmem_shr_doorbell_startup(void);
+void shmem_shr_doorbell_fini(void);
+
+void shmem_shr_doorbell_wake(shmem_shr_doorbell_t *doorbell);
+void shmem_shr_doorbell_sleep(uint32_t seq);
+
+
+/* Register the calling thread as a sleeper.  The caller must recheck its wait
+ * condition after arming and before sleeping on the returned sequence
+ * number, so that an update racing with the registration is not missed. */
+static inline uint32_t
+shmem_shr_doorbell_arm(void)
+{
+    uint32_t seq = __atomic_load_n(&shmem_shr_doorbell_self->seq,
+                                   __ATOMIC_ACQUIRE);
+
+    __atomic_fetch_add(&shmem_shr_doorbell_self->sleepers, 1, __ATOMIC_SEQ_CST);
+
+    return seq;
+}
+
+
+static inline void
+shmem_shr_doorbell_disarm(void)
+{
+    __atomic_fetch_sub(&shmem_shr_doorbell_self->sleepers, 1, __ATOMIC_RELEASE);
+}
+
+
+/* Called by a writer after updating memory on the PE with the given noderank.
+ * The fence orders the update before the read of the sleeper count, pairing
+ * with the fence implied by the atomic increment in shmem_shr_doorbell_arm. */
+static inline void
+shmem_shr_doorbell_ring(int noderank)
+{
+    shmem_shr_doorbell_t *doorbell;
+
+    if (NULL == shmem_shr_doorbell_peers) return;
+
+    doorbell = shmem_shr_doorbell_peers[noderank];
+    if (NULL == doorbell) return;
+
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+    if (__atomic_load_n(&doorbell->sleepers, __ATOMIC_RELAXED))
+        shmem_shr_doorbell_wake(doorbell);
+}
+
+#endif
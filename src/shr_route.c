@@ -0,0 +1,507 @@
+/* -*- C -*-
+ *
+ * Copyright (c) 2022 Intel Corporation. All rights reserved.
+ * This software is available to you under the BSD license.
+ *
+ * This file is part of the Sandia OpenSHMEM software package. For license
+ * information, see the LICENSE file in the top level directory of the
+ * distribution.
+ *
+ */
+
+/* Construction of the on-node routing tables, see shr_route.h.
+ *
+ * Without calibration, each destination uses its preferred on-node
+ * mechanism, in the order memcpy (self), XPMEM, memfd, CMA, up to that
+ * mechanism's size limit, and the network transport above it.  With
+ * SHMEM_SHR_ROUTE_CALIBRATE, every mechanism that can reach a destination,
+ * including the network transport's loopback, is timed at sizes from 64B to
+ * 4MiB, and each size range is routed to the fastest.  Routes to the calling
+ * PE are timed against the calling PE, and routes to peers against the
+ * symmetric heap of the next PE on the node, with all PEs measuring between
+ * runtime barriers.  Crossovers given explicitly in the environment take
+ * precedence over the calibration. */
+
+#include "config.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <inttypes.h>
+
+#define SHMEM_INTERNAL_INCLUDE
+#include "shmem.h"
+#include "shmem_internal.h"
+#include "shmem_comm.h"
+#include "shmem_pcntr.h"
+#include "shr_route.h"
+
+shmem_shr_route_t shmem_shr_route_table[SHMEM_SHR_ROUTE_NUM_OPS][SHMEM_SHR_ROUTE_NUM_DEST];
+int shmem_shr_route_mixed = 0;
+
+static const char *shr_route_mech_str[SHMEM_SHR_ROUTE_NUM_MECH] = {
+    "nic", "memcpy", "xpmem", "memfd", "cma"
+};
+static const char *shr_route_op_str[SHMEM_SHR_ROUTE_NUM_OPS] = { "put", "get" };
+static const char *shr_route_dest_str[SHMEM_SHR_ROUTE_NUM_DEST] = { "self", "heap", "data" };
+
+#define SHR_ROUTE_CAL_MIN_SIZE 64
+#define SHR_ROUTE_CAL_BYTES    (8 * 1024 * 1024)
+#define SHR_ROUTE_CAL_REPS     3
+
+/* A mechanism must be this much faster than the one serving the previous
+ * size to take over, which keeps measurement noise out of the tables */
+#define SHR_ROUTE_CAL_HYSTERESIS 0.9
+
+
+/* Whether mech is configured and can reach dest */
+static int
+shr_route_reaches(int mech, int dest)
+{
+    switch (mech) {
+        case SHMEM_SHR_ROUTE_NIC:
+#ifdef SHMEM_SHR_ROUTE_HAVE_NIC
+            return 1;
+#else
+            return 0;
+#endif
+        case SHMEM_SHR_ROUTE_MEMCPY:
+#if defined(USE_ON_NODE_COMMS) || defined(USE_MEMCPY)
+            return dest == SHMEM_SHR_ROUTE_SELF;
+#else
+            return 0;
+#endif
+        case SHMEM_SHR_ROUTE_XPMEM:
+#ifdef USE_XPMEM
+            return dest != SHMEM_SHR_ROUTE_SELF;
+#else
+            return 0;
+#endif
+        case SHMEM_SHR_ROUTE_MEMFD:
+#ifdef USE_MEMFD
+            return dest == SHMEM_SHR_ROUTE_HEAP;
+#else
+            return 0;
+#endif
+        case SHMEM_SHR_ROUTE_CMA:
+#ifdef USE_CMA
+            return dest != SHMEM_SHR_ROUTE_SELF;
+#else
+            return 0;
+#endif
+        default:
+            return 0;
+    }
+}
+
+
+/* Size limit of an on-node mechanism when the route is not calibrated */
+static size_t
+shr_route_default_max(int op, int mech)
+{
+#if defined(USE_ON_NODE_COMMS) || defined(USE_MEMCPY)
+    if (mech == SHMEM_SHR_ROUTE_MEMCPY && shmem_internal_params.SHR_ROUTE_SELF_MAX > 0)
+        return shmem_internal_params.SHR_ROUTE_SELF_MAX;
+#endif
+#ifdef USE_CMA
+    if (mech == SHMEM_SHR_ROUTE_CMA)
+        return op == SHMEM_SHR_ROUTE_PUT ? shmem_internal_params.CMA_PUT_MAX :
+                                           shmem_internal_params.CMA_GET_MAX;
+#endif
+    return SIZE_MAX;
+}
+
+
+static void
+shr_route_build_default(int op, int dest)
+{
+    shmem_shr_route_t *r = &shmem_shr_route_table[op][dest];
+    size_t max;
+
+    if (r->fallback == SHMEM_SHR_ROUTE_NIC) {
+        r->steps[0].max  = SIZE_MAX;
+        r->steps[0].mech = SHMEM_SHR_ROUTE_NIC;
+        return;
+    }
+
+    max = shr_route_default_max(op, r->fallback);
+#ifndef SHMEM_SHR_ROUTE_HAVE_NIC
+    max = SIZE_MAX;
+#endif
+
+    r->steps[0].max  = max;
+    r->steps[0].mech = r->fallback;
+
+    if (max != SIZE_MAX) {
+        r->steps[1].max  = SIZE_MAX;
+        r->steps[1].mech = SHMEM_SHR_ROUTE_NIC;
+    }
+}
+
+
+#if defined(USE_ON_NODE_COMMS) || defined(USE_MEMCPY)
+/* Whether the user fixed the crossovers of dest in the environment */
+static int
+shr_route_pinned(int dest)
+{
+    if (dest == SHMEM_SHR_ROUTE_SELF && shmem_internal_params.SHR_ROUTE_SELF_MAX_provided)
+        return 1;
+#ifdef USE_CMA
+    if (dest != SHMEM_SHR_ROUTE_SELF &&
+        (shmem_internal_params.CMA_PUT_MAX_provided || shmem_internal_params.CMA_GET_MAX_provided))
+        return 1;
+#endif
+    return 0;
+}
+
+
+static size_t
+shr_route_cal_size(int i)
+{
+    return (size_t) SHR_ROUTE_CAL_MIN_SIZE << (2 * i);
+}
+
+
+/* Perform one transfer with mech targeting pe, which is the calling PE or an
+ * on-node peer.  remote is in the symmetric heap and local is private
+ * memory. */
+static void
+shr_route_xfer(int op, int mech, char *remote, char *local, size_t len, int pe)
+{
+    switch (mech) {
+        case SHMEM_SHR_ROUTE_MEMCPY:
+            if (op == SHMEM_SHR_ROUTE_PUT)
+                shmem_internal_memcpy(remote, local, len);
+            else
+                shmem_internal_memcpy(local, remote, len);
+            break;
+#ifdef USE_XPMEM
+        case SHMEM_SHR_ROUTE_XPMEM:
+            if (op == SHMEM_SHR_ROUTE_PUT)
+                shmem_transport_xpmem_put(remote, local, len, pe,
+                                          shmem_internal_get_shr_rank(pe));
+            else
+                shmem_transport_xpmem_get(local, remote, len, pe,
+                                          shmem_internal_get_shr_rank(pe));
+            break;
+#endif
+#ifdef USE_MEMFD
+        case SHMEM_SHR_ROUTE_MEMFD:
+            if (op == SHMEM_SHR_ROUTE_PUT)
+                shmem_transport_memfd_put(remote, local, len, pe,
+                                          shmem_internal_get_shr_rank(pe));
+            else
+                shmem_transport_memfd_get(local, remote, len, pe,
+                                          shmem_internal_get_shr_rank(pe));
+            break;
+#endif
+#ifdef USE_CMA
+        case SHMEM_SHR_ROUTE_CMA:
+            if (pe != shmem_internal_my_pe) {
+                if (op == SHMEM_SHR_ROUTE_PUT)
+                    shmem_transport_cma_put(remote, local, len, pe,
+                                            shmem_internal_get_shr_rank(pe));
+                else
+                    shmem_transport_cma_get(local, remote, len, pe,
+                                            shmem_internal_get_shr_rank(pe));
+            } else {
+                /* shmem_transport_cma_put/get copy directly when targeting
+                 * the calling PE, so issue the system call here */
+                struct iovec liov = { local, len }, riov = { remote, len };
+                ssize_t bytes;
+
+                if (op == SHMEM_SHR_ROUTE_PUT)
+                    bytes = process_vm_writev(shmem_transport_cma_my_pid, &liov, 1, &riov, 1, 0);
+                else
+                    bytes = process_vm_readv(shmem_transport_cma_my_pid, &liov, 1, &riov, 1, 0);
+
+                if (bytes < 0 || (size_t) bytes != len) {
+                    char errmsg[256];
+                    RAISE_ERROR_MSG("process_vm_%s() failed (%s)\n",
+                                    op == SHMEM_SHR_ROUTE_PUT ? "writev" : "readv",
+                                    shmem_util_strerror(errno, errmsg, 256));
+                }
+            }
+            break;
+#endif
+#ifdef SHMEM_SHR_ROUTE_HAVE_NIC
+        case SHMEM_SHR_ROUTE_NIC:
+            if (op == SHMEM_SHR_ROUTE_PUT)
+                shmem_transport_put_nbi((shmem_transport_ctx_t *) SHMEM_CTX_DEFAULT,
+                                        remote, local, len, pe);
+            else
+                shmem_transport_get((shmem_transport_ctx_t *) SHMEM_CTX_DEFAULT,
+                                    local, remote, len, pe);
+            break;
+#endif
+        default:
+            RAISE_ERROR_MSG("Invalid on-node mechanism %d\n", mech);
+    }
+}
+
+
+static void
+shr_route_complete(int op, int mech)
+{
+#ifdef SHMEM_SHR_ROUTE_HAVE_NIC
+    if (mech != SHMEM_SHR_ROUTE_NIC)
+        return;
+
+    if (op == SHMEM_SHR_ROUTE_PUT) {
+        int ret = shmem_transport_quiet((shmem_transport_ctx_t *) SHMEM_CTX_DEFAULT);
+        if (ret)
+            RAISE_ERROR(ret);
+    } else {
+        shmem_transport_get_wait((shmem_transport_ctx_t *) SHMEM_CTX_DEFAULT);
+    }
+#endif
+}
+
+
+/* Time per transfer (ns) of len bytes with mech, best of SHR_ROUTE_CAL_REPS.
+ * Transfers are issued back to back and completed once, as a stream of
+ * nonblocking operations would be. */
+static uint64_t
+shr_route_measure(int op, int mech, char *remote, char *local, size_t len, int pe)
+{
+    uint64_t start, t, best = UINT64_MAX;
+    size_t i, iters = SHR_ROUTE_CAL_BYTES / len;
+    int rep;
+
+    if (iters < 2) iters = 2;
+    if (iters > 100) iters = 100;
+
+    shr_route_xfer(op, mech, remote, local, len, pe);
+    shr_route_complete(op, mech);
+
+    for (rep = 0; rep < SHR_ROUTE_CAL_REPS; rep++) {
+        start = shmem_internal_pcntr_now();
+        for (i = 0; i < iters; i++)
+            shr_route_xfer(op, mech, remote, local, len, pe);
+        shr_route_complete(op, mech);
+        t = (shmem_internal_pcntr_now() - start) / iters;
+        if (t < best) best = t;
+    }
+
+    return best;
+}
+
+
+static void
+shr_route_build_calibrated(int op, int dest,
+                           uint64_t times[SHMEM_SHR_ROUTE_NUM_MECH][SHMEM_SHR_ROUTE_CAL_NSIZES])
+{
+    shmem_shr_route_t *r = &shmem_shr_route_table[op][dest];
+    int i, mech, cur = -1, nsteps = 0;
+
+    for (i = 0; i < SHMEM_SHR_ROUTE_CAL_NSIZES; i++) {
+        int best = cur;
+
+        for (mech = 0; mech < SHMEM_SHR_ROUTE_NUM_MECH; mech++) {
+            if (!shr_route_reaches(mech, dest)) continue;
+            if (best == -1 ||
+                (best == cur && times[mech][i] < SHR_ROUTE_CAL_HYSTERESIS * times[cur][i]) ||
+                (best != cur && times[mech][i] < times[best][i]))
+                best = mech;
+        }
+
+        if (best != cur) {
+            if (nsteps > 0)
+                r->steps[nsteps - 1].max = shr_route_cal_size(i - 1);
+            r->steps[nsteps].mech = best;
+            nsteps++;
+            cur = best;
+        }
+    }
+
+    r->steps[nsteps - 1].max = SIZE_MAX;
+}
+
+
+/* The next PE on this node, or the calling PE if it is alone on the node */
+static int
+shr_route_peer(void)
+{
+    int size = shmem_internal_get_shr_size();
+    int rank = shmem_internal_get_shr_rank(shmem_internal_my_pe);
+    int pe;
+
+    if (size < 2 || rank < 0)
+        return shmem_internal_my_pe;
+
+    for (pe = 0; pe < shmem_internal_num_pes; pe++) {
+        if (shmem_internal_get_shr_rank(pe) == (rank + 1) % size)
+            return pe;
+    }
+
+    return shmem_internal_my_pe;
+}
+
+
+/* Collective over all PEs, which must agree on SHMEM_SHR_ROUTE_CALIBRATE */
+static void
+shr_route_calibrate(void)
+{
+    /* Indexed by whether the routes target the calling PE or a peer */
+    uint64_t times[2][SHMEM_SHR_ROUTE_NUM_OPS][SHMEM_SHR_ROUTE_NUM_MECH][SHMEM_SHR_ROUTE_CAL_NSIZES];
+    size_t max_len = shr_route_cal_size(SHMEM_SHR_ROUTE_CAL_NSIZES - 1);
+    char *remote, *local;
+    int op, dest, mech, i, self, ok = 1;
+    int pes[2] = { shmem_internal_my_pe, shr_route_peer() };
+
+    remote = shmem_internal_shmalloc(max_len);
+    local = malloc(max_len);
+    if (NULL == remote || NULL == local) {
+        RAISE_WARN_STR("Unable to allocate on-node route calibration buffers, using defaults");
+        ok = 0;
+    } else {
+        memset(remote, 0, max_len);
+        memset(local, 1, max_len);
+    }
+
+    /* Peers access our buffer from here on.  A PE that failed to allocate
+     * still takes part in the barriers; its heap is mapped in full, so a
+     * peer's transfers into it are harmless. */
+    shmem_runtime_barrier();
+
+    for (op = 0; ok && op < SHMEM_SHR_ROUTE_NUM_OPS; op++) {
+        for (self = 0; self < 2; self++) {
+            for (mech = 0; mech < SHMEM_SHR_ROUTE_NUM_MECH; mech++) {
+                int used = 0;
+
+                for (dest = 0; dest < SHMEM_SHR_ROUTE_NUM_DEST; dest++)
+                    used |= ((dest == SHMEM_SHR_ROUTE_SELF) == !self) &&
+                            shr_route_reaches(mech, dest) && !shr_route_pinned(dest);
+                if (!used) continue;
+
+                for (i = 0; i < SHMEM_SHR_ROUTE_CAL_NSIZES; i++) {
+                    times[self][op][mech][i] = shr_route_measure(op, mech, remote, local,
+                                                                 shr_route_cal_size(i),
+                                                                 pes[self]);
+                    DEBUG_MSG("Route calibration %s %s to PE %d, %zu bytes: %"PRIu64" ns\n",
+                              shr_route_op_str[op], shr_route_mech_str[mech], pes[self],
+                              shr_route_cal_size(i), times[self][op][mech][i]);
+                }
+            }
+        }
+
+        for (dest = 0; dest < SHMEM_SHR_ROUTE_NUM_DEST; dest++) {
+            if (shr_route_pinned(dest) ||
+                shmem_shr_route_table[op][dest].fallback == SHMEM_SHR_ROUTE_NIC)
+                continue;
+            shr_route_build_calibrated(op, dest,
+                                       times[dest != SHMEM_SHR_ROUTE_SELF][op]);
+        }
+    }
+
+    /* Keep our buffer until the peers are done with it */
+    shmem_runtime_barrier();
+
+    if (NULL != remote) shmem_internal_free(remote);
+    free(local);
+}
+#endif /* USE_ON_NODE_COMMS || USE_MEMCPY */
+
+
+/* Write a description of route r to str, e.g. "memfd <= 65536, nic" */
+static void
+shr_route_str(const shmem_shr_route_t *r, char *str, size_t len)
+{
+    size_t off = 0;
+    int i;
+
+    str[0] = '\0';
+    for (i = 0; off < len; i++) {
+        if (r->steps[i].max == SIZE_MAX) {
+            snprintf(str + off, len - off, "%s%s", i ? ", " : "",
+                     shr_route_mech_str[r->steps[i].mech]);
+            break;
+        }
+        off += snprintf(str + off, len - off, "%s%s <= %zu", i ? ", " : "",
+                        shr_route_mech_str[r->steps[i].mech], r->steps[i].max);
+    }
+}
+
+
+/* Record whether puts and atomics to on-node PEs are split between the
+ * network transport and shared memory */
+static void
+shr_route_set_mixed(void)
+{
+#ifdef SHMEM_SHR_ROUTE_HAVE_NIC
+    int nic = 0, shr = 0, dest, i;
+
+#ifdef USE_SHR_ATOMICS
+    shr = 1;
+#endif
+    /* Without shared memory atomics, on-node atomics take the network
+     * transport; with memfd, those outside the symmetric heap do */
+#if !defined(USE_SHR_ATOMICS) || defined(USE_MEMFD)
+    nic = 1;
+#endif
+
+    for (dest = 0; dest < SHMEM_SHR_ROUTE_NUM_DEST; dest++) {
+        const shmem_shr_route_step_t *steps = shmem_shr_route_table[SHMEM_SHR_ROUTE_PUT][dest].steps;
+
+        for (i = 0; ; i++) {
+            if (steps[i].mech == SHMEM_SHR_ROUTE_NIC)
+                nic = 1;
+            else
+                shr = 1;
+            if (steps[i].max == SIZE_MAX) break;
+        }
+    }
+
+    shmem_shr_route_mixed = nic && shr;
+#endif
+}
+
+
+int
+shmem_shr_route_init(void)
+{
+    static const int pref[] = { SHMEM_SHR_ROUTE_MEMCPY, SHMEM_SHR_ROUTE_XPMEM,
+                                SHMEM_SHR_ROUTE_MEMFD, SHMEM_SHR_ROUTE_CMA };
+    int op, dest;
+    size_t i;
+
+    for (op = 0; op < SHMEM_SHR_ROUTE_NUM_OPS; op++) {
+        for (dest = 0; dest < SHMEM_SHR_ROUTE_NUM_DEST; dest++) {
+            shmem_shr_route_t *r = &shmem_shr_route_table[op][dest];
+
+            r->fallback = SHMEM_SHR_ROUTE_NIC;
+            for (i = 0; i < sizeof(pref) / sizeof(pref[0]); i++) {
+                if (shr_route_reaches(pref[i], dest)) {
+                    r->fallback = pref[i];
+                    break;
+                }
+            }
+
+            shr_route_build_default(op, dest);
+        }
+    }
+
+#if defined(USE_ON_NODE_COMMS) || defined(USE_MEMCPY)
+    if (shmem_internal_params.SHR_ROUTE_CALIBRATE)
+        shr_route_calibrate();
+#endif
+
+    shr_route_set_mixed();
+
+    for (op = 0; op < SHMEM_SHR_ROUTE_NUM_OPS; op++) {
+        for (dest = 0; dest < SHMEM_SHR_ROUTE_NUM_DEST; dest++) {
+            char route_str[256];
+
+            shr_route_str(&shmem_shr_route_table[op][dest], route_str, sizeof(route_str));
+            DEBUG_MSG("On-node route %s %s: %s\n", shr_route_op_str[op],
+                      shr_route_dest_str[dest], route_str);
+        }
+    }
+
+    if (shmem_shr_route_mixed)
+        DEBUG_MSG("On-node puts and atomics use both the network transport and shared "
+                  "memory, fence will quiet after those through the transport\n");
+
+    return 0;
+}
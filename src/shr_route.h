@@ -0,0 +1,121 @@
+/* -*- C -*-
+ *
+ * Copyright (c) 2022 Intel Corporation. All rights reserved.
+ * This software is available to you under the BSD license.
+ *
+ * This file is part of the Sandia OpenSHMEM software package. For license
+ * information, see the LICENSE file in the top level directory of the
+ * distribution.
+ *
+ */
+
+#ifndef SHR_ROUTE_H
+#define SHR_ROUTE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "shmem_internal.h"
+
+/* Routing of puts and gets between the on-node mechanisms and the network
+ * transport.  Every on-node mechanism that was configured is registered, and
+ * each operation selects one by its class (put or get), its destination
+ * (the calling PE itself, or the symmetric heap or data segment of an
+ * on-node peer), and its size.  The crossovers between mechanisms are taken
+ * from the environment or calibrated at startup, see shr_route.c. */
+
+#if defined(USE_PORTALS4) || defined(USE_OFI) || defined(USE_UCX)
+#define SHMEM_SHR_ROUTE_HAVE_NIC 1
+#endif
+
+typedef enum {
+    SHMEM_SHR_ROUTE_NIC = 0,    /* Network transport, including loopback */
+    SHMEM_SHR_ROUTE_MEMCPY,     /* Direct copy, self-targeted only */
+    SHMEM_SHR_ROUTE_XPMEM,
+    SHMEM_SHR_ROUTE_MEMFD,
+    SHMEM_SHR_ROUTE_CMA,
+    SHMEM_SHR_ROUTE_NUM_MECH
+} shmem_shr_route_mech_t;
+
+typedef enum {
+    SHMEM_SHR_ROUTE_PUT = 0,
+    SHMEM_SHR_ROUTE_GET,
+    SHMEM_SHR_ROUTE_NUM_OPS
+} shmem_shr_route_op_t;
+
+typedef enum {
+    SHMEM_SHR_ROUTE_SELF = 0,
+    SHMEM_SHR_ROUTE_HEAP,
+    SHMEM_SHR_ROUTE_DATA,
+    SHMEM_SHR_ROUTE_NUM_DEST
+} shmem_shr_route_dest_t;
+
+/* Sizes measured by the startup calibration, 64B to 4MiB in powers of 4 */
+#define SHMEM_SHR_ROUTE_CAL_NSIZES 9
+
+typedef struct {
+    size_t max;                 /* Largest transfer taken by mech */
+    int mech;
+} shmem_shr_route_step_t;
+
+/* The last step of a route always has max == SIZE_MAX */
+typedef struct {
+    shmem_shr_route_step_t steps[SHMEM_SHR_ROUTE_CAL_NSIZES + 1];
+    int fallback;               /* On-node mechanism used when one is required */
+} shmem_shr_route_t;
+
+extern shmem_shr_route_t shmem_shr_route_table[SHMEM_SHR_ROUTE_NUM_OPS][SHMEM_SHR_ROUTE_NUM_DEST];
+
+/* Set when some on-node puts or atomics may take the network transport and
+ * others shared memory.  The transport's fence does not order the two, so each
+ * context then records whether a put or atomic to an on-node PE went through
+ * the transport since its last quiet, and a fence quiets only in that case. */
+extern int shmem_shr_route_mixed;
+
+int shmem_shr_route_init(void);
+
+
+static inline int
+shmem_shr_route_dest(const void *remote, int pe)
+{
+    if (pe == shmem_internal_my_pe)
+        return SHMEM_SHR_ROUTE_SELF;
+    else if ((char *) remote >= (char *) shmem_internal_heap_base &&
+             (char *) remote < (char *) shmem_internal_heap_base + shmem_internal_heap_length)
+        return SHMEM_SHR_ROUTE_HEAP;
+    else
+        return SHMEM_SHR_ROUTE_DATA;
+}
+
+
+/* Mechanism for a transfer of len bytes to or from remote on pe, which must
+ * be an on-node PE.  Returns SHMEM_SHR_ROUTE_NIC when the network transport
+ * is preferred. */
+static inline int
+shmem_shr_route_select(shmem_shr_route_op_t op, const void *remote, size_t len, int pe)
+{
+    const shmem_shr_route_step_t *s =
+        shmem_shr_route_table[op][shmem_shr_route_dest(remote, pe)].steps;
+
+    while (len > s->max)
+        s++;
+
+    return s->mech;
+}
+
+
+/* As shmem_shr_route_select, for callers that have already committed to the
+ * on-node path, e.g. the copy engine */
+static inline int
+shmem_shr_route_select_shr(shmem_shr_route_op_t op, const void *remote, size_t len, int pe)
+{
+    const shmem_shr_route_t *r = &shmem_shr_route_table[op][shmem_shr_route_dest(remote, pe)];
+    const shmem_shr_route_step_t *s = r->steps;
+
+    while (len > s->max)
+        s++;
+
+    return s->mech == SHMEM_SHR_ROUTE_NIC ? r->fallback : s->mech;
+}
+
+#endif /* SHR_ROUTE_H */
@@ -203,12 +203,35 @@ static void *mmap_alloc(size_t bytes)
     }
 #endif /* __linux__ */
 
+#ifdef USE_MEMFD
+    /* Back the heap with a shared file, either the huge page file or a memfd,
+     * which on-node peers map through /proc/<pid>/fd */
+    if (0 == fd)
+        fd = memfd_create("shmem-heap", MFD_CLOEXEC);
+
+    if (fd > 0 && 0 == ftruncate(fd, bytes)) {
+        ret = mmap(requested_base,
+                   bytes,
+                   PROT_READ | PROT_WRITE,
+                   MAP_SHARED,
+                   fd,
+                   0);
+        if (ret != MAP_FAILED)
+            shmem_internal_heap_fd = fd;
+    } else {
+        RAISE_WARN_MSG("Unable to create shared sym. heap file: %s\n",
+                       strerror(errno));
+        if (fd < 0) fd = 0;
+        ret = MAP_FAILED;
+    }
+#else
     ret = mmap(requested_base,
                bytes,
                PROT_READ | PROT_WRITE,
                MAP_ANON | MAP_PRIVATE,
                fd,
                0);
+#endif
     if (ret == MAP_FAILED) {
         RAISE_WARN_MSG("Unable to allocate sym. heap, size %zuB: %s\n"
                        RAISE_PE_PREFIX
@@ -219,6 +242,9 @@ static void *mmap_alloc(size_t bytes)
     if (fd) {
         if (file_name)
             unlink(file_name);
+#ifdef USE_MEMFD
+        if (fd != shmem_internal_heap_fd)
+#endif
         close(fd);
     }
     if (directory) {
@@ -258,6 +284,12 @@ shmem_internal_symmetric_fini(void)
     if (NULL != shmem_internal_heap_base) {
         if (!shmem_internal_params.SYMMETRIC_HEAP_USE_MALLOC) {
             munmap( (void*)shmem_internal_heap_base, (size_t)shmem_internal_heap_length );
+#ifdef USE_MEMFD
+            if (shmem_internal_heap_fd >= 0) {
+                close(shmem_internal_heap_fd);
+                shmem_internal_heap_fd = -1;
+            }
+#endif
         } else {
             free(shmem_internal_heap_base);
         }
@@ -144,4 +144,98 @@ shmem_transport_cma_get(void *target, const void *source, size_t len, int pe,
         }
 }
 
+
+/* Strided transfers pack up to this many blocks into the iovec lists of a
+ * single process_vm_writev/readv call (IOV_MAX is 1024 on Linux). */
+#define SHMEM_TRANSPORT_CMA_MAX_IOV 256
+
+static inline void
+shmem_transport_cma_iput(void *target, const void *source, ptrdiff_t tst,
+                         ptrdiff_t sst, size_t bsize, size_t nblocks,
+                         int pe, int noderank)
+{
+        ssize_t bytes;
+        size_t i, n;
+        struct iovec tgt[SHMEM_TRANSPORT_CMA_MAX_IOV];
+        struct iovec src[SHMEM_TRANSPORT_CMA_MAX_IOV];
+        pid_t target_pid = shmem_transport_cma_peers[noderank];
+
+        CHK_ACCESS(target,"cma_iput target");
+
+        if ( target_pid == shmem_transport_cma_my_pid ) {
+            for (i = 0; i < nblocks; i++)
+                memcpy((uint8_t *) target + i * tst,
+                       (const uint8_t *) source + i * sst, bsize);
+            return;
+        }
+
+        while (nblocks > 0) {
+            n = nblocks < SHMEM_TRANSPORT_CMA_MAX_IOV ? nblocks :
+                SHMEM_TRANSPORT_CMA_MAX_IOV;
+
+            for (i = 0; i < n; i++) {
+                tgt[i].iov_base = target;
+                src[i].iov_base = (void *) source;
+                tgt[i].iov_len = src[i].iov_len = bsize;
+                target = (uint8_t *) target + tst;
+                source = (const uint8_t *) source + sst;
+            }
+
+            bytes = process_vm_writev(target_pid, src, n, tgt, n, 0);
+
+            if ( bytes < 0 || (size_t) bytes != n * bsize) {
+                char errmsg[256];
+                RAISE_ERROR_MSG("process_vm_writev() failed (%s)\n",
+                                shmem_util_strerror(errno, errmsg, 256));
+            }
+
+            nblocks -= n;
+        }
+}
+
+
+static inline void
+shmem_transport_cma_iget(void *target, const void *source, ptrdiff_t tst,
+                         ptrdiff_t sst, size_t bsize, size_t nblocks,
+                         int pe, int noderank)
+{
+        ssize_t bytes;
+        size_t i, n;
+        struct iovec tgt[SHMEM_TRANSPORT_CMA_MAX_IOV];
+        struct iovec src[SHMEM_TRANSPORT_CMA_MAX_IOV];
+        pid_t target_pid = shmem_transport_cma_peers[noderank];
+
+        CHK_ACCESS(source,"cma_iget source");
+
+        if ( target_pid == shmem_transport_cma_my_pid ) {
+            for (i = 0; i < nblocks; i++)
+                memcpy((uint8_t *) target + i * tst,
+                       (const uint8_t *) source + i * sst, bsize);
+            return;
+        }
+
+        while (nblocks > 0) {
+            n = nblocks < SHMEM_TRANSPORT_CMA_MAX_IOV ? nblocks :
+                SHMEM_TRANSPORT_CMA_MAX_IOV;
+
+            for (i = 0; i < n; i++) {
+                tgt[i].iov_base = target;
+                src[i].iov_base = (void *) source;
+                tgt[i].iov_len = src[i].iov_len = bsize;
+                target = (uint8_t *) target + tst;
+                source = (const uint8_t *) source + sst;
+            }
+
+            bytes = process_vm_readv(target_pid, tgt, n, src, n, 0);
+
+            if ( bytes < 0 || (size_t) bytes != n * bsize) {
+                char errmsg[256];
+                RAISE_ERROR_MSG("process_vm_readv() failed (%s)\n",
+                                shmem_util_strerror(errno, errmsg, 256));
+            }
+
+            nblocks -= n;
+        }
+}
+
 #endif /* SHMEM_TRANSPORT_CMA_H */
@@ -0,0 +1,157 @@
+/* -*- C -*-
+ *
+ * Copyright (c) 2022 Intel Corporation. All rights reserved.
+ * This software is available to you under the BSD license.
+ *
+ * This file is part of the Sandia OpenSHMEM software package. For license
+ * information, see the LICENSE file in the top level directory of the
+ * distribution.
+ *
+ */
+
+#include "config.h"
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#define SHMEM_INTERNAL_INCLUDE
+#include "shmem.h"
+#include "shmem_internal.h"
+#include "transport_memfd.h"
+#include "runtime.h"
+
+char **shmem_transport_memfd_heap_ptrs = NULL;
+static size_t *shmem_transport_memfd_heap_lens = NULL;
+
+/* Peers reopen the heap memfd through /proc/<pid>/fd/<fd> */
+typedef struct pmi_memfd_data {
+    pid_t           lpid;
+    int             fd;
+} pmi_memfd_data_t;
+
+
+int
+shmem_transport_memfd_init(void)
+{
+    int ret;
+    pmi_memfd_data_t memfd_data;
+
+    if (shmem_internal_heap_fd < 0) {
+        RETURN_ERROR_STR("memfd transport requires an mmap'ed symmetric heap "
+                         "(unset SHMEM_SYMMETRIC_HEAP_USE_MALLOC)");
+        return 1;
+    }
+
+    memfd_data.lpid = getpid();
+    memfd_data.fd   = shmem_internal_heap_fd;
+
+    ret = shmem_runtime_put("memfd-heap", &memfd_data, sizeof(pmi_memfd_data_t));
+    if (0 != ret) {
+        RETURN_ERROR_MSG("runtime_put failed: %d\n", ret);
+    }
+
+    return ret;
+}
+
+
+int
+shmem_transport_memfd_startup(void)
+{
+    int i, ret, fd, peer_num, num_on_node;
+    pmi_memfd_data_t memfd_data;
+    struct stat st;
+    char path[64];
+    char errmsg[256];
+    void *heap;
+
+    num_on_node = shmem_runtime_get_node_size();
+
+    shmem_transport_memfd_heap_ptrs = calloc(num_on_node, sizeof(char *));
+    shmem_transport_memfd_heap_lens = calloc(num_on_node, sizeof(size_t));
+    if (NULL == shmem_transport_memfd_heap_ptrs ||
+        NULL == shmem_transport_memfd_heap_lens) return 1;
+
+    for (i = 0 ; i < shmem_internal_num_pes; ++i) {
+        peer_num = shmem_runtime_get_node_rank(i);
+        if (-1 == peer_num) continue;
+
+        if (i == shmem_internal_my_pe) {
+            shmem_transport_memfd_heap_ptrs[peer_num] = shmem_internal_heap_base;
+            continue;
+        }
+
+        ret = shmem_runtime_get(i, "memfd-heap", &memfd_data,
+                                sizeof(pmi_memfd_data_t));
+        if (0 != ret) {
+            RETURN_ERROR_MSG("runtime_get failed: %d\n", ret);
+            return 1;
+        }
+
+        snprintf(path, sizeof(path), "/proc/%d/fd/%d", (int) memfd_data.lpid,
+                 memfd_data.fd);
+
+        fd = open(path, O_RDWR | O_CLOEXEC);
+        if (fd < 0) {
+            RETURN_ERROR_MSG("Unable to open heap of PE %d (%s)\n", i,
+                             shmem_util_strerror(errno, errmsg, 256));
+            return 1;
+        }
+
+        /* The heap file may be rounded up to the huge page size */
+        if (0 != fstat(fd, &st)) {
+            RETURN_ERROR_MSG("Unable to stat heap of PE %d (%s)\n", i,
+                             shmem_util_strerror(errno, errmsg, 256));
+            close(fd);
+            return 1;
+        }
+
+        heap = mmap(NULL, (size_t) st.st_size, PROT_READ | PROT_WRITE,
+                    MAP_SHARED, fd, 0);
+        close(fd);
+
+        if (MAP_FAILED == heap) {
+            RETURN_ERROR_MSG("Unable to map heap of PE %d (%s)\n", i,
+                             shmem_util_strerror(errno, errmsg, 256));
+            return 1;
+        }
+
+        shmem_transport_memfd_heap_ptrs[peer_num] = heap;
+        shmem_transport_memfd_heap_lens[peer_num] = (size_t) st.st_size;
+    }
+
+    return 0;
+}
+
+
+int
+shmem_transport_memfd_fini(void)
+{
+    int i;
+
+    if (NULL != shmem_transport_memfd_heap_ptrs) {
+        for (i = 0; i < shmem_runtime_get_node_size(); i++) {
+            if (NULL != shmem_transport_memfd_heap_ptrs[i] &&
+                0 != shmem_transport_memfd_heap_lens[i])
+                munmap(shmem_transport_memfd_heap_ptrs[i],
+                       shmem_transport_memfd_heap_lens[i]);
+        }
+        free(shmem_transport_memfd_heap_ptrs);
+        shmem_transport_memfd_heap_ptrs = NULL;
+    }
+
+    free(shmem_transport_memfd_heap_lens);
+    shmem_transport_memfd_heap_lens = NULL;
+
+    return 0;
+}
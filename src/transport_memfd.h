@@ -0,0 +1,152 @@
+/* -*- C -*-
+ *
+ * Copyright (c) 2022 Intel Corporation. All rights reserved.
+ * This software is available to you under the BSD license.
+ *
+ * This file is part of the Sandia OpenSHMEM software package. For license
+ * information, see the LICENSE file in the top level directory of the
+ * distribution.
+ *
+ */
+
+#ifndef TRANSPORT_MEMFD_H
+#define TRANSPORT_MEMFD_H
+
+#include <string.h>
+#include <stddef.h>
+#include <inttypes.h>
+
+#include "shmem_internal.h"
+#include "shmem_copy.h"
+
+#ifdef USE_CMA
+#include "transport_cma.h"
+#endif
+
+/* Each PE backs its symmetric heap with a memfd, which every on-node peer maps
+ * into its own address space.  Heap accesses to on-node peers are then plain
+ * loads and stores.  The data segment cannot be shared this way; accesses to
+ * it use CMA when available and otherwise the network transport. */
+extern char **shmem_transport_memfd_heap_ptrs;
+
+int shmem_transport_memfd_init(void);
+
+int shmem_transport_memfd_startup(void);
+
+int shmem_transport_memfd_fini(void);
+
+
+static inline
+int
+shmem_transport_memfd_in_heap(const void *target, size_t len)
+{
+    return (char *) target >= (char *) shmem_internal_heap_base &&
+           (char *) target + len <= (char *) shmem_internal_heap_base +
+                                    shmem_internal_heap_length;
+}
+
+
+static inline
+void *
+shmem_transport_memfd_ptr(const void *target, int noderank)
+{
+    if (!shmem_transport_memfd_in_heap(target, 0))
+        return NULL;
+
+    return shmem_transport_memfd_heap_ptrs[noderank] +
+           ((char *) target - (char *) shmem_internal_heap_base);
+}
+
+
+static inline
+void
+shmem_transport_memfd_put(void *target, const void *source, size_t len,
+                          int pe, int noderank)
+{
+    if (shmem_transport_memfd_in_heap(target, len)) {
+        shmem_internal_memcpy(shmem_transport_memfd_ptr(target, noderank),
+                              source, len);
+    } else {
+#ifdef USE_CMA
+        shmem_transport_cma_put(target, source, len, pe, noderank);
+#else
+        RAISE_ERROR_MSG("target (0x%"PRIXPTR") outside of symmetric heap\n",
+                        (uintptr_t) target);
+#endif
+    }
+}
+
+
+static inline
+void
+shmem_transport_memfd_get(void *target, const void *source, size_t len,
+                          int pe, int noderank)
+{
+    if (shmem_transport_memfd_in_heap(source, len)) {
+        shmem_internal_memcpy(target,
+                              shmem_transport_memfd_ptr(source, noderank), len);
+    } else {
+#ifdef USE_CMA
+        shmem_transport_cma_get(target, source, len, pe, noderank);
+#else
+        RAISE_ERROR_MSG("source (0x%"PRIXPTR") outside of symmetric heap\n",
+                        (uintptr_t) source);
+#endif
+    }
+}
+
+
+static inline
+void
+shmem_transport_memfd_iput(void *target, const void *source, ptrdiff_t tst,
+                           ptrdiff_t sst, size_t bsize, size_t nblocks,
+                           int pe, int noderank)
+{
+    char *remote_ptr;
+
+    if (shmem_transport_memfd_in_heap(target, (nblocks - 1) * tst + bsize)) {
+        remote_ptr = shmem_transport_memfd_ptr(target, noderank);
+        for ( ; nblocks > 0 ; --nblocks) {
+            memcpy(remote_ptr, source, bsize);
+            remote_ptr += tst;
+            source = (const uint8_t *) source + sst;
+        }
+    } else {
+#ifdef USE_CMA
+        shmem_transport_cma_iput(target, source, tst, sst, bsize, nblocks,
+                                 pe, noderank);
+#else
+        RAISE_ERROR_MSG("target (0x%"PRIXPTR") outside of symmetric heap\n",
+                        (uintptr_t) target);
+#endif
+    }
+}
+
+
+static inline
+void
+shmem_transport_memfd_iget(void *target, const void *source, ptrdiff_t tst,
+                           ptrdiff_t sst, size_t bsize, size_t nblocks,
+                           int pe, int noderank)
+{
+    char *remote_ptr;
+
+    if (shmem_transport_memfd_in_heap(source, (nblocks - 1) * sst + bsize)) {
+        remote_ptr = shmem_transport_memfd_ptr(source, noderank);
+        for ( ; nblocks > 0 ; --nblocks) {
+            memcpy(target, remote_ptr, bsize);
+            remote_ptr += sst;
+            target = (uint8_t *) target + tst;
+        }
+    } else {
+#ifdef USE_CMA
+        shmem_transport_cma_iget(target, source, tst, sst, bsize, nblocks,
+                                 pe, noderank);
+#else
+        RAISE_ERROR_MSG("source (0x%"PRIXPTR") outside of symmetric heap\n",
+                        (uintptr_t) source);
+#endif
+    }
+}
+
+#endif
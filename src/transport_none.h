@@ -33,11 +33,11 @@ enum shm_internal_op_t {
 };
 
 typedef enum shm_internal_op_t shm_internal_op_t;
-typedef int shmem_transport_ct_t;
 
 struct shmem_transport_ctx_t {
     long options;
     struct shmem_internal_team_t *team;
+    struct shmem_internal_pcntr_ctx_t *pcntr_stats;
 };
 typedef struct shmem_transport_ctx_t shmem_transport_ctx_t;
 
@@ -78,6 +78,7 @@ shmem_transport_ctx_create(struct shmem_internal_team_t *team, long options, shm
 
     (*ctx)->team = team;
     (*ctx)->options = 0;
+    (*ctx)->pcntr_stats = NULL;
 
     return 0;
 }
@@ -96,6 +97,13 @@ shmem_transport_ctx_destroy(shmem_transport_ctx_t *ctx)
     return;
 }
 
+static inline
+int
+shmem_transport_ctx_reuse(shmem_transport_ctx_t *ctx)
+{
+    return 0;
+}
+
 static inline
 int
 shmem_transport_quiet(shmem_transport_ctx_t* ctx)
@@ -110,6 +118,20 @@ shmem_transport_fence(shmem_transport_ctx_t* ctx)
     return 0;
 }
 
+static inline
+int
+shmem_transport_quiet_pe(shmem_transport_ctx_t* ctx, int pe)
+{
+    return 0;
+}
+
+static inline
+int
+shmem_transport_fence_pe(shmem_transport_ctx_t* ctx, int pe)
+{
+    return 0;
+}
+
 static inline
 void
 shmem_transport_put_scalar(shmem_transport_ctx_t* ctx, void *target, const void *source, size_t len, int pe)
@@ -162,6 +184,33 @@ shmem_transport_get_wait(shmem_transport_ctx_t* ctx)
     /* Nop */
 }
 
+static inline
+int
+shmem_transport_get_test(shmem_transport_ctx_t* ctx)
+{
+    return 1;
+}
+
+
+static inline
+void
+shmem_transport_iput(shmem_transport_ctx_t* ctx, void *target, const void *source,
+                     ptrdiff_t tst, ptrdiff_t sst, size_t bsize, size_t nblocks,
+                     int pe, long *completion)
+{
+    RAISE_ERROR_STR("No path to peer");
+}
+
+
+static inline
+void
+shmem_transport_iget(shmem_transport_ctx_t* ctx, void *target, const void *source,
+                     ptrdiff_t tst, ptrdiff_t sst, size_t bsize, size_t nblocks,
+                     int pe)
+{
+    RAISE_ERROR_STR("No path to peer");
+}
+
 
 static inline
 void
@@ -240,70 +289,42 @@ shmem_transport_fetch_atomic_nbi(shmem_transport_ctx_t* ctx, void *target, const
 
 static inline
 void
-shmem_transport_atomic_fetch(shmem_transport_ctx_t* ctx, void *target, const void *source, size_t len,
-                             int pe, shm_internal_datatype_t datatype)
+shmem_transport_fetch_atomic_batch(shmem_transport_ctx_t* ctx, void *const *target, const void *source,
+                                   void *dest, size_t len, const int *pe, size_t count,
+                                   shm_internal_op_t op, shm_internal_datatype_t datatype)
 {
     RAISE_ERROR_STR("No path to peer");
 }
 
 static inline
 void
-shmem_transport_atomic_set(shmem_transport_ctx_t* ctx, void *target, const void *source, size_t len,
-                             int pe, shm_internal_datatype_t datatype)
-{
-    RAISE_ERROR_STR("No path to peer");
-}
-
-static inline
-int shmem_transport_atomic_supported(shm_internal_op_t op, shm_internal_datatype_t datatype)
-{
-    return 0;
-}
-
-static inline
-void shmem_transport_ct_create(shmem_transport_ct_t **ct_ptr)
-{
-    RAISE_ERROR_STR("No path to peer");
-}
-
-static inline
-void shmem_transport_ct_free(shmem_transport_ct_t **ct_ptr)
+shmem_transport_cswap_batch(shmem_transport_ctx_t* ctx, void *const *target, const void *source,
+                            void *dest, const void *operand, size_t len, const int *pe,
+                            size_t count, shm_internal_datatype_t datatype)
 {
     RAISE_ERROR_STR("No path to peer");
 }
 
 static inline
-long shmem_transport_ct_get(shmem_transport_ct_t *ct)
-{
-    RAISE_ERROR_STR("No path to peer");
-    return 0;
-}
-
-static inline
-void shmem_transport_ct_set(shmem_transport_ct_t *ct, long value)
-{
-    RAISE_ERROR_STR("No path to peer");
-}
-
-static inline
-void shmem_transport_ct_wait(shmem_transport_ct_t *ct, long wait_for)
+void
+shmem_transport_atomic_fetch(shmem_transport_ctx_t* ctx, void *target, const void *source, size_t len,
+                             int pe, shm_internal_datatype_t datatype)
 {
     RAISE_ERROR_STR("No path to peer");
 }
 
 static inline
 void
-shmem_transport_put_ct_nb(shmem_transport_ct_t *ct, void *target, const void
-                          *source, size_t len, int pe, long *completion)
+shmem_transport_atomic_set(shmem_transport_ctx_t* ctx, void *target, const void *source, size_t len,
+                             int pe, shm_internal_datatype_t datatype)
 {
     RAISE_ERROR_STR("No path to peer");
 }
 
 static inline
-void shmem_transport_get_ct(shmem_transport_ct_t *ct, void
-                            *target, const void *source, size_t len, int pe)
+int shmem_transport_atomic_supported(shm_internal_op_t op, shm_internal_datatype_t datatype)
 {
-    RAISE_ERROR_STR("No path to peer");
+    return 0;
 }
 
 /**
@@ -103,6 +103,11 @@ long                            shmem_transport_ofi_get_poll_limit;
 size_t                          shmem_transport_ofi_max_buffered_send;
 size_t                          shmem_transport_ofi_max_msg_size;
 size_t                          shmem_transport_ofi_bounce_buffer_size;
+size_t                          shmem_transport_ofi_max_iov;
+#if WANT_TOTAL_DATA_ORDERING != 0
+int                             shmem_transport_ofi_total_data_ordering = 0;
+size_t                          shmem_transport_ofi_max_ordered_size = 0;
+#endif
 long                            shmem_transport_ofi_max_bounce_buffers;
 size_t                          shmem_transport_ofi_addrlen;
 #ifdef ENABLE_MR_RMA_EVENT
@@ -372,7 +377,8 @@ uint64_t shmem_transport_ofi_max_poll = (1ULL<<30);
 
 enum stx_allocator_t {
     ROUNDROBIN = 0,
-    RANDOM
+    RANDOM,
+    LOAD
 };
 typedef enum stx_allocator_t stx_allocator_t;
 static stx_allocator_t shmem_transport_ofi_stx_allocator;
@@ -384,6 +390,10 @@ struct shmem_transport_ofi_stx_t {
     struct fid_stx*   stx;
     long              ref_cnt;
     int               is_private;
+    /* Used by the load allocator: the NUMA node of the thread that first
+     * bound a context to the STX, and the contexts bound to it */
+    int               numa_node;
+    shmem_transport_ctx_t *ctx_list;
 };
 typedef struct shmem_transport_ofi_stx_t shmem_transport_ofi_stx_t;
 static shmem_transport_ofi_stx_t* shmem_transport_ofi_stx_pool = NULL;
@@ -423,6 +433,126 @@ int shmem_transport_ofi_is_private(long options) {
     }
 }
 
+/* NUMA node of the calling thread, or -1 if unknown */
+static inline
+int shmem_transport_ofi_stx_numa_node(void)
+{
+    int node = -1;
+#ifdef USE_HWLOC
+    hwloc_bitmap_t cpuset = hwloc_bitmap_alloc();
+    hwloc_obj_t obj = NULL;
+    int cpu;
+
+    if (cpuset == NULL) return -1;
+
+    if (hwloc_get_last_cpu_location(shmem_internal_topology, cpuset,
+                                    HWLOC_CPUBIND_THREAD) == 0 &&
+        (cpu = hwloc_bitmap_first(cpuset)) >= 0) {
+        while ((obj = hwloc_get_next_obj_by_type(shmem_internal_topology,
+                                                 HWLOC_OBJ_NUMANODE, obj)) != NULL) {
+            if (obj->cpuset && hwloc_bitmap_isset(obj->cpuset, cpu)) {
+                node = (int) obj->logical_index;
+                break;
+            }
+        }
+    }
+
+    hwloc_bitmap_free(cpuset);
+#endif
+    return node;
+}
+
+/* Operations issued on the STX by its contexts since the last call.  Reads
+ * the pending counters of other threads' contexts without their locks, so
+ * the result is approximate. */
+static inline
+uint64_t shmem_transport_ofi_stx_load(shmem_transport_ofi_stx_t *stx)
+{
+    uint64_t load = 0;
+    shmem_transport_ctx_t *ctx;
+
+    for (ctx = stx->ctx_list; ctx != NULL; ctx = ctx->stx_next) {
+        uint64_t issued = SHMEM_TRANSPORT_OFI_CNTR_READ(&ctx->pending_put_cntr) +
+                          SHMEM_TRANSPORT_OFI_CNTR_READ(&ctx->pending_get_cntr);
+        load += issued - ctx->stx_issued_sample;
+        ctx->stx_issued_sample = issued;
+    }
+
+    return load;
+}
+
+static inline
+void shmem_transport_ofi_stx_bind(shmem_transport_ctx_t *ctx, int stx_idx)
+{
+    shmem_transport_ofi_stx_t *stx = &shmem_transport_ofi_stx_pool[stx_idx];
+
+    if (stx->ref_cnt == 0)
+        stx->numa_node = shmem_transport_ofi_stx_numa_node();
+
+    ctx->stx_idx = stx_idx;
+    ctx->stx_issued_sample = SHMEM_TRANSPORT_OFI_CNTR_READ(&ctx->pending_put_cntr) +
+                             SHMEM_TRANSPORT_OFI_CNTR_READ(&ctx->pending_get_cntr);
+    ctx->stx_next = stx->ctx_list;
+    stx->ctx_list = ctx;
+    stx->ref_cnt++;
+}
+
+static inline
+void shmem_transport_ofi_stx_unbind(shmem_transport_ctx_t *ctx)
+{
+    shmem_transport_ofi_stx_t *stx = &shmem_transport_ofi_stx_pool[ctx->stx_idx];
+    shmem_transport_ctx_t **p;
+
+    for (p = &stx->ctx_list; *p != NULL; p = &(*p)->stx_next) {
+        if (*p == ctx) {
+            *p = ctx->stx_next;
+            break;
+        }
+    }
+
+    ctx->stx_next = NULL;
+    stx->ref_cnt--;
+    if (stx->ref_cnt == 0)
+        stx->numa_node = -1;
+}
+
+/* Select the least loaded STX among those that are shared and hold at most
+ * threshold contexts.  Load ties are broken in favor of STXs whose contexts
+ * run on the calling thread's NUMA node, then by the number of contexts. */
+static inline
+int shmem_transport_ofi_stx_search_load(long threshold, int exclude_idx,
+                                        uint64_t *best_load_out)
+{
+    int stx_idx = -1, best_remote = 0, i;
+    uint64_t best_load = 0;
+    int node = shmem_transport_ofi_stx_numa_node();
+
+    for (i = 0; i < shmem_transport_ofi_stx_max; i++) {
+        shmem_transport_ofi_stx_t *stx = &shmem_transport_ofi_stx_pool[i];
+        uint64_t load;
+        int remote;
+
+        if (i == exclude_idx || stx->ref_cnt == 0 || stx->is_private ||
+            (threshold != -1 && stx->ref_cnt > threshold))
+            continue;
+
+        load = shmem_transport_ofi_stx_load(stx);
+        remote = (node >= 0 && stx->numa_node >= 0 && stx->numa_node != node);
+
+        if (stx_idx < 0 || load < best_load ||
+            (load == best_load && remote < best_remote) ||
+            (load == best_load && remote == best_remote &&
+             stx->ref_cnt < shmem_transport_ofi_stx_pool[stx_idx].ref_cnt)) {
+            stx_idx = i;
+            best_load = load;
+            best_remote = remote;
+        }
+    }
+
+    if (best_load_out) *best_load_out = best_load;
+    return stx_idx;
+}
+
 static unsigned int rand_pool_seed;
 
 static inline
@@ -495,6 +625,11 @@ int shmem_transport_ofi_stx_search_shared(long threshold)
             }
 
             break;
+
+        case LOAD:
+            stx_idx = shmem_transport_ofi_stx_search_load(threshold, -1, NULL);
+            break;
+
         default:
             RAISE_ERROR_MSG("Invalid STX allocator (%d)\n",
                             shmem_transport_ofi_stx_allocator);
@@ -519,8 +654,7 @@ void shmem_transport_ofi_stx_allocate(shmem_transport_ctx_t *ctx)
                   &ctx->tid, sizeof(struct shmem_internal_tid), f);
 
         if (f) {
-            shmem_transport_ofi_stx_pool[f->stx_idx].ref_cnt++;
-            ctx->stx_idx = f->stx_idx;
+            shmem_transport_ofi_stx_bind(ctx, f->stx_idx);
 
         } else {
             /* No STX allocated to the given TID, attempt to allocate one */
@@ -542,8 +676,7 @@ void shmem_transport_ofi_stx_allocate(shmem_transport_ctx_t *ctx)
 
             shmem_internal_assert(stx_idx >= 0);
             stx = &shmem_transport_ofi_stx_pool[stx_idx];
-            ctx->stx_idx = stx_idx;
-            stx->ref_cnt++;
+            shmem_transport_ofi_stx_bind(ctx, stx_idx);
 
             if (is_unused) {
                 stx->is_private = 1;
@@ -570,8 +703,7 @@ void shmem_transport_ofi_stx_allocate(shmem_transport_ctx_t *ctx)
             stx_idx = shmem_transport_ofi_stx_search_shared(-1);
 
         shmem_internal_assert(stx_idx >= 0);
-        ctx->stx_idx = stx_idx;
-        shmem_transport_ofi_stx_pool[ctx->stx_idx].ref_cnt++;
+        shmem_transport_ofi_stx_bind(ctx, stx_idx);
     }
 
     shmem_transport_ofi_dump_stx();
@@ -1519,6 +1651,9 @@ int query_for_fabric(struct fabric_info *info)
     ep_attr.tx_ctx_cnt        = 0;
     hints.fabric_attr         = &fabric_attr;
     tx_attr.op_flags          = FI_DELIVERY_COMPLETE;
+#if WANT_TOTAL_DATA_ORDERING == 1
+    tx_attr.msg_order         = SHMEM_TRANSPORT_OFI_ORDER;
+#endif
     tx_attr.inject_size       = shmem_transport_ofi_max_buffered_send; /* require provider to support this as a min */
     hints.tx_attr             = &tx_attr; /* TODO: fill tx_attr */
     hints.rx_attr             = NULL;
@@ -1646,14 +1781,40 @@ int query_for_fabric(struct fabric_info *info)
     shmem_transport_ofi_mr_rma_event = (info->p_info->domain_attr->mr_mode & FI_MR_RMA_EVENT) != 0;
 #endif
 
+#if WANT_TOTAL_DATA_ORDERING != 0
+    /* Fence relies on write ordering only for writes the provider can order,
+     * which must at least include injected writes */
+    if ((info->p_info->tx_attr->msg_order & SHMEM_TRANSPORT_OFI_ORDER) == SHMEM_TRANSPORT_OFI_ORDER &&
+        info->p_info->ep_attr->max_order_waw_size >= shmem_transport_ofi_max_buffered_send) {
+        shmem_transport_ofi_total_data_ordering = 1;
+        shmem_transport_ofi_max_ordered_size = info->p_info->ep_attr->max_order_waw_size;
+        DEBUG_MSG("OFI provider orders writes up to %zu bytes\n",
+                  shmem_transport_ofi_max_ordered_size);
+    } else if (1 == WANT_TOTAL_DATA_ORDERING) {
+        RAISE_WARN_STR("Total data ordering feature enabled, but the OFI provider "
+                       "does not support FI_ORDER_WAW");
+        return 1;
+    }
+#endif
+
+    /* Strided RMA places one block per IOV entry on both sides, so it is
+     * bounded by the smaller of the local and remote IOV limits */
+    shmem_transport_ofi_max_iov = MIN(info->p_info->tx_attr->iov_limit,
+                                      info->p_info->tx_attr->rma_iov_limit);
+    shmem_transport_ofi_max_iov = MIN(shmem_transport_ofi_max_iov,
+                                      SHMEM_TRANSPORT_OFI_MAX_IOV);
+    if (shmem_transport_ofi_max_iov == 0)
+        shmem_transport_ofi_max_iov = 1;
+
     DEBUG_MSG("OFI provider: %s, fabric: %s, domain: %s, mr_mode: 0x%x\n"
-              RAISE_PE_PREFIX "max_inject: %zu, max_msg: %zu, stx: %s, stx_max: %ld, num_nics: %d\n",
+              RAISE_PE_PREFIX "max_inject: %zu, max_msg: %zu, max_iov: %zu, stx: %s, stx_max: %ld, num_nics: %d\n",
               info->p_info->fabric_attr->prov_name,
               info->p_info->fabric_attr->name, info->p_info->domain_attr->name,
               info->p_info->domain_attr->mr_mode,
               shmem_internal_my_pe,
               shmem_transport_ofi_max_buffered_send,
               shmem_transport_ofi_max_msg_size,
+              shmem_transport_ofi_max_iov,
               info->p_info->domain_attr->max_ep_stx_ctx == 0 ? "no" : "yes",
               shmem_transport_ofi_stx_max,
               num_nics);
@@ -1853,6 +2014,8 @@ int shmem_transport_init(void)
     } else if (0 == strcmp(type, "random")) {
         shmem_transport_ofi_stx_allocator = RANDOM;
         shmem_transport_ofi_stx_rand_init();
+    } else if (0 == strcmp(type, "load")) {
+        shmem_transport_ofi_stx_allocator = LOAD;
     } else {
         RAISE_WARN_MSG("Ignoring bad STX share algorithm '%s', using 'round-robin'\n", type);
         shmem_transport_ofi_stx_allocator = ROUNDROBIN;
@@ -1963,6 +2126,8 @@ int shmem_transport_startup(void)
         OFI_CHECK_RETURN_MSG(ret, "STX context creation failed (%s)\n", fi_strerror(ret));
         shmem_transport_ofi_stx_pool[i].ref_cnt = 0;
         shmem_transport_ofi_stx_pool[i].is_private = 0;
+        shmem_transport_ofi_stx_pool[i].numa_node = -1;
+        shmem_transport_ofi_stx_pool[i].ctx_list = NULL;
     }
 
     shmem_transport_ctx_default.team = &shmem_internal_team_world;
@@ -2044,6 +2209,73 @@ int shmem_transport_ctx_create(struct shmem_internal_team_t *team, long options,
 
 }
 
+/* Called when the context pool hands out an idle, quiesced context.  Under the
+ * load allocator, a shared context is moved to an unused STX if it shares its
+ * STX with others, or to a less loaded or closer STX, by recreating its
+ * endpoint. */
+int shmem_transport_ctx_reuse(shmem_transport_ctx_t *ctx)
+{
+    int ret = 0, stx_idx = -1, node, cur_remote, best_remote;
+    uint64_t cur_load, best_load;
+    shmem_transport_ofi_stx_t *cur;
+
+    if (shmem_transport_ofi_stx_allocator != LOAD || ctx->stx_idx < 0 ||
+        shmem_transport_ofi_is_private(ctx->options))
+        return 0;
+
+    SHMEM_MUTEX_LOCK(shmem_transport_ofi_lock);
+
+    cur = &shmem_transport_ofi_stx_pool[ctx->stx_idx];
+
+    if (cur->ref_cnt > 1)
+        stx_idx = shmem_transport_ofi_stx_search_unused();
+
+    if (stx_idx < 0) {
+        node = shmem_transport_ofi_stx_numa_node();
+        cur_load = shmem_transport_ofi_stx_load(cur);
+        stx_idx = shmem_transport_ofi_stx_search_load(-1, ctx->stx_idx, &best_load);
+
+        if (stx_idx >= 0) {
+            cur_remote = (node >= 0 && cur->numa_node >= 0 && cur->numa_node != node);
+            best_remote = (node >= 0 && shmem_transport_ofi_stx_pool[stx_idx].numa_node >= 0 &&
+                           shmem_transport_ofi_stx_pool[stx_idx].numa_node != node);
+
+            if (!(best_load * 2 < cur_load ||
+                  (cur_remote && !best_remote && best_load <= cur_load)))
+                stx_idx = -1;
+        }
+    }
+
+    if (stx_idx >= 0) {
+        DEBUG_MSG("Moving ctx %d from STX %d to STX %d\n", ctx->id, ctx->stx_idx, stx_idx);
+
+        ret = fi_close(&ctx->ep->fid);
+        OFI_CHECK_ERROR_MSG(ret, "Context endpoint close failed (%s)\n", fi_strerror(errno));
+        ctx->ep = NULL;
+
+        shmem_transport_ofi_stx_unbind(ctx);
+
+        ret = fi_endpoint(shmem_transport_ofi_domainfd,
+                          shmem_transport_ofi_info.p_info, &ctx->ep, NULL);
+        if (ret == 0) {
+            shmem_transport_ofi_stx_bind(ctx, stx_idx);
+            ret = bind_enable_ep_resources(ctx);
+        } else {
+            ctx->ep = NULL;
+            ctx->stx_idx = -1;
+        }
+
+        shmem_transport_ofi_dump_stx();
+    }
+
+    SHMEM_MUTEX_UNLOCK(shmem_transport_ofi_lock);
+
+    if (ret)
+        RETURN_ERROR_MSG("Context endpoint rebind failed (%s)\n", fi_strerror(errno));
+
+    return ret;
+}
+
 void shmem_transport_ctx_destroy(shmem_transport_ctx_t *ctx)
 {
     int ret;
@@ -2089,7 +2321,7 @@ void shmem_transport_ctx_destroy(shmem_transport_ctx_t *ctx)
                       sizeof(struct shmem_internal_tid), e);
             if (e) {
                 shmem_transport_ofi_stx_t *stx = &shmem_transport_ofi_stx_pool[ctx->stx_idx];
-                stx->ref_cnt--;
+                shmem_transport_ofi_stx_unbind(ctx);
                 if (stx->ref_cnt == 0) {
                     HASH_DEL(shmem_transport_ofi_stx_kvs, e);
                     free(e);
@@ -2100,7 +2332,7 @@ void shmem_transport_ctx_destroy(shmem_transport_ctx_t *ctx)
                 RAISE_WARN_STR("Unable to locate private STX");
             }
         } else {
-            shmem_transport_ofi_stx_pool[ctx->stx_idx].ref_cnt--;
+            shmem_transport_ofi_stx_unbind(ctx);
             if (shmem_transport_ofi_stx_pool[ctx->stx_idx].is_private) {
                 SHMEM_MUTEX_UNLOCK(shmem_transport_ofi_lock);
                 RAISE_ERROR_STR("Destroyed a ctx with an inconsistent is_private field");
@@ -69,6 +69,11 @@ extern long                             shmem_transport_ofi_get_poll_limit;
 extern size_t                           shmem_transport_ofi_max_buffered_send;
 extern size_t                           shmem_transport_ofi_max_msg_size;
 extern size_t                           shmem_transport_ofi_bounce_buffer_size;
+extern size_t                           shmem_transport_ofi_max_iov;
+#if WANT_TOTAL_DATA_ORDERING != 0
+extern int                              shmem_transport_ofi_total_data_ordering;
+extern size_t                           shmem_transport_ofi_max_ordered_size;
+#endif
 extern long                             shmem_transport_ofi_max_bounce_buffers;
 
 extern pthread_mutex_t                  shmem_transport_ofi_progress_lock;
@@ -266,6 +271,9 @@ typedef enum fi_op       shm_internal_op_t;
 #define SHMEM_TRANSPORT_OFI_TYPE_BOUNCE 0x01
 #define SHMEM_TRANSPORT_OFI_TYPE_LONG   0x02
 
+/* Upper bound on the IOV entries used by a single strided RMA message */
+#define SHMEM_TRANSPORT_OFI_MAX_IOV     64
+
 
 extern fi_addr_t *addr_table;
 
@@ -297,8 +305,6 @@ struct shmem_transport_ofi_bounce_buffer_t {
 
 typedef struct shmem_transport_ofi_bounce_buffer_t shmem_transport_ofi_bounce_buffer_t;
 
-typedef int shmem_transport_ct_t;
-
 enum shmem_internal_tid_t { tid_is_pid_t, tid_is_uint64_t };
 struct shmem_internal_tid
 {
@@ -333,8 +339,21 @@ struct shmem_transport_ctx_t {
     uint64_t                        completed_bb_cntr;
     shmem_free_list_t              *bounce_buffers;
     int                             stx_idx;
+    /* Links the contexts bound to an STX, and the number of operations they
+     * had issued when last sampled by the load-aware STX allocator */
+    struct shmem_transport_ctx_t   *stx_next;
+    uint64_t                        stx_issued_sample;
     struct shmem_internal_tid       tid;
     struct shmem_internal_team_t   *team;
+    struct shmem_internal_pcntr_ctx_t *pcntr_stats;
+    /* Set when a put or atomic to an on-node PE has been issued through this
+     * transport since the last quiet, see shmem_shr_route_mixed */
+    int                             shr_nic_pending;
+#if WANT_TOTAL_DATA_ORDERING != 0
+    /* Set when a write too large for the provider to order has been issued
+     * since the last fence */
+    int                             unordered_pending;
+#endif
 };
 
 typedef struct shmem_transport_ctx_t shmem_transport_ctx_t;
@@ -365,6 +384,26 @@ extern struct fid_ep* shmem_transport_ofi_target_ep;
 #define SHMEM_TRANSPORT_OFI_CNTR_INC(cntr) shmem_internal_cntr_inc(cntr)
 #endif /* USE_CTX_LOCK */
 
+/* Write-after-write ordering required of the provider for fence to skip
+ * waiting for the completion of outstanding writes */
+#define SHMEM_TRANSPORT_OFI_ORDER FI_ORDER_WAW
+
+#if WANT_TOTAL_DATA_ORDERING == 0
+#define SHMEM_TRANSPORT_OFI_TOTAL_DATA_ORDERING 0
+#define SHMEM_TRANSPORT_OFI_MARK_UNORDERED(ctx, len)
+#else
+#if WANT_TOTAL_DATA_ORDERING == 1
+#define SHMEM_TRANSPORT_OFI_TOTAL_DATA_ORDERING 1
+#else
+#define SHMEM_TRANSPORT_OFI_TOTAL_DATA_ORDERING shmem_transport_ofi_total_data_ordering
+#endif
+#define SHMEM_TRANSPORT_OFI_MARK_UNORDERED(ctx, len)                            \
+    do {                                                                        \
+        if ((len) > shmem_transport_ofi_max_ordered_size)                       \
+            __atomic_store_n(&(ctx)->unordered_pending, 1, __ATOMIC_RELAXED);   \
+    } while (0)
+#endif
+
 #define SHMEM_TRANSPORT_OFI_CTX_BB_LOCK(ctx)                                    \
     do {                                                                        \
         shmem_internal_assert(ctx->bounce_buffers != NULL);                     \
@@ -400,6 +439,7 @@ void shmem_transport_probe(void)
 
 int shmem_transport_ctx_create(struct shmem_internal_team_t *team, long options, shmem_transport_ctx_t **ctx);
 void shmem_transport_ctx_destroy(shmem_transport_ctx_t *ctx);
+int shmem_transport_ctx_reuse(shmem_transport_ctx_t *ctx);
 
 int shmem_transport_init(void);
 int shmem_transport_startup(void);
@@ -446,9 +486,7 @@ void shmem_transport_ofi_drain_cq(shmem_transport_ctx_t *ctx)
 }
 
 static inline
-shmem_transport_ofi_bounce_buffer_t * create_bounce_buffer(shmem_transport_ctx_t *ctx,
-                                                           const void *source,
-                                                           const size_t len)
+shmem_transport_ofi_bounce_buffer_t * shmem_transport_ofi_alloc_bounce_buffer(shmem_transport_ctx_t *ctx)
 {
     shmem_transport_ofi_bounce_buffer_t *buff;
 
@@ -470,6 +508,16 @@ shmem_transport_ofi_bounce_buffer_t * create_bounce_buffer(shmem_transport_ctx_t
 
     shmem_internal_assert(buff->frag.mytype == SHMEM_TRANSPORT_OFI_TYPE_BOUNCE);
 
+    return buff;
+}
+
+static inline
+shmem_transport_ofi_bounce_buffer_t * create_bounce_buffer(shmem_transport_ctx_t *ctx,
+                                                           const void *source,
+                                                           const size_t len)
+{
+    shmem_transport_ofi_bounce_buffer_t *buff = shmem_transport_ofi_alloc_bounce_buffer(ctx);
+
     memcpy(buff->data, source, len);
 
     return buff;
@@ -533,6 +581,92 @@ void shmem_transport_put_quiet(shmem_transport_ctx_t* ctx)
     SHMEM_TRANSPORT_OFI_CTX_UNLOCK(ctx);
 }
 
+
+/* Strided get of nblocks blocks of bsize bytes; strides are in bytes.  Up to
+ * shmem_transport_ofi_max_iov blocks are read by each message.  Providers
+ * limited to a single IOV read a contiguous source through a staging buffer
+ * and unpack it locally.  The caller must get_wait. */
+static inline
+void shmem_transport_iget(shmem_transport_ctx_t* ctx, void *target, const void *source,
+                          ptrdiff_t tst, ptrdiff_t sst, size_t bsize, size_t nblocks,
+                          int pe)
+{
+    int ret = 0;
+    uint64_t dst = (uint64_t) pe;
+    uint64_t polled = 0;
+    uint64_t key;
+    uint8_t *addr;
+    size_t i, n, max_n;
+    uint8_t *tgt_buf = (uint8_t *) target;
+
+    if (shmem_transport_ofi_max_iov > 1 && bsize <= shmem_transport_ofi_max_msg_size) {
+        struct iovec msg_iov[SHMEM_TRANSPORT_OFI_MAX_IOV];
+        struct fi_rma_iov rma_iov[SHMEM_TRANSPORT_OFI_MAX_IOV];
+        void *desc[SHMEM_TRANSPORT_OFI_MAX_IOV];
+        struct fi_msg_rma msg = { .addr = GET_DEST(dst), .context = NULL, .data = 0 };
+
+        max_n = MIN(shmem_transport_ofi_max_iov,
+                    shmem_transport_ofi_max_msg_size / bsize);
+
+        shmem_transport_ofi_get_mr(source, pe, &addr, &key);
+
+        SHMEM_TRANSPORT_OFI_CTX_LOCK(ctx);
+        while (nblocks > 0) {
+            n = MIN(nblocks, max_n);
+
+            for (i = 0; i < n; i++) {
+                msg_iov[i].iov_base = tgt_buf;
+                msg_iov[i].iov_len  = bsize;
+                desc[i]             = GET_MR_DESC(shmem_transport_ofi_get_mr_desc_index(tgt_buf));
+                rma_iov[i].addr     = (uint64_t) addr;
+                rma_iov[i].len      = bsize;
+                rma_iov[i].key      = key;
+                tgt_buf += tst;
+                addr    += sst;
+            }
+
+            msg.msg_iov       = msg_iov;
+            msg.desc          = desc;
+            msg.iov_count     = n;
+            msg.rma_iov       = rma_iov;
+            msg.rma_iov_count = n;
+
+            SHMEM_TRANSPORT_OFI_CNTR_INC(&ctx->pending_get_cntr);
+
+            polled = 0;
+            do {
+                ret = fi_readmsg(ctx->ep, &msg, 0);
+            } while (try_again(ctx, ret, &polled));
+
+            nblocks -= n;
+        }
+        SHMEM_TRANSPORT_OFI_CTX_UNLOCK(ctx);
+
+    } else if ((size_t) sst == bsize && bsize * nblocks <= shmem_transport_ofi_bounce_buffer_size) {
+        uint8_t *staging = malloc(bsize * nblocks);
+
+        if (NULL == staging)
+            RAISE_ERROR_STR("Strided get staging buffer allocation failed");
+
+        shmem_transport_get(ctx, staging, source, bsize * nblocks, pe);
+        shmem_transport_get_wait(ctx);
+
+        for (i = 0; i < nblocks; i++) {
+            memcpy(tgt_buf, staging + i * bsize, bsize);
+            tgt_buf += tst;
+        }
+
+        free(staging);
+
+    } else {
+        for ( ; nblocks > 0 ; --nblocks) {
+            shmem_transport_get(ctx, tgt_buf, source, bsize, pe);
+            tgt_buf += tst;
+            source = (const uint8_t *) source + sst;
+        }
+    }
+}
+
 static inline
 int shmem_transport_quiet(shmem_transport_ctx_t* ctx)
 {
@@ -547,10 +681,16 @@ int shmem_transport_quiet(shmem_transport_ctx_t* ctx)
 static inline
 int shmem_transport_fence(shmem_transport_ctx_t* ctx)
 {
-#if WANT_TOTAL_DATA_ORDERING == 0
-    /* Communication is unordered; must wait for puts and buffered (injected)
-     * non-fetching atomics to be completed in order to ensure ordering. */
-    shmem_transport_put_quiet(ctx);
+    if (0 == SHMEM_TRANSPORT_OFI_TOTAL_DATA_ORDERING) {
+        /* Communication is unordered; must wait for puts and buffered (injected)
+         * non-fetching atomics to be completed in order to ensure ordering. */
+        shmem_transport_put_quiet(ctx);
+    }
+#if WANT_TOTAL_DATA_ORDERING != 0
+    /* The provider orders writes, except those larger than its ordering limit */
+    else if (__atomic_exchange_n(&ctx->unordered_pending, 0, __ATOMIC_ACQ_REL)) {
+        shmem_transport_put_quiet(ctx);
+    }
 #endif
     /* Complete fetching ops; needed to support nonblocking fetch-atomics */
     shmem_transport_get_wait(ctx);
@@ -559,6 +699,22 @@ int shmem_transport_fence(shmem_transport_ctx_t* ctx)
 }
 
 
+/* The put and get counters of a context count completions to all PEs, so
+ * completing the operations to one PE completes them all */
+static inline
+int shmem_transport_quiet_pe(shmem_transport_ctx_t* ctx, int pe)
+{
+    return shmem_transport_quiet(ctx);
+}
+
+
+static inline
+int shmem_transport_fence_pe(shmem_transport_ctx_t* ctx, int pe)
+{
+    return shmem_transport_fence(ctx);
+}
+
+
 /* Process RMA operation return code.  If libfabric returned -FI_EAGAIN, attempt
  * to reclaim resources and indicate that the operation should be retried.  If
  * retry limit (ofi_max_poll) is exceeded, abort. */
@@ -652,6 +808,8 @@ void shmem_transport_ofi_put_large(shmem_transport_ctx_t* ctx, void *target, con
     uint64_t frag_target = (uint64_t) addr;
     size_t frag_len = len;
 
+    SHMEM_TRANSPORT_OFI_MARK_UNORDERED(ctx, len);
+
     /* operation generates counting events and must be completed by
      * quiet. */
     SHMEM_TRANSPORT_OFI_CTX_LOCK(ctx);
@@ -694,6 +852,8 @@ void shmem_transport_put_nb(shmem_transport_ctx_t* ctx, void *target, const void
 
     } else if (len <= shmem_transport_ofi_bounce_buffer_size && ctx->bounce_buffers) {
 
+        SHMEM_TRANSPORT_OFI_MARK_UNORDERED(ctx, len);
+
         SHMEM_TRANSPORT_OFI_CTX_LOCK(ctx);
         SHMEM_TRANSPORT_OFI_CNTR_INC(&ctx->pending_put_cntr);
         shmem_transport_ofi_get_mr(target, pe, &addr, &key);
@@ -737,6 +897,8 @@ void shmem_transport_put_signal_nbi(shmem_transport_ctx_t* ctx, void *target, co
 
     shmem_transport_ofi_get_mr(target, pe, &addr, &key);
 
+    SHMEM_TRANSPORT_OFI_MARK_UNORDERED(ctx, len);
+
     if (len <= shmem_transport_ofi_max_buffered_send) {
         uint8_t *src_buf = (uint8_t *) source;
 
@@ -894,6 +1056,139 @@ void shmem_transport_put_nbi(shmem_transport_ctx_t* ctx, void *target, const voi
     }
 }
 
+/* Strided put of nblocks blocks of bsize bytes; strides are in bytes.  When
+ * blocks fit in a bounce buffer, they are packed and written with a single
+ * source IOV and one target IOV per block, so the source buffer is reusable on
+ * return.  Otherwise, up to shmem_transport_ofi_max_iov blocks are described
+ * directly by the IOV lists of each write, and the caller must put_wait. */
+static inline
+void shmem_transport_iput(shmem_transport_ctx_t* ctx, void *target, const void *source,
+                          ptrdiff_t tst, ptrdiff_t sst, size_t bsize, size_t nblocks,
+                          int pe, long *completion)
+{
+    int ret = 0;
+    uint64_t dst = (uint64_t) pe;
+    uint64_t polled = 0;
+    uint64_t key;
+    uint8_t *addr;
+    size_t i, n, max_n;
+    const int target_contig = ((size_t) tst == bsize);
+    const uint8_t *src_buf = (const uint8_t *) source;
+    struct iovec msg_iov[SHMEM_TRANSPORT_OFI_MAX_IOV];
+    struct fi_rma_iov rma_iov[SHMEM_TRANSPORT_OFI_MAX_IOV];
+    void *desc[SHMEM_TRANSPORT_OFI_MAX_IOV];
+    struct fi_msg_rma msg = { .addr = GET_DEST(dst), .data = 0 };
+
+    shmem_internal_assert(completion != NULL);
+
+    SHMEM_TRANSPORT_OFI_MARK_UNORDERED(ctx, bsize * nblocks);
+
+    if (bsize <= shmem_transport_ofi_bounce_buffer_size && ctx->bounce_buffers &&
+        (target_contig || shmem_transport_ofi_max_iov > 1)) {
+
+        max_n = shmem_transport_ofi_bounce_buffer_size / bsize;
+        if (!target_contig)
+            max_n = MIN(max_n, shmem_transport_ofi_max_iov);
+
+        shmem_transport_ofi_get_mr(target, pe, &addr, &key);
+
+        SHMEM_TRANSPORT_OFI_CTX_LOCK(ctx);
+        while (nblocks > 0) {
+            shmem_transport_ofi_bounce_buffer_t *buff;
+
+            n = MIN(nblocks, max_n);
+            SHMEM_TRANSPORT_OFI_CNTR_INC(&ctx->pending_put_cntr);
+            buff = shmem_transport_ofi_alloc_bounce_buffer(ctx);
+
+            if (target_contig) {
+                rma_iov[0].addr = (uint64_t) addr;
+                rma_iov[0].len  = n * bsize;
+                rma_iov[0].key  = key;
+                addr += n * bsize;
+            }
+
+            for (i = 0; i < n; i++) {
+                memcpy(buff->data + i * bsize, src_buf, bsize);
+                if (!target_contig) {
+                    rma_iov[i].addr = (uint64_t) addr;
+                    rma_iov[i].len  = bsize;
+                    rma_iov[i].key  = key;
+                    addr += tst;
+                }
+                src_buf += sst;
+            }
+
+            msg_iov[0].iov_base = buff->data;
+            msg_iov[0].iov_len  = n * bsize;
+            msg.msg_iov         = msg_iov;
+            msg.desc            = GET_MR_DESC_ADDR(shmem_transport_ofi_get_mr_desc_index(buff->data));
+            msg.iov_count       = 1;
+            msg.rma_iov         = rma_iov;
+            msg.rma_iov_count   = target_contig ? 1 : n;
+            msg.context         = buff;
+
+            polled = 0;
+            do {
+                ret = fi_writemsg(ctx->ep, &msg, FI_COMPLETION | FI_DELIVERY_COMPLETE);
+            } while (try_again(ctx, ret, &polled));
+
+            nblocks -= n;
+        }
+        SHMEM_TRANSPORT_OFI_CTX_UNLOCK(ctx);
+
+    } else if (shmem_transport_ofi_max_iov > 1 && bsize <= shmem_transport_ofi_max_msg_size) {
+
+        max_n = MIN(shmem_transport_ofi_max_iov,
+                    shmem_transport_ofi_max_msg_size / bsize);
+
+        shmem_transport_ofi_get_mr(target, pe, &addr, &key);
+
+        /* operation generates counting events and must be completed by
+         * quiet. */
+        SHMEM_TRANSPORT_OFI_CTX_LOCK(ctx);
+        while (nblocks > 0) {
+            n = MIN(nblocks, max_n);
+
+            for (i = 0; i < n; i++) {
+                msg_iov[i].iov_base = (void *) src_buf;
+                msg_iov[i].iov_len  = bsize;
+                desc[i]             = GET_MR_DESC(shmem_transport_ofi_get_mr_desc_index(src_buf));
+                rma_iov[i].addr     = (uint64_t) addr;
+                rma_iov[i].len      = bsize;
+                rma_iov[i].key      = key;
+                src_buf += sst;
+                addr    += tst;
+            }
+
+            msg.msg_iov       = msg_iov;
+            msg.desc          = desc;
+            msg.iov_count     = n;
+            msg.rma_iov       = rma_iov;
+            msg.rma_iov_count = n;
+            msg.context       = NULL;
+
+            SHMEM_TRANSPORT_OFI_CNTR_INC(&ctx->pending_put_cntr);
+
+            polled = 0;
+            do {
+                ret = fi_writemsg(ctx->ep, &msg, FI_DELIVERY_COMPLETE);
+            } while (try_again(ctx, ret, &polled));
+
+            nblocks -= n;
+        }
+        SHMEM_TRANSPORT_OFI_CTX_UNLOCK(ctx);
+
+        (*completion)++;
+
+    } else {
+        for ( ; nblocks > 0 ; --nblocks) {
+            shmem_transport_put_nb(ctx, target, src_buf, bsize, pe, completion);
+            target = (uint8_t *) target + tst;
+            src_buf += sst;
+        }
+    }
+}
+
 
 static inline
 void shmem_transport_get(shmem_transport_ctx_t* ctx, void *target, const void *source, size_t len, int pe)
@@ -998,6 +1293,31 @@ void shmem_transport_get_wait(shmem_transport_ctx_t* ctx)
 }
 
 
+/* Returns nonzero if the gets on ctx have completed, without waiting.  The
+ * counters are read in the same order as in shmem_transport_get_wait. */
+static inline
+int shmem_transport_get_test(shmem_transport_ctx_t* ctx)
+{
+    uint64_t success, fail, cnt;
+
+    SHMEM_TRANSPORT_OFI_CTX_LOCK(ctx);
+
+    success = fi_cntr_read(ctx->get_cntr);
+    fail = fi_cntr_readerr(ctx->get_cntr);
+    cnt = SHMEM_TRANSPORT_OFI_CNTR_READ(&ctx->pending_get_cntr);
+
+    shmem_transport_probe();
+
+    SHMEM_TRANSPORT_OFI_CTX_UNLOCK(ctx);
+
+    if (fail) {
+        RAISE_ERROR_MSG("Operations completed in error (%" PRIu64 ")\n", fail);
+    }
+
+    return success >= cnt;
+}
+
+
 static inline
 void shmem_transport_cswap_nbi(shmem_transport_ctx_t* ctx, void *target, const
                                void *source, void *dest, const void *operand,
@@ -1180,6 +1500,8 @@ void shmem_transport_atomicv(shmem_transport_ctx_t* ctx, void *target, const voi
 
     shmem_internal_assert(SHMEM_Dtsize[dt] * len == full_len);
 
+    SHMEM_TRANSPORT_OFI_MARK_UNORDERED(ctx, full_len);
+
     SHMEM_TRANSPORT_OFI_CTX_LOCK(ctx);
     ret = fi_atomicvalid(ctx->ep, dt, op,
                          &max_atomic_size);
@@ -1320,6 +1642,131 @@ void shmem_transport_fetch_atomic_nbi(shmem_transport_ctx_t* ctx, void *target,
 }
 
 
+/* Batched NBI fetching atomics.  The context lock is taken once for the whole
+ * batch and every operation but the last is posted with FI_MORE, allowing the
+ * provider to coalesce doorbells.  After a failed post FI_MORE is dropped, so
+ * that operations the provider deferred are flushed before the retry. */
+static inline
+void shmem_transport_fetch_atomic_batch(shmem_transport_ctx_t* ctx,
+                                        void *const *target, const void *source,
+                                        void *dest, size_t len, const int *pe,
+                                        size_t count, int op, int datatype)
+{
+    size_t i;
+
+    shmem_internal_assert(len <= sizeof(double _Complex));
+    shmem_internal_assert(SHMEM_Dtsize[SHMEM_TRANSPORT_DTYPE(datatype)] == len);
+
+    SHMEM_TRANSPORT_OFI_CTX_LOCK(ctx);
+
+    for (i = 0; i < count; i++) {
+        int ret = 0;
+        uint64_t dst = (uint64_t) pe[i];
+        uint64_t polled = 0;
+        uint64_t key;
+        uint64_t flags = FI_INJECT | ((i + 1 < count) ? FI_MORE : 0);
+        uint8_t *addr;
+        const uint8_t *src = (const uint8_t *) source + i * len;
+        uint8_t *res = (uint8_t *) dest + i * len;
+
+        shmem_transport_ofi_get_mr(target[i], pe[i], &addr, &key);
+
+        struct fi_ioc resultv = { .addr = res, .count = 1 };
+        const struct fi_ioc sourcev = { .addr = (void *) src, .count = 1 };
+        const struct fi_rma_ioc rmav= { .addr = (uint64_t) addr, .count = 1, .key = key };
+        const struct fi_msg_atomic msg = {
+                                     .msg_iov       = &sourcev,
+                                     .desc          = GET_MR_DESC_ADDR(shmem_transport_ofi_get_mr_desc_index(src)),
+                                     .iov_count     = 1,
+                                     .addr          = GET_DEST(dst),
+                                     .rma_iov       = &rmav,
+                                     .rma_iov_count = 1,
+                                     .datatype      = SHMEM_TRANSPORT_DTYPE(datatype),
+                                     .op            = op,
+                                     .context       = NULL,
+                                     .data          = 0
+                                   };
+
+        SHMEM_TRANSPORT_OFI_CNTR_INC(&ctx->pending_get_cntr);
+
+        do {
+            ret = fi_fetch_atomicmsg(ctx->ep,
+                                     &msg,
+                                     &resultv,
+                                     GET_MR_DESC_ADDR(shmem_transport_ofi_get_mr_desc_index(res)),
+                                     1,
+                                     flags);
+            flags &= ~FI_MORE;
+        } while (try_again(ctx, ret, &polled));
+    }
+
+    SHMEM_TRANSPORT_OFI_CTX_UNLOCK(ctx);
+}
+
+
+static inline
+void shmem_transport_cswap_batch(shmem_transport_ctx_t* ctx,
+                                 void *const *target, const void *source,
+                                 void *dest, const void *operand, size_t len,
+                                 const int *pe, size_t count, int datatype)
+{
+    size_t i;
+
+    shmem_internal_assert(len <= sizeof(double _Complex));
+    shmem_internal_assert(SHMEM_Dtsize[SHMEM_TRANSPORT_DTYPE(datatype)] == len);
+
+    SHMEM_TRANSPORT_OFI_CTX_LOCK(ctx);
+
+    for (i = 0; i < count; i++) {
+        int ret = 0;
+        uint64_t dst = (uint64_t) pe[i];
+        uint64_t polled = 0;
+        uint64_t key;
+        uint64_t flags = FI_INJECT | ((i + 1 < count) ? FI_MORE : 0);
+        uint8_t *addr;
+        const uint8_t *src = (const uint8_t *) source + i * len;
+        const uint8_t *cmp = (const uint8_t *) operand + i * len;
+        uint8_t *res = (uint8_t *) dest + i * len;
+
+        shmem_transport_ofi_get_mr(target[i], pe[i], &addr, &key);
+
+        struct fi_ioc resultv = { .addr = res, .count = 1 };
+        const struct fi_ioc sourcev = { .addr = (void *) src, .count = 1 };
+        const struct fi_ioc comparev = { .addr = (void *) cmp, .count = 1 };
+        const struct fi_rma_ioc rmav= { .addr = (uint64_t) addr, .count = 1, .key = key };
+        const struct fi_msg_atomic msg = {
+                                     .msg_iov       = &sourcev,
+                                     .desc          = GET_MR_DESC_ADDR(shmem_transport_ofi_get_mr_desc_index(src)),
+                                     .iov_count     = 1,
+                                     .addr          = GET_DEST(dst),
+                                     .rma_iov       = &rmav,
+                                     .rma_iov_count = 1,
+                                     .datatype      = SHMEM_TRANSPORT_DTYPE(datatype),
+                                     .op            = FI_CSWAP,
+                                     .context       = NULL,
+                                     .data          = 0
+                                   };
+
+        SHMEM_TRANSPORT_OFI_CNTR_INC(&ctx->pending_get_cntr);
+
+        do {
+            ret = fi_compare_atomicmsg(ctx->ep,
+                                       &msg,
+                                       &comparev,
+                                       NULL,
+                                       1,
+                                       &resultv,
+                                       GET_MR_DESC_ADDR(shmem_transport_ofi_get_mr_desc_index(res)),
+                                       1,
+                                       flags);
+            flags &= ~FI_MORE;
+        } while (try_again(ctx, ret, &polled));
+    }
+
+    SHMEM_TRANSPORT_OFI_CTX_UNLOCK(ctx);
+}
+
+
 static inline
 void shmem_transport_fetch_atomic(shmem_transport_ctx_t* ctx, void *target,
                                   const void *source, void *dest,
@@ -1442,52 +1889,6 @@ int shmem_transport_atomic_supported(shm_internal_op_t op,
 }
 
 
-static inline
-void shmem_transport_put_ct_nb(shmem_transport_ct_t *ct, void *target,
-                               const void *source, size_t len, int pe,
-                               long *completion)
-{
-    RAISE_ERROR_STR("OFI transport does not currently support CT operations");
-}
-
-static inline
-void shmem_transport_get_ct(shmem_transport_ct_t *ct, void *target,
-                            const void *source, size_t len, int pe)
-{
-    RAISE_ERROR_STR("OFI transport does not currently support CT operations");
-}
-
-static inline
-void shmem_transport_ct_create(shmem_transport_ct_t **ct_ptr)
-{
-    RAISE_ERROR_STR("OFI transport does not currently support CT operations");
-}
-
-static inline
-void shmem_transport_ct_free(shmem_transport_ct_t **ct_ptr)
-{
-    RAISE_ERROR_STR("OFI transport does not currently support CT operations");
-}
-
-static inline
-long shmem_transport_ct_get(shmem_transport_ct_t *ct)
-{
-    RAISE_ERROR_STR("OFI transport does not currently support CT operations");
-    return -1;
-}
-
-static inline
-void shmem_transport_ct_set(shmem_transport_ct_t *ct, long value)
-{
-    RAISE_ERROR_STR("OFI transport does not currently support CT operations");
-}
-
-static inline
-void shmem_transport_ct_wait(shmem_transport_ct_t *ct, long wait_for)
-{
-    RAISE_ERROR_STR("OFI transport does not currently support CT operations");
-}
-
 static inline
 uint64_t shmem_transport_received_cntr_get(void)
 {
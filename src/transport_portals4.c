@@ -30,6 +30,7 @@
 #include "shmemx.h"
 #include "shmem_internal.h"
 #include "shmem_comm.h"
+#include "shmem_synchronization.h"
 #include "runtime.h"
 
 /* Temporarily redefine SHM_INTERNAL integer types to their Portals
@@ -774,6 +775,414 @@ shmem_transport_startup(void)
 }
 
 
+/* Triggered operation offload of collectives over all PEs.
+ *
+ * Each collective has its own portal table entry, whose LE covers a private
+ * buffer and counts every message it receives on a counting event.  The PEs
+ * form a k-ary tree rooted at PE 0 with radix SHMEM_COLL_RADIX.  At the start
+ * of a collective, a PE posts triggered operations that forward to its parent
+ * and children once its counter reaches the threshold for this operation, and
+ * then adds its own contribution; the rest of the tree forwarding is done by
+ * the NIC, without the host.  Counters are never reset: every PE knows how
+ * many messages each collective delivers to it, and the thresholds of the
+ * next operation start from the current total.
+ *
+ * Barrier: a PE's counter receives one message from each child, one
+ * increment from the PE itself, and (except at the root) the release from
+ * the parent.  The arrival message to the parent is triggered by the
+ * children and the PE itself, and the release messages to the children by
+ * the release from the parent.
+ *
+ * Broadcast (root PE 0): the data is forwarded down the tree, and every PE
+ * acknowledges it to its parent once it has copied it out and its children
+ * have acknowledged it.  The parent's forward of the next broadcast is
+ * triggered only after all acknowledgments of the previous one, which keeps
+ * the buffer from being overwritten while it is still in use.
+ *
+ * Reduction: every PE atomically adds its contribution to its own
+ * accumulator, children add their accumulator to their parent's once it is
+ * complete, and the root's result is forwarded down the tree into the result
+ * buffer.  Accumulators alternate between two buffers, and each is reset to
+ * zero at the start of the reduction following the one that used it. */
+
+int shmem_transport_portals4_coll_enabled = 0;
+size_t shmem_transport_portals4_coll_max_size = 0;
+
+struct shmem_transport_portals4_coll_le_t {
+    ptl_handle_ct_t ct;
+    ptl_pt_index_t pt;
+    ptl_handle_le_t le;
+    ptl_size_t base;    /* Counter value at the end of the last operation */
+};
+typedef struct shmem_transport_portals4_coll_le_t shmem_transport_portals4_coll_le_t;
+
+#define COLL_LE_INITIALIZER { PTL_INVALID_HANDLE, PTL_PT_ANY, PTL_INVALID_HANDLE, 0 }
+
+static shmem_transport_portals4_coll_le_t coll_barrier = COLL_LE_INITIALIZER;
+static shmem_transport_portals4_coll_le_t coll_bcast = COLL_LE_INITIALIZER;
+static shmem_transport_portals4_coll_le_t coll_acc = COLL_LE_INITIALIZER;
+static shmem_transport_portals4_coll_le_t coll_res = COLL_LE_INITIALIZER;
+
+static char *coll_buf = NULL;
+static size_t coll_buf_len = 0;
+static ptl_handle_md_t coll_md = PTL_INVALID_HANDLE;
+static ptl_handle_md_t coll_reduce_md = PTL_INVALID_HANDLE;
+static ptl_handle_ct_t coll_reduce_md_ct = PTL_INVALID_HANDLE;
+static ptl_size_t coll_reduce_sent = 0;
+static uint64_t coll_reduce_epoch = 0;
+static size_t coll_reduce_last_len = 0;
+
+static int coll_parent = -1;
+static int coll_num_children = 0;
+static int *coll_children = NULL;
+
+/* Buffer layout: barrier (one long, padded for alignment), broadcast, two
+ * accumulators, reduction result, and reduction source */
+#define COLL_BCAST_OFF          16
+#define COLL_ACC_OFF(parity)    (COLL_BCAST_OFF + (1 + (parity)) * shmem_transport_portals4_coll_max_size)
+#define COLL_RES_OFF            (COLL_BCAST_OFF + 3 * shmem_transport_portals4_coll_max_size)
+#define COLL_SRC_OFF            (COLL_BCAST_OFF + 4 * shmem_transport_portals4_coll_max_size)
+
+
+static void
+coll_le_fini(shmem_transport_portals4_coll_le_t *c)
+{
+    if (PTL_PT_ANY == c->pt) return;
+
+    PtlLEUnlink(c->le);
+    PtlPTFree(shmem_transport_portals4_ni_h, c->pt);
+    PtlCTFree(c->ct);
+
+    SHMEM_MUTEX_LOCK(shmem_internal_mutex_ptl4_pt_state);
+    shmem_transport_portals4_pt_state[c->pt] = PT_FREE;
+    SHMEM_MUTEX_UNLOCK(shmem_internal_mutex_ptl4_pt_state);
+
+    c->pt = PTL_PT_ANY;
+}
+
+
+static int
+coll_le_init(shmem_transport_portals4_coll_le_t *c, size_t offset, size_t len)
+{
+    int ret;
+
+    ret = PtlCTAlloc(shmem_transport_portals4_ni_h, &c->ct);
+    if (PTL_OK != ret) {
+        RETURN_ERROR_MSG("PtlCTAlloc of collective CT failed: %d\n", ret);
+        return ret;
+    }
+
+    /* PT indices are allocated collectively, so all PEs get the same one */
+    shmem_transport_portals4_ct_attach(c->ct, coll_buf + offset, len, &c->pt, &c->le);
+    c->base = 0;
+
+    return 0;
+}
+
+
+static inline void
+coll_ct_inc(ptl_handle_ct_t ct)
+{
+    int ret;
+    ptl_ct_event_t inc;
+
+    inc.success = 1;
+    inc.failure = 0;
+
+    ret = PtlCTInc(ct, inc);
+    if (PTL_OK != ret) { RAISE_ERROR(ret); }
+}
+
+
+static inline void
+coll_ct_wait(ptl_handle_ct_t ct, ptl_size_t threshold)
+{
+    int ret;
+    ptl_ct_event_t ev;
+
+    /* Another PE may only join this collective after completing a pending
+     * non-blocking collective that needs our help, so keep progressing it
+     * rather than blocking in PtlCTWait */
+    if (shmem_internal_nbc_num_active) {
+        for (;;) {
+            ret = PtlCTGet(ct, &ev);
+            if (PTL_OK != ret) { RAISE_ERROR(ret); }
+            if (ev.success >= threshold || ev.failure != 0) break;
+            SHMEM_WAIT_PROBE();
+            SPINLOCK_BODY();
+        }
+    } else {
+        ret = PtlCTWait(ct, threshold, &ev);
+        if (PTL_OK != ret) { RAISE_ERROR(ret); }
+    }
+
+    if (ev.failure != 0) {
+        RAISE_ERROR_STR("Collective offload counting event failure");
+    }
+}
+
+
+static inline void
+coll_triggered_put(ptl_handle_md_t md, size_t local_offset, size_t len, int pe,
+                   ptl_pt_index_t pt, size_t remote_offset,
+                   ptl_handle_ct_t trig_ct, ptl_size_t threshold)
+{
+    int ret;
+    ptl_process_t peer;
+
+    peer.rank = pe;
+
+    ret = PtlTriggeredPut(md, local_offset, len, PTL_NO_ACK_REQ, peer, pt, 0,
+                          remote_offset, NULL, 0, trig_ct, threshold);
+    if (PTL_OK != ret) { RAISE_ERROR(ret); }
+}
+
+
+int
+shmem_transport_portals4_coll_init(void)
+{
+    int ret, i, first_child;
+    long radix = shmem_internal_params.COLL_RADIX;
+    ptl_md_t md;
+
+    if (shmem_internal_thread_level == SHMEM_THREAD_MULTIPLE) {
+        /* Collectives on different teams may run concurrently on the same
+         * counters */
+        RAISE_WARN_STR("Collective offload is not supported with SHMEM_THREAD_MULTIPLE");
+        return 0;
+    }
+
+    if (ni_limits.max_triggered_ops < 2 * (radix + 1)) {
+        RAISE_WARN_MSG("Collective offload needs %ld triggered operations, NI provides %d\n",
+                       2 * (radix + 1), ni_limits.max_triggered_ops);
+        return 0;
+    }
+
+    /* Round up to keep the accumulators aligned for any datatype */
+    shmem_transport_portals4_coll_max_size =
+        (shmem_internal_params.PORTALS4_COLL_OFFLOAD_SIZE + 15) & ~((size_t) 15);
+
+    coll_buf_len = COLL_SRC_OFF + shmem_transport_portals4_coll_max_size;
+    coll_buf = calloc(1, coll_buf_len);
+    if (NULL == coll_buf) {
+        RETURN_ERROR_STR("Out of memory allocating collective offload buffer");
+        return 1;
+    }
+
+    coll_children = malloc(sizeof(int) * radix);
+    if (NULL == coll_children) {
+        RETURN_ERROR_STR("Out of memory allocating collective offload tree");
+        return 1;
+    }
+
+    coll_parent = (shmem_internal_my_pe == 0) ? -1 : (shmem_internal_my_pe - 1) / (int) radix;
+    first_child = shmem_internal_my_pe * (int) radix + 1;
+    coll_num_children = 0;
+    for (i = 0; i < radix && first_child + i < shmem_internal_num_pes; i++)
+        coll_children[coll_num_children++] = first_child + i;
+
+    if (0 != (ret = coll_le_init(&coll_barrier, 0, sizeof(long))) ||
+        0 != (ret = coll_le_init(&coll_bcast, COLL_BCAST_OFF,
+                                 shmem_transport_portals4_coll_max_size)) ||
+        0 != (ret = coll_le_init(&coll_acc, COLL_ACC_OFF(0),
+                                 2 * shmem_transport_portals4_coll_max_size)) ||
+        0 != (ret = coll_le_init(&coll_res, COLL_RES_OFF,
+                                 shmem_transport_portals4_coll_max_size)))
+        return ret;
+
+    md.start = coll_buf;
+    md.length = coll_buf_len;
+    md.options = PTL_MD_EVENT_SUCCESS_DISABLE;
+    if (1 != PORTALS4_TOTAL_DATA_ORDERING) {
+        md.options |= PTL_MD_UNORDERED;
+    }
+    md.eq_handle = PTL_EQ_NONE;
+    md.ct_handle = PTL_CT_NONE;
+    ret = PtlMDBind(shmem_transport_portals4_ni_h, &md, &coll_md);
+    if (PTL_OK != ret) {
+        RETURN_ERROR_MSG("PtlMDBind of collective MD failed: %d\n", ret);
+        return ret;
+    }
+
+    /* Reductions count send completions before reusing their buffers */
+    ret = PtlCTAlloc(shmem_transport_portals4_ni_h, &coll_reduce_md_ct);
+    if (PTL_OK != ret) {
+        RETURN_ERROR_MSG("PtlCTAlloc of reduction MD CT failed: %d\n", ret);
+        return ret;
+    }
+
+    md.options |= PTL_MD_EVENT_CT_SEND;
+    md.ct_handle = coll_reduce_md_ct;
+    ret = PtlMDBind(shmem_transport_portals4_ni_h, &md, &coll_reduce_md);
+    if (PTL_OK != ret) {
+        RETURN_ERROR_MSG("PtlMDBind of reduction MD failed: %d\n", ret);
+        return ret;
+    }
+
+    shmem_transport_portals4_coll_enabled = 1;
+
+    return 0;
+}
+
+
+void
+shmem_transport_portals4_coll_fini(void)
+{
+    shmem_transport_portals4_coll_enabled = 0;
+
+    if (!PtlHandleIsEqual(coll_reduce_md, PTL_INVALID_HANDLE))
+        PtlMDRelease(coll_reduce_md);
+    if (!PtlHandleIsEqual(coll_md, PTL_INVALID_HANDLE))
+        PtlMDRelease(coll_md);
+    if (!PtlHandleIsEqual(coll_reduce_md_ct, PTL_INVALID_HANDLE))
+        PtlCTFree(coll_reduce_md_ct);
+    coll_reduce_md = coll_md = PTL_INVALID_HANDLE;
+    coll_reduce_md_ct = PTL_INVALID_HANDLE;
+
+    coll_le_fini(&coll_res);
+    coll_le_fini(&coll_acc);
+    coll_le_fini(&coll_bcast);
+    coll_le_fini(&coll_barrier);
+
+    free(coll_children);
+    coll_children = NULL;
+    free(coll_buf);
+    coll_buf = NULL;
+}
+
+
+void
+shmem_transport_portals4_coll_barrier(void)
+{
+    ptl_size_t arrived, released;
+    int i;
+
+    arrived = coll_barrier.base + coll_num_children + 1;
+    released = (coll_parent < 0) ? arrived : arrived + 1;
+
+    if (coll_parent >= 0)
+        coll_triggered_put(coll_md, 0, 0, coll_parent, coll_barrier.pt, 0,
+                           coll_barrier.ct, arrived);
+
+    for (i = 0; i < coll_num_children; i++)
+        coll_triggered_put(coll_md, 0, 0, coll_children[i], coll_barrier.pt, 0,
+                           coll_barrier.ct, released);
+
+    coll_ct_inc(coll_barrier.ct);
+    coll_ct_wait(coll_barrier.ct, released);
+
+    coll_barrier.base = released;
+}
+
+
+void
+shmem_transport_portals4_coll_bcast(void *target, const void *source, size_t len,
+                                    int complete)
+{
+    ptl_size_t base = coll_bcast.base;
+    ptl_size_t done;
+    int i;
+
+    shmem_internal_assert(len <= shmem_transport_portals4_coll_max_size);
+
+    if (coll_parent < 0) {
+        /* Data, then one acknowledgment per child */
+        done = base + 1 + coll_num_children;
+
+        for (i = 0; i < coll_num_children; i++)
+            coll_triggered_put(coll_md, COLL_BCAST_OFF, len, coll_children[i],
+                               coll_bcast.pt, 0, coll_bcast.ct, base + 1);
+
+        /* The previous broadcast has been acknowledged by all PEs, so the
+         * buffer is free */
+        coll_ct_wait(coll_bcast.ct, base);
+        memcpy(coll_buf + COLL_BCAST_OFF, source, len);
+        coll_ct_inc(coll_bcast.ct);
+    } else {
+        /* Data, one acknowledgment per child, then this PE's copy */
+        done = base + 2 + coll_num_children;
+
+        for (i = 0; i < coll_num_children; i++)
+            coll_triggered_put(coll_md, COLL_BCAST_OFF, len, coll_children[i],
+                               coll_bcast.pt, 0, coll_bcast.ct, base + 1);
+        coll_triggered_put(coll_md, 0, 0, coll_parent, coll_bcast.pt, 0,
+                           coll_bcast.ct, done);
+
+        coll_ct_wait(coll_bcast.ct, base + 1);
+        memcpy(target, coll_buf + COLL_BCAST_OFF, len);
+        coll_ct_inc(coll_bcast.ct);
+    }
+
+    if (complete)
+        coll_ct_wait(coll_bcast.ct, done);
+
+    coll_bcast.base = done;
+}
+
+
+void
+shmem_transport_portals4_coll_reduce(void *target, const void *source, size_t len,
+                                     shm_internal_op_t op,
+                                     shm_internal_datatype_t datatype)
+{
+    int ret, i;
+    int parity = (int) (coll_reduce_epoch & 1);
+    ptl_size_t acc_done = coll_acc.base + coll_num_children + 1;
+    ptl_process_t me;
+
+    shmem_internal_assert(shmem_transport_portals4_coll_reduce_supported(op, len));
+
+    /* Wait until the sends of the previous reduction have read their buffers,
+     * then reset its accumulator for use by the one after this */
+    coll_ct_wait(coll_reduce_md_ct, coll_reduce_sent);
+    memset(coll_buf + COLL_ACC_OFF(1 - parity), 0, coll_reduce_last_len);
+    memcpy(coll_buf + COLL_SRC_OFF, source, len);
+
+    if (coll_parent < 0) {
+        for (i = 0; i < coll_num_children; i++)
+            coll_triggered_put(coll_reduce_md, COLL_ACC_OFF(parity), len, coll_children[i],
+                               coll_res.pt, 0, coll_acc.ct, acc_done);
+    } else {
+        ptl_process_t parent;
+
+        parent.rank = coll_parent;
+        ret = PtlTriggeredAtomic(coll_reduce_md, COLL_ACC_OFF(parity), len, PTL_NO_ACK_REQ,
+                                 parent, coll_acc.pt, 0,
+                                 parity * shmem_transport_portals4_coll_max_size,
+                                 NULL, 0, op, SHMEM_TRANSPORT_DTYPE(datatype),
+                                 coll_acc.ct, acc_done);
+        if (PTL_OK != ret) { RAISE_ERROR(ret); }
+
+        for (i = 0; i < coll_num_children; i++)
+            coll_triggered_put(coll_reduce_md, COLL_RES_OFF, len, coll_children[i],
+                               coll_res.pt, 0, coll_res.ct, coll_res.base + 1);
+        coll_reduce_sent++;
+    }
+    coll_reduce_sent += coll_num_children;
+
+    /* Add this PE's contribution to its accumulator */
+    me.rank = shmem_internal_my_pe;
+    ret = PtlAtomic(coll_reduce_md, COLL_SRC_OFF, len, PTL_NO_ACK_REQ, me, coll_acc.pt, 0,
+                    parity * shmem_transport_portals4_coll_max_size, NULL, 0, op,
+                    SHMEM_TRANSPORT_DTYPE(datatype));
+    if (PTL_OK != ret) { RAISE_ERROR(ret); }
+    coll_reduce_sent++;
+
+    if (coll_parent < 0) {
+        coll_ct_wait(coll_acc.ct, acc_done);
+        memcpy(target, coll_buf + COLL_ACC_OFF(parity), len);
+    } else {
+        coll_ct_wait(coll_res.ct, coll_res.base + 1);
+        memcpy(target, coll_buf + COLL_RES_OFF, len);
+        coll_res.base++;
+    }
+
+    coll_acc.base = acc_done;
+    coll_reduce_last_len = len;
+    coll_reduce_epoch++;
+}
+
+
 int
 shmem_transport_fini(void)
 {
@@ -785,6 +1194,7 @@ shmem_transport_fini(void)
     shmem_transport_quiet(&shmem_transport_ctx_default);
     shmem_transport_ctx_destroy(&shmem_transport_ctx_default);
 
+    shmem_transport_portals4_coll_fini();
     cleanup_handles();
     PtlFini();
 
@@ -143,6 +143,10 @@ struct shmem_transport_ctx_t {
     shmem_internal_cntr_t pending_put_cntr;
     shmem_internal_cntr_t pending_get_cntr;
     struct shmem_internal_team_t   *team;
+    struct shmem_internal_pcntr_ctx_t *pcntr_stats;
+    /* Set when a put or atomic to an on-node PE has been issued through this
+     * transport since the last quiet, see shmem_shr_route_mixed */
+    int shr_nic_pending;
 };
 
 typedef struct shmem_transport_ctx_t shmem_transport_ctx_t;
@@ -150,6 +154,13 @@ extern shmem_transport_ctx_t shmem_transport_ctx_default;
 int shmem_transport_ctx_create(struct shmem_internal_team_t *team, long options, shmem_transport_ctx_t **ctx);
 void shmem_transport_ctx_destroy(shmem_transport_ctx_t *ctx);
 
+static inline
+int
+shmem_transport_ctx_reuse(shmem_transport_ctx_t *ctx)
+{
+    return 0;
+}
+
 /*
  * PORTALS4_GET_REMOTE_ACCESS is used to get the correct PT and offset
  * from the base of the list entry on that PT for a given target
@@ -312,6 +323,24 @@ shmem_transport_fence(shmem_transport_ctx_t* ctx)
     return ret;
 }
 
+
+/* Portals completion events are counted per context, not per target, so
+ * completing the operations to one PE completes them all */
+static inline
+int
+shmem_transport_quiet_pe(shmem_transport_ctx_t* ctx, int pe)
+{
+    return shmem_transport_quiet(ctx);
+}
+
+
+static inline
+int
+shmem_transport_fence_pe(shmem_transport_ctx_t* ctx, int pe)
+{
+    return shmem_transport_fence(ctx);
+}
+
 static inline
 void
 shmem_transport_portals4_drain_eq(void)
@@ -715,6 +744,52 @@ shmem_transport_get_wait(shmem_transport_ctx_t* ctx)
 }
 
 
+/* Returns nonzero if the gets on ctx have completed, without waiting */
+static inline
+int
+shmem_transport_get_test(shmem_transport_ctx_t* ctx)
+{
+    int ret;
+    ptl_ct_event_t ct;
+
+    ret = PtlCTGet(ctx->get_ct, &ct);
+    if (PTL_OK != ret) { RAISE_ERROR(ret); }
+    if (ct.failure != 0) { RAISE_ERROR_MSG("get operations failed (%" PRIu64 "\n", ct.failure); }
+
+    return ct.success >= shmem_internal_cntr_read(&ctx->pending_get_cntr);
+}
+
+
+/* Strided transfers of nblocks blocks of bsize bytes; strides are in bytes.
+ * The transport has no vectored RMA, so each block is a separate operation. */
+static inline
+void
+shmem_transport_iput(shmem_transport_ctx_t* ctx, void *target, const void *source,
+                     ptrdiff_t tst, ptrdiff_t sst, size_t bsize, size_t nblocks,
+                     int pe, long *completion)
+{
+    for ( ; nblocks > 0 ; --nblocks) {
+        shmem_transport_put_nb(ctx, target, source, bsize, pe, completion);
+        target = (uint8_t *) target + tst;
+        source = (const uint8_t *) source + sst;
+    }
+}
+
+
+static inline
+void
+shmem_transport_iget(shmem_transport_ctx_t* ctx, void *target, const void *source,
+                     ptrdiff_t tst, ptrdiff_t sst, size_t bsize, size_t nblocks,
+                     int pe)
+{
+    for ( ; nblocks > 0 ; --nblocks) {
+        shmem_transport_get(ctx, target, source, bsize, pe);
+        target = (uint8_t *) target + tst;
+        source = (const uint8_t *) source + sst;
+    }
+}
+
+
 static inline
 void
 shmem_transport_swap(shmem_transport_ctx_t* ctx, void *target, const void *source, void *dest, size_t len,
@@ -1067,6 +1142,40 @@ shmem_transport_fetch_atomic_nbi(shmem_transport_ctx_t* ctx, void *target,
 }
 
 
+static inline
+void
+shmem_transport_fetch_atomic_batch(shmem_transport_ctx_t* ctx, void *const *target,
+                                   const void *source, void *dest, size_t len,
+                                   const int *pe, size_t count, ptl_op_t op,
+                                   ptl_datatype_t datatype)
+{
+    size_t i;
+
+    for (i = 0; i < count; i++)
+        shmem_transport_fetch_atomic_nbi(ctx, target[i],
+                                         (const uint8_t *) source + i * len,
+                                         (uint8_t *) dest + i * len, len, pe[i],
+                                         op, datatype);
+}
+
+
+static inline
+void
+shmem_transport_cswap_batch(shmem_transport_ctx_t* ctx, void *const *target,
+                            const void *source, void *dest, const void *operand,
+                            size_t len, const int *pe, size_t count,
+                            ptl_datatype_t datatype)
+{
+    size_t i;
+
+    for (i = 0; i < count; i++)
+        shmem_transport_cswap_nbi(ctx, target[i], (const uint8_t *) source + i * len,
+                                  (uint8_t *) dest + i * len,
+                                  (const uint8_t *) operand + i * len, len, pe[i],
+                                  datatype);
+}
+
+
 static inline
 void
 shmem_transport_atomic_set(shmem_transport_ctx_t* ctx, void *target, const void *source, size_t len,
@@ -1292,6 +1401,30 @@ void shmem_transport_ct_wait(shmem_transport_ct_t *ct, long wait_for)
     }
 }
 
+/* Collectives over all PEs offloaded with triggered operations, see
+ * transport_portals4.c.  Broadcasts must be rooted at PE 0, and reductions
+ * are limited to operations whose identity is zero (sum, or, xor). */
+extern int shmem_transport_portals4_coll_enabled;
+extern size_t shmem_transport_portals4_coll_max_size;
+
+int shmem_transport_portals4_coll_init(void);
+void shmem_transport_portals4_coll_fini(void);
+void shmem_transport_portals4_coll_barrier(void);
+void shmem_transport_portals4_coll_bcast(void *target, const void *source, size_t len,
+                                         int complete);
+void shmem_transport_portals4_coll_reduce(void *target, const void *source, size_t len,
+                                          shm_internal_op_t op,
+                                          shm_internal_datatype_t datatype);
+
+static inline
+int shmem_transport_portals4_coll_reduce_supported(shm_internal_op_t op, size_t len)
+{
+    return shmem_transport_portals4_coll_enabled &&
+           len <= shmem_transport_portals4_coll_max_size &&
+           len <= shmem_transport_portals4_max_atomic_size &&
+           (op == SHM_INTERNAL_SUM || op == SHM_INTERNAL_BOR || op == SHM_INTERNAL_BXOR);
+}
+
 static inline
 uint64_t shmem_transport_received_cntr_get(void)
 {
@@ -28,6 +28,13 @@
 
 #define MIN(a,b) (((a)<(b))?(a):(b))
 
+/* Header of the address info published by each PE, followed by the worker
+ * address and the packed data and heap rkeys */
+typedef struct {
+    size_t   addr_len, data_rkey_len, heap_rkey_len;
+    uint8_t *data_base, *heap_base;
+} shmem_transport_ucx_info_t;
+
 shmem_transport_ctx_t shmem_transport_ctx_default;
 shmem_ctx_t SHMEM_CTX_DEFAULT = (shmem_ctx_t) &shmem_transport_ctx_default;
 
@@ -39,6 +46,24 @@ ucp_mem_h     shmem_transport_ucp_mem_heap;
 
 shmem_transport_peer_t *shmem_transport_peers;
 
+shmem_transport_ucx_worker_t shmem_transport_ucx_default_worker;
+long shmem_transport_ucx_max_pending;
+
+/* Workers created for contexts, progressed by the progress thread */
+static shmem_transport_ucx_worker_t *shmem_transport_ucx_worker_list = NULL;
+static pthread_mutex_t shmem_transport_ucx_worker_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* Worker shared by the contexts of a thread when SHMEM_UCX_CTX_WORKER=thread */
+static __thread shmem_transport_ucx_worker_t *shmem_transport_ucx_thread_worker = NULL;
+
+enum {
+    SHMEM_TRANSPORT_UCX_CTX_WORKER_CTX,
+    SHMEM_TRANSPORT_UCX_CTX_WORKER_THREAD,
+    SHMEM_TRANSPORT_UCX_CTX_WORKER_DEFAULT
+};
+
+static int shmem_transport_ucx_ctx_worker = SHMEM_TRANSPORT_UCX_CTX_WORKER_CTX;
+
 /* Tables to translate between SHM_INTERNAL and UCP ops */
 ucp_atomic_post_op_t shmem_transport_ucx_post_op[] = {
     UCP_ATOMIC_POST_OP_AND,
@@ -54,9 +79,12 @@ ucp_atomic_fetch_op_t shmem_transport_ucx_fetch_op[] = {
     UCP_ATOMIC_FETCH_OP_FADD
 };
 
-void shmem_transport_ucx_cb_nop(void *request, ucs_status_t status) {
-    return;
-}
+ucp_atomic_op_t shmem_transport_ucx_amo_op[] = {
+    UCP_ATOMIC_OP_AND,
+    UCP_ATOMIC_OP_OR,
+    UCP_ATOMIC_OP_XOR,
+    UCP_ATOMIC_OP_ADD
+};
 
 void shmem_transport_ucx_cb_complete(void *request, ucs_status_t status, void *user_data) {
     if (status != UCS_OK)
@@ -66,54 +94,267 @@ void shmem_transport_ucx_cb_complete(void *request, ucs_status_t status, void *u
     return;
 }
 
+void shmem_transport_ucx_cb_ctx(void *request, ucs_status_t status, void *user_data) {
+    shmem_transport_ctx_t *ctx = (shmem_transport_ctx_t *) user_data;
+
+    if (status != UCS_OK)
+        RAISE_ERROR_MSG("Error while completing operation (%s)\n", ucs_status_string(status));
+
+    __atomic_fetch_sub(&ctx->pending, 1, __ATOMIC_RELEASE);
+    return;
+}
+
 static pthread_t shmem_transport_ucx_progress_thread;
 static int shmem_transport_ucx_progress_thread_enabled = 1;
 
 static void * shmem_transport_ucx_progress_thread_func(void *arg)
 {
     while (__atomic_load_n(&shmem_transport_ucx_progress_thread_enabled, __ATOMIC_ACQUIRE)) {
+        shmem_transport_ucx_worker_t *w;
+
         shmem_transport_probe();
+
+        pthread_mutex_lock(&shmem_transport_ucx_worker_lock);
+        for (w = shmem_transport_ucx_worker_list; w != NULL; w = w->next)
+            ucp_worker_progress(w->worker);
+        pthread_mutex_unlock(&shmem_transport_ucx_worker_lock);
+
         usleep(shmem_internal_params.PROGRESS_INTERVAL);
     }
 
     return NULL;
 }
 
-int shmem_transport_init(void)
+/* Wait for a request on the given worker, e.g. an endpoint close */
+static ucs_status_t shmem_transport_ucx_worker_wait(ucp_worker_h worker, ucs_status_ptr_t req)
 {
     ucs_status_t status;
-    ucp_params_t params;
-    ucp_worker_params_t worker_params;
-    ucp_worker_attr_t worker_attr;
-    ucs_thread_mode_t requested;
 
-    params.field_mask = UCP_PARAM_FIELD_FEATURES;
-    params.features   = UCP_FEATURE_RMA | UCP_FEATURE_AMO32 | UCP_FEATURE_AMO64;
+    if (req == NULL)
+        return UCS_OK;
+    else if (UCS_PTR_IS_ERR(req))
+        return UCS_PTR_STATUS(req);
 
-    status = ucp_config_read(NULL, NULL, &shmem_transport_ucp_config);
+    do {
+        ucp_worker_progress(worker);
+        status = ucp_request_check_status(req);
+    } while (status == UCS_INPROGRESS);
+
+    ucp_request_free(req);
+    return status;
+}
+
+/* Create the worker's endpoint to pe and unpack the peer's rkeys.  Called
+ * on first use of the peer by shmem_transport_ucx_get_mr. */
+void shmem_transport_ucx_connect(shmem_transport_ucx_worker_t *w, int pe)
+{
+    shmem_transport_ucx_conn_t *conn = &w->conns[pe];
+    ucp_ep_params_t params;
+    ucs_status_t status;
+    ucp_ep_h ep;
+
+    pthread_mutex_lock(&w->lock);
+
+    if (conn->ep != NULL) {
+        /* Connected by another thread */
+        pthread_mutex_unlock(&w->lock);
+        return;
+    }
+
+    params.field_mask = UCP_EP_PARAM_FIELD_REMOTE_ADDRESS;
+    params.address    = shmem_transport_peers[pe].addr;
+
+    status = ucp_ep_create(w->worker, &params, &ep);
     UCX_CHECK_STATUS(status);
-    status = ucp_init(&params, shmem_transport_ucp_config, &shmem_transport_ucp_ctx);
+
+    status = ucp_ep_rkey_unpack(ep, shmem_transport_peers[pe].data_rkey_buf,
+                                &conn->data_rkey);
     UCX_CHECK_STATUS(status);
+    status = ucp_ep_rkey_unpack(ep, shmem_transport_peers[pe].heap_rkey_buf,
+                                &conn->heap_rkey);
+    UCX_CHECK_STATUS(status);
+
+    /* Publish the endpoint after the rkeys, the endpoint is the flag checked
+     * without the lock */
+    __atomic_store_n(&conn->ep, ep, __ATOMIC_RELEASE);
+
+    pthread_mutex_unlock(&w->lock);
+}
+
+/* Allocate the worker's connection table.  Endpoints are created on first
+ * use, unless SHMEM_UCX_EAGER_CONNECT is set. */
+static int shmem_transport_ucx_worker_connect(shmem_transport_ucx_worker_t *w)
+{
+    int i;
+
+    w->conns = calloc(shmem_internal_num_pes, sizeof(shmem_transport_ucx_conn_t));
+    if (w->conns == NULL) {
+        RAISE_WARN_STR("Out of memory allocating UCX connection table");
+        return 1;
+    }
+
+    if (shmem_internal_params.UCX_EAGER_CONNECT) {
+        for (i = 0; i < shmem_internal_num_pes; i++)
+            shmem_transport_ucx_connect(w, i);
+    }
+
+    return 0;
+}
+
+static void shmem_transport_ucx_worker_disconnect(shmem_transport_ucx_worker_t *w)
+{
+    int i;
+
+    if (w->conns == NULL)
+        return;
+
+    for (i = 0; i < shmem_internal_num_pes; i++) {
+        if (w->conns[i].ep == NULL)
+            continue;
+
+        ucp_rkey_destroy(w->conns[i].data_rkey);
+        ucp_rkey_destroy(w->conns[i].heap_rkey);
+        ucs_status_ptr_t pstatus = ucp_ep_close_nb(w->conns[i].ep, UCP_EP_CLOSE_MODE_FLUSH);
+        shmem_transport_ucx_worker_wait(w->worker, pstatus);
+    }
+
+    free(w->conns);
+    w->conns = NULL;
+}
+
+/* Create a connected worker for contexts.  Returns NULL when UCX cannot
+ * provide the requested thread mode. */
+static shmem_transport_ucx_worker_t *shmem_transport_ucx_worker_create(ucs_thread_mode_t mode)
+{
+    shmem_transport_ucx_worker_t *w;
+    ucp_worker_params_t worker_params;
+    ucp_worker_attr_t worker_attr;
+    ucs_status_t status;
+
+    w = malloc(sizeof(shmem_transport_ucx_worker_t));
+    if (w == NULL)
+        return NULL;
+
+    w->conns   = NULL;
+    w->ref_cnt = 0;
+    pthread_mutex_init(&w->lock, NULL);
+
+    /* The progress thread progresses all workers */
+    if (shmem_internal_params.PROGRESS_INTERVAL > 0)
+        mode = UCS_THREAD_MODE_MULTI;
 
     worker_params.field_mask  = UCP_WORKER_PARAM_FIELD_THREAD_MODE;
+    worker_params.thread_mode = mode;
+
+    status = ucp_worker_create(shmem_transport_ucp_ctx, &worker_params, &w->worker);
+    if (status != UCS_OK) {
+        DEBUG_MSG("UCX worker creation failed (%s)\n", ucs_status_string(status));
+        free(w);
+        return NULL;
+    }
+
+    worker_attr.field_mask = UCP_WORKER_ATTR_FIELD_THREAD_MODE;
+    status = ucp_worker_query(w->worker, &worker_attr);
+    UCX_CHECK_STATUS(status);
+
+    if (worker_attr.thread_mode < mode) {
+        DEBUG_MSG("UCX thread mode %d not available for context worker (%d)\n",
+                  mode, worker_attr.thread_mode);
+        ucp_worker_destroy(w->worker);
+        free(w);
+        return NULL;
+    }
+
+    w->thread_mode = worker_attr.thread_mode;
+    w->owner       = pthread_self();
+
+    if (shmem_transport_ucx_worker_connect(w)) {
+        ucp_worker_destroy(w->worker);
+        free(w);
+        return NULL;
+    }
+
+    pthread_mutex_lock(&shmem_transport_ucx_worker_lock);
+    w->next = shmem_transport_ucx_worker_list;
+    shmem_transport_ucx_worker_list = w;
+    pthread_mutex_unlock(&shmem_transport_ucx_worker_lock);
 
+    return w;
+}
+
+static void shmem_transport_ucx_worker_destroy(shmem_transport_ucx_worker_t *w)
+{
+    shmem_transport_ucx_worker_t **p;
+
+    pthread_mutex_lock(&shmem_transport_ucx_worker_lock);
+    for (p = &shmem_transport_ucx_worker_list; *p != NULL; p = &(*p)->next) {
+        if (*p == w) {
+            *p = w->next;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&shmem_transport_ucx_worker_lock);
+
+    shmem_transport_ucx_worker_disconnect(w);
+    ucp_worker_destroy(w->worker);
+    pthread_mutex_destroy(&w->lock);
+    free(w);
+}
+
+/* UCX thread mode matching the library thread level */
+static ucs_thread_mode_t shmem_transport_ucx_thread_mode(void)
+{
     switch (shmem_internal_thread_level) {
         case SHMEM_THREAD_SINGLE:
-            worker_params.thread_mode = UCS_THREAD_MODE_SINGLE;
-            break;
+            return UCS_THREAD_MODE_SINGLE;
         case SHMEM_THREAD_FUNNELED:
-            worker_params.thread_mode = UCS_THREAD_MODE_SERIALIZED;
-            break;
+            return UCS_THREAD_MODE_SERIALIZED;
         case SHMEM_THREAD_SERIALIZED:
-            worker_params.thread_mode = UCS_THREAD_MODE_SERIALIZED;
-            break;
+            return UCS_THREAD_MODE_SERIALIZED;
         case SHMEM_THREAD_MULTIPLE:
-            worker_params.thread_mode = UCS_THREAD_MODE_MULTI;
-            break;
+            return UCS_THREAD_MODE_MULTI;
         default:
             RAISE_ERROR_MSG("Invalid thread level (%d)\n", shmem_internal_thread_level);
     }
 
+    return UCS_THREAD_MODE_MULTI;
+}
+
+int shmem_transport_init(void)
+{
+    ucs_status_t status;
+    ucp_params_t params;
+    ucp_worker_params_t worker_params;
+    ucp_worker_attr_t worker_attr;
+    ucs_thread_mode_t requested;
+
+    params.field_mask = UCP_PARAM_FIELD_FEATURES;
+    params.features   = UCP_FEATURE_RMA | UCP_FEATURE_AMO32 | UCP_FEATURE_AMO64;
+
+    status = ucp_config_read(NULL, NULL, &shmem_transport_ucp_config);
+    UCX_CHECK_STATUS(status);
+    status = ucp_init(&params, shmem_transport_ucp_config, &shmem_transport_ucp_ctx);
+    UCX_CHECK_STATUS(status);
+
+    if (shmem_internal_params.UCX_MAX_PENDING <= 0)
+        RAISE_ERROR_MSG("Invalid SHMEM_UCX_MAX_PENDING (%ld)\n",
+                        shmem_internal_params.UCX_MAX_PENDING);
+
+    shmem_transport_ucx_max_pending = shmem_internal_params.UCX_MAX_PENDING;
+
+    if (0 == strcmp(shmem_internal_params.UCX_CTX_WORKER, "ctx"))
+        shmem_transport_ucx_ctx_worker = SHMEM_TRANSPORT_UCX_CTX_WORKER_CTX;
+    else if (0 == strcmp(shmem_internal_params.UCX_CTX_WORKER, "thread"))
+        shmem_transport_ucx_ctx_worker = SHMEM_TRANSPORT_UCX_CTX_WORKER_THREAD;
+    else if (0 == strcmp(shmem_internal_params.UCX_CTX_WORKER, "default"))
+        shmem_transport_ucx_ctx_worker = SHMEM_TRANSPORT_UCX_CTX_WORKER_DEFAULT;
+    else
+        RAISE_ERROR_MSG("Invalid UCX context worker \"%s\"\n",
+                        shmem_internal_params.UCX_CTX_WORKER);
+
+    worker_params.field_mask  = UCP_WORKER_PARAM_FIELD_THREAD_MODE;
+    worker_params.thread_mode = shmem_transport_ucx_thread_mode();
+
     requested = worker_params.thread_mode;
 
     if (shmem_internal_params.PROGRESS_INTERVAL > 0)
@@ -150,49 +391,18 @@ int shmem_transport_init(void)
         }
     }
 
-    /* Publish addressing info to be exchanged by runtime layer */
+    /* Register memory and publish the worker address, rkeys, and segment
+     * addresses in a single info blob, so that a peer's info is fetched with
+     * few runtime lookups */
     {
+        shmem_transport_ucx_info_t info;
+        ucp_mem_map_params_t params;
         ucp_address_t *addr;
-        uint8_t *addr_bytes;
+        void *data_rkey, *heap_rkey;
+        uint8_t *blob;
         size_t len;
         int ret;
 
-        status = ucp_worker_get_address(shmem_transport_ucp_worker, &addr, &len);
-        UCX_CHECK_STATUS(status);
-
-        /* Limit the X in "addrX" to a range of printable ASCII characters */
-        if (len > 'z' - '0' * RUNTIME_ADDR_CHUNK)
-            RAISE_ERROR_MSG("UCX address too large (length %zu, chunk %d)\n", len, RUNTIME_ADDR_CHUNK);
-
-        ret = shmem_runtime_put("addr_len", &len, sizeof(size_t));
-        if (ret) RAISE_ERROR_MSG("Runtime put of UCX address length failed (length %zu)\n", len);
-
-        addr_bytes = (uint8_t*) addr;
-
-        for (size_t chunk = 0; chunk < len; chunk += RUNTIME_ADDR_CHUNK) {
-            char key[6] = "addrX";
-            size_t chunk_idx = 4;
-
-            key[chunk_idx] = '0' + chunk/RUNTIME_ADDR_CHUNK;
-
-            ret = shmem_runtime_put(key, addr_bytes+chunk, MIN(len-chunk, RUNTIME_ADDR_CHUNK));
-
-            if (ret) {
-                RAISE_ERROR_MSG("Runtime put of UCX address chunk %zu failed (chunk %d)\n",
-                                chunk/RUNTIME_ADDR_CHUNK, RUNTIME_ADDR_CHUNK);
-            }
-        }
-
-        ucp_worker_release_address(shmem_transport_ucp_worker, addr);
-    }
-
-    /* Register memory and publish rkeys */
-    {
-        void *rkey;
-        size_t len;
-        int ret;
-        ucp_mem_map_params_t params;
-
         params.field_mask = UCP_MEM_MAP_PARAM_FIELD_ADDRESS |
                             UCP_MEM_MAP_PARAM_FIELD_LENGTH  |
                             UCP_MEM_MAP_PARAM_FIELD_FLAGS;
@@ -205,21 +415,8 @@ int shmem_transport_init(void)
         UCX_CHECK_STATUS(status);
 
         status = ucp_rkey_pack(shmem_transport_ucp_ctx, shmem_transport_ucp_mem_data,
-                              &rkey, &len);
+                               &data_rkey, &info.data_rkey_len);
         UCX_CHECK_STATUS(status);
-        ret = shmem_runtime_put("data_rkey_len", &len, sizeof(size_t));
-        if (ret) RAISE_ERROR_STR("Runtime put of UCX data segment rkey length");
-        ret = shmem_runtime_put("data_rkey", rkey, len);
-        if (ret) RAISE_ERROR_STR("Runtime put of UCX data segment rkey");
-        ucp_rkey_buffer_release(rkey);
-
-#ifndef ENABLE_REMOTE_VIRTUAL_ADDRESSING
-        ret = shmem_runtime_put("data_base", &shmem_internal_data_base, sizeof(uint8_t*));
-        if (ret) {
-            RAISE_WARN_STR("Put of data segment address to runtime KVS failed");
-            return 1;
-        }
-#endif
 
         /* Heap segment */
         params.address = shmem_internal_heap_base;
@@ -228,25 +425,70 @@ int shmem_transport_init(void)
         UCX_CHECK_STATUS(status);
 
         status = ucp_rkey_pack(shmem_transport_ucp_ctx, shmem_transport_ucp_mem_heap,
-                            &rkey, &len);
-        ret = shmem_runtime_put("heap_rkey_len", &len, sizeof(size_t));
-        if (ret) RAISE_ERROR_STR("Runtime put of UCX heap segment rkey length");
-        ret = shmem_runtime_put("heap_rkey", rkey, len);
-        if (ret) RAISE_ERROR_STR("Runtime put of UCX heap segment rkey");
-        ucp_rkey_buffer_release(rkey);
+                               &heap_rkey, &info.heap_rkey_len);
+        UCX_CHECK_STATUS(status);
 
-#ifndef ENABLE_REMOTE_VIRTUAL_ADDRESSING
-        ret = shmem_runtime_put("heap_base", &shmem_internal_heap_base, sizeof(uint8_t*));
-        if (ret) {
-            RAISE_WARN_STR("Put of heap address to runtime KVS failed");
-            return 1;
+        status = ucp_worker_get_address(shmem_transport_ucp_worker, &addr, &info.addr_len);
+        UCX_CHECK_STATUS(status);
+
+        info.data_base = (uint8_t *) shmem_internal_data_base;
+        info.heap_base = (uint8_t *) shmem_internal_heap_base;
+
+        len = sizeof(info) + info.addr_len + info.data_rkey_len + info.heap_rkey_len;
+
+        /* Limit the X in "infoX" to a range of printable ASCII characters */
+        if (len > ('z' - '0') * RUNTIME_ADDR_CHUNK)
+            RAISE_ERROR_MSG("UCX address info too large (length %zu, chunk %d)\n", len, RUNTIME_ADDR_CHUNK);
+
+        blob = malloc(len);
+        if (blob == NULL)
+            RAISE_ERROR_MSG("Out of memory, allocating UCX address info (len = %zu)\n", len);
+
+        memcpy(blob, &info, sizeof(info));
+        memcpy(blob + sizeof(info), addr, info.addr_len);
+        memcpy(blob + sizeof(info) + info.addr_len, data_rkey, info.data_rkey_len);
+        memcpy(blob + sizeof(info) + info.addr_len + info.data_rkey_len, heap_rkey,
+               info.heap_rkey_len);
+
+        ucp_worker_release_address(shmem_transport_ucp_worker, addr);
+        ucp_rkey_buffer_release(data_rkey);
+        ucp_rkey_buffer_release(heap_rkey);
+
+        ret = shmem_runtime_put("info_len", &len, sizeof(size_t));
+        if (ret) RAISE_ERROR_MSG("Runtime put of UCX address info length failed (length %zu)\n", len);
+
+        for (size_t chunk = 0; chunk < len; chunk += RUNTIME_ADDR_CHUNK) {
+            char key[6] = "infoX";
+            size_t chunk_idx = 4;
+
+            key[chunk_idx] = '0' + chunk/RUNTIME_ADDR_CHUNK;
+
+            ret = shmem_runtime_put(key, blob+chunk, MIN(len-chunk, RUNTIME_ADDR_CHUNK));
+
+            if (ret) {
+                RAISE_ERROR_MSG("Runtime put of UCX address info chunk %zu failed (chunk %d)\n",
+                                chunk/RUNTIME_ADDR_CHUNK, RUNTIME_ADDR_CHUNK);
+            }
         }
-#endif
+
+        free(blob);
     }
 
+    /* The default worker is connected in startup */
+    shmem_transport_ucx_default_worker.worker  = shmem_transport_ucp_worker;
+    shmem_transport_ucx_default_worker.conns   = NULL;
+    shmem_transport_ucx_default_worker.ref_cnt = 1;
+    shmem_transport_ucx_default_worker.thread_mode = worker_attr.thread_mode;
+    shmem_transport_ucx_default_worker.owner   = pthread_self();
+    shmem_transport_ucx_default_worker.next    = NULL;
+    pthread_mutex_init(&shmem_transport_ucx_default_worker.lock, NULL);
+
     /* Configure the default context */
     shmem_transport_ctx_default.options = 0;
     shmem_transport_ctx_default.team    = &shmem_internal_team_world;
+    shmem_transport_ctx_default.worker  = &shmem_transport_ucx_default_worker;
+    shmem_transport_ctx_default.pending = 0;
+    shmem_transport_ctx_default.shr_nic_pending = 0;
 
     return 0;
 }
@@ -258,71 +500,53 @@ int shmem_transport_startup(void)
     shmem_transport_peers = malloc(shmem_internal_num_pes *
                                    sizeof(shmem_transport_peer_t));
 
-    /* Build connection table to each peer */
+    if (shmem_transport_peers == NULL)
+        RAISE_ERROR_STR("Out of memory allocating UCX peers table");
+
+    /* Gather the addressing info of each peer.  Endpoints and rkeys are
+     * created by each worker on first use of the peer. */
     for (i = 0; i < shmem_internal_num_pes; i++) {
-        ucs_status_t status;
-        ucp_ep_params_t params;
-        size_t rkey_len;
-        void *rkey;
-        uint8_t *addr_bytes;
+        shmem_transport_ucx_info_t info;
+        uint8_t *blob;
         size_t len;
 
-        ret = shmem_runtime_get(i, "addr_len", &shmem_transport_peers[i].addr_len, sizeof(size_t));
-        if (ret) RAISE_ERROR_MSG("Runtime get of UCX address length failed (PE %d, ret %d)\n", i, ret);
+        ret = shmem_runtime_get(i, "info_len", &len, sizeof(size_t));
+        if (ret) RAISE_ERROR_MSG("Runtime get of UCX address info length failed (PE %d, ret %d)\n", i, ret);
 
-        len = shmem_transport_peers[i].addr_len;
-        shmem_transport_peers[i].addr = malloc(len);
-        addr_bytes = (uint8_t*) shmem_transport_peers[i].addr;
+        blob = malloc(len);
+        if (blob == NULL)
+            RAISE_ERROR_MSG("Out of memory, allocating UCX address info (len = %zu)\n", len);
 
         for (size_t chunk = 0; chunk < len; chunk += RUNTIME_ADDR_CHUNK) {
-            char key[6] = "addrX";
+            char key[6] = "infoX";
             size_t chunk_idx = 4;
 
             key[chunk_idx] = '0' + chunk/RUNTIME_ADDR_CHUNK;
 
-            ret = shmem_runtime_get(i, key, addr_bytes+chunk, MIN(len-chunk, RUNTIME_ADDR_CHUNK));
+            ret = shmem_runtime_get(i, key, blob+chunk, MIN(len-chunk, RUNTIME_ADDR_CHUNK));
 
             if (ret) {
-                RAISE_ERROR_MSG("Runtime get of UCX address chunk %zu failed (chunk %d)\n",
-                                chunk/RUNTIME_ADDR_CHUNK, RUNTIME_ADDR_CHUNK);
+                RAISE_ERROR_MSG("Runtime get of UCX address info chunk %zu failed (PE %d, chunk %d)\n",
+                                chunk/RUNTIME_ADDR_CHUNK, i, RUNTIME_ADDR_CHUNK);
             }
         }
 
-        params.field_mask = UCP_EP_PARAM_FIELD_REMOTE_ADDRESS;
-        params.address    = shmem_transport_peers[i].addr;
-
-        status = ucp_ep_create(shmem_transport_ucp_worker, &params, &shmem_transport_peers[i].ep);
-        UCX_CHECK_STATUS(status);
-
-        ret = shmem_runtime_get(i, "data_rkey_len", &rkey_len, sizeof(size_t));
-        if (ret) RAISE_ERROR_MSG("Runtime get of UCX data rkey length failed (PE %d, ret %d)\n", i, ret);
-        rkey = malloc(rkey_len);
-        if (rkey == NULL) RAISE_ERROR_MSG("Out of memory, allocating rkey buffer (len = %zu)\n", rkey_len);
-        ret = shmem_runtime_get(i, "data_rkey", rkey, rkey_len);
-        if (ret) RAISE_ERROR_MSG("Runtime get of UCX data rkey failed (PE %d, ret %d)\n", i, ret);
-        status = ucp_ep_rkey_unpack(shmem_transport_peers[i].ep, rkey, &shmem_transport_peers[i].data_rkey);
-        UCX_CHECK_STATUS(status);
-        free(rkey);
-
-        ret = shmem_runtime_get(i, "heap_rkey_len", &rkey_len, sizeof(size_t));
-        if (ret) RAISE_ERROR_MSG("Runtime get of UCX heap rkey length failed (PE %d, ret %d)\n", i, ret);
-        rkey = malloc(rkey_len);
-        if (rkey == NULL) RAISE_ERROR_MSG("Out of memory, allocating rkey buffer (len = %zu)\n", rkey_len);
-        ret = shmem_runtime_get(i, "heap_rkey", rkey, rkey_len);
-        if (ret) RAISE_ERROR_MSG("Runtime get of UCX heap rkey failed (PE %d, ret %d)\n", i, ret);
-        status = ucp_ep_rkey_unpack(shmem_transport_peers[i].ep, rkey, &shmem_transport_peers[i].heap_rkey);
-        UCX_CHECK_STATUS(status);
-        free(rkey);
+        memcpy(&info, blob, sizeof(info));
 
+        shmem_transport_peers[i].info          = blob;
+        shmem_transport_peers[i].addr          = (ucp_address_t *) (blob + sizeof(info));
+        shmem_transport_peers[i].data_rkey_buf = blob + sizeof(info) + info.addr_len;
+        shmem_transport_peers[i].heap_rkey_buf = blob + sizeof(info) + info.addr_len +
+                                                 info.data_rkey_len;
 #ifndef ENABLE_REMOTE_VIRTUAL_ADDRESSING
-        ret = shmem_runtime_get(i, "data_base", &shmem_transport_peers[i].data_base, sizeof(void*));
-        if (ret) RAISE_ERROR_MSG("Runtime get of UCX data base address failed (PE %d, ret %d)\n", i, ret);
-
-        ret = shmem_runtime_get(i, "heap_base", &shmem_transport_peers[i].heap_base, sizeof(void*));
-        if (ret) RAISE_ERROR_MSG("Runtime get of UCX heap base address failed (PE %d, ret %d)\n", i, ret);
+        shmem_transport_peers[i].data_base     = info.data_base;
+        shmem_transport_peers[i].heap_base     = info.heap_base;
 #endif
     }
 
+    ret = shmem_transport_ucx_worker_connect(&shmem_transport_ucx_default_worker);
+    if (ret) return ret;
+
     if (shmem_internal_params.PROGRESS_INTERVAL > 0)
         pthread_create(&shmem_transport_ucx_progress_thread, NULL,
                        &shmem_transport_ucx_progress_thread_func, NULL);
@@ -330,6 +554,94 @@ int shmem_transport_startup(void)
     return 0;
 }
 
+int shmem_transport_ctx_create(struct shmem_internal_team_t *team, long options, shmem_transport_ctx_t **ctx)
+{
+    shmem_transport_ctx_t *ctxp;
+    shmem_transport_ucx_worker_t *w;
+    ucs_thread_mode_t mode = shmem_transport_ucx_thread_mode();
+
+    if (team == NULL)
+        RAISE_ERROR_STR("Context creation occured on a NULL team");
+
+    ctxp = malloc(sizeof(shmem_transport_ctx_t));
+
+    if (ctxp == NULL)
+        return 1;
+
+    switch (shmem_transport_ucx_ctx_worker) {
+        case SHMEM_TRANSPORT_UCX_CTX_WORKER_CTX:
+            /* A private context is only used by the thread that created it */
+            if (options & SHMEM_CTX_PRIVATE)
+                mode = UCS_THREAD_MODE_SINGLE;
+            else if ((options & SHMEM_CTX_SERIALIZED) && mode > UCS_THREAD_MODE_SERIALIZED)
+                mode = UCS_THREAD_MODE_SERIALIZED;
+
+            w = shmem_transport_ucx_worker_create(mode);
+            break;
+        case SHMEM_TRANSPORT_UCX_CTX_WORKER_THREAD:
+            /* Shareable contexts created by the thread may be used by other
+             * threads, so the worker keeps the library thread mode.  The
+             * thread's reference keeps the worker until finalize. */
+            if (shmem_transport_ucx_thread_worker == NULL) {
+                shmem_transport_ucx_thread_worker = shmem_transport_ucx_worker_create(mode);
+                if (shmem_transport_ucx_thread_worker != NULL)
+                    shmem_transport_ucx_thread_worker->ref_cnt = 1;
+            }
+            w = shmem_transport_ucx_thread_worker;
+            break;
+        default:
+            w = &shmem_transport_ucx_default_worker;
+    }
+
+    if (w == NULL) {
+        free(ctxp);
+        return 1;
+    }
+
+    __atomic_fetch_add(&w->ref_cnt, 1, __ATOMIC_RELAXED);
+
+    ctxp->options     = options;
+    ctxp->team        = team;
+    ctxp->pcntr_stats = NULL;
+    ctxp->worker      = w;
+    ctxp->pending     = 0;
+    ctxp->shr_nic_pending = 0;
+
+    *ctx = ctxp;
+
+    return 0;
+}
+
+int shmem_transport_ctx_reuse(shmem_transport_ctx_t *ctx)
+{
+    /* Contexts are only reused with the same options, and the worker stays
+     * connected.  A single-threaded worker must not be used by any thread
+     * other than its creator, so such a context is recreated instead. */
+    if (ctx->worker->thread_mode == UCS_THREAD_MODE_SINGLE &&
+        !pthread_equal(ctx->worker->owner, pthread_self()))
+        return 1;
+
+    return 0;
+}
+
+void shmem_transport_ctx_destroy(shmem_transport_ctx_t *ctx)
+{
+    shmem_transport_ucx_worker_t *w;
+
+    if (ctx == NULL)
+        return;
+    else if (ctx == (shmem_transport_ctx_t *) SHMEM_CTX_DEFAULT)
+        RAISE_ERROR_STR("Cannot destroy SHMEM_CTX_DEFAULT");
+
+    w = ctx->worker;
+
+    if (__atomic_sub_fetch(&w->ref_cnt, 1, __ATOMIC_ACQ_REL) == 0 &&
+        w != &shmem_transport_ucx_default_worker)
+        shmem_transport_ucx_worker_destroy(w);
+
+    free(ctx);
+}
+
 int shmem_transport_fini(void)
 {
     ucs_status_t status;
@@ -344,15 +656,16 @@ int shmem_transport_fini(void)
     /* Clean up contexts */
     shmem_transport_quiet(&shmem_transport_ctx_default);
 
+    /* Workers of contexts that were not destroyed, including per-thread
+     * workers, which are kept until finalize */
+    while (shmem_transport_ucx_worker_list != NULL)
+        shmem_transport_ucx_worker_destroy(shmem_transport_ucx_worker_list);
+
+    shmem_transport_ucx_worker_disconnect(&shmem_transport_ucx_default_worker);
+
     /* Clean up peers table */
-    for (i = 0; i < shmem_internal_num_pes; i++) {
-        ucp_rkey_destroy(shmem_transport_peers[i].data_rkey);
-        ucp_rkey_destroy(shmem_transport_peers[i].heap_rkey);
-        ucs_status_ptr_t pstatus = ucp_ep_close_nb(shmem_transport_peers[i].ep,
-                                                   UCP_EP_CLOSE_MODE_FLUSH);
-        shmem_transport_ucx_complete_op(pstatus);
-        free(shmem_transport_peers[i].addr);
-    }
+    for (i = 0; i < shmem_internal_num_pes; i++)
+        free(shmem_transport_peers[i].info);
 
     free(shmem_transport_peers);
 
@@ -13,6 +13,7 @@
 #define TRANSPORT_UCX_H
 
 #include <string.h>
+#include <pthread.h>
 #include "shmem_internal.h"
 #include "transport.h"
 #include <ucs/type/status.h>
@@ -37,36 +38,74 @@ enum shm_internal_op_t {
 
 extern ucp_atomic_post_op_t shmem_transport_ucx_post_op[];
 extern ucp_atomic_fetch_op_t shmem_transport_ucx_fetch_op[];
+extern ucp_atomic_op_t shmem_transport_ucx_amo_op[];
 
 typedef enum shm_internal_op_t shm_internal_op_t;
-typedef int shmem_transport_ct_t;
+
+/* Endpoint to a peer and the peer's rkeys, which are specific to a worker */
+typedef struct {
+    ucp_ep_h       ep;
+    ucp_rkey_h     data_rkey, heap_rkey;
+} shmem_transport_ucx_conn_t;
+
+/* A UCP worker with connections to all PEs.  Depending on
+ * SHMEM_UCX_CTX_WORKER, a context uses its own worker, a worker shared by
+ * the contexts created by the same thread, or the default worker. */
+struct shmem_transport_ucx_worker_t {
+    ucp_worker_h                          worker;
+    /* Indexed by PE, an entry is connected on first use */
+    shmem_transport_ucx_conn_t           *conns;
+    pthread_mutex_t                       lock;
+    long                                  ref_cnt;
+    /* Thread mode granted by UCX and the thread that created the worker */
+    ucs_thread_mode_t                     thread_mode;
+    pthread_t                             owner;
+    struct shmem_transport_ucx_worker_t  *next;
+};
+typedef struct shmem_transport_ucx_worker_t shmem_transport_ucx_worker_t;
 
 struct shmem_transport_ctx_t {
     long options;
     struct shmem_internal_team_t *team;
+    struct shmem_internal_pcntr_ctx_t *pcntr_stats;
+    /* Set when a put or atomic to an on-node PE has been issued through this
+     * transport since the last quiet, see shmem_shr_route_mixed */
+    int shr_nic_pending;
+    shmem_transport_ucx_worker_t *worker;
+    /* Operations posted with shmem_transport_ucx_cb_ctx that have not
+     * completed yet */
+    long pending;
 };
 typedef struct shmem_transport_ctx_t shmem_transport_ctx_t;
 
 typedef struct {
-    size_t         addr_len;
+    /* Worker address and packed rkeys, which point into info and are
+     * unpacked by each worker that connects to the peer */
     ucp_address_t *addr;
-    ucp_ep_h       ep;
+    void          *data_rkey_buf, *heap_rkey_buf;
 #ifndef ENABLE_REMOTE_VIRTUAL_ADDRESSING
     uint8_t       *data_base, *heap_base;
 #endif
-    ucp_rkey_h     data_rkey, heap_rkey;
+    void          *info;
 } shmem_transport_peer_t;
 
 extern shmem_transport_peer_t *shmem_transport_peers;
 extern ucp_worker_h shmem_transport_ucp_worker;
+extern shmem_transport_ucx_worker_t shmem_transport_ucx_default_worker;
+extern long shmem_transport_ucx_max_pending;
 
-void shmem_transport_ucx_cb_nop(void *request, ucs_status_t status);
 void shmem_transport_ucx_cb_complete(void *request, ucs_status_t status, void *user_data);
+void shmem_transport_ucx_cb_ctx(void *request, ucs_status_t status, void *user_data);
+void shmem_transport_ucx_connect(shmem_transport_ucx_worker_t *w, int pe);
 
 int shmem_transport_init(void);
 int shmem_transport_startup(void);
 int shmem_transport_fini(void);
 
+int shmem_transport_ctx_create(struct shmem_internal_team_t *team, long options, shmem_transport_ctx_t **ctx);
+void shmem_transport_ctx_destroy(shmem_transport_ctx_t *ctx);
+int shmem_transport_ctx_reuse(shmem_transport_ctx_t *ctx);
+
 #define UCX_CHECK_STATUS(status)                                                        \
     do {                                                                                \
         if (status != UCS_OK) {                                                         \
@@ -88,19 +127,31 @@ shmem_transport_probe(void)
     ucp_worker_progress(shmem_transport_ucp_worker);
 }
 
+/* Progress the context's worker, and the default worker, which is the target
+ * of operations from other PEs */
+static inline
+void
+shmem_transport_ucx_progress(shmem_transport_ctx_t *ctx)
+{
+    if (ctx->worker != &shmem_transport_ucx_default_worker)
+        ucp_worker_progress(ctx->worker->worker);
+
+    shmem_transport_probe();
+}
+
 static inline
-ucs_status_t shmem_transport_ucx_complete_op(ucs_status_ptr_t req) {
+ucs_status_t shmem_transport_ucx_complete_op(shmem_transport_ctx_t *ctx, ucs_status_ptr_t req) {
     if (req == NULL) {
         /* All calls to complete_op must generate progress to avoid deadlock
          * in application-level polling loops */
-        shmem_transport_probe();
+        shmem_transport_ucx_progress(ctx);
         return UCS_OK;
     } else if (UCS_PTR_IS_ERR(req)) {
         return UCS_PTR_STATUS(req);
     } else {
         ucs_status_t status;
         do {
-            shmem_transport_probe();
+            shmem_transport_ucx_progress(ctx);
             status = ucp_request_check_status(req);
         } while (status == UCS_INPROGRESS);
         ucp_request_free(req);
@@ -109,37 +160,67 @@ ucs_status_t shmem_transport_ucx_complete_op(ucs_status_ptr_t req) {
 }
 
 static inline
-ucs_status_t shmem_transport_ucx_release_op(ucs_status_ptr_t req) {
-    if (req == NULL)
-         return UCS_OK;
-    else if (UCS_PTR_IS_ERR(req))
+ucs_status_t shmem_transport_ucx_post_cb_op(ucs_status_ptr_t req, void *completion) {
+    if (req == NULL) {
+        __atomic_store_n((long*)completion, 0, __ATOMIC_RELEASE);
+        return UCS_OK;
+    } else if (UCS_PTR_IS_ERR(req)) {
         return UCS_PTR_STATUS(req);
-    else {
+    } else {
         ucp_request_free(req);
         return UCS_INPROGRESS;
     }
 }
 
+/* Account for an operation posted with shmem_transport_ucx_cb_ctx.  The
+ * caller calls shmem_transport_ucx_begin_op before posting the operation. */
 static inline
-ucs_status_t shmem_transport_ucx_post_cb_op(ucs_status_ptr_t req, void *completion) {
+void shmem_transport_ucx_track_op(shmem_transport_ctx_t *ctx, ucs_status_ptr_t req) {
     if (req == NULL) {
-        __atomic_store_n((long*)completion, 0, __ATOMIC_RELEASE);
-        return UCS_OK;
+        /* Completed in place, the callback is not invoked */
+        __atomic_fetch_sub(&ctx->pending, 1, __ATOMIC_RELEASE);
     } else if (UCS_PTR_IS_ERR(req)) {
-        return UCS_PTR_STATUS(req);
+        ucs_status_t status = UCS_PTR_STATUS(req);
+        UCX_CHECK_STATUS(status);
     } else {
+        /* The callback is still invoked once the operation completes */
         ucp_request_free(req);
-        return UCS_INPROGRESS;
     }
+
+    /* Manual progress to avoid deadlock for application-level polling */
+    shmem_transport_ucx_progress(ctx);
 }
 
+/* Account for an operation that will complete with shmem_transport_ucx_cb_ctx.
+ * The number of outstanding operations on a context is bounded by
+ * SHMEM_UCX_MAX_PENDING, so that UCX request memory does not grow without
+ * bound when an application issues many non-blocking fetches. */
 static inline
-void shmem_transport_ucx_get_mr(const void *addr, int dest_pe,
-                                uint8_t **remote_addr, ucp_rkey_h *rkey) {
+void shmem_transport_ucx_begin_op(shmem_transport_ctx_t *ctx) {
+    while (__atomic_load_n(&ctx->pending, __ATOMIC_ACQUIRE) >= shmem_transport_ucx_max_pending)
+        shmem_transport_ucx_progress(ctx);
+
+    __atomic_fetch_add(&ctx->pending, 1, __ATOMIC_RELAXED);
+}
+
+/* Endpoint of the context's worker for dest_pe, and the address and rkey of
+ * addr on dest_pe.  The endpoint is created on first use. */
+static inline
+void shmem_transport_ucx_get_mr(shmem_transport_ctx_t *ctx, const void *addr, int dest_pe,
+                                uint8_t **remote_addr, ucp_rkey_h *rkey, ucp_ep_h *ep) {
+    shmem_transport_ucx_conn_t *conn = &ctx->worker->conns[dest_pe];
+
+    *ep = __atomic_load_n(&conn->ep, __ATOMIC_ACQUIRE);
+
+    if (__builtin_expect(*ep == NULL, 0)) {
+        shmem_transport_ucx_connect(ctx->worker, dest_pe);
+        *ep = conn->ep;
+    }
+
     if ((void*) addr >= shmem_internal_data_base &&
         (uint8_t*) addr < (uint8_t*) shmem_internal_data_base + shmem_internal_data_length) {
 
-        *rkey = shmem_transport_peers[dest_pe].data_rkey;
+        *rkey = conn->data_rkey;
 #ifdef ENABLE_REMOTE_VIRTUAL_ADDRESSING
         *remote_addr = (uint8_t *) addr;
 #else
@@ -149,7 +230,7 @@ void shmem_transport_ucx_get_mr(const void *addr, int dest_pe,
     } else if ((void*) addr >= shmem_internal_heap_base &&
                (uint8_t*) addr < (uint8_t*) shmem_internal_heap_base + shmem_internal_heap_length) {
 
-        *rkey = shmem_transport_peers[dest_pe].heap_rkey;
+        *rkey = conn->heap_rkey;
 #ifdef ENABLE_REMOTE_VIRTUAL_ADDRESSING
         *remote_addr = (uint8_t *) addr;
 #else
@@ -163,69 +244,77 @@ void shmem_transport_ucx_get_mr(const void *addr, int dest_pe,
 
 static inline
 int
-shmem_transport_ctx_create(struct shmem_internal_team_t *team, long options, shmem_transport_ctx_t **ctx)
+shmem_transport_quiet(shmem_transport_ctx_t* ctx)
 {
-    /* FIXME: Contexts are not optimized yet. We could create a separate set of
-     * EPs for each context (or team), and/or we could use completion callbacks
-     * to implement completion counters at the SOS level to enable separate
-     * completion tracking per context. */
-
-    if (team == NULL)
-        RAISE_ERROR_STR("Context creation occured on a NULL team");
-
-    *ctx = malloc(sizeof(shmem_transport_ctx_t));
+    ucs_status_t status;
 
-    if (*ctx == NULL)
-        return 1;
+    status = ucp_worker_flush(ctx->worker->worker);
+    UCX_CHECK_STATUS(status);
 
-    (*ctx)->team = team;
-    (*ctx)->options = 0;
+    /* Wait for the completion callbacks of fetching operations, which write
+     * their results */
+    while (__atomic_load_n(&ctx->pending, __ATOMIC_ACQUIRE) > 0)
+        shmem_transport_ucx_progress(ctx);
 
     return 0;
 }
 
 static inline
-void
-shmem_transport_ctx_destroy(shmem_transport_ctx_t *ctx)
+int
+shmem_transport_fence(shmem_transport_ctx_t* ctx)
 {
-    if (ctx == NULL)
-        return;
-    else if (ctx == (shmem_transport_ctx_t *) SHMEM_CTX_DEFAULT)
-        RAISE_ERROR_STR("Cannot destroy SHMEM_CTX_DEFAULT");
-    else
-        free(ctx);
+#if defined(USE_CMA) || ((defined(USE_XPMEM) || defined(USE_MEMFD)) && !defined(USE_SHR_ATOMICS))
+    /* Put/get use shared memory and atomics use UCX. Flush to resolve a race
+     * across transports. */
+    return shmem_transport_quiet(ctx);
+#else
+    ucs_status_t status;
 
-    return;
+    status = ucp_worker_fence(ctx->worker->worker);
+    UCX_CHECK_STATUS(status);
+
+    return 0;
+#endif
 }
 
+/* Only the endpoint of the given PE is flushed, so that completion is not
+ * delayed by outstanding puts and atomics to other PEs.  Fetching operations
+ * posted with shmem_transport_ucx_cb_ctx are counted per context rather than
+ * per PE, so for those this is a full quiet: it also waits for the ones
+ * issued to other PEs. */
 static inline
 int
-shmem_transport_quiet(shmem_transport_ctx_t* ctx)
+shmem_transport_quiet_pe(shmem_transport_ctx_t* ctx, int pe)
 {
+    ucp_request_param_t param = { .op_attr_mask = 0 };
+    ucp_ep_h ep = __atomic_load_n(&ctx->worker->conns[pe].ep, __ATOMIC_ACQUIRE);
+    ucs_status_ptr_t pstatus;
     ucs_status_t status;
 
-    status = ucp_worker_flush(shmem_transport_ucp_worker);
-    UCX_CHECK_STATUS(status);
+    /* Nothing was sent to an unconnected PE */
+    if (ep != NULL) {
+        pstatus = ucp_ep_flush_nbx(ep, &param);
+        status = shmem_transport_ucx_complete_op(ctx, pstatus);
+        UCX_CHECK_STATUS(status);
+    }
+
+    while (__atomic_load_n(&ctx->pending, __ATOMIC_ACQUIRE) > 0)
+        shmem_transport_ucx_progress(ctx);
 
     return 0;
 }
 
 static inline
 int
-shmem_transport_fence(shmem_transport_ctx_t* ctx)
+shmem_transport_fence_pe(shmem_transport_ctx_t* ctx, int pe)
 {
-    ucs_status_t status;
-
-#if defined(USE_CMA) || (defined(USE_XPMEM) && !defined(USE_SHR_ATOMICS))
-    /* Put/get use shared memory and atomics use UCX. Flush to resolve a race
-     * across transports. */
-    status = ucp_worker_flush(shmem_transport_ucp_worker);
+#if defined(USE_CMA) || ((defined(USE_XPMEM) || defined(USE_MEMFD)) && !defined(USE_SHR_ATOMICS))
+    /* Fence is implemented by a flush in this configuration, which can be
+     * limited to the given PE */
+    return shmem_transport_quiet_pe(ctx, pe);
 #else
-    status = ucp_worker_fence(shmem_transport_ucp_worker);
+    return shmem_transport_fence(ctx);
 #endif
-    UCX_CHECK_STATUS(status);
-
-    return 0;
 }
 
 static inline
@@ -234,11 +323,12 @@ shmem_transport_put_scalar(shmem_transport_ctx_t* ctx, void *target, const void
 {
     ucs_status_t status;
     ucp_rkey_h rkey;
+    ucp_ep_h ep;
     uint8_t *remote_addr;
 
-    shmem_transport_ucx_get_mr(target, pe, &remote_addr, &rkey);
+    shmem_transport_ucx_get_mr(ctx, target, pe, &remote_addr, &rkey, &ep);
 
-    status = ucp_put_nbi(shmem_transport_peers[pe].ep, source, len, (uint64_t) remote_addr, rkey);
+    status = ucp_put_nbi(ep, source, len, (uint64_t) remote_addr, rkey);
     UCX_CHECK_STATUS_INPROGRESS(status);
 
     /* SOS expects scalar puts to complete locally. Use ucp_put_nbi in the hope
@@ -256,6 +346,7 @@ shmem_transport_put_nb(shmem_transport_ctx_t* ctx, void *target, const void *sou
 {
     ucs_status_t status;
     ucp_rkey_h rkey;
+    ucp_ep_h ep;
     uint8_t *remote_addr;
 
     ucp_request_param_t param = {
@@ -264,9 +355,9 @@ shmem_transport_put_nb(shmem_transport_ctx_t* ctx, void *target, const void *sou
         .user_data    = completion
     };
 
-    shmem_transport_ucx_get_mr(target, pe, &remote_addr, &rkey);
+    shmem_transport_ucx_get_mr(ctx, target, pe, &remote_addr, &rkey, &ep);
 
-    ucs_status_ptr_t pstatus = ucp_put_nbx(shmem_transport_peers[pe].ep, source,
+    ucs_status_ptr_t pstatus = ucp_put_nbx(ep, source,
                                            len, (uint64_t) remote_addr, rkey, &param);
 
     status = shmem_transport_ucx_post_cb_op(pstatus, completion);
@@ -278,7 +369,7 @@ void
 shmem_transport_put_wait(shmem_transport_ctx_t* ctx, long *completion)
 {
     while (__atomic_load_n(completion, __ATOMIC_ACQUIRE) > 0)
-        shmem_transport_probe();
+        shmem_transport_ucx_progress(ctx);
 }
 
 static inline
@@ -288,11 +379,12 @@ shmem_transport_put_nbi(shmem_transport_ctx_t* ctx, void *target, const void *so
 {
     ucs_status_t status;
     ucp_rkey_h rkey;
+    ucp_ep_h ep;
     uint8_t *remote_addr;
 
-    shmem_transport_ucx_get_mr(target, pe, &remote_addr, &rkey);
+    shmem_transport_ucx_get_mr(ctx, target, pe, &remote_addr, &rkey, &ep);
 
-    status = ucp_put_nbi(shmem_transport_peers[pe].ep, source, len, (uint64_t) remote_addr, rkey);
+    status = ucp_put_nbi(ep, source, len, (uint64_t) remote_addr, rkey);
     UCX_CHECK_STATUS_INPROGRESS(status);
 }
 
@@ -302,100 +394,126 @@ shmem_transport_get(shmem_transport_ctx_t* ctx, void *target, const void *source
 {
     ucs_status_ptr_t pstatus;
     ucp_rkey_h rkey;
+    ucp_ep_h ep;
     uint8_t *remote_addr;
 
-    shmem_transport_ucx_get_mr(source, pe, &remote_addr, &rkey);
+    ucp_request_param_t param = {
+        .op_attr_mask = UCP_OP_ATTR_FIELD_CALLBACK | UCP_OP_ATTR_FIELD_USER_DATA,
+        .cb.send      = &shmem_transport_ucx_cb_ctx,
+        .user_data    = ctx
+    };
 
-    pstatus = ucp_get_nb(shmem_transport_peers[pe].ep, target, len,
-                         (uint64_t) remote_addr, rkey, &shmem_transport_ucx_cb_nop);
+    shmem_transport_ucx_get_mr(ctx, source, pe, &remote_addr, &rkey, &ep);
 
-    ucs_status_t status = shmem_transport_ucx_complete_op(pstatus);
-    UCX_CHECK_STATUS(status);
+    shmem_transport_ucx_begin_op(ctx);
+
+    pstatus = ucp_get_nbx(ep, target, len, (uint64_t) remote_addr, rkey, &param);
+
+    shmem_transport_ucx_track_op(ctx, pstatus);
 }
 
 static inline
 void
 shmem_transport_get_wait(shmem_transport_ctx_t* ctx)
 {
-    /* Blocking fetching ops are completed in place, so this is a nop */
+    /* Gets and fetching atomics complete through shmem_transport_ucx_cb_ctx */
+    while (__atomic_load_n(&ctx->pending, __ATOMIC_ACQUIRE) > 0)
+        shmem_transport_ucx_progress(ctx);
 }
 
-
+/* Returns nonzero if the gets on ctx have completed.  Other pending
+ * operations are counted as well, so this may report gets as incomplete
+ * until those finish. */
 static inline
-void
-shmem_transport_swap(shmem_transport_ctx_t* ctx, void *target, const void *source, void *dest,
-                     size_t len, int pe, shm_internal_datatype_t datatype)
+int
+shmem_transport_get_test(shmem_transport_ctx_t* ctx)
 {
-    uint8_t *remote_addr;
-    ucp_rkey_h rkey;
-    ucs_status_ptr_t pstatus;
-    uint64_t value;
+    shmem_transport_ucx_progress(ctx);
+    return __atomic_load_n(&ctx->pending, __ATOMIC_ACQUIRE) == 0;
+}
 
-    shmem_transport_ucx_get_mr(target, pe, &remote_addr, &rkey);
 
-    switch (len) {
-        case 1:
-            value = (uint64_t) *(uint8_t*)source;
-            break;
-        case 2:
-            value = (uint64_t) *(uint16_t*)source;
-            break;
-        case 4:
-            value = (uint64_t) *(uint32_t*)source;
-            break;
-        case 8:
-            value = (uint64_t) *(uint64_t*)source;
-            break;
-        default:
-            RAISE_ERROR_MSG("Unsupported datatype len=%zu\n", len);
+/* Strided transfers of nblocks blocks of bsize bytes; strides are in bytes.
+ * The transport has no vectored RMA, so each block is a separate operation. */
+static inline
+void
+shmem_transport_iput(shmem_transport_ctx_t* ctx, void *target, const void *source,
+                     ptrdiff_t tst, ptrdiff_t sst, size_t bsize, size_t nblocks,
+                     int pe, long *completion)
+{
+    for ( ; nblocks > 0 ; --nblocks) {
+        shmem_transport_put_nb(ctx, target, source, bsize, pe, completion);
+        target = (uint8_t *) target + tst;
+        source = (const uint8_t *) source + sst;
     }
+}
 
-    pstatus = ucp_atomic_fetch_nb(shmem_transport_peers[pe].ep, UCP_ATOMIC_FETCH_OP_SWAP, value,
-                                  dest, len, (uint64_t) remote_addr, rkey,
-                                  &shmem_transport_ucx_cb_nop);
 
-    ucs_status_t status = shmem_transport_ucx_complete_op(pstatus);
-    UCX_CHECK_STATUS(status);
+static inline
+void
+shmem_transport_iget(shmem_transport_ctx_t* ctx, void *target, const void *source,
+                     ptrdiff_t tst, ptrdiff_t sst, size_t bsize, size_t nblocks,
+                     int pe)
+{
+    for ( ; nblocks > 0 ; --nblocks) {
+        shmem_transport_get(ctx, target, source, bsize, pe);
+        target = (uint8_t *) target + tst;
+        source = (const uint8_t *) source + sst;
+    }
 }
 
+
+/* Post a fetching atomic that completes in quiet or get_wait.  The operand
+ * and result are len bytes; for CSWAP, the operand is the compare value and
+ * the result buffer initially holds the swap value.  UCX reads the operands
+ * when the operation is posted. */
 static inline
 void
-shmem_transport_swap_nbi(shmem_transport_ctx_t* ctx, void *target, const void *source, void *dest,
-                         size_t len, int pe, shm_internal_datatype_t datatype)
+shmem_transport_ucx_fetch_atomic_nbi(shmem_transport_ctx_t* ctx, ucp_atomic_op_t opcode,
+                                     void *target, const void *operand, void *result,
+                                     size_t len, int pe)
 {
     uint8_t *remote_addr;
     ucp_rkey_h rkey;
+    ucp_ep_h ep;
     ucs_status_ptr_t pstatus;
-    uint64_t value;
 
-    shmem_transport_ucx_get_mr(target, pe, &remote_addr, &rkey);
+    ucp_request_param_t param = {
+        .op_attr_mask = UCP_OP_ATTR_FIELD_CALLBACK | UCP_OP_ATTR_FIELD_USER_DATA |
+                        UCP_OP_ATTR_FIELD_DATATYPE | UCP_OP_ATTR_FIELD_REPLY_BUFFER,
+        .cb.send      = &shmem_transport_ucx_cb_ctx,
+        .user_data    = ctx,
+        .datatype     = ucp_dt_make_contig(len),
+        .reply_buffer = result
+    };
 
-    switch (len) {
-        case 1:
-            value = (uint64_t) *(uint8_t*)source;
-            break;
-        case 2:
-            value = (uint64_t) *(uint16_t*)source;
-            break;
-        case 4:
-            value = (uint64_t) *(uint32_t*)source;
-            break;
-        case 8:
-            value = (uint64_t) *(uint64_t*)source;
-            break;
-        default:
-            RAISE_ERROR_MSG("Unsupported datatype len=%zu\n", len);
-    }
+    if (len != 4 && len != 8)
+        RAISE_ERROR_MSG("Unsupported datatype len=%zu\n", len);
 
-    pstatus = ucp_atomic_fetch_nb(shmem_transport_peers[pe].ep, UCP_ATOMIC_FETCH_OP_SWAP, value,
-                                  dest, len, (uint64_t) remote_addr, rkey,
-                                  &shmem_transport_ucx_cb_nop);
+    shmem_transport_ucx_get_mr(ctx, target, pe, &remote_addr, &rkey, &ep);
 
-    /* Manual progress to avoid deadlock for application-level polling */
-    shmem_transport_probe();
+    shmem_transport_ucx_begin_op(ctx);
 
-    ucs_status_t status = shmem_transport_ucx_release_op(pstatus);
-    UCX_CHECK_STATUS_INPROGRESS(status);
+    pstatus = ucp_atomic_op_nbx(ep, opcode, operand, 1, (uint64_t) remote_addr,
+                                rkey, &param);
+
+    shmem_transport_ucx_track_op(ctx, pstatus);
+}
+
+static inline
+void
+shmem_transport_swap(shmem_transport_ctx_t* ctx, void *target, const void *source, void *dest,
+                     size_t len, int pe, shm_internal_datatype_t datatype)
+{
+    shmem_transport_ucx_fetch_atomic_nbi(ctx, UCP_ATOMIC_OP_SWAP, target, source, dest, len, pe);
+}
+
+static inline
+void
+shmem_transport_swap_nbi(shmem_transport_ctx_t* ctx, void *target, const void *source, void *dest,
+                         size_t len, int pe, shm_internal_datatype_t datatype)
+{
+    shmem_transport_ucx_fetch_atomic_nbi(ctx, UCP_ATOMIC_OP_SWAP, target, source, dest, len, pe);
 }
 
 static inline
@@ -404,38 +522,9 @@ shmem_transport_cswap(shmem_transport_ctx_t* ctx, void *target, const void *sour
                       const void *operand, size_t len, int pe,
                       shm_internal_datatype_t datatype)
 {
-    uint8_t *remote_addr;
-    ucp_rkey_h rkey;
-    ucs_status_ptr_t pstatus;
-    uint64_t value;
-
-    shmem_transport_ucx_get_mr(target, pe, &remote_addr, &rkey);
-
     memcpy(dest, source, len);
 
-    switch (len) {
-        case 1:
-            value = (uint64_t) *(uint8_t*)operand;
-            break;
-        case 2:
-            value = (uint64_t) *(uint16_t*)operand;
-            break;
-        case 4:
-            value = (uint64_t) *(uint32_t*)operand;
-            break;
-        case 8:
-            value = (uint64_t) *(uint64_t*)operand;
-            break;
-        default:
-            RAISE_ERROR_MSG("Unsupported datatype len=%zu\n", len);
-    }
-
-    pstatus = ucp_atomic_fetch_nb(shmem_transport_peers[pe].ep, UCP_ATOMIC_FETCH_OP_CSWAP,
-                                  value, dest, len, (uint64_t) remote_addr, rkey,
-                                  &shmem_transport_ucx_cb_nop);
-
-    ucs_status_t status = shmem_transport_ucx_complete_op(pstatus);
-    UCX_CHECK_STATUS(status);
+    shmem_transport_ucx_fetch_atomic_nbi(ctx, UCP_ATOMIC_OP_CSWAP, target, operand, dest, len, pe);
 }
 
 static inline
@@ -444,41 +533,9 @@ shmem_transport_cswap_nbi(shmem_transport_ctx_t* ctx, void *target, const void *
                           const void *operand, size_t len, int pe,
                           shm_internal_datatype_t datatype)
 {
-    uint8_t *remote_addr;
-    ucp_rkey_h rkey;
-    ucs_status_ptr_t pstatus;
-    uint64_t value;
-
-    shmem_transport_ucx_get_mr(target, pe, &remote_addr, &rkey);
-
     memcpy(dest, source, len);
 
-    switch (len) {
-        case 1:
-            value = (uint64_t) *(uint8_t*)operand;
-            break;
-        case 2:
-            value = (uint64_t) *(uint16_t*)operand;
-            break;
-        case 4:
-            value = (uint64_t) *(uint32_t*)operand;
-            break;
-        case 8:
-            value = (uint64_t) *(uint64_t*)operand;
-            break;
-        default:
-            RAISE_ERROR_MSG("Unsupported datatype len=%zu\n", len);
-    }
-
-    pstatus = ucp_atomic_fetch_nb(shmem_transport_peers[pe].ep, UCP_ATOMIC_FETCH_OP_CSWAP,
-                                  value, dest, len, (uint64_t) remote_addr, rkey,
-                                  &shmem_transport_ucx_cb_nop);
-
-    /* Manual progress to avoid deadlock for application-level polling */
-    shmem_transport_probe();
-
-    ucs_status_t status = shmem_transport_ucx_release_op(pstatus);
-    UCX_CHECK_STATUS_INPROGRESS(status);
+    shmem_transport_ucx_fetch_atomic_nbi(ctx, UCP_ATOMIC_OP_CSWAP, target, operand, dest, len, pe);
 }
 
 static inline
@@ -488,10 +545,11 @@ shmem_transport_atomic(shmem_transport_ctx_t* ctx, void *target, const void *sou
 {
     uint8_t *remote_addr;
     ucp_rkey_h rkey;
+    ucp_ep_h ep;
     ucs_status_t status;
     uint64_t value;
 
-    shmem_transport_ucx_get_mr(target, pe, &remote_addr, &rkey);
+    shmem_transport_ucx_get_mr(ctx, target, pe, &remote_addr, &rkey, &ep);
 
     shmem_internal_assert(op <= SHMEM_TRANSPORT_UCX_OP_LAST);
 
@@ -512,7 +570,7 @@ shmem_transport_atomic(shmem_transport_ctx_t* ctx, void *target, const void *sou
             RAISE_ERROR_MSG("Unsupported datatype len=%zu\n", len);
     }
 
-    status = ucp_atomic_post(shmem_transport_peers[pe].ep, shmem_transport_ucx_post_op[op],
+    status = ucp_atomic_post(ep, shmem_transport_ucx_post_op[op],
                              value, len, (uint64_t) remote_addr, rkey);
     UCX_CHECK_STATUS_INPROGRESS(status);
 }
@@ -532,39 +590,10 @@ void
 shmem_transport_fetch_atomic(shmem_transport_ctx_t* ctx, void *target, const void *source, void *dest, size_t len,
                              int pe, shm_internal_op_t op, shm_internal_datatype_t datatype)
 {
-    uint8_t *remote_addr;
-    ucp_rkey_h rkey;
-    ucs_status_ptr_t pstatus;
-    uint64_t value;
-
-    shmem_transport_ucx_get_mr(target, pe, &remote_addr, &rkey);
-
     shmem_internal_assert(op <= SHMEM_TRANSPORT_UCX_OP_LAST);
 
-    switch (len) {
-        case 1:
-            value = (uint64_t) *(uint8_t*)source;
-            break;
-        case 2:
-            value = (uint64_t) *(uint16_t*)source;
-            break;
-        case 4:
-            value = (uint64_t) *(uint32_t*)source;
-            break;
-        case 8:
-            value = (uint64_t) *(uint64_t*)source;
-            break;
-        default:
-            RAISE_ERROR_MSG("Unsupported datatype len=%zu\n", len);
-    }
-
-    pstatus = ucp_atomic_fetch_nb(shmem_transport_peers[pe].ep,
-                                  shmem_transport_ucx_fetch_op[op], value,
-                                  dest, len, (uint64_t) remote_addr, rkey,
-                                  &shmem_transport_ucx_cb_nop);
-
-    ucs_status_t status = shmem_transport_ucx_complete_op(pstatus);
-    UCX_CHECK_STATUS(status);
+    shmem_transport_ucx_fetch_atomic_nbi(ctx, shmem_transport_ucx_amo_op[op], target, source,
+                                         dest, len, pe);
 }
 
 static inline
@@ -572,42 +601,37 @@ void
 shmem_transport_fetch_atomic_nbi(shmem_transport_ctx_t* ctx, void *target, const void *source, void *dest, size_t len,
                                  int pe, shm_internal_op_t op, shm_internal_datatype_t datatype)
 {
-    uint8_t *remote_addr;
-    ucp_rkey_h rkey;
-    ucs_status_ptr_t pstatus;
-    uint64_t value;
-
-    shmem_transport_ucx_get_mr(target, pe, &remote_addr, &rkey);
-
     shmem_internal_assert(op <= SHMEM_TRANSPORT_UCX_OP_LAST);
 
-    switch (len) {
-        case 1:
-            value = (uint64_t) *(uint8_t*)source;
-            break;
-        case 2:
-            value = (uint64_t) *(uint16_t*)source;
-            break;
-        case 4:
-            value = (uint64_t) *(uint32_t*)source;
-            break;
-        case 8:
-            value = (uint64_t) *(uint64_t*)source;
-            break;
-        default:
-            RAISE_ERROR_MSG("Unsupported datatype len=%zu\n", len);
-    }
+    shmem_transport_ucx_fetch_atomic_nbi(ctx, shmem_transport_ucx_amo_op[op], target, source,
+                                         dest, len, pe);
+}
 
-    pstatus = ucp_atomic_fetch_nb(shmem_transport_peers[pe].ep,
-                                  shmem_transport_ucx_fetch_op[op], value,
-                                  dest, len, (uint64_t) remote_addr, rkey,
-                                  &shmem_transport_ucx_cb_nop);
+static inline
+void
+shmem_transport_fetch_atomic_batch(shmem_transport_ctx_t* ctx, void *const *target, const void *source,
+                                   void *dest, size_t len, const int *pe, size_t count,
+                                   shm_internal_op_t op, shm_internal_datatype_t datatype)
+{
+    size_t i;
 
-    /* Manual progress to avoid deadlock for application-level polling */
-    shmem_transport_probe();
+    for (i = 0; i < count; i++)
+        shmem_transport_fetch_atomic_nbi(ctx, target[i], (const uint8_t *) source + i * len,
+                                         (uint8_t *) dest + i * len, len, pe[i], op, datatype);
+}
 
-    ucs_status_t status = shmem_transport_ucx_release_op(pstatus);
-    UCX_CHECK_STATUS_INPROGRESS(status);
+static inline
+void
+shmem_transport_cswap_batch(shmem_transport_ctx_t* ctx, void *const *target, const void *source,
+                            void *dest, const void *operand, size_t len, const int *pe,
+                            size_t count, shm_internal_datatype_t datatype)
+{
+    size_t i;
+
+    for (i = 0; i < count; i++)
+        shmem_transport_cswap_nbi(ctx, target[i], (const uint8_t *) source + i * len,
+                                  (uint8_t *) dest + i * len, (const uint8_t *) operand + i * len,
+                                  len, pe[i], datatype);
 }
 
 static inline
@@ -615,18 +639,10 @@ void
 shmem_transport_atomic_fetch(shmem_transport_ctx_t* ctx, void *target, const void *source, size_t len,
                              int pe, shm_internal_datatype_t datatype)
 {
-    uint8_t *remote_addr;
-    ucp_rkey_h rkey;
-    ucs_status_ptr_t pstatus;
-
-    shmem_transport_ucx_get_mr(source, pe, &remote_addr, &rkey);
+    static const uint64_t zero = 0;
 
-    pstatus = ucp_atomic_fetch_nb(shmem_transport_peers[pe].ep, UCP_ATOMIC_FETCH_OP_FADD, 0,
-                                  target, len, (uint64_t) remote_addr, rkey,
-                                  &shmem_transport_ucx_cb_nop);
-
-    ucs_status_t status = shmem_transport_ucx_complete_op(pstatus);
-    UCX_CHECK_STATUS(status);
+    shmem_transport_ucx_fetch_atomic_nbi(ctx, UCP_ATOMIC_OP_ADD, (void *) source, &zero,
+                                         target, len, pe);
 }
 
 static inline
@@ -634,41 +650,12 @@ void
 shmem_transport_atomic_set(shmem_transport_ctx_t* ctx, void *target, const void *source, size_t len,
                              int pe, shm_internal_datatype_t datatype)
 {
-    uint8_t *remote_addr;
-    ucp_rkey_h rkey;
-    ucs_status_ptr_t pstatus;
-    uint64_t value;
-
     /* XXX: Set is implemented as swap, so dest is thrown away. Allocate dest
      * as a static rather than on the stack to avoid needing to block on
      * completion before returning. */
     static uint64_t dest;
 
-    shmem_transport_ucx_get_mr(target, pe, &remote_addr, &rkey);
-
-    switch (len) {
-        case 1:
-            value = (uint64_t) *(uint8_t*)source;
-            break;
-        case 2:
-            value = (uint64_t) *(uint16_t*)source;
-            break;
-        case 4:
-            value = (uint64_t) *(uint32_t*)source;
-            break;
-        case 8:
-            value = (uint64_t) *(uint64_t*)source;
-            break;
-        default:
-            RAISE_ERROR_MSG("Unsupported datatype len=%zu\n", len);
-    }
-
-    pstatus = ucp_atomic_fetch_nb(shmem_transport_peers[pe].ep, UCP_ATOMIC_FETCH_OP_SWAP, value,
-                                  &dest, len, (uint64_t) remote_addr, rkey,
-                                  &shmem_transport_ucx_cb_nop);
-
-    ucs_status_t status = shmem_transport_ucx_release_op(pstatus);
-    UCX_CHECK_STATUS_INPROGRESS(status);
+    shmem_transport_ucx_fetch_atomic_nbi(ctx, UCP_ATOMIC_OP_SWAP, target, source, &dest, len, pe);
 }
 
 static inline
@@ -679,9 +666,10 @@ shmem_transport_mswap(shmem_transport_ctx_t* ctx, void *target, const void *sour
 {
     uint8_t *remote_addr;
     ucp_rkey_h rkey;
+    ucp_ep_h ep;
     int done = 0;
 
-    shmem_transport_ucx_get_mr(target, pe, &remote_addr, &rkey);
+    shmem_transport_ucx_get_mr(ctx, target, pe, &remote_addr, &rkey, &ep);
 
     if (len != 4)
         RAISE_ERROR_STR("Unsupported datatype");
@@ -691,14 +679,16 @@ shmem_transport_mswap(shmem_transport_ctx_t* ctx, void *target, const void *sour
         uint32_t v;
 
         shmem_transport_atomic_fetch(ctx, &v, target, len, pe, datatype);
+        shmem_transport_get_wait(ctx);
 
         uint32_t new = (v & ~*(uint32_t *)mask) | (*(uint32_t *)source & *(uint32_t *)mask);
 
         shmem_transport_cswap(ctx, target, &new, dest, &v, len, pe, datatype);
+        shmem_transport_get_wait(ctx);
         if (*(uint32_t *)dest == v) done = 1;
 
         /* Manual progress to avoid deadlock for application-level polling */
-        shmem_transport_probe();
+        shmem_transport_ucx_progress(ctx);
     }
 }
 
@@ -738,52 +728,6 @@ shmem_transport_put_signal_nbi(shmem_transport_ctx_t* ctx, void *target, const v
 
 /*** Functions below are not supported ***/
 
-static inline
-void shmem_transport_ct_create(shmem_transport_ct_t **ct_ptr)
-{
-    RAISE_ERROR_STR("No path to peer");
-}
-
-static inline
-void shmem_transport_ct_free(shmem_transport_ct_t **ct_ptr)
-{
-    RAISE_ERROR_STR("No path to peer");
-}
-
-static inline
-long shmem_transport_ct_get(shmem_transport_ct_t *ct)
-{
-    RAISE_ERROR_STR("No path to peer");
-    return 0;
-}
-
-static inline
-void shmem_transport_ct_set(shmem_transport_ct_t *ct, long value)
-{
-    RAISE_ERROR_STR("No path to peer");
-}
-
-static inline
-void shmem_transport_ct_wait(shmem_transport_ct_t *ct, long wait_for)
-{
-    RAISE_ERROR_STR("No path to peer");
-}
-
-static inline
-void
-shmem_transport_put_ct_nb(shmem_transport_ct_t *ct, void *target, const void
-                          *source, size_t len, int pe, long *completion)
-{
-    RAISE_ERROR_STR("No path to peer");
-}
-
-static inline
-void shmem_transport_get_ct(shmem_transport_ct_t *ct, void
-                            *target, const void *source, size_t len, int pe)
-{
-    RAISE_ERROR_STR("No path to peer");
-}
-
 /**
  * Query the value of the transport's received messages counter.
  */